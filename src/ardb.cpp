@@ -31,8 +31,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <algorithm>
 
-#define ARDB_STORAGE_CODEC_VER  1
+#define ARDB_STORAGE_CODEC_VER  ARDB_CODEC_MEMCMP
 #define ARDB_STORAGE_CONFIG_BUFFER_LEN 512
 
 OP_NAMESPACE_BEGIN
@@ -43,6 +44,7 @@ OP_NAMESPACE_BEGIN
     {
         if (m_enable)
         {
+            g_db->BeginBatchWrite(ctx);
             g_db->GetKeyValueEngine().BeginBatchWrite();
         }
     }
@@ -52,19 +54,27 @@ OP_NAMESPACE_BEGIN
         {
             if (m_success)
             {
+                uint64 start = get_current_epoch_micros();
                 int ret = g_db->GetKeyValueEngine().CommitBatchWrite();
+                g_db->GetStatistics().GetLatencyHistograms().StatEngine(ENGINE_OP_COMMIT,
+                        get_current_epoch_micros() - start);
                 m_ctx.write_success = ret == 0;
+                g_db->EndBatchWrite(ret == 0);
             }
             else
             {
                 g_db->GetKeyValueEngine().DiscardBatchWrite();
+                g_db->EndBatchWrite(false);
             }
         }
     }
 
     Ardb::Ardb(KeyValueEngineFactory& factory) :
             m_service(NULL), m_engine_factory(factory), m_engine(NULL), m_cache(m_cfg), m_watched_ctx(NULL), m_slave(
-                    this), m_starttime(0), m_compacting(false), m_last_compact_start_time(0), m_last_compact_duration(0)
+                    this), m_backup(this), m_starttime(0), m_compacting(false), m_last_compact_start_time(0), m_last_compact_duration(0), m_reclaim_pending(
+                    0), m_reclaimed_keys(0), m_reclaimed_elements(0), m_rechunk_pending(0), m_rechunked_keys(0), m_rechunk_skipped_keys(0), m_zrank_pending(0), m_zrank_built_keys(0), m_zrank_skipped_keys(0), m_key_counts_rebuild(
+            NULL), m_key_count_verifier(NULL), m_key_counts_restart(false), m_key_counts_stop(false), m_key_counts_dirty(
+            false), m_key_count_guesses(0)
     {
         g_db = this;
         struct RedisCommandHandlerSetting settingTable[] =
@@ -86,6 +96,7 @@ OP_NAMESPACE_BEGIN
                 { "import", REDIS_CMD_IMPORT, &Ardb::Import, 0, 1, "ars", 0, 0, 0 },
                 { "lastsave", REDIS_CMD_LASTSAVE, &Ardb::LastSave, 0, 0, "r", 0, 0, 0 },
                 { "slowlog", REDIS_CMD_SLOWLOG, &Ardb::SlowLog, 1, 2, "r", 0, 0, 0 },
+                { "latency", REDIS_CMD_LATENCY, &Ardb::Latency, 1, -1, "r", 0, 0, 0 },
                 { "dbsize", REDIS_CMD_DBSIZE, &Ardb::DBSize, 0, 0, "r", 0, 0, 0 },
                 { "config", REDIS_CMD_CONFIG, &Ardb::Config, 1, 3, "ar", 0, 0, 0 },
                 { "client", REDIS_CMD_CLIENT, &Ardb::Client, 1, 3, "ar", 0, 0, 0 },
@@ -103,108 +114,110 @@ OP_NAMESPACE_BEGIN
                 { "psync", REDIS_CMD_PSYNC, &Ardb::PSync, 2, 2, "ars", 0, 0, 0 },
                 { "apsync", REDIS_CMD_PSYNC, &Ardb::PSync, 2, -1, "ars", 0, 0, 0 },
                 { "select", REDIS_CMD_SELECT, &Ardb::Select, 1, 1, "r", 0, 0, 0 },
-                { "append", REDIS_CMD_APPEND, &Ardb::Append, 2, 2, "w", 0, 0, 0 },
-                { "get", REDIS_CMD_GET, &Ardb::Get, 1, 1, "r", 0, 0, 0 },
-                { "set", REDIS_CMD_SET, &Ardb::Set, 2, 7, "w", 0, 0, 0 },
+                { "append", REDIS_CMD_APPEND, &Ardb::Append, 2, 2, "wK", 0, 0, 0 },
+                { "get", REDIS_CMD_GET, &Ardb::Get, 1, 1, "rK", 0, 0, 0 },
+                { "set", REDIS_CMD_SET, &Ardb::Set, 2, 7, "wK", 0, 0, 0 },
                 { "del", REDIS_CMD_DEL, &Ardb::Del, 1, -1, "w", 0, 0, 0 },
-                { "exists", REDIS_CMD_EXISTS, &Ardb::Exists, 1, 1, "r", 0, 0, 0 },
-                { "expire", REDIS_CMD_EXPIRE, &Ardb::Expire, 2, 2, "w", 0, 0, 0 },
-                { "pexpire", REDIS_CMD_PEXPIRE, &Ardb::PExpire, 2, 2, "w", 0, 0, 0 },
-                { "expireat", REDIS_CMD_EXPIREAT, &Ardb::Expireat, 2, 2, "w", 0, 0, 0 },
-                { "pexpireat", REDIS_CMD_PEXPIREAT, &Ardb::PExpireat, 2, 2, "w", 0, 0, 0 },
-                { "persist", REDIS_CMD_PERSIST, &Ardb::Persist, 1, 1, "w", 1, 0, 0 },
-                { "ttl", REDIS_CMD_TTL, &Ardb::TTL, 1, 1, "r", 0, 0, 0 },
-                { "pttl", REDIS_CMD_PTTL, &Ardb::PTTL, 1, 1, "r", 0, 0, 0 },
-                { "type", REDIS_CMD_TYPE, &Ardb::Type, 1, 1, "r", 0, 0, 0 },
-                { "bitcount", REDIS_CMD_BITCOUNT, &Ardb::Bitcount, 1, 3, "r", 0, 0, 0 },
+                { "unlink", REDIS_CMD_UNLINK, &Ardb::Unlink, 1, -1, "w", 0, 0, 0 },
+                { "exists", REDIS_CMD_EXISTS, &Ardb::Exists, 1, 1, "rK", 0, 0, 0 },
+                { "expire", REDIS_CMD_EXPIRE, &Ardb::Expire, 2, 2, "wK", 0, 0, 0 },
+                { "pexpire", REDIS_CMD_PEXPIRE, &Ardb::PExpire, 2, 2, "wK", 0, 0, 0 },
+                { "expireat", REDIS_CMD_EXPIREAT, &Ardb::Expireat, 2, 2, "wK", 0, 0, 0 },
+                { "pexpireat", REDIS_CMD_PEXPIREAT, &Ardb::PExpireat, 2, 2, "wK", 0, 0, 0 },
+                { "persist", REDIS_CMD_PERSIST, &Ardb::Persist, 1, 1, "wK", 1, 0, 0 },
+                { "ttl", REDIS_CMD_TTL, &Ardb::TTL, 1, 1, "rK", 0, 0, 0 },
+                { "pttl", REDIS_CMD_PTTL, &Ardb::PTTL, 1, 1, "rK", 0, 0, 0 },
+                { "type", REDIS_CMD_TYPE, &Ardb::Type, 1, 1, "rK", 0, 0, 0 },
+                { "bitcount", REDIS_CMD_BITCOUNT, &Ardb::Bitcount, 1, 3, "rK", 0, 0, 0 },
                 { "bitop", REDIS_CMD_BITOP, &Ardb::Bitop, 3, -1, "w", 1, 0, 0 },
                 { "bitopcount", REDIS_CMD_BITOPCUNT, &Ardb::BitopCount, 2, -1, "w", 0, 0, 0 },
-                { "decr", REDIS_CMD_DECR, &Ardb::Decr, 1, 1, "w", 1, 0, 0 },
-                { "decrby", REDIS_CMD_DECRBY, &Ardb::Decrby, 2, 2, "w", 1, 0, 0 },
-                { "getbit", REDIS_CMD_GETBIT, &Ardb::GetBit, 2, 2, "r", 0, 0, 0 },
-                { "getrange", REDIS_CMD_GETRANGE, &Ardb::GetRange, 3, 3, "r", 0, 0, 0 },
-                { "getset", REDIS_CMD_GETSET, &Ardb::GetSet, 2, 2, "w", 1, 0, 0 },
-                { "incr", REDIS_CMD_INCR, &Ardb::Incr, 1, 1, "w", 1, 0, 0 },
-                { "incrby", REDIS_CMD_INCRBY, &Ardb::Incrby, 2, 2, "w", 1, 0, 0 },
-                { "incrbyfloat", REDIS_CMD_INCRBYFLOAT, &Ardb::IncrbyFloat, 2, 2, "w", 0, 0, 0 },
+                { "decr", REDIS_CMD_DECR, &Ardb::Decr, 1, 1, "wK", 1, 0, 0 },
+                { "decrby", REDIS_CMD_DECRBY, &Ardb::Decrby, 2, 2, "wK", 1, 0, 0 },
+                { "getbit", REDIS_CMD_GETBIT, &Ardb::GetBit, 2, 2, "rK", 0, 0, 0 },
+                { "getrange", REDIS_CMD_GETRANGE, &Ardb::GetRange, 3, 3, "rK", 0, 0, 0 },
+                { "getset", REDIS_CMD_GETSET, &Ardb::GetSet, 2, 2, "wK", 1, 0, 0 },
+                { "incr", REDIS_CMD_INCR, &Ardb::Incr, 1, 1, "wK", 1, 0, 0 },
+                { "incrby", REDIS_CMD_INCRBY, &Ardb::Incrby, 2, 2, "wK", 1, 0, 0 },
+                { "incrbyfloat", REDIS_CMD_INCRBYFLOAT, &Ardb::IncrbyFloat, 2, 2, "wK", 0, 0, 0 },
                 { "mget", REDIS_CMD_MGET, &Ardb::MGet, 1, -1, "w", 0, 0, 0 },
                 { "mset", REDIS_CMD_MSET, &Ardb::MSet, 2, -1, "w", 0, 0, 0 },
                 { "msetnx", REDIS_CMD_MSETNX, &Ardb::MSetNX, 2, -1, "w", 0, 0, 0 },
-                { "psetex", REDIS_CMD_PSETEX, &Ardb::MSetNX, 3, 3, "w", 0, 0, 0 },
-                { "setbit", REDIS_CMD_SETBIT, &Ardb::SetBit, 3, 3, "w", 0, 0, 0 },
-                { "setex", REDIS_CMD_SETEX, &Ardb::SetEX, 3, 3, "w", 0, 0, 0 },
-                { "setnx", REDIS_CMD_SETNX, &Ardb::SetNX, 2, 2, "w", 0, 0, 0 },
-                { "setrange", REDIS_CMD_SETEANGE, &Ardb::SetRange, 3, 3, "w", 0, 0, 0 },
-                { "strlen", REDIS_CMD_STRLEN, &Ardb::Strlen, 1, 1, "r", 0, 0, 0 },
-                { "hdel", REDIS_CMD_HDEL, &Ardb::HDel, 2, -1, "w", 0, 0, 0 },
-                { "hexists", REDIS_CMD_HEXISTS, &Ardb::HExists, 2, 2, "r", 0, 0, 0 },
-                { "hget", REDIS_CMD_HGET, &Ardb::HGet, 2, 2, "r", 0, 0, 0 },
-                { "hgetall", REDIS_CMD_HGETALL, &Ardb::HGetAll, 1, 1, "r", 0, 0, 0 },
-                { "hincrby", REDIS_CMD_HINCR, &Ardb::HIncrby, 3, 3, "w", 0, 0, 0 },
-                { "hmincrby", REDIS_CMD_HMINCRBY, &Ardb::HMIncrby, 3, -1, "w", 0, 0, 0 },
-                { "hincrbyfloat", REDIS_CMD_HINCRBYFLOAT, &Ardb::HIncrbyFloat, 3, 3, "w", 0, 0, 0 },
-                { "hkeys", REDIS_CMD_HKEYS, &Ardb::HKeys, 1, 1, "r", 0, 0, 0 },
-                { "hlen", REDIS_CMD_HLEN, &Ardb::HLen, 1, 1, "r", 0, 0, 0 },
-                { "hvals", REDIS_CMD_HVALS, &Ardb::HVals, 1, 1, "r", 0, 0, 0 },
-                { "hmget", REDIS_CMD_HMGET, &Ardb::HMGet, 2, -1, "r", 0, 0, 0 },
-                { "hset", REDIS_CMD_HSET, &Ardb::HSet, 3, 3, "w", 0, 0, 0 },
-                { "hsetnx", REDIS_CMD_HSETNX, &Ardb::HSetNX, 3, 3, "w", 0, 0, 0 },
-                { "hmset", REDIS_CMD_HMSET, &Ardb::HMSet, 3, -1, "w", 0, 0, 0 },
-                { "hreplace", REDIS_CMD_HREPLACE, &Ardb::HReplace, 3, -1, "w", 0, 0, 0 },
-                { "hscan", REDIS_CMD_HSCAN, &Ardb::HScan, 2, 6, "r", 0, 0, 0 },
-                { "scard", REDIS_CMD_SCARD, &Ardb::SCard, 1, 1, "r", 0, 0, 0 },
-                { "sadd", REDIS_CMD_SADD, &Ardb::SAdd, 2, -1, "w", 0, 0, 0 },
-                { "sreplace", REDIS_CMD_SADD, &Ardb::SReplace, 2, -1, "w", 0, 0, 0 },
+                { "psetex", REDIS_CMD_PSETEX, &Ardb::MSetNX, 3, 3, "wK", 0, 0, 0 },
+                { "setbit", REDIS_CMD_SETBIT, &Ardb::SetBit, 3, 3, "wK", 0, 0, 0 },
+                { "setex", REDIS_CMD_SETEX, &Ardb::SetEX, 3, 3, "wK", 0, 0, 0 },
+                { "setnx", REDIS_CMD_SETNX, &Ardb::SetNX, 2, 2, "wK", 0, 0, 0 },
+                { "setrange", REDIS_CMD_SETEANGE, &Ardb::SetRange, 3, 3, "wK", 0, 0, 0 },
+                { "strlen", REDIS_CMD_STRLEN, &Ardb::Strlen, 1, 1, "rK", 0, 0, 0 },
+                { "hdel", REDIS_CMD_HDEL, &Ardb::HDel, 2, -1, "wK", 0, 0, 0 },
+                { "hexists", REDIS_CMD_HEXISTS, &Ardb::HExists, 2, 2, "rK", 0, 0, 0 },
+                { "hget", REDIS_CMD_HGET, &Ardb::HGet, 2, 2, "rK", 0, 0, 0 },
+                { "hgetall", REDIS_CMD_HGETALL, &Ardb::HGetAll, 1, 1, "rK", 0, 0, 0 },
+                { "hincrby", REDIS_CMD_HINCR, &Ardb::HIncrby, 3, 3, "wK", 0, 0, 0 },
+                { "hmincrby", REDIS_CMD_HMINCRBY, &Ardb::HMIncrby, 3, -1, "wK", 0, 0, 0 },
+                { "hincrbyfloat", REDIS_CMD_HINCRBYFLOAT, &Ardb::HIncrbyFloat, 3, 3, "wK", 0, 0, 0 },
+                { "hkeys", REDIS_CMD_HKEYS, &Ardb::HKeys, 1, 1, "rK", 0, 0, 0 },
+                { "hlen", REDIS_CMD_HLEN, &Ardb::HLen, 1, 1, "rK", 0, 0, 0 },
+                { "hvals", REDIS_CMD_HVALS, &Ardb::HVals, 1, 1, "rK", 0, 0, 0 },
+                { "hmget", REDIS_CMD_HMGET, &Ardb::HMGet, 2, -1, "rK", 0, 0, 0 },
+                { "hset", REDIS_CMD_HSET, &Ardb::HSet, 3, 3, "wK", 0, 0, 0 },
+                { "hsetnx", REDIS_CMD_HSETNX, &Ardb::HSetNX, 3, 3, "wK", 0, 0, 0 },
+                { "hmset", REDIS_CMD_HMSET, &Ardb::HMSet, 3, -1, "wK", 0, 0, 0 },
+                { "hreplace", REDIS_CMD_HREPLACE, &Ardb::HReplace, 3, -1, "wK", 0, 0, 0 },
+                { "hscan", REDIS_CMD_HSCAN, &Ardb::HScan, 2, 6, "rK", 0, 0, 0 },
+                { "scard", REDIS_CMD_SCARD, &Ardb::SCard, 1, 1, "rK", 0, 0, 0 },
+                { "sadd", REDIS_CMD_SADD, &Ardb::SAdd, 2, -1, "wK", 0, 0, 0 },
+                { "sreplace", REDIS_CMD_SADD, &Ardb::SReplace, 2, -1, "wK", 0, 0, 0 },
                 { "sdiff", REDIS_CMD_SDIFF, &Ardb::SDiff, 2, -1, "r", 0, 0, 0 },
                 { "sdiffcount", REDIS_CMD_SDIFFCOUNT, &Ardb::SDiffCount, 2, -1, "r", 0, 0, 0 },
                 { "sdiffstore", REDIS_CMD_SDIFFSTORE, &Ardb::SDiffStore, 3, -1, "w", 0, 0, 0 },
                 { "sinter", REDIS_CMD_SINTER, &Ardb::SInter, 2, -1, "r", 0, 0, 0 },
                 { "sintercount", REDIS_CMD_SINTERCOUNT, &Ardb::SInterCount, 2, -1, "r", 0, 0, 0 },
                 { "sinterstore", REDIS_CMD_SINTERSTORE, &Ardb::SInterStore, 3, -1, "r", 0, 0, 0 },
-                { "sismember", REDIS_CMD_SISMEMBER, &Ardb::SIsMember, 2, 2, "r", 0, 0, 0 },
-                { "smembers", REDIS_CMD_SMEMBERS, &Ardb::SMembers, 1, 1, "r", 0, 0, 0 },
+                { "sismember", REDIS_CMD_SISMEMBER, &Ardb::SIsMember, 2, 2, "rK", 0, 0, 0 },
+                { "smismember", REDIS_CMD_SMISMEMBER, &Ardb::SMIsMember, 2, -1, "rK", 0, 0, 0 },
+                { "smembers", REDIS_CMD_SMEMBERS, &Ardb::SMembers, 1, 1, "rK", 0, 0, 0 },
                 { "smove", REDIS_CMD_SMOVE, &Ardb::SMove, 3, 3, "w", 0, 0, 0 },
-                { "spop", REDIS_CMD_SPOP, &Ardb::SPop, 1, 1, "w", 0, 0, 0 },
-                { "srandmember", REDIS_CMD_SRANMEMEBER, &Ardb::SRandMember, 1, 2, "r", 0, 0, 0 },
-                { "srem", REDIS_CMD_SREM, &Ardb::SRem, 2, -1, "w", 1, 0, 0 },
+                { "spop", REDIS_CMD_SPOP, &Ardb::SPop, 1, 1, "wK", 0, 0, 0 },
+                { "srandmember", REDIS_CMD_SRANMEMEBER, &Ardb::SRandMember, 1, 2, "rK", 0, 0, 0 },
+                { "srem", REDIS_CMD_SREM, &Ardb::SRem, 2, -1, "wK", 1, 0, 0 },
                 { "sunion", REDIS_CMD_SUNION, &Ardb::SUnion, 2, -1, "r", 0, 0, 0 },
                 { "sunionstore", REDIS_CMD_SUNIONSTORE, &Ardb::SUnionStore, 3, -1, "r", 0, 0, 0 },
                 { "sunioncount", REDIS_CMD_SUNIONCOUNT, &Ardb::SUnionCount, 2, -1, "r", 0, 0, 0 },
-                { "sscan", REDIS_CMD_SSCAN, &Ardb::SScan, 2, 6, "r", 0, 0, 0 },
-                { "zadd", REDIS_CMD_ZADD, &Ardb::ZAdd, 3, -1, "w", 0, 0, 0 },
-                { "zcard", REDIS_CMD_ZCARD, &Ardb::ZCard, 1, 1, "r", 0, 0, 0 },
-                { "zcount", REDIS_CMD_ZCOUNT, &Ardb::ZCount, 3, 3, "r", 0, 0, 0 },
-                { "zincrby", REDIS_CMD_ZINCRBY, &Ardb::ZIncrby, 3, 3, "w", 0, 0, 0 },
-                { "zrange", REDIS_CMD_ZRANGE, &Ardb::ZRange, 3, 4, "r", 0, 0, 0 },
-                { "zrangebyscore", REDIS_CMD_ZRANGEBYSCORE, &Ardb::ZRangeByScore, 3, 7, "r", 0, 0, 0 },
-                { "zrank", REDIS_CMD_ZRANK, &Ardb::ZRank, 2, 2, "r", 0, 0, 0 },
-                { "zrem", REDIS_CMD_ZREM, &Ardb::ZRem, 2, -1, "w", 0, 0, 0 },
-                { "zremrangebyrank", REDIS_CMD_ZREMRANGEBYRANK, &Ardb::ZRemRangeByRank, 3, 3, "w", 0, 0, 0 },
-                { "zremrangebyscore", REDIS_CMD_ZREMRANGEBYSCORE, &Ardb::ZRemRangeByScore, 3, 3, "w", 0, 0, 0 },
-                { "zrevrange", REDIS_CMD_ZREVRANGE, &Ardb::ZRevRange, 3, 4, "r", 0, 0, 0 },
-                { "zrevrangebyscore", REDIS_CMD_ZREVRANGEBYSCORE, &Ardb::ZRevRangeByScore, 3, 7, "r", 0, 0, 0 },
+                { "sscan", REDIS_CMD_SSCAN, &Ardb::SScan, 2, 6, "rK", 0, 0, 0 },
+                { "zadd", REDIS_CMD_ZADD, &Ardb::ZAdd, 3, -1, "wK", 0, 0, 0 },
+                { "zcard", REDIS_CMD_ZCARD, &Ardb::ZCard, 1, 1, "rK", 0, 0, 0 },
+                { "zcount", REDIS_CMD_ZCOUNT, &Ardb::ZCount, 3, 3, "rK", 0, 0, 0 },
+                { "zincrby", REDIS_CMD_ZINCRBY, &Ardb::ZIncrby, 3, 3, "wK", 0, 0, 0 },
+                { "zrange", REDIS_CMD_ZRANGE, &Ardb::ZRange, 3, 4, "rK", 0, 0, 0 },
+                { "zrangebyscore", REDIS_CMD_ZRANGEBYSCORE, &Ardb::ZRangeByScore, 3, 7, "rK", 0, 0, 0 },
+                { "zrank", REDIS_CMD_ZRANK, &Ardb::ZRank, 2, 2, "rK", 0, 0, 0 },
+                { "zrem", REDIS_CMD_ZREM, &Ardb::ZRem, 2, -1, "wK", 0, 0, 0 },
+                { "zremrangebyrank", REDIS_CMD_ZREMRANGEBYRANK, &Ardb::ZRemRangeByRank, 3, 3, "wK", 0, 0, 0 },
+                { "zremrangebyscore", REDIS_CMD_ZREMRANGEBYSCORE, &Ardb::ZRemRangeByScore, 3, 3, "wK", 0, 0, 0 },
+                { "zrevrange", REDIS_CMD_ZREVRANGE, &Ardb::ZRevRange, 3, 4, "rK", 0, 0, 0 },
+                { "zrevrangebyscore", REDIS_CMD_ZREVRANGEBYSCORE, &Ardb::ZRevRangeByScore, 3, 7, "rK", 0, 0, 0 },
                 { "zinterstore", REDIS_CMD_ZINTERSTORE, &Ardb::ZInterStore, 3, -1, "w", 0, 0, 0 },
                 { "zunionstore", REDIS_CMD_ZUNIONSTORE, &Ardb::ZUnionStore, 3, -1, "w", 0, 0, 0 },
-                { "zrevrank", REDIS_CMD_ZREVRANK, &Ardb::ZRevRank, 2, 2, "r", 0, 0, 0 },
-                { "zscore", REDIS_CMD_ZSCORE, &Ardb::ZScore, 2, 2, "r", 0, 0, 0 },
-                { "zscan", REDIS_CMD_ZSCORE, &Ardb::ZScan, 2, 6, "r", 0, 0, 0 },
-                { "zlexcount", REDIS_CMD_ZLEXCOUNT, &Ardb::ZLexCount, 3, 3, "r", 0, 0, 0 },
-                { "zrangebylex", REDIS_CMD_ZRANGEBYLEX, &Ardb::ZRangeByLex, 3, 6, "r", 0, 0, 0 },
-                { "zrevrangebylex", REDIS_CMD_ZREVRANGEBYLEX, &Ardb::ZRangeByLex, 3, 6, "r", 0, 0, 0 },
-                { "zremrangebylex", REDIS_CMD_ZREMRANGEBYLEX, &Ardb::ZRemRangeByLex, 3, 3, "w", 0, 0, 0 },
-                { "lindex", REDIS_CMD_LINDEX, &Ardb::LIndex, 2, 2, "r", 0, 0, 0 },
-                { "linsert", REDIS_CMD_LINSERT, &Ardb::LInsert, 4, 4, "w", 0, 0, 0 },
-                { "llen", REDIS_CMD_LLEN, &Ardb::LLen, 1, 1, "r", 0, 0, 0 },
-                { "lpop", REDIS_CMD_LPOP, &Ardb::LPop, 1, 1, "w", 0, 0, 0 },
-                { "lpush", REDIS_CMD_LPUSH, &Ardb::LPush, 2, -1, "w", 0, 0, 0 },
-                { "lpushx", REDIS_CMD_LPUSHX, &Ardb::LPushx, 2, 2, "w", 0, 0, 0 },
-                { "lrange", REDIS_CMD_LRANGE, &Ardb::LRange, 3, 3, "r", 0, 0, 0 },
-                { "lrem", REDIS_CMD_LREM, &Ardb::LRem, 3, 3, "w", 0, 0, 0 },
-                { "lset", REDIS_CMD_LSET, &Ardb::LSet, 3, 3, "w", 0, 0, 0 },
-                { "ltrim", REDIS_CMD_LTRIM, &Ardb::LTrim, 3, 3, "w", 0, 0, 0 },
-                { "rpop", REDIS_CMD_RPOP, &Ardb::RPop, 1, 1, "w", 0, 0, 0 },
-                { "rpush", REDIS_CMD_RPUSH, &Ardb::RPush, 2, -1, "w", 0, 0, 0 },
-                { "rpushx", REDIS_CMD_RPUSHX, &Ardb::RPushx, 2, 2, "w", 0, 0, 0 },
+                { "zrevrank", REDIS_CMD_ZREVRANK, &Ardb::ZRevRank, 2, 2, "rK", 0, 0, 0 },
+                { "zscore", REDIS_CMD_ZSCORE, &Ardb::ZScore, 2, 2, "rK", 0, 0, 0 },
+                { "zscan", REDIS_CMD_ZSCORE, &Ardb::ZScan, 2, 6, "rK", 0, 0, 0 },
+                { "zlexcount", REDIS_CMD_ZLEXCOUNT, &Ardb::ZLexCount, 3, 3, "rK", 0, 0, 0 },
+                { "zrangebylex", REDIS_CMD_ZRANGEBYLEX, &Ardb::ZRangeByLex, 3, 6, "rK", 0, 0, 0 },
+                { "zrevrangebylex", REDIS_CMD_ZREVRANGEBYLEX, &Ardb::ZRangeByLex, 3, 6, "rK", 0, 0, 0 },
+                { "zremrangebylex", REDIS_CMD_ZREMRANGEBYLEX, &Ardb::ZRemRangeByLex, 3, 3, "wK", 0, 0, 0 },
+                { "lindex", REDIS_CMD_LINDEX, &Ardb::LIndex, 2, 2, "rK", 0, 0, 0 },
+                { "linsert", REDIS_CMD_LINSERT, &Ardb::LInsert, 4, 4, "wK", 0, 0, 0 },
+                { "llen", REDIS_CMD_LLEN, &Ardb::LLen, 1, 1, "rK", 0, 0, 0 },
+                { "lpop", REDIS_CMD_LPOP, &Ardb::LPop, 1, 1, "wK", 0, 0, 0 },
+                { "lpush", REDIS_CMD_LPUSH, &Ardb::LPush, 2, -1, "wK", 0, 0, 0 },
+                { "lpushx", REDIS_CMD_LPUSHX, &Ardb::LPushx, 2, 2, "wK", 0, 0, 0 },
+                { "lrange", REDIS_CMD_LRANGE, &Ardb::LRange, 3, 3, "rK", 0, 0, 0 },
+                { "lrem", REDIS_CMD_LREM, &Ardb::LRem, 3, 3, "wK", 0, 0, 0 },
+                { "lset", REDIS_CMD_LSET, &Ardb::LSet, 3, 3, "wK", 0, 0, 0 },
+                { "ltrim", REDIS_CMD_LTRIM, &Ardb::LTrim, 3, 3, "wK", 0, 0, 0 },
+                { "rpop", REDIS_CMD_RPOP, &Ardb::RPop, 1, 1, "wK", 0, 0, 0 },
+                { "rpush", REDIS_CMD_RPUSH, &Ardb::RPush, 2, -1, "wK", 0, 0, 0 },
+                { "rpushx", REDIS_CMD_RPUSHX, &Ardb::RPushx, 2, 2, "wK", 0, 0, 0 },
                 { "rpoplpush", REDIS_CMD_RPOPLPUSH, &Ardb::RPopLPush, 2, 2, "w", 0, 0, 0 },
                 { "blpop", REDIS_CMD_BLPOP, &Ardb::BLPop, 2, -1, "w", 0, 0, 0 },
                 { "brpop", REDIS_CMD_BRPOP, &Ardb::BRPop, 2, -1, "w", 0, 0, 0 },
@@ -224,11 +237,11 @@ OP_NAMESPACE_BEGIN
                 { "script", REDIS_CMD_SCRIPT, &Ardb::Script, 1, -1, "s", 0, 0, 0 },
                 { "randomkey", REDIS_CMD_RANDOMKEY, &Ardb::Randomkey, 0, 0, "r", 0, 0, 0 },
                 { "scan", REDIS_CMD_SCAN, &Ardb::Scan, 1, 5, "r", 0, 0, 0 },
-                { "geoadd", REDIS_CMD_GEO_ADD, &Ardb::GeoAdd, 5, -1, "w", 0, 0, 0 },
-                { "geosearch", REDIS_CMD_GEO_SEARCH, &Ardb::GeoSearch, 5, -1, "r", 0, 0, 0 },
+                { "geoadd", REDIS_CMD_GEO_ADD, &Ardb::GeoAdd, 5, -1, "wK", 0, 0, 0 },
+                { "geosearch", REDIS_CMD_GEO_SEARCH, &Ardb::GeoSearch, 5, -1, "rK", 0, 0, 0 },
                 { "cache", REDIS_CMD_CACHE, &Ardb::Cache, 2, 2, "r", 0, 0, 0 },
                 { "auth", REDIS_CMD_AUTH, &Ardb::Auth, 1, 1, "r", 0, 0, 0 },
-                { "pfadd", REDIS_CMD_PFADD, &Ardb::PFAdd, 2, -1, "w", 0, 0, 0 },
+                { "pfadd", REDIS_CMD_PFADD, &Ardb::PFAdd, 2, -1, "wK", 0, 0, 0 },
                 { "pfcount", REDIS_CMD_PFCOUNT, &Ardb::PFCount, 1, -1, "w", 0, 0, 0 },
                 { "pfmerge", REDIS_CMD_PFMERGE, &Ardb::PFMerge, 2, -1, "w", 0, 0, 0 }, };
 
@@ -259,17 +272,38 @@ OP_NAMESPACE_BEGIN
                     case 'R':
                         settingTable[i].flags |= ARDB_CMD_RANDOM;
                         break;
+                    case 'K':
+                        settingTable[i].flags |= ARDB_CMD_SINGLE_KEY;
+                        break;
                     default:
                         break;
                 }
                 f++;
             }
-            m_settings[settingTable[i].name] = settingTable[i];
+            settingTable[i].name_len = strlen(settingTable[i].name);
+            uint32 id = 0;
+            while (id < m_settings.size() && strcmp(m_settings[id].name, settingTable[i].name))
+            {
+                id++;
+            }
+            settingTable[i].id = id;
+            if (id == m_settings.size())
+            {
+                m_settings.push_back(settingTable[i]);
+            }
+            else
+            {
+                m_settings[id] = settingTable[i];
+            }
         }
+        CompileCommandTable();
+        m_stat.GetCommandStat().Init(m_settings.size());
+        m_stat.GetLatencyHistograms().Init(m_settings.size());
     }
 
     Ardb::~Ardb()
     {
+        StopKeyCountVerifier();
         DELETE(m_engine);
     }
 
@@ -329,18 +363,142 @@ OP_NAMESPACE_BEGIN
         StringStringMap::iterator it = m_cfg.rename_commands.begin();
         while (it != m_cfg.rename_commands.end())
         {
-            std::string cmd = string_tolower(it->first);
-            RedisCommandHandlerSettingTable::iterator found = m_settings.find(cmd);
-            if (found != m_settings.end())
+            int32 id = LookupCommand(it->first);
+            if (id >= 0)
             {
-                RedisCommandHandlerSetting setting = found->second;
-                m_settings.erase(found);
-                m_settings[it->second] = setting;
+                //the command already having the new name is shadowed, an empty name disables the command
+                int32 shadowed = LookupCommand(it->second);
+                if (shadowed >= 0 && shadowed != id)
+                {
+                    m_settings[shadowed].name_len = 0;
+                }
+                m_command_names.push_back(it->second);
+                m_settings[id].name = m_command_names.back().c_str();
+                m_settings[id].name_len = m_command_names.back().size();
+                CompileCommandTable();
             }
             it++;
         }
     }
 
+    static inline uint32 command_hash(const char* name, size_t len, uint32 seed)
+    {
+        uint32 h = 2166136261U ^ seed;
+        for (size_t i = 0; i < len; i++)
+        {
+            unsigned char c = name[i];
+            if (c >= 'A' && c <= 'Z')
+            {
+                c += 'a' - 'A';
+            }
+            h = (h ^ c) * 16777619U;
+        }
+        h ^= h >> 16;
+        h *= 0x85ebca6bU;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35U;
+        h ^= h >> 16;
+        return h;
+    }
+
+    /*
+     * Build a perfect hash of command names: names are grouped into buckets by a first hash, then each bucket,
+     * largest first, searches a seed of the second hash placing all its names into free slots.
+     */
+    void Ardb::CompileCommandTable()
+    {
+        uint32 bucket_count = 1;
+        while (bucket_count < m_settings.size())
+        {
+            bucket_count <<= 1;
+        }
+        uint32 slot_count = bucket_count * 2;
+        while (true)
+        {
+            std::vector<std::vector<uint32> > buckets(bucket_count);
+            for (uint32 i = 0; i < m_settings.size(); i++)
+            {
+                const RedisCommandHandlerSetting& setting = m_settings[i];
+                if (0 == setting.name_len)
+                {
+                    continue;
+                }
+                std::vector<uint32>& bucket = buckets[command_hash(setting.name, setting.name_len, 0)
+                        & (bucket_count - 1)];
+                uint32 j = 0;
+                while (j < bucket.size()
+                        && (m_settings[bucket[j]].name_len != setting.name_len
+                                || strncasecmp(m_settings[bucket[j]].name, setting.name, setting.name_len)))
+                {
+                    j++;
+                }
+                //names are unique, the check keeps the seed search from never ending
+                if (j == bucket.size())
+                {
+                    bucket.push_back(i);
+                }
+            }
+            std::vector<std::pair<uint32, uint32> > order;
+            for (uint32 i = 0; i < bucket_count; i++)
+            {
+                if (!buckets[i].empty())
+                {
+                    order.push_back(std::make_pair(buckets[i].size(), i));
+                }
+            }
+            std::sort(order.rbegin(), order.rend());
+            m_command_seeds.assign(bucket_count, 0);
+            m_command_slots.assign(slot_count, -1);
+            bool placed = true;
+            for (uint32 i = 0; placed && i < order.size(); i++)
+            {
+                std::vector<uint32>& bucket = buckets[order[i].second];
+                std::vector<uint32> slots(bucket.size());
+                placed = false;
+                for (uint32 seed = 1; !placed && seed < 65536; seed++)
+                {
+                    placed = true;
+                    for (uint32 j = 0; placed && j < bucket.size(); j++)
+                    {
+                        const RedisCommandHandlerSetting& setting = m_settings[bucket[j]];
+                        slots[j] = command_hash(setting.name, setting.name_len, seed) & (slot_count - 1);
+                        placed = m_command_slots[slots[j]] < 0
+                                && std::find(slots.begin(), slots.begin() + j, slots[j]) == slots.begin() + j;
+                    }
+                    if (placed)
+                    {
+                        m_command_seeds[order[i].second] = seed;
+                        for (uint32 j = 0; j < bucket.size(); j++)
+                        {
+                            m_command_slots[slots[j]] = bucket[j];
+                        }
+                    }
+                }
+            }
+            if (placed)
+            {
+                return;
+            }
+            slot_count <<= 1;
+        }
+    }
+
+    int32 Ardb::LookupCommand(const std::string& cmd)
+    {
+        if (m_command_seeds.empty() || cmd.empty())
+        {
+            return -1;
+        }
+        uint32 bucket = command_hash(cmd.data(), cmd.size(), 0) & (m_command_seeds.size() - 1);
+        uint32 slot = command_hash(cmd.data(), cmd.size(), m_command_seeds[bucket]) & (m_command_slots.size() - 1);
+        int32 id = m_command_slots[slot];
+        if (id < 0 || m_settings[id].name_len != cmd.size() || strncasecmp(m_settings[id].name, cmd.data(), cmd.size()))
+        {
+            return -1;
+        }
+        return id;
+    }
+
     bool Ardb::IsEmpty()
     {
         KeyObject from;
@@ -354,20 +512,34 @@ OP_NAMESPACE_BEGIN
         return empty;
     }
 
+    int Ardb::SaveStorageConfig()
+    {
+        std::string storage_cfg_path = m_cfg.data_base_path + "/.storage.cfg";
+        char buffer[ARDB_STORAGE_CONFIG_BUFFER_LEN];
+        memset(buffer, 0, sizeof(buffer));
+        StorageConfig* scfg = (StorageConfig*) buffer;
+        *scfg = m_storage_config;
+        std::string content;
+        content.assign(buffer, ARDB_STORAGE_CONFIG_BUFFER_LEN);
+        return file_write_content(storage_cfg_path, content);
+    }
+
     int Ardb::CheckStorageCodecVersion()
     {
         m_storage_config.codec_ver = ARDB_STORAGE_CODEC_VER;
         std::string storage_cfg_path = m_cfg.data_base_path + "/.storage.cfg";
         if (!is_file_exist(storage_cfg_path))
         {
-            char buffer[ARDB_STORAGE_CONFIG_BUFFER_LEN];
-            memset(buffer, 0, sizeof(buffer));
-            StorageConfig* scfg = (StorageConfig*) buffer;
-            scfg->codec_ver = ARDB_STORAGE_CODEC_VER;
-            std::string content;
-            content.assign(buffer, ARDB_STORAGE_CONFIG_BUFFER_LEN);
-            file_write_content(storage_cfg_path, content);
-            m_storage_config = *scfg;
+            /*
+             * data written before the storage config existed always used the varint codec
+             */
+            std::deque<std::string> fs;
+            std::string engine_path = m_cfg.data_base_path + "/" + m_engine_factory.GetName();
+            if (is_dir_exist(engine_path) && list_subfiles(engine_path, fs) == 0 && !fs.empty())
+            {
+                m_storage_config.codec_ver = ARDB_CODEC_VARINT;
+            }
+            SaveStorageConfig();
         }
         else
         {
@@ -380,7 +552,110 @@ OP_NAMESPACE_BEGIN
             }
             StorageConfig* scfg = (StorageConfig*) (buffer.GetRawBuffer());
             m_storage_config = *scfg;
+            if (m_storage_config.codec_ver < ARDB_CODEC_VARINT || m_storage_config.codec_ver > ARDB_STORAGE_CODEC_VER)
+            {
+                ERROR_LOG("Unsupported storage codec version:%d in %s", m_storage_config.codec_ver,
+                        storage_cfg_path.c_str());
+                return -1;
+            }
+        }
+        if (m_storage_config.codec_ver < ARDB_STORAGE_CODEC_VER)
+        {
+            WARN_LOG("Storage is using legacy key codec %d, run 'ardb-server <conf> --migrate-codec' offline to upgrade.",
+                    m_storage_config.codec_ver);
+        }
+        KeyObject::SetCodecVersion(m_storage_config.codec_ver);
+        return 0;
+    }
+
+    /*
+     * Offline rewrite of all keys from the varint codec into the memcmp codec. Keys are copied into a
+     * fresh engine created by 'target' under 'target_dir', which then replaces the old engine dir.
+     * The old engine dir is kept as '<engine>.varint'.
+     */
+    int Ardb::MigrateStorageCodec(const ArdbConfig& cfg, KeyValueEngineFactory& target, const std::string& target_dir)
+    {
+        m_cfg = cfg;
+        if (0 != CheckStorageCodecVersion())
+        {
+            return -1;
+        }
+        if (m_storage_config.codec_ver >= ARDB_CODEC_MEMCMP)
+        {
+            INFO_LOG("Storage already uses codec %d, nothing to migrate.", m_storage_config.codec_ver);
+            return 0;
+        }
+        std::string name = m_engine_factory.GetName();
+        KeyObject::SetCodecVersion(ARDB_CODEC_VARINT);
+        KeyValueEngine* src = m_engine_factory.CreateDB(name);
+        KeyObject::SetCodecVersion(ARDB_CODEC_MEMCMP);
+        KeyValueEngine* dst = target.CreateDB(name);
+        if (NULL == src || NULL == dst)
+        {
+            ERROR_LOG("Failed to open engines for codec migration.");
+            if (NULL != src)
+            {
+                m_engine_factory.CloseDB(src);
+            }
+            if (NULL != dst)
+            {
+                target.CloseDB(dst);
+            }
+            return -1;
+        }
+        Options options;
+        options.read_fill_cache = false;
+        Iterator* iter = src->Find(Slice(), options);
+        uint64 count = 0, invalid = 0;
+        int err = 0;
+        iter->SeekToFirst();
+        dst->BeginBatchWrite();
+        while (iter->Valid())
+        {
+            KeyObject k;
+            if (!decode_key(iter->Key(), k, ARDB_CODEC_VARINT))
+            {
+                invalid++;
+                iter->Next();
+                continue;
+            }
+            k.Encode(ARDB_CODEC_MEMCMP);
+            Slice kbuf(k.encode_buf.GetRawReadBuffer(), k.encode_buf.ReadableBytes());
+            if (0 != (err = dst->Put(kbuf, iter->Value(), options)))
+            {
+                break;
+            }
+            count++;
+            if (count % 10000 == 0)
+            {
+                dst->CommitBatchWrite();
+                dst->BeginBatchWrite();
+                INFO_LOG("%" PRIu64 " keys migrated.", count);
+            }
+            iter->Next();
+        }
+        dst->CommitBatchWrite();
+        DELETE(iter);
+        m_engine_factory.CloseDB(src);
+        target.CloseDB(dst);
+        if (0 != err)
+        {
+            ERROR_LOG("Failed to write migrated key with err:%d", err);
+            return -1;
         }
+        std::string engine_path = m_cfg.data_base_path + "/" + name;
+        std::string backup_path = engine_path + ".varint";
+        if (0 != rename(engine_path.c_str(), backup_path.c_str())
+                || 0 != rename((target_dir + "/" + name).c_str(), engine_path.c_str()))
+        {
+            ERROR_LOG("Failed to replace %s with migrated data for reason:%s", engine_path.c_str(), strerror(errno));
+            return -1;
+        }
+        rmdir(target_dir.c_str());
+        m_storage_config.codec_ver = ARDB_CODEC_MEMCMP;
+        SaveStorageConfig();
+        INFO_LOG("Migrated %" PRIu64 " keys into memcmp codec, skipped %" PRIu64 " invalid keys, old data kept at %s",
+                count, invalid, backup_path.c_str());
         return 0;
     }
 
@@ -411,13 +686,19 @@ OP_NAMESPACE_BEGIN
         }
 
         INFO_LOG("Start init storage engine.");
+        if (CheckStorageCodecVersion() != 0)
+        {
+            return -1;
+        }
         m_engine = m_engine_factory.CreateDB(m_engine_factory.GetName().c_str());
-        if (NULL == m_engine || CheckStorageCodecVersion() != 0)
+        if (NULL == m_engine)
         {
             ERROR_LOG("Faild to open db:%s", m_cfg.home.c_str());
             return -1;
         }
         RenameCommand();
+        LoadReclaimKeys();
+        LoadKeyCounts();
 
         m_stat.Init();
         return 0;
@@ -426,6 +707,10 @@ OP_NAMESPACE_BEGIN
     void Ardb::Start()
     {
         ArdbLogger::InitDefaultLogger(m_cfg.loglevel, m_cfg.logfile);
+        if (m_cfg.log_async)
+        {
+            ArdbLogger::StartAsyncLogging(m_cfg.log_async_buffer_size);
+        }
         uint32 worker_count = 0;
         for (uint32 i = 0; i < m_cfg.thread_pool_sizes.size(); i++)
         {
@@ -441,7 +726,7 @@ OP_NAMESPACE_BEGIN
         }
         m_service = new ChannelService(m_cfg.max_clients + 32 + GetKeyValueEngine().MaxOpenFiles());
         m_service->SetThreadPoolSize(worker_count);
-        m_key_lock.Init(worker_count + 8);
+        m_key_lock.Init(worker_count + 8, m_cfg.key_lock_shards);
 
         ChannelOptions ops;
         ops.tcp_nodelay = true;
@@ -517,6 +802,11 @@ OP_NAMESPACE_BEGIN
         m_service->RegisterUserEventCallback(ServerEventCallback, this);
 
         m_cron.Start();
+        m_expire.Start(m_cfg.expire_sweeper_threads);
+        if (m_key_counts_dirty)
+        {
+            RebuildKeyCounts();
+        }
         m_cache.Init();
         m_cache.Start();
 
@@ -528,7 +818,10 @@ OP_NAMESPACE_BEGIN
         m_service->Start();
         sexit: m_master.Stop();
         m_cron.StopSelf();
+        m_expire.StopSelf();
         m_cache.StopSelf();
+        StopKeyCountVerifier();
+        SaveKeyCounts(true);
         DELETE(m_service);
         DELETE(m_engine);
         ArdbLogger::DestroyDefaultLogger();
@@ -578,12 +871,20 @@ OP_NAMESPACE_BEGIN
         uint64 start = get_current_epoch_micros();
         int ret = GetKeyValueEngine().Del(key, options);
         uint64 end = get_current_epoch_micros();
-        m_stat.StatWriteLatency(end - start);
+        m_stat.StatWriteLatency(end - start, ENGINE_OP_DEL);
         ctx.data_change = true;
         return ret;
     }
     int Ardb::SetKeyValue(Context& ctx, ValueObject& value)
     {
+        if (value.type == ZSET_META && NULL != value.attach.zrank)
+        {
+            ZSetRankFlush(ctx, value);
+        }
+        if (value.type == LIST_META && NULL != value.attach.lchunk)
+        {
+            ListChunkFlush(ctx, value);
+        }
         if (!value.key.encode_buf.Readable())
         {
             value.key.Encode();
@@ -591,6 +892,7 @@ OP_NAMESPACE_BEGIN
         Slice kbuf(value.key.encode_buf.GetRawReadBuffer(), value.key.encode_buf.ReadableBytes());
         value.Encode();
         Slice vbuf(value.encode_buf.GetRawReadBuffer(), value.encode_buf.ReadableBytes());
+        uint8 old_type = KEY_META == value.key.type ? LookupMetaType(ctx, value.key, value.type) : KEY_END;
         int ret = SetRaw(ctx, kbuf, vbuf);
         if (0 == ret)
         {
@@ -598,6 +900,10 @@ OP_NAMESPACE_BEGIN
             options.from_read_result = false;
             options.cmd = ctx.current_cmd_type;
             m_cache.Put(value.key, value, options);
+            if (KEY_META == value.key.type)
+            {
+                CountKey(ctx, value.key, old_type, value.type);
+            }
         }
         return ret;
     }
@@ -613,6 +919,49 @@ OP_NAMESPACE_BEGIN
         m_stat.StatSeekLatency(end - start);
     }
 
+    /*
+     * Forward only iterator over the entries sharing the (db, type, key) prefix of 'from', it becomes invalid
+     * at the prefix boundary. Callers must not Prev() or re-seek outside the prefix.
+     */
+    Iterator* Ardb::IteratorPrefix(KeyObject& from)
+    {
+        if (!from.encode_buf.Readable())
+        {
+            from.Encode();
+        }
+        Slice kbuf(from.encode_buf.GetRawReadBuffer(), from.encode_buf.ReadableBytes());
+        /*
+         * key + '\0' is the immediate successor of key under both key codecs, elements of a versioned key end
+         * where the next version of it starts.
+         */
+        std::string next_key(from.key.data(), from.key.size());
+        KeyObject bound;
+        bound.db = from.db;
+        bound.type = from.type;
+        if (from.version > 0)
+        {
+            bound.version = from.version + 1;
+        }
+        else
+        {
+            next_key.push_back(0);
+        }
+        bound.key = next_key;
+        bound.Encode();
+        Options options;
+        options.read_fill_cache = false;
+        options.upper_bound = Slice(bound.encode_buf.GetRawReadBuffer(), bound.encode_buf.ReadableBytes());
+        uint64 start = get_current_epoch_micros();
+        Iterator* it = GetKeyValueEngine().Find(kbuf, options);
+        uint64 end = get_current_epoch_micros();
+        m_stat.StatSeekLatency(end - start);
+        if (NULL != it && !it->Valid())
+        {
+            DELETE(it);
+        }
+        return it;
+    }
+
     Iterator* Ardb::IteratorKeyValue(KeyObject& from, bool match_key)
     {
         if (!from.encode_buf.Readable())
@@ -637,7 +986,7 @@ OP_NAMESPACE_BEGIN
                     DELETE(it);
                     return NULL;
                 }
-                if (kk.db != from.db || kk.key != from.key)
+                if (kk.db != from.db || kk.key != from.key || kk.version != from.version)
                 {
                     DELETE(it);
                     return NULL;
@@ -656,8 +1005,14 @@ OP_NAMESPACE_BEGIN
         if (NULL != kv)
         {
             int err = m_cache.Get(key, *kv);
-            if (0 == err || ERR_NOT_EXIST == err)
+            if (0 == err)
+            {
+                RecordMetaType(ctx, key, kv->type);
+                return err;
+            }
+            if (ERR_NOT_EXIST == err)
             {
+                RecordMetaType(ctx, key, KEY_END);
                 return err;
             }
         }
@@ -684,11 +1039,100 @@ OP_NAMESPACE_BEGIN
                 options.cmd = ctx.current_cmd_type;
                 m_cache.Put(key, *kv, options);
             }
+            RecordMetaType(ctx, key, v.empty() ? KEY_END : (uint8) v[0]);
             return 0;
         }
+        RecordMetaType(ctx, key, KEY_END);
         return ERR_NOT_EXIST;
     }
 
+    struct EncodedKeyLess
+    {
+            const ValueObjectArray& kvs;
+            EncodedKeyLess(const ValueObjectArray& v) :
+                    kvs(v)
+            {
+            }
+            bool operator()(size_t a, size_t b) const
+            {
+                const Buffer& x = kvs[a].key.encode_buf;
+                const Buffer& y = kvs[b].key.encode_buf;
+                if (CommonComparator::Bytewise())
+                {
+                    return Slice(x.GetRawReadBuffer(), x.ReadableBytes()).compare(
+                            Slice(y.GetRawReadBuffer(), y.ReadableBytes())) < 0;
+                }
+                return CommonComparator::Compare(x.GetRawReadBuffer(), x.ReadableBytes(), y.GetRawReadBuffer(),
+                        y.ReadableBytes()) < 0;
+            }
+    };
+
+    /*
+     * Batched GetKeyValue, kvs[i].key must be set by the caller. Cache misses are read with one engine MultiGet
+     * in comparator order so that the engine walks its blocks sequentially.
+     */
+    void Ardb::MultiGetKeyValue(Context& ctx, ValueObjectArray& kvs, std::vector<int>& errs)
+    {
+        errs.assign(kvs.size(), ERR_NOT_EXIST);
+        std::vector<size_t> misses;
+        for (size_t i = 0; i < kvs.size(); i++)
+        {
+            int err = m_cache.Get(kvs[i].key, kvs[i]);
+            if (0 == err || ERR_NOT_EXIST == err)
+            {
+                RecordMetaType(ctx, kvs[i].key, 0 == err ? kvs[i].type : KEY_END);
+                errs[i] = err;
+                continue;
+            }
+            if (!kvs[i].key.encode_buf.Readable())
+            {
+                kvs[i].key.Encode();
+            }
+            misses.push_back(i);
+        }
+        if (misses.empty())
+        {
+            return;
+        }
+        std::sort(misses.begin(), misses.end(), EncodedKeyLess(kvs));
+        std::vector<Slice> kbufs;
+        kbufs.reserve(misses.size());
+        for (size_t i = 0; i < misses.size(); i++)
+        {
+            const Buffer& kbuf = kvs[misses[i]].key.encode_buf;
+            kbufs.push_back(Slice(kbuf.GetRawReadBuffer(), kbuf.ReadableBytes()));
+        }
+        std::vector<std::string> vals;
+        std::vector<int> rets;
+        Options options;
+        uint64 start = get_current_epoch_micros();
+        GetKeyValueEngine().MultiGet(kbufs, vals, rets, options);
+        uint64 end = get_current_epoch_micros();
+        m_stat.StatReadLatency(end - start);
+
+        bool is_read_ctx = (ctx.cmd_setting_flags & ARDB_CMD_READONLY) != 0;
+        CacheSetOptions cache_options;
+        cache_options.from_read_result = is_read_ctx;
+        cache_options.cmd = ctx.current_cmd_type;
+        for (size_t i = 0; i < misses.size(); i++)
+        {
+            ValueObject& kv = kvs[misses[i]];
+            RecordMetaType(ctx, kv.key, 0 == rets[i] && !vals[i].empty() ? (uint8) vals[i][0] : KEY_END);
+            if (0 != rets[i])
+            {
+                continue;
+            }
+            if (!decode_value(vals[i], kv))
+            {
+                ERROR_LOG("Failed to decode value for key %s", kv.key.key.data());
+                errs[misses[i]] = -1;
+                continue;
+            }
+            m_cache.Put(kv.key, kv, cache_options);
+            errs[misses[i]] = 0;
+        }
+    }
+
     int Ardb::DelKeyValue(Context& ctx, KeyObject& key)
     {
         if (!key.encode_buf.Readable())
@@ -696,10 +1140,15 @@ OP_NAMESPACE_BEGIN
             key.Encode();
         }
         Slice kbuf(key.encode_buf.GetRawReadBuffer(), key.encode_buf.ReadableBytes());
+        uint8 old_type = KEY_META == key.type ? LookupMetaType(ctx, key) : KEY_END;
         int ret = DelRaw(ctx, kbuf);
         if (0 == ret)
         {
             m_cache.Del(key, key.meta_type);
+            if (KEY_META == key.type)
+            {
+                CountKey(ctx, key, old_type, KEY_END);
+            }
         }
         return ret;
     }
@@ -711,6 +1160,32 @@ OP_NAMESPACE_BEGIN
         v.key.key = key;
         v.type = expected_type;
         int ret = GetKeyValue(ctx, v.key, &v);
+        return CheckMetaValue(ctx, key, expected_type, v, ret);
+    }
+
+    void Ardb::MultiGetMetaValue(Context& ctx, const SliceArray& keys, KeyType expected_type, ValueObjectArray& vs,
+            std::vector<int>& errs)
+    {
+        vs.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            vs[i].key.db = ctx.currentDB;
+            vs[i].key.type = KEY_META;
+            vs[i].key.key = keys[i];
+            vs[i].type = expected_type;
+        }
+        MultiGetKeyValue(ctx, vs, errs);
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            errs[i] = CheckMetaValue(ctx, keys[i], expected_type, vs[i], errs[i]);
+        }
+    }
+
+    /*
+     * Applies expiration and type checking to a loaded meta value, 'ret' is the result of the read.
+     */
+    int Ardb::CheckMetaValue(Context& ctx, const Slice& key, KeyType expected_type, ValueObject& v, int ret)
+    {
         if (0 == ret)
         {
             v.key.meta_type = v.type;
@@ -724,7 +1199,7 @@ OP_NAMESPACE_BEGIN
                     std::string keystr;
                     keystr.assign(key.data(), key.size());
                     del.AddArg(keystr);
-                    m_master.FeedSlaves(ctx.currentDB, del);
+                    FeedSlaves(ctx.currentDB, del);
                 }
                 return ERR_NOT_EXIST;
             }
@@ -768,6 +1243,10 @@ OP_NAMESPACE_BEGIN
                 break;
             }
         }
+        if (expected_type != KEY_END && expected_type != STRING_META)
+        {
+            v.meta.version = NewCollectionVersion(ctx.currentDB, key);
+        }
         return ERR_NOT_EXIST;
     }
 
@@ -867,11 +1346,18 @@ OP_NAMESPACE_BEGIN
         uint64 start_time = get_current_epoch_micros();
         ctx.last_interaction_ustime = start_time;
         ctx.cmd_setting_flags = setting.flags;
+        ctx.meta_types.clear();
         int ret = (this->*(setting.handler))(ctx, args);
+        ctx.meta_types.clear();
+        ctx.ResetArena();
         uint64 stop_time = get_current_epoch_micros();
         ctx.last_interaction_ustime = stop_time;
-        atomic_add_uint64(&(setting.calls), 1);
-        atomic_add_uint64(&(setting.microseconds), stop_time - start_time);
+        m_stat.GetCommandStat().Stat(setting.id, stop_time - start_time);
+        m_stat.GetLatencyHistograms().StatCommand(setting.id, stop_time - start_time);
+        if (args.GetRecvTime() > 0 && args.GetRecvTime() <= start_time)
+        {
+            m_stat.GetLatencyHistograms().StatQueue(start_time - args.GetRecvTime());
+        }
         TryPushSlowCommand(args, stop_time - start_time);
         DEBUG_LOG("Process recved cmd[%lld] cost %lluus", ctx.sequence, stop_time - start_time);
         return ret;
@@ -879,15 +1365,18 @@ OP_NAMESPACE_BEGIN
 
     Ardb::RedisCommandHandlerSetting* Ardb::FindRedisCommandHandlerSetting(RedisCommandFrame& args)
     {
-        std::string& cmd = args.GetMutableCommand();
-        lower_string(cmd);
-        RedisCommandHandlerSettingTable::iterator found = m_settings.find(cmd);
-        if (found == m_settings.end())
+        int32 id = args.GetCommandId();
+        if (id < 0 || (uint32) id >= m_settings.size())
         {
-            return NULL;
+            id = LookupCommand(args.GetCommand());
+            if (id < 0)
+            {
+                return NULL;
+            }
+            args.SetCommandId(id);
+            args.SetType(m_settings[id].type);
         }
-        args.SetType(found->second.type);
-        return &(found->second);
+        return &(m_settings[id]);
     }
 
     struct ResumeOverloadConnection: public Runnable
@@ -1001,16 +1490,16 @@ OP_NAMESPACE_BEGIN
         else
         {
             if (ctx.InTransc()
-                    && (args.GetCommand() != "multi" && args.GetCommand() != "exec" && args.GetCommand() != "discard"
-                            && args.GetCommand() != "quit"))
+                    && (setting.type != REDIS_CMD_MULTI && setting.type != REDIS_CMD_EXEC
+                            && setting.type != REDIS_CMD_DISCARD && setting.type != REDIS_CMD_QUIT))
             {
                 ctx.GetTransc().cached_cmds.push_back(args);
                 fill_status_reply(ctx.reply, "QUEUED");
             }
             else if (ctx.IsSubscribedConn()
-                    && (args.GetCommand() != "subscribe" && args.GetCommand() != "psubscribe"
-                            && args.GetCommand() != "unsubscribe" && args.GetCommand() != "punsubscribe"
-                            && args.GetCommand() != "quit"))
+                    && (setting.type != REDIS_CMD_SUBSCRIBE && setting.type != REDIS_CMD_PSUBSCRIBE
+                            && setting.type != REDIS_CMD_UNSUBSCRIBE && setting.type != REDIS_CMD_PUNSUBSCRIBE
+                            && setting.type != REDIS_CMD_QUIT))
             {
                 fill_error_reply(ctx.reply, "only (P)SUBSCRIBE / (P)UNSUBSCRIBE / QUIT allowed in this context");
             }
@@ -1037,7 +1526,7 @@ OP_NAMESPACE_BEGIN
             if ((flags & ARDB_PROCESS_FEED_REPLICATION_ONLY) || (flags & ARDB_PROCESS_FORCE_REPLICATION))
             {
                 //feed to replication
-                m_master.FeedSlaves(ctx.currentDB, *(ctx.current_cmd));
+                FeedSlaves(ctx.currentDB, *(ctx.current_cmd));
             }
             else if (ctx.data_change)
             {
@@ -1047,19 +1536,19 @@ OP_NAMESPACE_BEGIN
                     if (!ctx.GetTransc().cached_cmds.empty())
                     {
                         RedisCommandFrame multi("MULTI");
-                        m_master.FeedSlaves(ctx.currentDB, multi);
+                        FeedSlaves(ctx.currentDB, multi);
                         for (uint32 i = 0; i < ctx.GetTransc().cached_cmds.size(); i++)
                         {
                             RedisCommandFrame& transc_cmd = ctx.GetTransc().cached_cmds.at(i);
-                            m_master.FeedSlaves(ctx.currentDB, transc_cmd);
+                            FeedSlaves(ctx.currentDB, transc_cmd);
                         }
                         RedisCommandFrame exec("EXEC");
-                        m_master.FeedSlaves(ctx.currentDB, exec);
+                        FeedSlaves(ctx.currentDB, exec);
                     }
                 }
                 else if ((setting.flags & ARDB_CMD_WRITE))
                 {
-                    m_master.FeedSlaves(ctx.currentDB, *(ctx.current_cmd));
+                    FeedSlaves(ctx.currentDB, *(ctx.current_cmd));
                 }
             }
         }
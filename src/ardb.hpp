@@ -45,11 +45,14 @@
 #include "statistics.hpp"
 #include "context.hpp"
 #include "cron.hpp"
+#include "expire.hpp"
 #include "config.hpp"
 #include "logger.hpp"
 #include "replication/master.hpp"
 #include "replication/slave.hpp"
+#include "replication/backup.hpp"
 #include "util/redis_helper.hpp"
+#include "util/pattern_trie.hpp"
 
 #define ARDB_OK 0
 #define ERR_INVALID_ARGS -3
@@ -82,6 +85,7 @@
 //#define ARDB_CMD_STALE 1024                /* "t" flag */
 //#define ARDB_CMD_SKIP_MONITOR 2048         /* "M" flag */
 //#define ARDB_CMD_ASKING 4096               /* "k" flag */
+#define ARDB_CMD_SINGLE_KEY 8192           /* "K" flag, first argument is the only key */
 
 #define ARDB_PROCESS_WITHOUT_REPLICATION 1
 #define ARDB_PROCESS_REPL_WRITE 2
@@ -134,10 +138,28 @@ OP_NAMESPACE_BEGIN
     };
 
     class RedisRequestHandler;
-    class ExpireCheck;
+    class ExpireManager;
     class ConnectionTimeout;
     class CompactTask;
     class RedisCursorClearTask;
+    class ReclaimTask;
+    class ListRechunkTask;
+    class ZSetRankTask;
+    class KeyCountVerifier;
+    class KeyCountReconcileTask;
+
+    /*
+     * Key count of one db indexed by meta type, slot 0 is the total of all types.
+     */
+    struct KeyCounts
+    {
+            int64 counts[LIST_META + 1];
+            KeyCounts()
+            {
+                memset(counts, 0, sizeof(counts));
+            }
+    };
+
     class Ardb
     {
         public:
@@ -151,8 +173,8 @@ OP_NAMESPACE_BEGIN
                     int max_arity;
                     const char* sflags;
                     int flags;
-                    volatile uint64 microseconds;
-                    volatile uint64 calls;
+                    uint32 id;  //index in the command table, also the slot of its stats
+                    uint32 name_len;
             };
         private:
             ChannelService* m_service;
@@ -167,14 +189,26 @@ OP_NAMESPACE_BEGIN
 
             L1Cache m_cache;
             CronManager m_cron;
+            ExpireManager m_expire;
             Statistics m_stat;
 
-            typedef TreeMap<std::string, RedisCommandHandlerSetting>::Type RedisCommandHandlerSettingTable;
+            /*
+             * Commands are compiled into a collision free hash table at startup, a name is located by two
+             * case insensitive hashes and one comparison, see CompileCommandTable.
+             */
+            typedef std::vector<RedisCommandHandlerSetting> RedisCommandHandlerSettingTable;
             RedisCommandHandlerSettingTable m_settings;
+            std::vector<uint32> m_command_seeds;
+            std::vector<int32> m_command_slots;
+            std::deque<std::string> m_command_names; //storage of renamed command names
 
             ThreadLocal<LUAInterpreter> m_lua;
 
             ThreadLocal<RedisReplyPool> m_reply_pool;
+            /*
+             * Context of the outermost batch write open on the thread, NULL if none.
+             */
+            ThreadLocal<Context*> m_batch_ctx;
             /*
              * Transction watched keys
              */
@@ -184,7 +218,8 @@ OP_NAMESPACE_BEGIN
 
             typedef TreeMap<std::string, ContextSet>::Type PubsubContextTable;
             PubsubContextTable m_pubsub_channels;
-            PubsubContextTable m_pubsub_patterns;
+            typedef PatternTrie<ContextSet> PubsubPatternIndex;
+            PubsubPatternIndex m_pubsub_patterns;
             SpinRWLock m_pubsub_ctx_lock;
 
             typedef TreeMap<DBItemKey, ContextDeque>::Type BlockContextTable;
@@ -199,6 +234,7 @@ OP_NAMESPACE_BEGIN
 
             void TryPushSlowCommand(const RedisCommandFrame& cmd, uint64 micros);
             void GetSlowlog(Context& ctx, uint32 len);
+            void PrintLatencyStat(std::string& str);
 
             RedisDumpFile m_redis_dump;
             ArdbDumpFile m_ardb_dump;
@@ -206,6 +242,7 @@ OP_NAMESPACE_BEGIN
             ReplBacklog m_repl_backlog;
             Master m_master;
             Slave m_slave;
+            Backup m_backup;
 
             time_t m_starttime;
             bool m_compacting;
@@ -220,6 +257,57 @@ OP_NAMESPACE_BEGIN
 
             StorageConfig m_storage_config;
 
+            /*
+             * Unlinked collection keys whose elements are still reclaimed in background, one entry per unlinked
+             * collection version of the key.
+             */
+            struct ReclaimEntry
+            {
+                    uint8 meta_type;
+                    uint32 version;
+                    ReclaimEntry(uint8 t = 0, uint32 v = 0) :
+                            meta_type(t), version(v)
+                    {
+                    }
+            };
+            typedef std::vector<ReclaimEntry> ReclaimEntryArray;
+            typedef TreeMap<DBItemKey, ReclaimEntryArray>::Type ReclaimKeyTable;
+            ReclaimKeyTable m_reclaim_keys;
+            SpinMutexLock m_reclaim_lock;
+            volatile uint64 m_reclaim_pending;
+            volatile uint64 m_reclaimed_keys;
+            volatile uint64 m_reclaimed_elements;
+
+            /*
+             * Lists waiting to be converted to chunked layout, or compacted, by the db cron.
+             */
+            typedef TreeSet<DBItemKey>::Type RechunkKeySet;
+            RechunkKeySet m_rechunk_keys;
+            SpinMutexLock m_rechunk_lock;
+            volatile uint64 m_rechunk_pending;
+            volatile uint64 m_rechunked_keys;
+            volatile uint64 m_rechunk_skipped_keys;
+
+            /*
+             * Raw zsets waiting for the db cron to build their rank index.
+             */
+            typedef TreeSet<DBItemKey>::Type ZSetRankKeySet;
+            ZSetRankKeySet m_zrank_keys;
+            SpinMutexLock m_zrank_lock;
+            volatile uint64 m_zrank_pending;
+            volatile uint64 m_zrank_built_keys;
+            volatile uint64 m_zrank_skipped_keys;
+
+            typedef TreeMap<DBID, KeyCounts>::Type KeyCountTable;
+            KeyCountTable m_key_counts;
+            KeyCountTable* m_key_counts_rebuild; /* counts collected by the running verifier, NULL if none */
+            SpinMutexLock m_key_counts_lock;
+            KeyCountVerifier* m_key_count_verifier;
+            volatile bool m_key_counts_restart;
+            volatile bool m_key_counts_stop;
+            volatile bool m_key_counts_dirty;
+            volatile uint64 m_key_count_guesses; /* blind overwrites counted without knowing the old type */
+
             DataDumpFile& GetDataDumpFile();
             void FillInfoResponse(const std::string& section, std::string& info);
 
@@ -236,9 +324,33 @@ OP_NAMESPACE_BEGIN
             int DelRaw(Context& ctx, const Slice& key);
             int SetKeyValue(Context& ctx, ValueObject& value);
             int GetKeyValue(Context& ctx, KeyObject& key, ValueObject* kv);
+            void MultiGetKeyValue(Context& ctx, ValueObjectArray& kvs, std::vector<int>& errs);
             int DelKeyValue(Context& ctx, KeyObject& key);
             int DeleteKey(Context& ctx, const Slice& key);
+            int LazyDeleteKey(Context& ctx, const Slice& key);
+            uint64 ReclaimElements(Context& ctx, const DBItemKey& item, const ReclaimEntry& entry, uint64 limit, bool& done);
+            void SaveReclaimEntries(Context& ctx, const DBItemKey& item, const ReclaimEntryArray& entries);
+            uint32 NewCollectionVersion(DBID db, const Slice& key);
+            void ReclaimStep(uint64 max_millis);
+            int LoadReclaimKeys();
+            void ClearReclaimKeys(DBID db, bool all);
+            uint8 LookupMetaType(Context& ctx, KeyObject& key, uint8 blind_type = KEY_END);
+            void RecordMetaType(Context& ctx, KeyObject& key, uint8 type);
+            void CountKey(Context& ctx, KeyObject& key, uint8 old_type, uint8 new_type);
+            void ApplyKeyCount(DBID db, uint8 old_type, uint8 new_type);
+            void BeginBatchWrite(Context& ctx);
+            void EndBatchWrite(bool committed);
+            void FeedSlaves(DBID db, RedisCommandFrame& cmd);
+            int64 GetKeyCount(DBID db, uint8 type);
+            int LoadKeyCounts();
+            int SaveKeyCounts(bool clean);
+            void RebuildKeyCounts();
+            void VerifyKeyCounts();
+            void StopKeyCountVerifier();
+            void ClearKeyCounts(DBID db, bool all);
+            void ReconcileKeyCounts();
             Iterator* IteratorKeyValue(KeyObject& from, bool match_key);
+            Iterator* IteratorPrefix(KeyObject& from);
             void IteratorSeek(Iterator* iter, KeyObject& target);
 
             void RewriteClientCommand(Context& ctx, RedisCommandFrame& cmd);
@@ -250,6 +362,9 @@ OP_NAMESPACE_BEGIN
             int StringGet(Context& ctx, const std::string& key, ValueObject& value);
 
             int GetMetaValue(Context& ctx, const Slice& key, KeyType expected_type, ValueObject& v);
+            void MultiGetMetaValue(Context& ctx, const SliceArray& keys, KeyType expected_type, ValueObjectArray& vs,
+                    std::vector<int>& errs);
+            int CheckMetaValue(Context& ctx, const Slice& key, KeyType expected_type, ValueObject& v, int ret);
 
             int HashSet(Context& ctx, ValueObject& meta, const Data& field, Data& value);
             int HashMultiSet(Context& ctx, ValueObject& meta, DataMap& fs);
@@ -262,7 +377,27 @@ OP_NAMESPACE_BEGIN
             int ZipListConvert(Context& ctx, ValueObject& meta);
             int ListIter(Context& ctx, ValueObject& meta, ListIterator& iter, bool reverse);
             int SequencialListIter(Context& ctx, ValueObject& meta, ListIterator& iter, int64 index);
+            int ChunkedListIter(Context& ctx, ValueObject& meta, ListIterator& iter, int64 index);
+            ListChunkCache& GetListChunkCache(ValueObject& meta);
+            int ListChunkLoadNode(Context& ctx, ValueObject& meta, uint64 id, ListChunkNode*& node);
+            int ListChunkLoad(Context& ctx, ValueObject& meta, uint64 id, ListChunk*& chunk);
+            int ListChunkPeek(Context& ctx, ValueObject& meta, uint64 id, ListChunk& owned, ListChunk*& chunk);
+            uint64 ListChunkNewNode(ValueObject& meta, ListChunkNode* root, uint32 level, ListChunkNode*& node);
+            uint64 ListChunkNewChunk(ValueObject& meta, ListChunkNode* root, ListChunk*& chunk);
+            int ListChunkLocate(Context& ctx, ValueObject& meta, uint64 index, ListChunkPath& path);
+            int ListChunkDrop(Context& ctx, ValueObject& meta, ListChunkPath& path, uint32 idx);
+            int ListChunkInsert(Context& ctx, ValueObject& meta, uint64 index, const Data& value);
+            int ListChunkRemove(Context& ctx, ValueObject& meta, uint64 index, Data* value);
+            int ListChunkTrimEdge(Context& ctx, ValueObject& meta, bool head, uint64 count);
+            int ListChunkBuild(Context& ctx, ValueObject& meta);
+            int ListChunkFlush(Context& ctx, ValueObject& meta);
+            int ListChunkClear(Context& ctx, ValueObject& meta);
+            bool ListRechunkTooLarge(ValueObject& meta);
+            void ListRechunkLater(Context& ctx, ValueObject& meta);
+            void ListRechunkStep(uint64 max_millis);
             int ListPop(Context& ctx, const std::string& key, bool lpop);
+            int ListRawInsert(Context& ctx, ValueObject& meta, const std::string& match, const std::string& value,
+                    bool head);
             int ListInsert(Context& ctx, const std::string& key, const std::string* match, const std::string& value,
                     bool head, bool abort_nonexist);
             int ListInsert(Context& ctx, ValueObject& meta, const std::string* match, const std::string& value,
@@ -287,7 +422,6 @@ OP_NAMESPACE_BEGIN
             int ZSetValueIter(Context& ctx, ValueObject& meta, Data& from, ZSetIterator& iter, bool readonly);
             int ZSetAdd(Context& ctx, ValueObject& meta, const Data& element, const Data& score, Data* old_score);
             int ZSetScore(Context& ctx, ValueObject& meta, const Data& value, Data& score, Location* loc = NULL);
-            int ZSetRankByScore(Context& ctx, ValueObject& meta, Data& score, uint32& rank);
             int ZSetRange(Context& ctx, const Slice& key, int64 start, int64 stop, bool withscores, bool reverse,
                     DataOperation op);
             int ZSetRangeByLex(Context& ctx, const std::string& key, const ZSetRangeByLexOptions& options,
@@ -298,6 +432,21 @@ OP_NAMESPACE_BEGIN
             int ZSetRangeByScore(Context& ctx, RedisCommandFrame& cmd);
             int ZSetRem(Context& ctx, ValueObject& meta, const std::string& value);
             int ZSetLen(Context& ctx, const Slice& key);
+            ZSetRankCache& GetZSetRankCache(ValueObject& meta);
+            int ZSetRankLoadNode(Context& ctx, ValueObject& meta, uint64 id, ZSetRankNode*& node);
+            uint64 ZSetRankNewNode(ValueObject& meta, ZSetRankNode* root, uint32 level, ZSetRankNode*& node);
+            int ZSetRankWalk(Context& ctx, ValueObject& meta, const ZSetRankMember& from, uint64 skip,
+                    const ZSetRankMember* until, uint64& walked, ZSetRankMember* found);
+            int ZSetRankBuild(Context& ctx, ValueObject& meta);
+            int ZSetRankInsert(Context& ctx, ValueObject& meta, const Data& element, const Data& score);
+            int ZSetRankRemove(Context& ctx, ValueObject& meta, const Data& element, const Data& score);
+            int ZSetRankOf(Context& ctx, ValueObject& meta, const Data& element, const Data& score, uint64& rank);
+            int ZSetMemberAtRank(Context& ctx, ValueObject& meta, uint64 rank, ZSetRankMember& member);
+            int ZSetRankFlush(Context& ctx, ValueObject& meta);
+            int ZSetRankClear(Context& ctx, ValueObject& meta);
+            bool ZSetRankTooLarge(ValueObject& meta);
+            void ZSetRankLater(Context& ctx, ValueObject& meta);
+            void ZSetRankStep(uint64 max_millis);
 
             int BitGet(Context& ctx, const std::string& key, uint64 offset);
             int BitsetIter(Context& ctx, ValueObject& meta, int64 index, BitsetIterator& iter);
@@ -342,7 +491,10 @@ OP_NAMESPACE_BEGIN
             int RenameBitset(Context& ctx, DBID srcdb, const std::string& srckey, DBID dstdb,
                     const std::string& dstkey);
 
-            int GeoSearchByOptions(Context& ctx, ValueObject& meta, GeoSearchOptions& options);
+            bool GeoMatchFilters(Context& ctx, GeoSearchOptions& options, const std::string& value);
+            int GeoFetchCandidates(Context& ctx, ValueObject& meta, GeoSearchOptions& options, GeoSearchState& state);
+            int GeoSearchByOptions(Context& ctx, ValueObject& meta, GeoSearchOptions& options, GeoSearchState& state,
+                    bool fill_reply);
 
             int DoCompact(Context& ctx, DBID db, bool sync);
             int DoCompact(const std::string& start, const std::string& end);
@@ -362,6 +514,7 @@ OP_NAMESPACE_BEGIN
             int DBSize(Context& ctx, RedisCommandFrame& cmd);
             int Config(Context& ctx, RedisCommandFrame& cmd);
             int SlowLog(Context& ctx, RedisCommandFrame& cmd);
+            int Latency(Context& ctx, RedisCommandFrame& cmd);
             int Client(Context& ctx, RedisCommandFrame& cmd);
             int Keys(Context& ctx, RedisCommandFrame& cmd);
             int KeysCount(Context& ctx, RedisCommandFrame& cmd);
@@ -423,6 +576,7 @@ OP_NAMESPACE_BEGIN
             int Strlen(Context& ctx, RedisCommandFrame& cmd);
             int Set(Context& ctx, RedisCommandFrame& cmd);
             int Del(Context& ctx, RedisCommandFrame& cmd);
+            int Unlink(Context& ctx, RedisCommandFrame& cmd);
             int Exists(Context& ctx, RedisCommandFrame& cmd);
             int Expire(Context& ctx, RedisCommandFrame& cmd);
             int Expireat(Context& ctx, RedisCommandFrame& cmd);
@@ -462,6 +616,7 @@ OP_NAMESPACE_BEGIN
             int SInter(Context& ctx, RedisCommandFrame& cmd);
             int SInterStore(Context& ctx, RedisCommandFrame& cmd);
             int SIsMember(Context& ctx, RedisCommandFrame& cmd);
+            int SMIsMember(Context& ctx, RedisCommandFrame& cmd);
             int SMembers(Context& ctx, RedisCommandFrame& cmd);
             int SMove(Context& ctx, RedisCommandFrame& cmd);
             int SPop(Context& ctx, RedisCommandFrame& cmd);
@@ -538,6 +693,8 @@ OP_NAMESPACE_BEGIN
 
             int DoCall(Context& ctx, RedisCommandHandlerSetting& setting, RedisCommandFrame& cmd);
             RedisCommandHandlerSetting* FindRedisCommandHandlerSetting(RedisCommandFrame& cmd);
+            int32 LookupCommand(const std::string& cmd);
+            void CompileCommandTable();
             bool ParseConfig(const Properties& props);
             void RenameCommand();
             void FreeClientContext(Context& ctx);
@@ -547,6 +704,7 @@ OP_NAMESPACE_BEGIN
             int FindElementByRedisCursor(const std::string& cursor, std::string& element);
             void ClearExpireRedisCursor();
             int CheckStorageCodecVersion();
+            int SaveStorageConfig();
             bool IsEmpty();
 
             friend class RedisRequestHandler;
@@ -557,14 +715,23 @@ OP_NAMESPACE_BEGIN
             friend class RedisDumpFile;
             friend class ArdbDumpFile;
             friend class ZSetIterator;
-            friend class ExpireCheck;
+            friend class ExpireManager;
             friend class ConnectionTimeout;
             friend class CompactTask;
             friend class RedisCursorClearTask;
+            friend class ReclaimTask;
+            friend class ListRechunkTask;
+            friend class ZSetRankTask;
+            friend class ListIterator;
+            friend class KeyCountVerifier;
+            friend class KeyCountReconcileTask;
+            friend class Backup;
             friend class L1Cache;
+            friend class BatchWriteGuard;
         public:
             Ardb(KeyValueEngineFactory& factory);
             int Init(const ArdbConfig& cfg);
+            int MigrateStorageCodec(const ArdbConfig& cfg, KeyValueEngineFactory& target, const std::string& target_dir);
             void Start();
             ArdbConfig& GetConfig()
             {
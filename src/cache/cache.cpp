@@ -40,8 +40,28 @@
 #define CACHE_STATE_DIRTY  7
 #define CACHE_STATE_DESTROYING  8
 
+#define CACHE_SLOT_NONE  0xFFFFFFFF
+
 OP_NAMESPACE_BEGIN
 
+    /*
+     * Rough heap bytes of a cached element, 32 bytes stand for the tree node holding it.
+     */
+    static inline int64 data_mem(const Data& d)
+    {
+        return sizeof(Data) + 32 + (d.encoding == STRING_ENCODING_RAW ? d.StringLength() : 0);
+    }
+
+    static inline int64 zset_data_mem(const ZSetData* d)
+    {
+        return sizeof(ZSetData) + 64 + data_mem(d->value) + (NULL != d->loc ? sizeof(Location) : 0);
+    }
+
+    static inline uint64 slot_mem(const DBItemKey& key)
+    {
+        return sizeof(CacheSlot) + sizeof(CacheData) + 64 + key.key.size();
+    }
+
     bool CacheData::IsMetaLoaded()
     {
         return state == CACHE_STATE_META_LOADED || state == CACHE_STATE_FULL_LOADED || state == CACHE_STATE_LOADING;
@@ -51,9 +71,24 @@ OP_NAMESPACE_BEGIN
         WriteLockGuard<SpinRWLock> guard(lock);
         meta.clear();
         DoClear();
+        Charge(-(int64) mem);
         state = CACHE_STATE_INIT;
 
     }
+    void CacheData::Charge(int64 delta)
+    {
+        atomic_add_uint64(&mem, (uint64) delta);
+        volatile uint64* shard_usage = usage;
+        if (NULL != shard_usage)
+        {
+            atomic_add_uint64(shard_usage, (uint64) delta);
+        }
+    }
+    void CacheData::SetMeta(const char* data, size_t len)
+    {
+        Charge((int64) len - (int64) meta.size());
+        meta.assign(data, len);
+    }
     uint32 CacheData::AddRef()
     {
         return atomic_add_uint32(&ref, 1);
@@ -102,6 +137,7 @@ OP_NAMESPACE_BEGIN
             data_erased = data.erase(entry);
             scores.erase(fit);
             score_erased = 1;
+            Charge(-zset_data_mem(entry));
             DELETE(entry);
         }
         if (data.size() != scores.size())
@@ -122,6 +158,7 @@ OP_NAMESPACE_BEGIN
             entry->loc = new Location;
             GeoHashHelper::GetMercatorXYByHash(score.value.iv, entry->loc->x, entry->loc->y);
         }
+        Charge(zset_data_mem(entry));
         if (data.size() != scores.size())
         {
             ERROR_LOG("Data size:%u, while score size:%u with insert flag %d:%d", data.size(), scores.size(), data_intersetd, score_intersetd);
@@ -138,6 +175,7 @@ OP_NAMESPACE_BEGIN
             ZSetData* entry = fit->second;
             data.erase(entry);
             scores.erase(fit);
+            Charge(-zset_data_mem(entry));
             DELETE(entry);
         }
     }
@@ -157,52 +195,450 @@ OP_NAMESPACE_BEGIN
     void SetDataCache::Add(const Data& element)
     {
         WriteLockGuard<SpinRWLock> guard(lock);
-        data.insert(element);
+        if (data.insert(element).second)
+        {
+            Charge(data_mem(element));
+        }
     }
 
     void SetDataCache::Del(const Data& element)
     {
         WriteLockGuard<SpinRWLock> guard(lock);
-        data.erase(element);
+        if (data.erase(element) > 0)
+        {
+            Charge(-data_mem(element));
+        }
+    }
+
+    static void data_map_put(CacheData* cache, DataMap& data, const Data& k, const Data& v)
+    {
+        DataMap::iterator found = data.find(k);
+        if (found != data.end())
+        {
+            cache->Charge(data_mem(v) - data_mem(found->second));
+            found->second = v;
+        }
+        else
+        {
+            cache->Charge(data_mem(k) + data_mem(v));
+            data[k] = v;
+        }
+    }
+
+    static void data_map_erase(CacheData* cache, DataMap& data, const Data& k)
+    {
+        DataMap::iterator found = data.find(k);
+        if (found != data.end())
+        {
+            cache->Charge(-(data_mem(found->first) + data_mem(found->second)));
+            data.erase(found);
+        }
     }
 
     void HashDataCache::Add(const Data& field, const Data& value)
     {
         WriteLockGuard<SpinRWLock> guard(lock);
-        data[field] = value;
+        data_map_put(this, data, field, value);
     }
     void HashDataCache::Del(const Data& field)
     {
         WriteLockGuard<SpinRWLock> guard(lock);
-        data.erase(field);
+        data_map_erase(this, data, field);
     }
 
     void ListDataCache::Add(const Data& index, const Data& value)
     {
         WriteLockGuard<SpinRWLock> guard(lock);
-        data[index] = value;
+        data_map_put(this, data, index, value);
     }
     void ListDataCache::Del(const Data& index)
     {
         WriteLockGuard<SpinRWLock> guard(lock);
-        data.erase(index);
+        data_map_erase(this, data, index);
+    }
+
+    static const uint32 kSketchSeeds[] =
+        { 0x97cb3127U, 0xab7c1c9dU, 0xc2b2ae35U, 0x27d4eb2fU };
+
+    void FrequencySketch::Resize(uint64 capacity)
+    {
+        uint32 width = 64;
+        while (width < capacity && width < (1U << 20))
+        {
+            width <<= 1;
+        }
+        m_table.assign(width * 4, 0);
+        m_mask = width - 1;
+        m_sample = width * 10;
+        m_additions = 0;
+    }
+
+    void FrequencySketch::Increment(uint32 hash)
+    {
+        if (m_table.empty())
+        {
+            return;
+        }
+        volatile uint8* counters = &m_table[0];
+        uint32 width = m_mask + 1;
+        for (uint32 i = 0; i < 4; i++)
+        {
+            volatile uint8& counter = counters[i * width + (((hash * kSketchSeeds[i]) >> 8) & m_mask)];
+            uint8 count = counter;
+            if (count < 15)
+            {
+                counter = count + 1;
+            }
+        }
+        m_additions++;
+    }
+
+    uint8 FrequencySketch::Frequency(uint32 hash) const
+    {
+        if (m_table.empty())
+        {
+            return 0;
+        }
+        const volatile uint8* counters = &m_table[0];
+        uint32 width = m_mask + 1;
+        uint8 freq = 15;
+        for (uint32 i = 0; i < 4; i++)
+        {
+            uint8 counter = counters[i * width + (((hash * kSketchSeeds[i]) >> 8) & m_mask)];
+            if (counter < freq)
+            {
+                freq = counter;
+            }
+        }
+        return freq;
+    }
+
+    /*
+     * Halve all counters if enough increments were seen since the last aging, returns true if it did.
+     * Increments racing with it are either halved as well or counted in the next period.
+     */
+    bool FrequencySketch::Age()
+    {
+        if (m_table.empty() || m_additions < m_sample)
+        {
+            return false;
+        }
+        m_additions = 0;
+        volatile uint8* counters = &m_table[0];
+        for (size_t i = 0; i < m_table.size(); i++)
+        {
+            counters[i] = counters[i] >> 1;
+        }
+        return true;
+    }
+
+    bool CacheShard::Full(uint64 extra_entries) const
+    {
+        return (max_entries > 0 && index.size() + extra_entries > max_entries) || (max_bytes > 0 && bytes > max_bytes);
+    }
+
+    /*
+     * Move the CLOCK hand to the next slot whose reference bit is clear, clearing the bits it passes.
+     */
+    uint32 CacheShard::NextVictim()
+    {
+        uint32 count = slots.size();
+        for (uint32 i = 0; i < count * 2; i++)
+        {
+            uint32 slot = hand;
+            hand = (hand + 1) % count;
+            if (NULL == slots[slot].data)
+            {
+                continue;
+            }
+            if (slots[slot].referenced)
+            {
+                slots[slot].referenced = 0;
+                continue;
+            }
+            return slot;
+        }
+        return CACHE_SLOT_NONE;
+    }
+
+    void CacheShard::Remove(uint32 slot)
+    {
+        CacheSlot& entry = slots[slot];
+        index.erase(entry.key);
+        entry.data->usage = NULL;
+        atomic_sub_uint64(&bytes, entry.data->mem + slot_mem(entry.key));
+        entry.data = NULL;
+        entry.referenced = 0;
+        entry.key.key.clear();
+        free_slots.push_back(slot);
+    }
+
+    ClockCache::ClockCache() :
+            m_shards(NULL), m_shard_count(0), m_max_entries(0), m_max_bytes(0), m_rejected(0), m_evicted(0)
+    {
+    }
+
+    void ClockCache::Init(uint32 shards, uint64 max_entries, uint64 max_bytes)
+    {
+        if (NULL != m_shards)
+        {
+            return;
+        }
+        m_shard_count = shards;
+        m_shards = new CacheShard[shards];
+        m_max_entries = max_entries;
+        m_max_bytes = max_bytes;
+        for (uint32 i = 0; i < m_shard_count; i++)
+        {
+            m_shards[i].max_entries = max_entries > 0 ? (max_entries + shards - 1) / shards : 0;
+            m_shards[i].max_bytes = max_bytes > 0 ? (max_bytes + shards - 1) / shards : 0;
+            m_shards[i].sketch.Resize(m_shards[i].max_entries);
+        }
+    }
+
+    /*
+     * Return the entry with a reference taken, or NULL.
+     */
+    CacheData* ClockCache::Get(const DBItemKey& key, bool peek)
+    {
+        if (NULL == m_shards)
+        {
+            return NULL;
+        }
+        uint32 hash = KeyLocker::HashKey(key.db, key.key);
+        CacheShard& shard = GetShard(hash);
+        if (!peek)
+        {
+            shard.sketch.Increment(hash);
+        }
+        ReadLockGuard<SpinRWLock> guard(shard.lock);
+        CacheShard::SlotIndex::iterator found = shard.index.find(key);
+        if (found == shard.index.end())
+        {
+            return NULL;
+        }
+        CacheSlot& slot = shard.slots[found->second];
+        if (!peek && !slot.referenced)
+        {
+            slot.referenced = 1;
+        }
+        slot.data->AddRef();
+        return slot.data;
+    }
+
+    /*
+     * Remove the entry and hand over the reference held by the cache.
+     */
+    CacheData* ClockCache::Erase(const DBItemKey& key)
+    {
+        if (NULL == m_shards)
+        {
+            return NULL;
+        }
+        CacheShard& shard = GetShard(KeyLocker::HashKey(key.db, key.key));
+        WriteLockGuard<SpinRWLock> guard(shard.lock);
+        CacheShard::SlotIndex::iterator found = shard.index.find(key);
+        if (found == shard.index.end())
+        {
+            return NULL;
+        }
+        CacheData* data = shard.slots[found->second].data;
+        shard.Remove(found->second);
+        return data;
+    }
+
+    void ClockCache::Evict(CacheShard& shard, uint32 slot, CacheDataArray& evicted)
+    {
+        evicted.push_back(shard.slots[slot].data);
+        shard.Remove(slot);
+        atomic_add_uint64(&m_evicted, 1);
+    }
+
+    /*
+     * Insert takes over the caller's reference of 'data', replaced and evicted entries are returned in 'evicted'.
+     * It returns false if the admission filter rejects the key.
+     */
+    bool ClockCache::Insert(const DBItemKey& key, CacheData* data, bool force_admit, CacheDataArray& evicted)
+    {
+        if (NULL == m_shards)
+        {
+            return false;
+        }
+        uint32 hash = KeyLocker::HashKey(key.db, key.key);
+        CacheShard& shard = GetShard(hash);
+        WriteLockGuard<SpinRWLock> guard(shard.lock);
+        CacheShard::SlotIndex::iterator found = shard.index.find(key);
+        if (found != shard.index.end())
+        {
+            evicted.push_back(shard.slots[found->second].data);
+            shard.Remove(found->second);
+        }
+        bool admitted = force_admit;
+        while (shard.Full(1))
+        {
+            uint32 victim = shard.NextVictim();
+            if (CACHE_SLOT_NONE == victim)
+            {
+                break;
+            }
+            if (!admitted)
+            {
+                const DBItemKey& vkey = shard.slots[victim].key;
+                if (shard.sketch.Frequency(hash) <= shard.sketch.Frequency(KeyLocker::HashKey(vkey.db, vkey.key)))
+                {
+                    atomic_add_uint64(&m_rejected, 1);
+                    return false;
+                }
+                admitted = true;
+            }
+            Evict(shard, victim, evicted);
+        }
+        uint32 slot = 0;
+        if (!shard.free_slots.empty())
+        {
+            slot = shard.free_slots.back();
+            shard.free_slots.pop_back();
+        }
+        else
+        {
+            shard.slots.push_back(CacheSlot());
+            slot = shard.slots.size() - 1;
+        }
+        CacheSlot& entry = shard.slots[slot];
+        entry.key = key;
+        entry.data = data;
+        entry.referenced = 0;
+        shard.index[key] = slot;
+        data->usage = &shard.bytes;
+        atomic_add_uint64(&shard.bytes, data->mem + slot_mem(key));
+        return true;
+    }
+
+    /*
+     * Collections grow after they are admitted, so shards are trimmed back under their limits periodically.
+     * The frequency sketches are aged here too, before the shard lock is taken.
+     * The byte counters are recomputed here as well, since concurrent updates may let them drift a little.
+     * Entries are charged without the shard lock, the recomputed value is only stored if no charge landed
+     * meanwhile, otherwise the correction waits for the next trim.
+     */
+    void ClockCache::Trim(CacheDataArray& evicted)
+    {
+        for (uint32 i = 0; i < m_shard_count && NULL != m_shards; i++)
+        {
+            CacheShard& shard = m_shards[i];
+            shard.sketch.Age();
+            WriteLockGuard<SpinRWLock> guard(shard.lock);
+            uint64 charged = shard.bytes;
+            uint64 bytes = 0;
+            for (uint32 j = 0; j < shard.slots.size(); j++)
+            {
+                if (NULL != shard.slots[j].data)
+                {
+                    bytes += shard.slots[j].data->mem + slot_mem(shard.slots[j].key);
+                }
+            }
+            atomic_cmp_set_uint64(&shard.bytes, charged, bytes);
+            while (shard.Full(0))
+            {
+                uint32 victim = shard.NextVictim();
+                if (CACHE_SLOT_NONE == victim)
+                {
+                    break;
+                }
+                Evict(shard, victim, evicted);
+            }
+        }
+    }
+
+    void ClockCache::ClearEntries(DBID db, bool withdb_limit)
+    {
+        for (uint32 i = 0; i < m_shard_count && NULL != m_shards; i++)
+        {
+            CacheShard& shard = m_shards[i];
+            WriteLockGuard<SpinRWLock> guard(shard.lock);
+            for (uint32 j = 0; j < shard.slots.size(); j++)
+            {
+                CacheSlot& slot = shard.slots[j];
+                if (NULL != slot.data && (!withdb_limit || slot.key.db == db))
+                {
+                    slot.data->Clear();
+                }
+            }
+        }
+    }
+
+    uint64 ClockCache::Size()
+    {
+        uint64 size = 0;
+        for (uint32 i = 0; i < m_shard_count && NULL != m_shards; i++)
+        {
+            ReadLockGuard<SpinRWLock> guard(m_shards[i].lock);
+            size += m_shards[i].index.size();
+        }
+        return size;
+    }
+
+    uint64 ClockCache::Bytes()
+    {
+        uint64 bytes = 0;
+        for (uint32 i = 0; i < m_shard_count && NULL != m_shards; i++)
+        {
+            bytes += m_shards[i].bytes;
+        }
+        return bytes;
+    }
+
+    void ClockCache::Destroy()
+    {
+        for (uint32 i = 0; i < m_shard_count && NULL != m_shards; i++)
+        {
+            CacheShard& shard = m_shards[i];
+            for (uint32 j = 0; j < shard.slots.size(); j++)
+            {
+                if (NULL != shard.slots[j].data)
+                {
+                    shard.slots[j].data->Clear();
+                    delete shard.slots[j].data;
+                }
+            }
+        }
+        delete[] m_shards;
+        m_shards = NULL;
+        m_shard_count = 0;
+    }
+
+    ClockCache::~ClockCache()
+    {
+        Destroy();
     }
 
     L1Cache::L1Cache(const ArdbConfig& cfg) :
-            m_cfg(cfg), m_estimate_memory_size(0)
+            m_cfg(cfg)
     {
     }
 
     int L1Cache::Init()
     {
-        m_zset_cache.cache.SetMaxCacheSize(m_cfg.L1_zset_max_cache_size);
-        m_set_cache.cache.SetMaxCacheSize(m_cfg.L1_set_max_cache_size);
-        m_hash_cache.cache.SetMaxCacheSize(m_cfg.L1_hash_max_cache_size);
-        m_list_cache.cache.SetMaxCacheSize(m_cfg.L1_list_max_cache_size);
-        m_string_cache.cache.SetMaxCacheSize(m_cfg.L1_string_max_cache_size);
+        uint32 shards = m_cfg.L1_cache_shards;
+        m_zset_cache.Init(shards, m_cfg.L1_zset_max_cache_size, m_cfg.L1_zset_max_cache_memory);
+        m_set_cache.Init(shards, m_cfg.L1_set_max_cache_size, m_cfg.L1_set_max_cache_memory);
+        m_hash_cache.Init(shards, m_cfg.L1_hash_max_cache_size, m_cfg.L1_hash_max_cache_memory);
+        m_list_cache.Init(shards, m_cfg.L1_list_max_cache_size, m_cfg.L1_list_max_cache_memory);
+        m_string_cache.Init(shards, m_cfg.L1_string_max_cache_size, m_cfg.L1_string_max_cache_memory);
         return 0;
     }
 
+    void L1Cache::TrimCache(ClockCache& cache)
+    {
+        CacheDataArray evicted;
+        cache.Trim(evicted);
+        for (uint32 i = 0; i < evicted.size(); i++)
+        {
+            evicted[i]->state = CACHE_STATE_DESTROYING;
+            evicted[i]->DecRef();
+        }
+    }
+
     void L1Cache::Run()
     {
         struct ClearStatTask: public Runnable
@@ -221,7 +657,24 @@ OP_NAMESPACE_BEGIN
                     cache.m_set_cache.stat.Clear();
                 }
         };
+        struct TrimTask: public Runnable
+        {
+                L1Cache& cache;
+                TrimTask(L1Cache& c) :
+                        cache(c)
+                {
+                }
+                void Run()
+                {
+                    cache.TrimCache(cache.m_string_cache);
+                    cache.TrimCache(cache.m_hash_cache);
+                    cache.TrimCache(cache.m_list_cache);
+                    cache.TrimCache(cache.m_zset_cache);
+                    cache.TrimCache(cache.m_set_cache);
+                }
+        };
         m_serv.GetTimer().ScheduleHeapTask(new ClearStatTask(*this), 10, 300, SECONDS);
+        m_serv.GetTimer().ScheduleHeapTask(new TrimTask(*this), 1, 1, SECONDS);
         m_serv.Start();
     }
 
@@ -267,7 +720,7 @@ OP_NAMESPACE_BEGIN
         return false;
     }
 
-    CommonLRUCache& L1Cache::GetCacheByType(uint8 type)
+    ClockCache& L1Cache::GetCacheByType(uint8 type)
     {
         switch (type)
         {
@@ -463,50 +916,34 @@ OP_NAMESPACE_BEGIN
 
     CacheResult L1Cache::GetCacheData(uint8 type, DBItemKey& key, const CacheGetOptions& options)
     {
-        CacheData* item = NULL;
-        CommonLRUCache& cache = GetCacheByType(type);
+        ClockCache& cache = GetCacheByType(type);
         CacheResult result(cache);
+        if (options.delete_entry)
         {
-            LockGuard<SpinMutexLock> guard(cache.lock);
-            if (options.delete_entry)
-            {
-                cache.cache.Erase(key, item);
-            }
-            else
-            {
-                if (options.peek)
-                {
-                    cache.cache.Peek(key, item);
-                }
-                else
-                {
-                    cache.cache.Get(key, item);
-                }
-            }
+            result.data = cache.Erase(key);
+            return result;
         }
-
+        CacheData* item = cache.Get(key, options.peek);
         if (NULL != item)
         {
-            if (!options.delete_entry)
+            if (options.dirty_if_loading && item->state == CACHE_STATE_LOADING)
+            {
+                item->state = CACHE_STATE_DIRTY;
+                item->DecRef();
+                return result;
+            }
+            if (!options.expected_states.empty())
             {
-                if (options.dirty_if_loading && item->state == CACHE_STATE_LOADING)
+                if (options.expected_states.count(item->state) == 0)
                 {
-                    item->state = CACHE_STATE_DIRTY;
+                    item->DecRef();
                     return result;
                 }
-                if (!options.expected_states.empty())
-                {
-                    if (options.expected_states.count(item->state) == 0)
-                    {
-                        return result;
-                    }
-                }
-                item->AddRef();
             }
         }
         else
         {
-            if (options.create_if_notexist && !options.delete_entry)
+            if (options.create_if_notexist)
             {
                 switch (type)
                 {
@@ -546,14 +983,21 @@ OP_NAMESPACE_BEGIN
                         break;
                     }
                 }
-                LockGuard<SpinMutexLock> guard(cache.lock);
-                CacheTableEntry erased;
-                if (cache.cache.Insert(key, item, erased))
+                /*
+                 * one reference for the cache, one for the caller
+                 */
+                item->AddRef();
+                CacheDataArray evicted;
+                if (!cache.Insert(key, item, options.force_admit, evicted))
                 {
-                    erased.second->state = CACHE_STATE_DESTROYING;
-                    m_serv.AsyncIO(0, DestroyCache, erased.second);
+                    delete item;
+                    item = NULL;
+                }
+                for (uint32 i = 0; i < evicted.size(); i++)
+                {
+                    evicted[i]->state = CACHE_STATE_DESTROYING;
+                    m_serv.AsyncIO(0, DestroyCache, evicted[i]);
                 }
-                item->AddRef();
             }
         }
         result.data = item;
@@ -778,8 +1222,7 @@ OP_NAMESPACE_BEGIN
                         v.Encode();
                     }
                     WriteLockGuard<SpinRWLock> guard(meta->lock);
-                    meta->meta.clear();
-                    meta->meta.assign(v.encode_buf.GetRawReadBuffer(), v.encode_buf.ReadableBytes());
+                    meta->SetMeta(v.encode_buf.GetRawReadBuffer(), v.encode_buf.ReadableBytes());
                     if (meta->state == CACHE_STATE_INIT)
                     {
                         meta->state = CACHE_STATE_META_LOADED;
@@ -969,6 +1412,7 @@ OP_NAMESPACE_BEGIN
         kk.key = key;
         CacheGetOptions options;
         options.create_if_notexist = true;
+        options.force_admit = true;
         options.expected_states.insert(CACHE_STATE_INIT);
         options.expected_states.insert(CACHE_STATE_META_LOADED);
         CacheData* item = GetCacheData(type, kk, options).data;
@@ -1028,40 +1472,22 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
-    void L1Cache::ClearLRUCache(CommonLRUCache& cache, DBID dbid, bool withdb_limit)
-    {
-        LockGuard<SpinMutexLock> guard(cache.lock);
-        CacheTable::CacheList& cachelist = cache.cache.GetCacheList();
-        CacheTable::CacheList::iterator it = cachelist.begin();
-        while (it != cachelist.end())
-        {
-            if (NULL != it->second)
-            {
-                if (!withdb_limit || (withdb_limit && it->first.db == dbid))
-                {
-                    it->second->Clear();
-                }
-            }
-            it++;
-        }
-    }
-
     int L1Cache::EvictDB(DBID db)
     {
-        ClearLRUCache(m_string_cache, db, true);
-        ClearLRUCache(m_hash_cache, db, true);
-        ClearLRUCache(m_set_cache, db, true);
-        ClearLRUCache(m_list_cache, db, true);
-        ClearLRUCache(m_zset_cache, db, true);
+        m_string_cache.ClearEntries(db, true);
+        m_hash_cache.ClearEntries(db, true);
+        m_set_cache.ClearEntries(db, true);
+        m_list_cache.ClearEntries(db, true);
+        m_zset_cache.ClearEntries(db, true);
         return 0;
     }
     int L1Cache::EvictAll()
     {
-        ClearLRUCache(m_string_cache, 0, false);
-        ClearLRUCache(m_hash_cache, 0, false);
-        ClearLRUCache(m_set_cache, 0, false);
-        ClearLRUCache(m_list_cache, 0, false);
-        ClearLRUCache(m_zset_cache, 0, false);
+        m_string_cache.ClearEntries(0, false);
+        m_hash_cache.ClearEntries(0, false);
+        m_set_cache.ClearEntries(0, false);
+        m_list_cache.ClearEntries(0, false);
+        m_zset_cache.ClearEntries(0, false);
         return 0;
     }
 
@@ -1137,22 +1563,20 @@ OP_NAMESPACE_BEGIN
 
     CacheData* L1Cache::GetReadCache(DBID db, const std::string& key, uint8 type)
     {
-        CacheData* item = NULL;
-        CommonLRUCache& cache = GetCacheByType(type);
+        ClockCache& cache = GetCacheByType(type);
         cache.stat.IncQueryStat();
-        LockGuard<SpinMutexLock> guard(cache.lock);
         DBItemKey kk(db, key);
-        cache.cache.Get(kk, item);
+        CacheData* item = cache.Get(kk, false);
         if (NULL != item)
         {
             if (item->state == CACHE_STATE_FULL_LOADED)
             {
-                item->AddRef();
                 item->lock.Lock(READ_LOCK);
                 cache.stat.IncHitStat();
             }
             else
             {
+                item->DecRef();
                 item = NULL;
             }
         }
@@ -1168,16 +1592,19 @@ OP_NAMESPACE_BEGIN
         cache->DecRef();
     }
 
-    static void PrintCacheStat(CommonLRUCache& cache, std::string& str)
+    static void PrintCacheStat(ClockCache& cache, std::string& str)
     {
         std::string hit_rate = "0";
         if (cache.stat.query_count > 0)
         {
             fast_dtoa(cache.stat.hit_count * 1.0 / cache.stat.query_count, 10, hit_rate);
         }
-        LockGuard<SpinMutexLock> guard(cache.lock);
-        str.append("size=").append(stringfromll(cache.cache.Size())).append(" ");
-        str.append("max_size=").append(stringfromll(cache.cache.MaxCacheSize())).append(" ");
+        str.append("size=").append(stringfromll(cache.Size())).append(" ");
+        str.append("max_size=").append(stringfromll(cache.MaxEntries())).append(" ");
+        str.append("memory=").append(stringfromll(cache.Bytes())).append(" ");
+        str.append("max_memory=").append(stringfromll(cache.MaxBytes())).append(" ");
+        str.append("evicted=").append(stringfromll(cache.Evicted())).append(" ");
+        str.append("rejected=").append(stringfromll(cache.Rejected())).append(" ");
         str.append("hit_rate=").append(hit_rate);
     }
 
@@ -1208,24 +1635,13 @@ OP_NAMESPACE_BEGIN
         m_serv.Wakeup();
     }
 
-    static void DestroyCache(CommonLRUCache& cache)
-    {
-        CacheTableEntry entry;
-        while (cache.cache.PeekFront(entry))
-        {
-            entry.second->Clear();
-            delete entry.second;
-            cache.cache.PopFront();
-        }
-    }
-
     L1Cache::~L1Cache()
     {
-        DestroyCache(m_string_cache);
-        DestroyCache(m_hash_cache);
-        DestroyCache(m_list_cache);
-        DestroyCache(m_set_cache);
-        DestroyCache(m_zset_cache);
+        m_string_cache.Destroy();
+        m_hash_cache.Destroy();
+        m_list_cache.Destroy();
+        m_set_cache.Destroy();
+        m_zset_cache.Destroy();
     }
 OP_NAMESPACE_END
 
@@ -30,7 +30,6 @@
 #define CACHE_HPP_
 
 #include "common/common.hpp"
-#include "util/lru.hpp"
 #include "codec.hpp"
 #include "options.hpp"
 #include "concurrent.hpp"
@@ -48,13 +47,17 @@ OP_NAMESPACE_BEGIN
             uint32 ref;
             uint8 type;
             uint8 state;
+            volatile uint64 mem;    /* estimated bytes of meta & elements */
+            volatile uint64* usage; /* byte counter of the owning cache shard */
             CacheData() :
-                    ref(1), type(0), state(1)
+                    ref(1), type(0), state(1), mem(0), usage(NULL)
             {
             }
             bool IsMetaLoaded();
             uint32 AddRef();
             uint32 DecRef();
+            void Charge(int64 delta);
+            void SetMeta(const char* data, size_t len);
             virtual void DoClear()
             {
             }
@@ -203,13 +206,114 @@ OP_NAMESPACE_BEGIN
                 query_count = 0;
             }
     };
-    typedef LRUCache<DBItemKey, CacheData*> CacheTable;
-    typedef CacheTable::CacheEntry CacheTableEntry;
-    struct CommonLRUCache
+
+    /*
+     * Count-min sketch of 4 rows with 4 bit counters (one per byte, capped at 15), it estimates how often
+     * a key was requested lately. Lookups bump the counters without any lock, a lost increment only makes
+     * the estimate a little lower. Aging halves all counters once 'sample' increments were seen, it's run
+     * by the periodic trim of the cache thread instead of the lookup that crosses the sample size.
+     */
+    class FrequencySketch
+    {
+        private:
+            std::vector<uint8> m_table;
+            uint32 m_mask;
+            volatile uint32 m_additions;
+            uint32 m_sample;
+        public:
+            FrequencySketch() :
+                    m_mask(0), m_additions(0), m_sample(0)
+            {
+            }
+            void Resize(uint64 capacity);
+            void Increment(uint32 hash);
+            uint8 Frequency(uint32 hash) const;
+            bool Age();
+    };
+
+    struct CacheSlot
+    {
+            DBItemKey key;
+            CacheData* data;
+            volatile uint8 referenced;
+            CacheSlot() :
+                    data(NULL), referenced(0)
+            {
+            }
+    };
+
+    struct CacheShard
+    {
+            typedef TreeMap<DBItemKey, uint32>::Type SlotIndex;
+            SlotIndex index;
+            std::vector<CacheSlot> slots;
+            std::vector<uint32> free_slots;
+            uint32 hand;
+            volatile uint64 bytes;
+            uint64 max_entries;
+            uint64 max_bytes;
+            FrequencySketch sketch;
+            SpinRWLock lock;
+            CacheShard() :
+                    hand(0), bytes(0), max_entries(0), max_bytes(0)
+            {
+            }
+            bool Full(uint64 extra_entries) const;
+            uint32 NextVictim();
+            void Remove(uint32 slot);
+    };
+
+    typedef std::vector<CacheData*> CacheDataArray;
+
+    /*
+     * Sharded cache of one data type. Lookups take the shard lock in read mode and only set the
+     * CLOCK reference bit of the hit slot, so readers of the same shard do not serialize. A new
+     * key is admitted into a full shard only if the frequency sketch rates it above the CLOCK
+     * victim, which keeps one-time scans from flushing the hot keys.
+     */
+    class ClockCache
     {
-            CacheTable cache;
-            SpinMutexLock lock;
+        private:
+            CacheShard* m_shards;
+            uint32 m_shard_count;
+            uint64 m_max_entries;
+            uint64 m_max_bytes;
+            volatile uint64 m_rejected;
+            volatile uint64 m_evicted;
+            CacheShard& GetShard(uint32 hash)
+            {
+                return m_shards[hash & (m_shard_count - 1)];
+            }
+            void Evict(CacheShard& shard, uint32 slot, CacheDataArray& evicted);
+        public:
             CacheStatistics stat;
+            ClockCache();
+            void Init(uint32 shards, uint64 max_entries, uint64 max_bytes);
+            CacheData* Get(const DBItemKey& key, bool peek);
+            CacheData* Erase(const DBItemKey& key);
+            bool Insert(const DBItemKey& key, CacheData* data, bool force_admit, CacheDataArray& evicted);
+            void Trim(CacheDataArray& evicted);
+            void ClearEntries(DBID db, bool withdb_limit);
+            void Destroy();
+            uint64 Size();
+            uint64 Bytes();
+            uint64 MaxEntries()
+            {
+                return m_max_entries;
+            }
+            uint64 MaxBytes()
+            {
+                return m_max_bytes;
+            }
+            uint64 Rejected()
+            {
+                return m_rejected;
+            }
+            uint64 Evicted()
+            {
+                return m_evicted;
+            }
+            ~ClockCache();
     };
 
     typedef TreeSet<uint8>::Type StateSet;
@@ -220,8 +324,10 @@ OP_NAMESPACE_BEGIN
             bool delete_entry;
             StateSet expected_states;
             bool dirty_if_loading;
+            bool force_admit;
             CacheGetOptions() :
-                    peek(false), create_if_notexist(false), delete_entry(false), dirty_if_loading(false)
+                    peek(false), create_if_notexist(false), delete_entry(false), dirty_if_loading(false), force_admit(
+                            false)
             {
             }
     };
@@ -245,9 +351,9 @@ OP_NAMESPACE_BEGIN
     };
     struct CacheResult
     {
-            CommonLRUCache& cache;
+            ClockCache& cache;
             CacheData* data;
-            CacheResult(CommonLRUCache& c) :
+            CacheResult(ClockCache& c) :
                     cache(c), data(NULL)
             {
             }
@@ -258,16 +364,14 @@ OP_NAMESPACE_BEGIN
         private:
             ChannelService m_serv;
             const ArdbConfig& m_cfg;
-            CommonLRUCache m_string_cache;
-            CommonLRUCache m_hash_cache;
-            CommonLRUCache m_set_cache;
-            CommonLRUCache m_list_cache;
-            CommonLRUCache m_zset_cache;
-
-            uint64 m_estimate_memory_size;
+            ClockCache m_string_cache;
+            ClockCache m_hash_cache;
+            ClockCache m_set_cache;
+            ClockCache m_list_cache;
+            ClockCache m_zset_cache;
 
-            CommonLRUCache& GetCacheByType(uint8 type);
-            void ClearLRUCache(CommonLRUCache& cache, DBID dbid, bool withdb_limit);
+            ClockCache& GetCacheByType(uint8 type);
+            void TrimCache(ClockCache& cache);
 
             CacheResult GetCacheData(uint8 type, DBItemKey& key, const CacheGetOptions& options);
 
@@ -34,13 +34,38 @@
 
 OP_NAMESPACE_BEGIN
 
+    /*
+     * Allocates a sds string in 'arena' if there is one with room left, otherwise on the heap.
+     */
+    static sds new_data_string(const void* init, size_t len, Arena* arena, bool& arena_str)
+    {
+        arena_str = false;
+        if (NULL != arena)
+        {
+            struct sdshdr* sh = (struct sdshdr*) arena->Allocate(sizeof(struct sdshdr) + len + 1);
+            if (NULL != sh)
+            {
+                sh->len = len;
+                sh->free = 0;
+                if (NULL != init)
+                {
+                    memcpy(sh->buf, init, len);
+                }
+                sh->buf[len] = '\0';
+                arena_str = true;
+                return sh->buf;
+            }
+        }
+        return sdsnewlen(init, len);
+    }
+
     Data::Data() :
-            encoding(0)
+            encoding(0), arena_str(false)
     {
         value.iv = 0;
     }
     Data::Data(const Slice& v, bool try_int_encoding) :
-            encoding(0)
+            encoding(0), arena_str(false)
     {
         SetString(v, try_int_encoding);
     }
@@ -50,7 +75,7 @@ OP_NAMESPACE_BEGIN
     }
 
     Data::Data(const Data& data) :
-            encoding(0)
+            encoding(0), arena_str(false)
     {
         value.iv = 0;
         Clone(data);
@@ -92,7 +117,7 @@ OP_NAMESPACE_BEGIN
         }
         return true;
     }
-    bool Data::Decode(Buffer& buf)
+    bool Data::Decode(Buffer& buf, Arena* arena)
     {
         Clear();
         char tmp;
@@ -124,24 +149,246 @@ OP_NAMESPACE_BEGIN
                 }
                 if (len > 0)
                 {
-                    value.sv = sdsnewlen(NULL, len);
-                    if (buf.Read(value.sv, len) < 0)
+                    if (buf.ReadableBytes() < (uint32) len)
                     {
-                        sdsfree(value.sv);
                         value.sv = NULL;
                         return false;
                     }
+                    value.sv = new_data_string(buf.GetRawReadBuffer(), len, arena, arena_str);
+                    buf.AdvanceReadIndex(len);
+                }
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+        return true;
+    }
+
+    /*
+     * Order preserving encoding used by ARDB_CODEC_MEMCMP keys:
+     *  - strings: zero bytes escaped as 0x00 0xFF, terminated by 0x00 0x01
+     *  - numbers: int64 and double share one tag and sort by value, stored as the sign-flipped big-endian
+     *    bits of the nearest double, followed by a tie byte (and for large int64 the distance to that double).
+     *    Equal int64 and double values encode to the same bytes, as CommonComparator treats them as the same
+     *    key; integral values decode as int64.
+     */
+#define ORDERED_NUMBER_BELOW   1
+#define ORDERED_NUMBER_EXACT   2
+#define ORDERED_NUMBER_ABOVE   3
+#define ORDERED_DOUBLE_2_POW_63    9223372036854775808.0
+
+    static void encode_ordered_bytes(Buffer& buf, const char* data, size_t len)
+    {
+        const char* end = data + len;
+        while (data < end)
+        {
+            const char* zero = (const char*) memchr(data, 0, end - data);
+            if (NULL == zero)
+            {
+                buf.Write(data, end - data);
+                break;
+            }
+            buf.Write(data, zero - data + 1);
+            buf.WriteByte((char) 0xFF);
+            data = zero + 1;
+        }
+        buf.WriteByte(0);
+        buf.WriteByte(1);
+    }
+
+    /*
+     * 'str' points into 'buf' unless the bytes contain escaped zeros, then they are copied into 'storage'.
+     */
+    static bool decode_ordered_bytes(Buffer& buf, Slice& str, std::string& storage)
+    {
+        const char* start = buf.GetRawReadBuffer();
+        size_t len = buf.ReadableBytes();
+        bool escaped = false;
+        size_t i = 0;
+        while (true)
+        {
+            const char* zero = (const char*) memchr(start + i, 0, len - i);
+            if (NULL == zero || (size_t) (zero - start) + 1 >= len)
+            {
+                return false;
+            }
+            i = zero - start + 1;
+            if (start[i] == 1)
+            {
+                break;
+            }
+            escaped = true;
+            i++;
+        }
+        size_t rawlen = i - 1;
+        if (!escaped)
+        {
+            str = Slice(start, rawlen);
+        }
+        else
+        {
+            storage.clear();
+            storage.reserve(rawlen);
+            for (size_t j = 0; j < rawlen; j++)
+            {
+                storage.push_back(start[j]);
+                if (0 == start[j])
+                {
+                    j++;
+                }
+            }
+            str = storage;
+        }
+        buf.AdvanceReadIndex(i + 1);
+        return true;
+    }
+
+    static uint64 ordered_double_bits(double v)
+    {
+        if (v == 0)
+        {
+            v = 0; /* -0.0 */
+        }
+        uint64 u;
+        memcpy(&u, &v, sizeof(u));
+        return (u >> 63) ? ~u : (u | (1ULL << 63));
+    }
+
+    static double ordered_bits_double(uint64 u)
+    {
+        u = (u >> 63) ? (u & ~(1ULL << 63)) : ~u;
+        double v;
+        memcpy(&v, &u, sizeof(v));
+        return v;
+    }
+
+    bool Data::EncodeOrdered(Buffer& buf) const
+    {
+        switch (encoding)
+        {
+            case STRING_ENCODING_INT64:
+            {
+                double approx = (double) value.iv;
+                int64 diff;
+                if (approx >= ORDERED_DOUBLE_2_POW_63)
+                {
+                    diff = (value.iv - LLONG_MAX) - 1;
+                }
+                else
+                {
+                    diff = value.iv - (int64) approx;
+                }
+                buf.WriteByte((char) STRING_ENCODING_INT64);
+                BufferHelper::WriteFixUInt64(buf, ordered_double_bits(approx));
+                if (0 == diff)
+                {
+                    buf.WriteByte((char) ORDERED_NUMBER_EXACT);
+                }
+                else
+                {
+                    /* |diff| is at most half the double ulp near 2^63, it fits in 16 bits */
+                    buf.WriteByte((char) (diff < 0 ? ORDERED_NUMBER_BELOW : ORDERED_NUMBER_ABOVE));
+                    BufferHelper::WriteFixUInt16(buf, ((uint16) diff) ^ 0x8000);
                 }
                 break;
             }
+            case STRING_ENCODING_DOUBLE:
+            {
+                buf.WriteByte((char) STRING_ENCODING_INT64);
+                BufferHelper::WriteFixUInt64(buf, ordered_double_bits(value.dv));
+                buf.WriteByte((char) ORDERED_NUMBER_EXACT);
+                break;
+            }
+            case STRING_ENCODING_RAW:
+            {
+                buf.WriteByte((char) STRING_ENCODING_RAW);
+                encode_ordered_bytes(buf, value.sv, sdslen(value.sv));
+                break;
+            }
             default:
             {
+                buf.WriteByte((char) STRING_ENCODING_NIL);
                 break;
             }
         }
         return true;
     }
 
+    bool Data::DecodeOrdered(Buffer& buf, Arena* arena)
+    {
+        Clear();
+        char tmp;
+        if (!buf.ReadByte(tmp))
+        {
+            return false;
+        }
+        switch ((uint8) tmp)
+        {
+            case STRING_ENCODING_NIL:
+            {
+                encoding = STRING_ENCODING_NIL;
+                return true;
+            }
+            case STRING_ENCODING_INT64:
+            {
+                uint64 bits;
+                char tie;
+                if (!BufferHelper::ReadFixUInt64(buf, bits) || !buf.ReadByte(tie))
+                {
+                    return false;
+                }
+                double approx = ordered_bits_double(bits);
+                if (tie == ORDERED_NUMBER_EXACT)
+                {
+                    if (approx >= -ORDERED_DOUBLE_2_POW_63 && approx < ORDERED_DOUBLE_2_POW_63
+                            && approx == floor(approx))
+                    {
+                        SetInt64((int64) approx);
+                    }
+                    else
+                    {
+                        SetDouble(approx);
+                    }
+                    return true;
+                }
+                uint16 flipped;
+                if (!BufferHelper::ReadFixUInt16(buf, flipped))
+                {
+                    return false;
+                }
+                int64 diff = (int16) (flipped ^ 0x8000);
+                if (approx >= ORDERED_DOUBLE_2_POW_63)
+                {
+                    SetInt64(LLONG_MAX + (diff + 1));
+                }
+                else
+                {
+                    SetInt64((int64) approx + diff);
+                }
+                return true;
+            }
+            case STRING_ENCODING_RAW:
+            {
+                Slice str;
+                std::string storage;
+                if (!decode_ordered_bytes(buf, str, storage))
+                {
+                    return false;
+                }
+                encoding = STRING_ENCODING_RAW;
+                value.sv = new_data_string(str.data(), str.size(), arena, arena_str);
+                return true;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
     void Data::Clone(const Data& data)
     {
         Clear();
@@ -180,10 +427,7 @@ OP_NAMESPACE_BEGIN
 
     void Data::SetString(const Slice& str, bool try_int_encoding)
     {
-        if (encoding == STRING_ENCODING_RAW && NULL != value.sv)
-        {
-            sdsfree(value.sv);
-        }
+        Clear();
         if (str.size() == 0)
         {
             encoding = STRING_ENCODING_NIL;
@@ -202,10 +446,7 @@ OP_NAMESPACE_BEGIN
     }
     bool Data::SetNumber(const std::string& str)
     {
-        if (encoding == STRING_ENCODING_RAW && NULL != value.sv)
-        {
-            sdsfree(value.sv);
-        }
+        Clear();
         if (string2ll(str.data(), str.size(), &(value.iv)) > 0)
         {
             encoding = STRING_ENCODING_INT64;
@@ -226,11 +467,13 @@ OP_NAMESPACE_BEGIN
     }
     void Data::SetInt64(int64 v)
     {
+        Clear();
         encoding = STRING_ENCODING_INT64;
         value.iv = v;
     }
     void Data::SetDouble(double v)
     {
+        Clear();
         encoding = STRING_ENCODING_DOUBLE;
         value.dv = v;
     }
@@ -468,17 +711,56 @@ OP_NAMESPACE_BEGIN
         return value.sv;
     }
 
-    void KeyObject::Encode()
+    /*
+     * Element keys of collections carry the collection version, see KEY_VERSION_FLAG.
+     */
+    static bool key_versioned(const KeyObject& k)
     {
-        encode_buf.Clear();
-        uint32 header = (uint32) (db << 8) + type;
+        if (0 == k.version)
+        {
+            return false;
+        }
+        switch (k.type)
+        {
+            case SET_ELEMENT:
+            case ZSET_ELEMENT_SCORE:
+            case ZSET_ELEMENT_VALUE:
+            case ZSET_ELEMENT_RANK:
+            case HASH_FIELD:
+            case LIST_ELEMENT:
+            case LIST_CHUNK:
+            case LIST_CHUNK_INDEX:
+            case BITSET_ELEMENT:
+            {
+                return true;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
+    static void encode_key_varint(KeyObject& k)
+    {
+        Buffer& encode_buf = k.encode_buf;
+        Data& element = k.element;
+        Data& score = k.score;
+        bool versioned = key_versioned(k);
+        uint32 header = (uint32) (k.db << 8) + k.type + (versioned ? KEY_VERSION_FLAG : 0);
         encode_buf.Write(&header, sizeof(header));
         //BufferHelper::WriteFixUInt32(encode_buf, header);
-        BufferHelper::WriteVarSlice(encode_buf, key);
-        switch (type)
+        BufferHelper::WriteVarSlice(encode_buf, k.key);
+        if (versioned)
+        {
+            BufferHelper::WriteFixUInt32(encode_buf, k.version);
+        }
+        switch (k.type)
         {
             case KEY_META:
             case SCRIPT:
+            case KEY_RECLAIM_ELEMENT:
+            case KEY_COUNT_ELEMENT:
             {
                 break;
             }
@@ -497,6 +779,9 @@ OP_NAMESPACE_BEGIN
                 break;
             }
             case BITSET_ELEMENT:
+            case ZSET_ELEMENT_RANK:
+            case LIST_CHUNK:
+            case LIST_CHUNK_INDEX:
             case KEY_EXPIRATION_ELEMENT:
             {
                 score.Encode(encode_buf);
@@ -509,24 +794,37 @@ OP_NAMESPACE_BEGIN
             }
         }
     }
-    bool KeyObject::Decode(Buffer& buf)
+
+    static bool decode_key_varint(KeyObject& k, Buffer& buf)
     {
+        Data& element = k.element;
+        Data& score = k.score;
         uint32 header = 0;
         if (!buf.Read(&header, sizeof(header)))
         {
             return false;
         }
-        Clear();
-        type = (uint8) (header & 0xFF);
-        db = header >> 8;
-        if (!BufferHelper::ReadVarSlice(buf, key))
+        k.Clear();
+        k.type = (uint8) (header & 0xFF);
+        k.db = header >> 8;
+        if (!BufferHelper::ReadVarSlice(buf, k.key))
         {
             return false;
         }
-        switch (type)
+        if (k.type != KEY_END && (k.type & KEY_VERSION_FLAG))
+        {
+            k.type &= ~KEY_VERSION_FLAG;
+            if (!BufferHelper::ReadFixUInt32(buf, k.version))
+            {
+                return false;
+            }
+        }
+        switch (k.type)
         {
             case KEY_META:
             case SCRIPT:
+            case KEY_RECLAIM_ELEMENT:
+            case KEY_COUNT_ELEMENT:
             {
                 break;
             }
@@ -534,7 +832,7 @@ OP_NAMESPACE_BEGIN
             case ZSET_ELEMENT_VALUE:
             case HASH_FIELD:
             {
-                if (!element.Decode(buf))
+                if (!element.Decode(buf, k.arena))
                 {
                     return false;
                 }
@@ -542,11 +840,11 @@ OP_NAMESPACE_BEGIN
             }
             case ZSET_ELEMENT_SCORE:
             {
-                if (!score.Decode(buf))
+                if (!score.Decode(buf, k.arena))
                 {
                     return false;
                 }
-                if (!element.Decode(buf))
+                if (!element.Decode(buf, k.arena))
                 {
                     return false;
                 }
@@ -554,9 +852,12 @@ OP_NAMESPACE_BEGIN
             }
             case BITSET_ELEMENT:
             case LIST_ELEMENT:
+            case ZSET_ELEMENT_RANK:
+            case LIST_CHUNK:
+            case LIST_CHUNK_INDEX:
             case KEY_EXPIRATION_ELEMENT:
             {
-                if (!score.Decode(buf))
+                if (!score.Decode(buf, k.arena))
                 {
                     return false;
                 }
@@ -571,6 +872,165 @@ OP_NAMESPACE_BEGIN
         return true;
     }
 
+    static void encode_key_memcmp(KeyObject& k)
+    {
+        bool versioned = key_versioned(k);
+        BufferHelper::WriteFixUInt32(k.encode_buf, (uint32) (k.db << 8) + k.type + (versioned ? KEY_VERSION_FLAG : 0));
+        if (k.type == KEY_EXPIRATION_ELEMENT)
+        {
+            /* expiration entries sort by deadline first */
+            k.score.EncodeOrdered(k.encode_buf);
+            encode_ordered_bytes(k.encode_buf, k.key.data(), k.key.size());
+            return;
+        }
+        encode_ordered_bytes(k.encode_buf, k.key.data(), k.key.size());
+        if (versioned)
+        {
+            BufferHelper::WriteFixUInt32(k.encode_buf, k.version);
+        }
+        switch (k.type)
+        {
+            case KEY_META:
+            case SCRIPT:
+            case KEY_RECLAIM_ELEMENT:
+            case KEY_COUNT_ELEMENT:
+            {
+                break;
+            }
+            case SET_ELEMENT:
+            case ZSET_ELEMENT_VALUE:
+            case HASH_FIELD:
+            {
+                k.element.EncodeOrdered(k.encode_buf);
+                break;
+            }
+            case ZSET_ELEMENT_SCORE:
+            {
+                k.score.EncodeOrdered(k.encode_buf);
+                k.element.EncodeOrdered(k.encode_buf);
+                break;
+            }
+            case LIST_ELEMENT:
+            case BITSET_ELEMENT:
+            case ZSET_ELEMENT_RANK:
+            case LIST_CHUNK:
+            case LIST_CHUNK_INDEX:
+            {
+                k.score.EncodeOrdered(k.encode_buf);
+                break;
+            }
+            default:
+            {
+                abort();
+                break;
+            }
+        }
+    }
+
+    static bool decode_key_memcmp(KeyObject& k, Buffer& buf)
+    {
+        uint32 header = 0;
+        if (!BufferHelper::ReadFixUInt32(buf, header))
+        {
+            return false;
+        }
+        k.Clear();
+        k.type = (uint8) (header & 0xFF);
+        k.db = header >> 8;
+        if (k.type == KEY_EXPIRATION_ELEMENT)
+        {
+            return k.score.DecodeOrdered(buf, k.arena) && decode_ordered_bytes(buf, k.key, k.key_storage);
+        }
+        if (!decode_ordered_bytes(buf, k.key, k.key_storage))
+        {
+            return false;
+        }
+        if (k.type != KEY_END && (k.type & KEY_VERSION_FLAG))
+        {
+            k.type &= ~KEY_VERSION_FLAG;
+            if (!BufferHelper::ReadFixUInt32(buf, k.version))
+            {
+                return false;
+            }
+        }
+        switch (k.type)
+        {
+            case KEY_META:
+            case SCRIPT:
+            case KEY_RECLAIM_ELEMENT:
+            case KEY_COUNT_ELEMENT:
+            {
+                return true;
+            }
+            case SET_ELEMENT:
+            case ZSET_ELEMENT_VALUE:
+            case HASH_FIELD:
+            {
+                return k.element.DecodeOrdered(buf, k.arena);
+            }
+            case ZSET_ELEMENT_SCORE:
+            {
+                return k.score.DecodeOrdered(buf, k.arena) && k.element.DecodeOrdered(buf, k.arena);
+            }
+            case LIST_ELEMENT:
+            case BITSET_ELEMENT:
+            case ZSET_ELEMENT_RANK:
+            case LIST_CHUNK:
+            case LIST_CHUNK_INDEX:
+            {
+                return k.score.DecodeOrdered(buf, k.arena);
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
+    static int g_key_codec_ver = ARDB_CODEC_MEMCMP;
+
+    void KeyObject::SetCodecVersion(int codec_ver)
+    {
+        g_key_codec_ver = codec_ver;
+    }
+
+    int KeyObject::CodecVersion()
+    {
+        return g_key_codec_ver;
+    }
+
+    void KeyObject::Encode()
+    {
+        Encode(g_key_codec_ver);
+    }
+
+    void KeyObject::Encode(int codec_ver)
+    {
+        encode_buf.Clear();
+        if (codec_ver >= ARDB_CODEC_MEMCMP)
+        {
+            encode_key_memcmp(*this);
+        }
+        else
+        {
+            encode_key_varint(*this);
+        }
+    }
+
+    bool KeyObject::Decode(Buffer& buf)
+    {
+        return Decode(buf, g_key_codec_ver);
+    }
+
+    bool KeyObject::Decode(Buffer& buf, int codec_ver)
+    {
+        if (codec_ver >= ARDB_CODEC_MEMCMP)
+        {
+            return decode_key_memcmp(*this, buf);
+        }
+        return decode_key_varint(*this, buf);
+    }
+
     int64 MetaValue::Length()
     {
         switch (Encoding())
@@ -661,7 +1121,6 @@ OP_NAMESPACE_BEGIN
                     BufferHelper::WriteVarInt64(buf, len);
                     min_index.Encode(buf);
                     max_index.Encode(buf);
-                    //encode_arg(buf, zset_score_range);
                 }
                 break;
             }
@@ -678,10 +1137,18 @@ OP_NAMESPACE_BEGIN
                 break;
             }
         }
+        /*
+         * Appended only when set, so metas of version 0 keep the layout written by older releases.
+         */
+        if (type != STRING_META && version > 0)
+        {
+            BufferHelper::WriteVarUInt32(buf, version);
+        }
     }
     bool MetaValue::Decode(Buffer& buf, uint8 type)
     {
         Clear();
+        version = 0;
         if (!BufferHelper::ReadVarUInt64(buf, expireat))
         {
             return false;
@@ -795,11 +1262,7 @@ OP_NAMESPACE_BEGIN
             }
             case BITSET_META:
             {
-                if (BufferHelper::ReadVarInt64(buf, len) && min_index.Decode(buf) && max_index.Decode(buf))
-                {
-                    return true;
-                }
-                else
+                if (!BufferHelper::ReadVarInt64(buf, len) || !min_index.Decode(buf) || !max_index.Decode(buf))
                 {
                     return false;
                 }
@@ -811,9 +1274,122 @@ OP_NAMESPACE_BEGIN
                 break;
             }
         }
+        if (type != STRING_META && buf.Readable())
+        {
+            return BufferHelper::ReadVarUInt32(buf, version);
+        }
         return true;
     }
 
+    void ZSetRankNode::Encode(Buffer& buf)
+    {
+        BufferHelper::WriteVarUInt32(buf, level);
+        BufferHelper::WriteVarUInt64(buf, next_id);
+        BufferHelper::WriteVarUInt32(buf, entries.size());
+        for (uint32 i = 0; i < entries.size(); i++)
+        {
+            entries[i].score.Encode(buf);
+            entries[i].element.Encode(buf);
+            BufferHelper::WriteVarUInt64(buf, entries[i].count);
+            BufferHelper::WriteVarUInt64(buf, entries[i].child);
+        }
+    }
+
+    bool ZSetRankNode::Decode(Buffer& buf)
+    {
+        uint32 size = 0;
+        if (!BufferHelper::ReadVarUInt32(buf, level) || !BufferHelper::ReadVarUInt64(buf, next_id)
+                || !BufferHelper::ReadVarUInt32(buf, size))
+        {
+            return false;
+        }
+        entries.resize(size);
+        for (uint32 i = 0; i < size; i++)
+        {
+            if (!entries[i].score.Decode(buf) || !entries[i].element.Decode(buf)
+                    || !BufferHelper::ReadVarUInt64(buf, entries[i].count)
+                    || !BufferHelper::ReadVarUInt64(buf, entries[i].child))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ListChunkNode::Encode(Buffer& buf)
+    {
+        BufferHelper::WriteVarUInt32(buf, level);
+        BufferHelper::WriteVarUInt64(buf, next_id);
+        BufferHelper::WriteVarUInt64(buf, chunks);
+        BufferHelper::WriteVarUInt32(buf, entries.size());
+        for (uint32 i = 0; i < entries.size(); i++)
+        {
+            BufferHelper::WriteVarUInt64(buf, entries[i].count);
+            BufferHelper::WriteVarUInt64(buf, entries[i].child);
+        }
+    }
+
+    bool ListChunkNode::Decode(Buffer& buf)
+    {
+        uint32 size = 0;
+        if (!BufferHelper::ReadVarUInt32(buf, level) || !BufferHelper::ReadVarUInt64(buf, next_id)
+                || !BufferHelper::ReadVarUInt64(buf, chunks) || !BufferHelper::ReadVarUInt32(buf, size))
+        {
+            return false;
+        }
+        entries.resize(size);
+        for (uint32 i = 0; i < size; i++)
+        {
+            if (!BufferHelper::ReadVarUInt64(buf, entries[i].count)
+                    || !BufferHelper::ReadVarUInt64(buf, entries[i].child))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ListChunk::Encode(Buffer& buf)
+    {
+        encode_arg(buf, elements);
+    }
+
+    bool ListChunk::Decode(Buffer& buf)
+    {
+        return decode_arg(buf, elements);
+    }
+
+    void ListChunkCache::Clear()
+    {
+        ListChunkNodeTable::iterator it = nodes.begin();
+        while (it != nodes.end())
+        {
+            DELETE(it->second);
+            it++;
+        }
+        nodes.clear();
+        ListChunkTable::iterator cit = chunks.begin();
+        while (cit != chunks.end())
+        {
+            DELETE(cit->second);
+            cit++;
+        }
+        chunks.clear();
+    }
+
+    void ZSetRankCache::Clear()
+    {
+        ZSetRankNodeTable::iterator it = nodes.begin();
+        while (it != nodes.end())
+        {
+            DELETE(it->second);
+            it++;
+        }
+        nodes.clear();
+        added.clear();
+        removed.clear();
+    }
+
     void ValueObject::Encode()
     {
         encode_buf.Clear();
@@ -832,6 +1408,9 @@ OP_NAMESPACE_BEGIN
             }
             case LIST_ELEMENT:
             case HASH_FIELD:
+            case ZSET_ELEMENT_RANK:
+            case LIST_CHUNK:
+            case LIST_CHUNK_INDEX:
             case SCRIPT:
             {
                 element.Encode(encode_buf);
@@ -882,9 +1461,12 @@ OP_NAMESPACE_BEGIN
             }
             case LIST_ELEMENT:
             case HASH_FIELD:
+            case ZSET_ELEMENT_RANK:
+            case LIST_CHUNK:
+            case LIST_CHUNK_INDEX:
             case SCRIPT:
             {
-                return element.Decode(buf);
+                return element.Decode(buf, arena);
             }
             case SET_ELEMENT:
             case ZSET_ELEMENT_SCORE:
@@ -894,11 +1476,11 @@ OP_NAMESPACE_BEGIN
             }
             case ZSET_ELEMENT_VALUE:
             {
-                return score.Decode(buf);
+                return score.Decode(buf, arena);
             }
             case BITSET_ELEMENT:
             {
-                return element.Decode(buf) && score.Decode(buf);
+                return element.Decode(buf, arena) && score.Decode(buf, arena);
             }
             default:
             {
@@ -915,6 +1497,13 @@ OP_NAMESPACE_BEGIN
         return key.Decode(buffer);
     }
 
+    bool decode_key(const Slice& kbuf, KeyObject& key, int codec_ver)
+    {
+        key.Clear();
+        Buffer buffer(const_cast<char*>(kbuf.data()), 0, kbuf.size());
+        return key.Decode(buffer, codec_ver);
+    }
+
     bool decode_value(const Slice& kbuf, ValueObject& value)
     {
         value.Clear();
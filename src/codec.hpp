@@ -34,6 +34,7 @@
 #include "buffer/buffer.hpp"
 #include "util/sds.h"
 #include "util/string_helper.hpp"
+#include "util/arena.hpp"
 #include "slice.hpp"
 #include <deque>
 
@@ -50,9 +51,24 @@
 
 #define COLLECTION_FLAG_NORMAL      0
 #define COLLECTION_FLAG_SEQLIST     1   //indicate that list is only sequentially pushed/poped at head/tail
+#define COLLECTION_FLAG_RANKINDEX   2   //indicate that zset maintains a persistent rank index
+#define COLLECTION_FLAG_CHUNKLIST   3   //indicate that list elements are packed into chunks located by a counted index
 
 #define ARDB_GLOBAL_DB 0xFFFFFF
 
+/*
+ * Set in the type byte of element keys belonging to a collection version other than 0, the version follows the
+ * key bytes then. Versioned elements sort in their own type range and never share a prefix with other versions.
+ */
+#define KEY_VERSION_FLAG 0x80
+
+/*
+ * Key codec versions recorded as StorageConfig::codec_ver. Keys written by ARDB_CODEC_MEMCMP
+ * sort by plain memcmp, so engines use their native bytewise comparator instead of CommonComparator.
+ */
+#define ARDB_CODEC_VARINT  1
+#define ARDB_CODEC_MEMCMP  2
+
 OP_NAMESPACE_BEGIN
 
     enum KeyType
@@ -64,15 +80,15 @@ OP_NAMESPACE_BEGIN
 
         SET_ELEMENT = 20,
 
-        ZSET_ELEMENT_SCORE = 30, ZSET_ELEMENT_VALUE = 31,
+        ZSET_ELEMENT_SCORE = 30, ZSET_ELEMENT_VALUE = 31, ZSET_ELEMENT_RANK = 32,
 
         HASH_FIELD = 40,
 
-        LIST_ELEMENT = 50,
+        LIST_ELEMENT = 50, LIST_CHUNK = 51, LIST_CHUNK_INDEX = 52,
 
         BITSET_ELEMENT = 70,
 
-        KEY_EXPIRATION_ELEMENT = 100, SCRIPT = 102,
+        KEY_EXPIRATION_ELEMENT = 100, KEY_RECLAIM_ELEMENT = 101, SCRIPT = 102, KEY_COUNT_ELEMENT = 103,
 
         KEY_END = 255, /* max value for 1byte */
     };
@@ -92,6 +108,8 @@ OP_NAMESPACE_BEGIN
             } value;
             //std::string str;
             uint8 encoding;
+            /* value.sv was allocated from a request Arena, Clear() leaves it to Arena::Reset() */
+            bool arena_str;
 
             Data();
             Data(const Slice& v, bool try_int_encoding = true);
@@ -104,7 +122,9 @@ OP_NAMESPACE_BEGIN
             ~Data();
 
             bool Encode(Buffer& buf) const;
-            bool Decode(Buffer& buf);
+            bool Decode(Buffer& buf, Arena* arena = NULL);
+            bool EncodeOrdered(Buffer& buf) const;
+            bool DecodeOrdered(Buffer& buf, Arena* arena = NULL);
 
             void SetString(const Slice& str, bool try_int_encoding);
             bool SetNumber(const std::string& str);
@@ -168,12 +188,13 @@ OP_NAMESPACE_BEGIN
 
             void Clear()
             {
-                if (encoding == STRING_ENCODING_RAW && NULL != value.sv)
+                if (encoding == STRING_ENCODING_RAW && NULL != value.sv && !arena_str)
                 {
                     sdsfree(value.sv);
                 }
                 value.iv = 0;
                 encoding = STRING_ENCODING_NIL;
+                arena_str = false;
             }
             sds RawString()
             {
@@ -213,39 +234,64 @@ OP_NAMESPACE_BEGIN
             Data score;
 
             uint8 meta_type;
+            /* version of the collection an element key belongs to, see MetaValue::version */
+            uint32 version;
+
+            /* holds the unescaped key when a memcmp encoded key contains zero bytes */
+            std::string key_storage;
+            /* decoded element/score strings are allocated here when set, see KVIterator */
+            Arena* arena;
             KeyObject() :
-                    db(0), type(0), meta_type(0)
+                    db(0), type(0), meta_type(0), version(0), arena(NULL)
             {
             }
             void Encode();
+            void Encode(int codec_ver);
             bool Decode(Buffer& buf);
+            bool Decode(Buffer& buf, int codec_ver);
+
+            static void SetCodecVersion(int codec_ver);
+            static int CodecVersion();
 
             void Clear()
             {
                 db = 0;
                 type = 0;
                 meta_type = 0;
+                version = 0;
                 element.Clear();
                 score.Clear();
             }
 
             KeyObject(const KeyObject& other) :
-                    db(0), type(0), meta_type(0)
+                    db(0), type(0), meta_type(0), version(0), arena(NULL)
             {
                 db = other.db;
                 type = other.type;
+                version = other.version;
                 key = other.key;
                 element = other.element;
                 score = other.score;
+                if (!other.key_storage.empty() && other.key.data() == other.key_storage.data())
+                {
+                    key_storage = other.key_storage;
+                    key = key_storage;
+                }
             }
             KeyObject& operator=(const KeyObject& other)
             {
                 Clear();
                 db = other.db;
                 type = other.type;
+                version = other.version;
                 key = other.key;
                 element = other.element;
                 score = other.score;
+                if (!other.key_storage.empty() && other.key.data() == other.key_storage.data())
+                {
+                    key_storage = other.key_storage;
+                    key = key_storage;
+                }
                 return *this;
             }
 
@@ -256,7 +302,6 @@ OP_NAMESPACE_BEGIN
 
     };
 
-    typedef TreeMap<double, uint32>::Type ScoreRanges;
     struct MetaValue
     {
             uint64 expireat;
@@ -271,9 +316,14 @@ OP_NAMESPACE_BEGIN
             Data min_index;  //min index value in collection(list/set)
             Data max_index;  //max index value in collection(list/set)
 
+            /*
+             * Version of the element keys of a collection. A key created while elements of an unlinked key with
+             * the same name are still reclaimed gets a version none of them uses, so it never sees them.
+             */
+            uint32 version;
 
             MetaValue() :
-                    expireat(0), attribute(0), len(0)
+                    expireat(0), attribute(0), len(0), version(0)
             {
             }
             uint8 Encoding()
@@ -296,6 +346,14 @@ OP_NAMESPACE_BEGIN
             {
                 return Flag()  == COLLECTION_FLAG_SEQLIST;
             }
+            bool HasRankIndex()
+            {
+                return Flag() == COLLECTION_FLAG_RANKINDEX;
+            }
+            bool IsChunkedList()
+            {
+                return Flag() == COLLECTION_FLAG_CHUNKLIST;
+            }
 
             int64 Length();
             void Encode(Buffer& buf, uint8 type);
@@ -315,13 +373,154 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    /*
+     * Zset rank index: a counted tree over (score, element) stored as ZSET_ELEMENT_RANK records,
+     * root node id is 0. Entries of a level 0 node count the members of a bucket starting at (score, element),
+     * entries of upper level nodes count all the members under child node.
+     */
+    struct ZSetRankEntry
+    {
+            Data score;
+            Data element;
+            uint64 count;
+            uint64 child;
+            ZSetRankEntry() :
+                    count(0), child(0)
+            {
+            }
+    };
+    typedef std::vector<ZSetRankEntry> ZSetRankEntryArray;
+
+    struct ZSetRankNode
+    {
+            uint32 level;
+            uint64 next_id;  //only used by root node
+            ZSetRankEntryArray entries;
+            bool dirty;
+            ZSetRankNode() :
+                    level(0), next_id(1), dirty(false)
+            {
+            }
+            void Encode(Buffer& buf);
+            bool Decode(Buffer& buf);
+    };
+
+    struct ZSetRankMember
+    {
+            Data score;
+            Data element;
+            int Compare(const ZSetRankMember& other) const
+            {
+                int cmp = score.Compare(other.score);
+                return 0 != cmp ? cmp : element.Compare(other.element);
+            }
+            bool operator <(const ZSetRankMember& other) const
+            {
+                return Compare(other) < 0;
+            }
+    };
+    typedef TreeSet<ZSetRankMember>::Type ZSetRankMemberSet;
+    typedef TreeMap<uint64, ZSetRankNode*>::Type ZSetRankNodeTable;
+
+    /*
+     * Rank index nodes & members touched by current write, since pending batch writes are not readable
+     * from storage engine.
+     */
+    struct ZSetRankCache
+    {
+            ZSetRankNodeTable nodes;
+            ZSetRankMemberSet added;
+            ZSetRankMemberSet removed;
+            void Clear();
+            ~ZSetRankCache()
+            {
+                Clear();
+            }
+    };
+
+    /*
+     * Chunked list: elements are packed in list order into LIST_CHUNK records, and located by position through
+     * a counted tree of LIST_CHUNK_INDEX records, root node id is 0. Entries of a level 0 node refer to chunks,
+     * entries of upper level nodes refer to child nodes, every entry counts the elements under it.
+     */
+    struct ListChunkEntry
+    {
+            uint64 count;
+            uint64 child;
+            ListChunkEntry() :
+                    count(0), child(0)
+            {
+            }
+    };
+    typedef std::vector<ListChunkEntry> ListChunkEntryArray;
+
+    struct ListChunkNode
+    {
+            uint32 level;
+            uint64 next_id;  //only used by root node, ids are shared by nodes & chunks
+            uint64 chunks;   //only used by root node
+            ListChunkEntryArray entries;
+            bool dirty;
+            ListChunkNode() :
+                    level(0), next_id(1), chunks(0), dirty(false)
+            {
+            }
+            void Encode(Buffer& buf);
+            bool Decode(Buffer& buf);
+    };
+
+    struct ListChunk
+    {
+            DataArray elements;
+            bool dirty;
+            ListChunk() :
+                    dirty(false)
+            {
+            }
+            void Encode(Buffer& buf);
+            bool Decode(Buffer& buf);
+    };
+    typedef TreeMap<uint64, ListChunkNode*>::Type ListChunkNodeTable;
+    typedef TreeMap<uint64, ListChunk*>::Type ListChunkTable;
+
+    /*
+     * Index nodes & chunks touched by current write, they are written back when the list meta is saved.
+     */
+    struct ListChunkCache
+    {
+            ListChunkNodeTable nodes;
+            ListChunkTable chunks;
+            void Clear();
+            ~ListChunkCache()
+            {
+                Clear();
+            }
+    };
+
+    /*
+     * Nodes & entry indexes from root down to the chunk holding a located position.
+     */
+    struct ListChunkPath
+    {
+            std::vector<ListChunkNode*> nodes;
+            std::vector<uint32> pos;
+            uint64 chunk_id;
+            uint64 offset;  //offset of the located position in chunk
+            ListChunkPath() :
+                    chunk_id(0), offset(0)
+            {
+            }
+    };
+
     struct AttachOptions
     {
             Location loc;  //decoded location
             bool fetch_loc;
             bool force_zipsave;
+            ZSetRankCache* zrank;
+            ListChunkCache* lchunk;
             AttachOptions() :
-                    fetch_loc(false),force_zipsave(false)
+                    fetch_loc(false),force_zipsave(false),zrank(NULL),lchunk(NULL)
             {
             }
     };
@@ -337,12 +536,15 @@ OP_NAMESPACE_BEGIN
             Data score;
 
             AttachOptions attach;
+            /* decoded element/score strings are allocated here when set, see KVIterator */
+            Arena* arena;
 
             ValueObject(uint8 t = KEY_END) :
-                    type(t)
+                    type(t), arena(NULL)
             {
             }
-            ValueObject(const ValueObject& other)
+            ValueObject(const ValueObject& other) :
+                    arena(NULL)
             {
                 type = other.type;
                 meta = other.meta;
@@ -352,6 +554,8 @@ OP_NAMESPACE_BEGIN
             }
             const ValueObject& operator=(const ValueObject& other)
             {
+                DELETE(attach.zrank);
+                DELETE(attach.lchunk);
                 type = other.type;
                 meta = other.meta;
                 element = other.element;
@@ -366,6 +570,8 @@ OP_NAMESPACE_BEGIN
                 element.Clear();
                 score.Clear();
                 meta.Clear();
+                DELETE(attach.zrank);
+                DELETE(attach.lchunk);
             }
             ~ValueObject()
             {
@@ -386,6 +592,7 @@ OP_NAMESPACE_BEGIN
     typedef std::vector<Slice> SliceArray;
 
     bool decode_key(const Slice& kbuf, KeyObject& key);
+    bool decode_key(const Slice& kbuf, KeyObject& key, int codec_ver);
     bool decode_value(const Slice& kbuf, ValueObject& value);
 
 OP_NAMESPACE_END
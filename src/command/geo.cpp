@@ -152,15 +152,19 @@ namespace ardb
         }
         uint64 t1 = get_current_epoch_millis();
         uint32 min_radius = 75; //magic number
+        GeoSearchState state;
         if (options.asc && options.limit > 0 && options.offset == 0 && options.radius > min_radius)
         {
+            /*
+             * Every pass only scans the geohash ranges the previous passes did not cover, the reply is
+             * built once the radius is settled.
+             */
             uint32 old_radius = options.radius;
             options.radius = min_radius;
             do
             {
-                ctx.reply.Clear();
-                int point_num = GeoSearchByOptions(ctx, meta, options);
-                if(point_num < 0)
+                int point_num = GeoSearchByOptions(ctx, meta, options, state, false);
+                if (point_num < 0)
                 {
                     break;
                 }
@@ -186,43 +190,110 @@ namespace ardb
                 }
             } while (options.radius <= old_radius);
         }
-        else
-        {
-            GeoSearchByOptions(ctx, meta, options);
-        }
+        GeoSearchByOptions(ctx, meta, options, state, true);
         ctx.reply.type = REDIS_REPLY_ARRAY;
         uint64 t2 = get_current_epoch_millis();
         DEBUG_LOG("####Cost %llums to range geosearch", t2 - t1);
         return 0;
     }
 
-    int Ardb::GeoSearchByOptions(Context& ctx, ValueObject& meta, GeoSearchOptions& options)
+    /*
+     * Appends the parts of [start, end) not scanned yet to 'ranges' and marks [start, end) as scanned.
+     */
+    static void geo_unscanned_ranges(GeoScoreRangeArray& scanned, uint64 start, uint64 end, GeoScoreRangeArray& ranges)
     {
-        uint64 start_time = get_current_epoch_micros();
-        int ret = 0;
-        double x = options.x, y = options.y;
-        if (options.by_member)
+        uint64 cursor = start;
+        for (size_t i = 0; i < scanned.size() && cursor < end; i++)
         {
-            Data element, score;
-            element.SetString(options.member, true);
-            ret = ZSetScore(ctx, meta, element, score);
-            if (0 != ret || score.IsNil())
+            if (scanned[i].second <= cursor)
             {
-                return -1;
+                continue;
             }
-            GeoHashHelper::GetMercatorXYByHash(score.value.iv, x, y);
-            //GeoHashHelper::GetXYByHash(score.value.iv, x, y);
+            if (scanned[i].first >= end)
+            {
+                break;
+            }
+            if (scanned[i].first > cursor)
+            {
+                ranges.push_back(GeoScoreRange(cursor, scanned[i].first));
+            }
+            cursor = scanned[i].second;
         }
-        else
+        if (cursor < end)
         {
-            if (options.coord_type != GEO_MERCATOR_TYPE)
+            ranges.push_back(GeoScoreRange(cursor, end));
+        }
+        scanned.push_back(GeoScoreRange(start, end));
+        std::sort(scanned.begin(), scanned.end());
+        size_t merged = 0;
+        for (size_t i = 1; i < scanned.size(); i++)
+        {
+            if (scanned[i].first <= scanned[merged].second)
+            {
+                scanned[merged].second = std::max(scanned[merged].second, scanned[i].second);
+            }
+            else
             {
-                x = GeoHashHelper::GetMercatorX(options.x);
-                y = GeoHashHelper::GetMercatorY(options.y);
+                scanned[++merged] = scanned[i];
             }
         }
-        DEBUG_LOG("####Step1: Cost %lluus", get_current_epoch_micros() - start_time);
-        GeoPointArray points;
+        scanned.resize(merged + 1);
+    }
+
+    bool Ardb::GeoMatchFilters(Context& ctx, GeoSearchOptions& options, const std::string& value)
+    {
+        if (options.includes.empty() && options.excludes.empty())
+        {
+            return true;
+        }
+        Data subst;
+        subst.SetString(value, false);
+        bool matched = options.includes.empty() ? true : false;
+        if (!options.includes.empty())
+        {
+            StringStringMap::const_iterator sit = options.includes.begin();
+            while (sit != options.includes.end())
+            {
+                Data mv;
+                if (0 != MatchValueByPattern(ctx, sit->first, sit->second, subst, mv))
+                {
+                    matched = false;
+                    break;
+                }
+                else
+                {
+                    matched = true;
+                }
+                sit++;
+            }
+        }
+        if (matched && !options.excludes.empty())
+        {
+            StringStringMap::const_iterator sit = options.excludes.begin();
+            while (sit != options.excludes.end())
+            {
+                Data mv;
+                if (0 == MatchValueByPattern(ctx, sit->first, sit->second, subst, mv))
+                {
+                    matched = false;
+                    break;
+                }
+                else
+                {
+                    matched = true;
+                }
+                sit++;
+            }
+        }
+        return matched;
+    }
+
+    /*
+     * Fetches the points of the areas covering the current radius into 'state.candidates', points of ranges
+     * fetched by earlier passes on the same state are already there.
+     */
+    int Ardb::GeoFetchCandidates(Context& ctx, ValueObject& meta, GeoSearchOptions& options, GeoSearchState& state)
+    {
         ZSetRangeByScoreOptions fetch_options;
         fetch_options.withscores = false;
         fetch_options.op = OP_GET;
@@ -230,14 +301,18 @@ namespace ardb
         fetch_options.fetch_geo_location = true;
         if (options.in_members)
         {
+            if (state.members_fetched)
+            {
+                return 0;
+            }
+            state.members_fetched = true;
             StringSet::iterator it = options.submembers.begin();
             while (it != options.submembers.end())
             {
                 Data element, score;
                 element.SetString(*it, true);
                 Location loc;
-                ret = ZSetScore(ctx, meta, element, score, &loc);
-                if (0 == ret)
+                if (0 == ZSetScore(ctx, meta, element, score, &loc))
                 {
                     fetch_options.results.push_back(element);
                     fetch_options.locs.push_back(loc);
@@ -248,140 +323,173 @@ namespace ardb
         else
         {
             GeoHashBitsSet ress;
-            GeoHashHelper::GetAreasByRadiusV2(GEO_MERCATOR_TYPE, y, x, options.radius, ress);
+            GeoHashHelper::GetAreasByRadiusV2(GEO_MERCATOR_TYPE, state.y, state.x, options.radius, ress);
             /*
              * Merge areas if possible to avoid disk search
              */
-            std::vector<ZRangeSpec> range_array;
+            GeoScoreRangeArray areas;
             GeoHashBitsSet::iterator rit = ress.begin();
-            typedef TreeMap<uint64, uint64>::Type HashRangeMap;
-            HashRangeMap tmp;
             while (rit != ress.end())
             {
                 GeoHashBits& hash = *rit;
                 GeoHashBits next = hash;
                 next.bits++;
-                tmp[GeoHashHelper::Allign60Bits(hash)] = GeoHashHelper::Allign60Bits(next);
+                areas.push_back(GeoScoreRange(GeoHashHelper::Allign60Bits(hash), GeoHashHelper::Allign60Bits(next)));
                 rit++;
             }
-            HashRangeMap::iterator tit = tmp.begin();
-            HashRangeMap::iterator nit = tmp.begin();
-            nit++;
-            while (tit != tmp.end())
+            std::sort(areas.begin(), areas.end());
+            GeoScoreRangeArray ranges;
+            for (size_t i = 0; i < areas.size();)
             {
-                ZRangeSpec range;
-                range.contain_min = true;
-                range.contain_max = true;
-                range.min.SetInt64(tit->first);
-                range.max.SetInt64(tit->second);
-                while (nit != tmp.end() && nit->first == range.max.value.iv)
+                uint64 start = areas[i].first, end = areas[i].second;
+                for (i++; i < areas.size() && areas[i].first <= end; i++)
                 {
-                    range.max.SetInt64(nit->second);
-                    nit++;
-                    tit++;
+                    end = std::max(end, areas[i].second);
                 }
-                range_array.push_back(range);
-                nit++;
-                tit++;
+                geo_unscanned_ranges(state.scanned, start, end, ranges);
             }
-
-            DEBUG_LOG("After areas merging, reduce searching area size from %u to %u", ress.size(), range_array.size());
-            std::vector<ZRangeSpec>::iterator hit = range_array.begin();
-            ZSetIterator* iter = NULL;
-            while (hit != range_array.end())
+            DEBUG_LOG("Search %u areas with %u unscanned ranges", ress.size(), ranges.size());
+            if (ranges.empty())
+            {
+                return 0;
+            }
+            if (meta.meta.Encoding() == COLLECTION_ENCODING_ZIPZSET)
+            {
+                /*
+                 * Small zsets are filtered in one pass instead of being sorted for every range.
+                 */
+                DataMap::iterator zit = meta.meta.zipmap.begin();
+                while (zit != meta.meta.zipmap.end())
+                {
+                    uint64 hash = zit->second.value.iv;
+                    GeoScoreRangeArray::iterator found = std::upper_bound(ranges.begin(), ranges.end(),
+                            GeoScoreRange(hash, (uint64) -1));
+                    if (found != ranges.begin() && hash < (found - 1)->second)
+                    {
+                        Location loc;
+                        GeoHashHelper::GetMercatorXYByHash(hash, loc.x, loc.y);
+                        fetch_options.results.push_back(zit->first);
+                        fetch_options.locs.push_back(loc);
+                    }
+                    zit++;
+                }
+            }
+            else
             {
-                ZRangeSpec& range = *hit;
-                uint64 t1 = get_current_epoch_millis();
-                ZSetRangeByScore(ctx, meta, range, fetch_options, iter);
-                uint64 t2 = get_current_epoch_millis();
-                DEBUG_LOG("####Cost %llums to range fetch", t2 - t1);
-                hit++;
+                ZSetIterator* iter = NULL;
+                for (size_t i = 0; i < ranges.size(); i++)
+                {
+                    ZRangeSpec range;
+                    range.contain_min = true;
+                    range.contain_max = false;
+                    range.min.SetInt64(ranges[i].first);
+                    range.max.SetInt64(ranges[i].second);
+                    ZSetRangeByScore(ctx, meta, range, fetch_options, iter);
+                }
+                DELETE(iter);
             }
-            DELETE(iter);
         }
-        DEBUG_LOG("####Step2: Cost %lluus", get_current_epoch_micros() - start_time);
-        uint32 outrange = 0;
         LocationDeque::iterator lit = fetch_options.locs.begin();
         DataArray::iterator vit = fetch_options.results.begin();
         while (vit != fetch_options.results.end())
         {
-            Location& loc = *lit;
             GeoPoint point;
-            point.x = loc.x;
-            point.y = loc.y;
+            point.x = lit->x;
+            point.y = lit->y;
+            vit->GetDecodeString(point.value);
+            if (GeoMatchFilters(ctx, options, point.value))
+            {
+                state.candidates.push_back(point);
+            }
+            vit++;
+            lit++;
+        }
+        return 0;
+    }
+
+    int Ardb::GeoSearchByOptions(Context& ctx, ValueObject& meta, GeoSearchOptions& options, GeoSearchState& state,
+            bool fill_reply)
+    {
+        uint64 start_time = get_current_epoch_micros();
+        if (!state.center_resolved)
+        {
+            state.x = options.x;
+            state.y = options.y;
+            if (options.by_member)
+            {
+                Data element, score;
+                element.SetString(options.member, true);
+                int ret = ZSetScore(ctx, meta, element, score);
+                if (0 != ret || score.IsNil())
+                {
+                    return -1;
+                }
+                GeoHashHelper::GetMercatorXYByHash(score.value.iv, state.x, state.y);
+            }
+            else if (options.coord_type != GEO_MERCATOR_TYPE)
+            {
+                state.x = GeoHashHelper::GetMercatorX(options.x);
+                state.y = GeoHashHelper::GetMercatorY(options.y);
+            }
+            state.center_resolved = true;
+        }
+        double x = state.x, y = state.y;
+        DEBUG_LOG("####Step1: Cost %lluus", get_current_epoch_micros() - start_time);
+        GeoFetchCandidates(ctx, meta, options, state);
+        DEBUG_LOG("####Step2: Cost %lluus", get_current_epoch_micros() - start_time);
+        /*
+         * With a sorted LIMIT only the best offset+limit points are kept in a bounded heap whose front is
+         * the worst point kept.
+         */
+        bool (*cmp)(const GeoPoint&, const GeoPoint&) = options.asc ? less_by_distance : great_by_distance;
+        uint32 topk = (!options.nosort && options.limit > 0) ? options.offset + options.limit : 0;
+        GeoPointArray points;
+        uint32 outrange = 0;
+        GeoPointArray::iterator cit = state.candidates.begin();
+        while (cit != state.candidates.end())
+        {
+            double distance;
             /*
              * distance accuracy is 0.2m
              */
-            if (GeoHashHelper::GetDistanceSquareIfInRadius(GEO_MERCATOR_TYPE, x, y, point.x, point.y, options.radius,
-                    point.distance, 0.2))
+            if (!GeoHashHelper::GetDistanceSquareIfInRadius(GEO_MERCATOR_TYPE, x, y, cit->x, cit->y, options.radius,
+                    distance, 0.2))
             {
-                vit->GetDecodeString(point.value);
-                /*
-                 * filter by exclude/include
-                 */
-                if (!options.includes.empty() || !options.excludes.empty())
-                {
-                    Data subst;
-                    subst.SetString(point.value, false);
-                    bool matched = options.includes.empty() ? true : false;
-                    if (!options.includes.empty())
-                    {
-                        StringStringMap::const_iterator sit = options.includes.begin();
-                        while (sit != options.includes.end())
-                        {
-                            Data mv;
-                            if (0 != MatchValueByPattern(ctx, sit->first, sit->second, subst, mv))
-                            {
-                                matched = false;
-                                break;
-                            }
-                            else
-                            {
-                                matched = true;
-                            }
-                            sit++;
-                        }
-                    }
-                    if (matched && !options.excludes.empty())
-                    {
-                        StringStringMap::const_iterator sit = options.excludes.begin();
-                        while (sit != options.excludes.end())
-                        {
-                            Data mv;
-                            if (0 == MatchValueByPattern(ctx, sit->first, sit->second, subst, mv))
-                            {
-                                matched = false;
-                                break;
-                            }
-                            else
-                            {
-                                matched = true;
-                            }
-                            sit++;
-                        }
-                    }
-                    if (matched)
-                    {
-                        points.push_back(point);
-                    }
-                }
-                else
+                outrange++;
+                cit++;
+                continue;
+            }
+            if (0 == topk || points.size() < topk)
+            {
+                points.push_back(*cit);
+                points.back().distance = distance;
+                if (topk > 0)
                 {
-                    points.push_back(point);
+                    std::push_heap(points.begin(), points.end(), cmp);
                 }
             }
             else
             {
-                outrange++;
+                GeoPoint point = *cit;
+                point.distance = distance;
+                if (cmp(point, points.front()))
+                {
+                    std::pop_heap(points.begin(), points.end(), cmp);
+                    points.back() = point;
+                    std::push_heap(points.begin(), points.end(), cmp);
+                }
             }
-            vit++;
-            lit++;
+            cit++;
         }
         DEBUG_LOG("###Result size:%d,  outrange:%d", points.size(), outrange);
         DEBUG_LOG("####Step3: Cost %lluus", get_current_epoch_micros() - start_time);
-        if (!options.nosort)
+        if (topk > 0)
         {
-            std::sort(points.begin(), points.end(), options.asc ? less_by_distance : great_by_distance);
+            std::sort_heap(points.begin(), points.end(), cmp);
+        }
+        else if (!options.nosort)
+        {
+            std::sort(points.begin(), points.end(), cmp);
         }
         DEBUG_LOG("####Step3.5: Cost %lluus", get_current_epoch_micros() - start_time);
         if (options.offset > 0)
@@ -405,6 +513,10 @@ namespace ardb
             }
         }
         DEBUG_LOG("####Step4: Cost %lluus", get_current_epoch_micros() - start_time);
+        if (!fill_reply)
+        {
+            return points.size();
+        }
         ValueObjectMap meta_cache;
         GeoPointArray::iterator pit = points.begin();
         while (pit != points.end())
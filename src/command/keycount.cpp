@@ -0,0 +1,480 @@
+/*
+ *Copyright (c) 2013-2014, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "ardb.hpp"
+
+/*
+ * Key counts: every creation/deletion of a meta key adjusts an in memory per db, per type counter, so
+ * DBSIZE and INFO keyspace never scan. The counters are written as one KEY_COUNT_ELEMENT record on clean
+ * shutdown and marked dirty again on startup; a dirty or missing record is rebuilt by a background scan of
+ * the meta keys.
+ */
+OP_NAMESPACE_BEGIN
+
+    class KeyCountVerifier: public Thread
+    {
+        private:
+            Ardb& m_db;
+        public:
+            KeyCountVerifier(Ardb& db) :
+                    m_db(db)
+            {
+            }
+            void Run()
+            {
+                m_db.VerifyKeyCounts();
+            }
+    };
+
+    static void count_key(KeyCounts& counts, uint8 type, int64 delta)
+    {
+        if (type >= STRING_META && type <= LIST_META)
+        {
+            counts.counts[type] += delta;
+            counts.counts[0] += delta;
+        }
+    }
+
+    static void count_record_key(KeyObject& k)
+    {
+        k.db = ARDB_GLOBAL_DB;
+        k.type = KEY_COUNT_ELEMENT;
+        k.key = "";
+        k.Encode();
+    }
+
+    void Ardb::RecordMetaType(Context& ctx, KeyObject& key, uint8 type)
+    {
+        if (KEY_META != key.type || !(ctx.cmd_setting_flags & ARDB_CMD_WRITE))
+        {
+            return;
+        }
+        ctx.meta_type_lookup.db = key.db;
+        ctx.meta_type_lookup.key.assign(key.key.data(), key.key.size());
+        ctx.meta_types[ctx.meta_type_lookup] = type;
+    }
+
+    /*
+     * Meta type of the stored key before it is overwritten or deleted, KEY_END if it does not exist.
+     * Most writes read the meta first, that read recorded the type already. A blind overwrite with a
+     * 'blind_type' only asks the engine for a check without disk reads; if that can not tell, the key is
+     * taken to exist with the written type, and the guess is left for the verifier to reconcile.
+     */
+    uint8 Ardb::LookupMetaType(Context& ctx, KeyObject& key, uint8 blind_type)
+    {
+        if (ctx.IsDumpFile())
+        {
+            return KEY_END;
+        }
+        if ((ctx.cmd_setting_flags & ARDB_CMD_WRITE) && !ctx.meta_types.empty())
+        {
+            ctx.meta_type_lookup.db = key.db;
+            ctx.meta_type_lookup.key.assign(key.key.data(), key.key.size());
+            MetaTypeTable::iterator found = ctx.meta_types.find(ctx.meta_type_lookup);
+            if (found != ctx.meta_types.end())
+            {
+                return found->second;
+            }
+        }
+        if (!key.encode_buf.Readable())
+        {
+            key.Encode();
+        }
+        Slice kbuf(key.encode_buf.GetRawReadBuffer(), key.encode_buf.ReadableBytes());
+        std::string v;
+        if (KEY_END != blind_type)
+        {
+            Options options;
+            uint64 start = get_current_epoch_micros();
+            int exist = GetKeyValueEngine().KeyMayExist(kbuf, &v, options);
+            m_stat.StatReadLatency(get_current_epoch_micros() - start);
+            if (exist >= 0)
+            {
+                return exist > 0 && !v.empty() ? (uint8) v[0] : KEY_END;
+            }
+            atomic_add_uint64(&m_key_count_guesses, 1);
+            return blind_type;
+        }
+        if (0 == GetRaw(ctx, kbuf, v) && !v.empty())
+        {
+            return (uint8) v[0];
+        }
+        return KEY_END;
+    }
+
+    void Ardb::CountKey(Context& ctx, KeyObject& key, uint8 old_type, uint8 new_type)
+    {
+        if (ctx.IsDumpFile())
+        {
+            /*
+             * loading a dump rebuilds the counts once it is done
+             */
+            return;
+        }
+        RecordMetaType(ctx, key, new_type);
+        if (old_type == new_type)
+        {
+            return;
+        }
+        Context* batch_ctx = m_batch_ctx.GetValue();
+        if (NULL != batch_ctx)
+        {
+            batch_ctx->key_count_changes.push_back(KeyCountChange(key.db, old_type, new_type));
+            return;
+        }
+        ApplyKeyCount(key.db, old_type, new_type);
+    }
+
+    void Ardb::ApplyKeyCount(DBID db, uint8 old_type, uint8 new_type)
+    {
+        LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+        KeyCounts& counts = m_key_counts[db];
+        count_key(counts, old_type, -1);
+        count_key(counts, new_type, 1);
+        if (NULL != m_key_counts_rebuild)
+        {
+            /*
+             * the verifier scans a snapshot, so changes made after it started are added on top of it.
+             */
+            KeyCounts& rebuild = (*m_key_counts_rebuild)[db];
+            count_key(rebuild, old_type, -1);
+            count_key(rebuild, new_type, 1);
+        }
+    }
+
+    /*
+     * Batches nest on a thread like the engine batch does, changes are staged in the context of the outermost one.
+     */
+    void Ardb::BeginBatchWrite(Context& ctx)
+    {
+        Context*& batch_ctx = m_batch_ctx.GetValue();
+        if (NULL == batch_ctx)
+        {
+            batch_ctx = &ctx;
+        }
+        batch_ctx->batch_depth++;
+    }
+
+    /*
+     * A discarded batch drops every write made in it so far, so do its staged key count changes.
+     */
+    void Ardb::EndBatchWrite(bool committed)
+    {
+        Context*& batch_ctx = m_batch_ctx.GetValue();
+        if (NULL == batch_ctx)
+        {
+            return;
+        }
+        if (!committed)
+        {
+            batch_ctx->key_count_changes.clear();
+            batch_ctx->repl_feeds.clear();
+            batch_ctx->meta_types.clear();
+        }
+        if (batch_ctx->batch_depth > 0)
+        {
+            batch_ctx->batch_depth--;
+        }
+        if (batch_ctx->batch_depth > 0)
+        {
+            return;
+        }
+        KeyCountChangeArray changes;
+        ReplicationFeedArray feeds;
+        changes.swap(batch_ctx->key_count_changes);
+        feeds.swap(batch_ctx->repl_feeds);
+        batch_ctx = NULL;
+        for (size_t i = 0; i < changes.size(); i++)
+        {
+            ApplyKeyCount(changes[i].db, changes[i].old_type, changes[i].new_type);
+        }
+        for (size_t i = 0; i < feeds.size(); i++)
+        {
+            m_master.FeedSlaves(feeds[i].db, feeds[i].cmd);
+        }
+    }
+
+    /*
+     * Slaves only get the writes of committed batches, commands run inside a batch are fed when it commits.
+     */
+    void Ardb::FeedSlaves(DBID db, RedisCommandFrame& cmd)
+    {
+        Context* batch_ctx = m_batch_ctx.GetValue();
+        if (NULL != batch_ctx)
+        {
+            batch_ctx->repl_feeds.push_back(ReplicationFeed(db, cmd));
+            return;
+        }
+        m_master.FeedSlaves(db, cmd);
+    }
+
+    int64 Ardb::GetKeyCount(DBID db, uint8 type)
+    {
+        LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+        KeyCountTable::iterator found = m_key_counts.find(db);
+        if (found == m_key_counts.end() || type > LIST_META)
+        {
+            return 0;
+        }
+        return found->second.counts[type] > 0 ? found->second.counts[type] : 0;
+    }
+
+    int Ardb::LoadKeyCounts()
+    {
+        KeyObject k;
+        count_record_key(k);
+        Context tmpctx;
+        std::string v;
+        m_key_counts_dirty = true;
+        if (0 == GetRaw(tmpctx, Slice(k.encode_buf.GetRawReadBuffer(), k.encode_buf.ReadableBytes()), v) && !v.empty())
+        {
+            Buffer buf(const_cast<char*>(v.data()), 0, v.size());
+            char clean = 0;
+            uint32 dbs = 0;
+            KeyCountTable counts;
+            bool valid = buf.ReadByte(clean) && BufferHelper::ReadVarUInt32(buf, dbs);
+            for (uint32 i = 0; valid && i < dbs; i++)
+            {
+                uint32 db = 0;
+                valid = BufferHelper::ReadVarUInt32(buf, db);
+                KeyCounts& c = counts[db];
+                for (uint8 type = STRING_META; valid && type <= LIST_META; type++)
+                {
+                    uint64 count = 0;
+                    valid = BufferHelper::ReadVarUInt64(buf, count);
+                    count_key(c, type, (int64) count);
+                }
+            }
+            if (valid && clean)
+            {
+                LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+                m_key_counts = counts;
+                m_key_counts_dirty = false;
+            }
+        }
+        if (m_key_counts_dirty)
+        {
+            INFO_LOG("Key counts were not saved on a clean shutdown, they will be rebuilt in background.");
+            return 0;
+        }
+        /*
+         * any exit from now on without SaveKeyCounts(true) leaves the record dirty
+         */
+        return SaveKeyCounts(false);
+    }
+
+    int Ardb::SaveKeyCounts(bool clean)
+    {
+        if (NULL == m_engine)
+        {
+            return -1;
+        }
+        KeyObject k;
+        count_record_key(k);
+        Buffer buf;
+        {
+            LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+            /*
+             * counts rebuilt only partially are never trusted
+             */
+            buf.WriteByte(clean && !m_key_counts_dirty ? 1 : 0);
+            BufferHelper::WriteVarUInt32(buf, m_key_counts.size());
+            KeyCountTable::iterator it = m_key_counts.begin();
+            while (it != m_key_counts.end())
+            {
+                BufferHelper::WriteVarUInt32(buf, it->first);
+                for (uint8 type = STRING_META; type <= LIST_META; type++)
+                {
+                    int64 count = it->second.counts[type];
+                    BufferHelper::WriteVarUInt64(buf, count > 0 ? count : 0);
+                }
+                it++;
+            }
+        }
+        Context tmpctx;
+        return SetRaw(tmpctx, Slice(k.encode_buf.GetRawReadBuffer(), k.encode_buf.ReadableBytes()),
+                Slice(buf.GetRawReadBuffer(), buf.ReadableBytes()));
+    }
+
+    /*
+     * Start the background verifier, or make the running one start over.
+     */
+    void Ardb::RebuildKeyCounts()
+    {
+        LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+        m_key_counts_dirty = true;
+        if (NULL != m_key_counts_rebuild)
+        {
+            m_key_counts_restart = true;
+            return;
+        }
+        if (NULL != m_key_count_verifier)
+        {
+            /*
+             * the previous verifier already finished
+             */
+            m_key_count_verifier->Join();
+            DELETE(m_key_count_verifier);
+        }
+        m_key_counts_stop = false;
+        NEW(m_key_counts_rebuild, KeyCountTable);
+        NEW(m_key_count_verifier, KeyCountVerifier(*this));
+        m_key_count_verifier->Start();
+    }
+
+    void Ardb::VerifyKeyCounts()
+    {
+        uint64 start_time = get_current_epoch_millis();
+        while (!m_key_counts_stop)
+        {
+            KeyObject start;
+            start.db = 0;
+            start.type = KEY_META;
+            Iterator* iter = NULL;
+            {
+                LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+                m_key_counts_rebuild->clear();
+                m_key_counts_restart = false;
+                iter = IteratorKeyValue(start, false);
+            }
+            KeyCountTable scanned;
+            uint64 scanned_keys = 0;
+            while (NULL != iter && iter->Valid() && !m_key_counts_stop && !m_key_counts_restart)
+            {
+                KeyObject k;
+                if (!decode_key(iter->Key(), k) || k.db == ARDB_GLOBAL_DB)
+                {
+                    break;
+                }
+                if (k.type != KEY_META)
+                {
+                    KeyObject next;
+                    next.db = k.db + 1;
+                    next.type = KEY_META;
+                    IteratorSeek(iter, next);
+                    continue;
+                }
+                Slice v = iter->Value();
+                if (v.size() > 0)
+                {
+                    count_key(scanned[k.db], (uint8) v.data()[0], 1);
+                }
+                scanned_keys++;
+                iter->Next();
+            }
+            DELETE(iter);
+            if (m_key_counts_stop)
+            {
+                break;
+            }
+            LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+            if (m_key_counts_restart)
+            {
+                continue;
+            }
+            KeyCountTable::iterator it = m_key_counts_rebuild->begin();
+            while (it != m_key_counts_rebuild->end())
+            {
+                KeyCounts& c = scanned[it->first];
+                for (uint8 type = 0; type <= LIST_META; type++)
+                {
+                    c.counts[type] += it->second.counts[type];
+                }
+                it++;
+            }
+            m_key_counts = scanned;
+            m_key_counts_dirty = false;
+            DELETE(m_key_counts_rebuild);
+            INFO_LOG("Rebuilt key counts from %llu keys in %llums.", scanned_keys, get_current_epoch_millis() - start_time);
+            return;
+        }
+        LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+        DELETE(m_key_counts_rebuild);
+    }
+
+    void Ardb::StopKeyCountVerifier()
+    {
+        if (NULL == m_key_count_verifier)
+        {
+            return;
+        }
+        m_key_counts_stop = true;
+        m_key_count_verifier->Join();
+        DELETE(m_key_count_verifier);
+    }
+
+    /*
+     * Called by the db cron, rebuilds the counts once guessed blind overwrites may have moved them by more than
+     * 1% of all keys.
+     */
+    void Ardb::ReconcileKeyCounts()
+    {
+        uint64 guesses = m_key_count_guesses;
+        if (guesses < 1000)
+        {
+            return;
+        }
+        int64 total = 0;
+        {
+            LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+            KeyCountTable::iterator it = m_key_counts.begin();
+            while (it != m_key_counts.end())
+            {
+                total += it->second.counts[0];
+                it++;
+            }
+        }
+        if (guesses * 100 < (uint64) total)
+        {
+            return;
+        }
+        atomic_sub_uint64(&m_key_count_guesses, guesses);
+        INFO_LOG("Rebuild key counts after %llu blind overwrites of unknown keys.", guesses);
+        RebuildKeyCounts();
+    }
+
+    void Ardb::ClearKeyCounts(DBID db, bool all)
+    {
+        LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+        if (all)
+        {
+            m_key_counts.clear();
+        }
+        else
+        {
+            m_key_counts.erase(db);
+        }
+        if (NULL != m_key_counts_rebuild)
+        {
+            /*
+             * the verifier snapshot still holds the flushed keys
+             */
+            m_key_counts_restart = true;
+        }
+    }
+OP_NAMESPACE_END
@@ -314,6 +314,10 @@ OP_NAMESPACE_BEGIN
     int Ardb::Rename(Context& ctx, RedisCommandFrame& cmd)
     {
         bool withnx = cmd.GetType() == REDIS_CMD_RENAMENX;
+        SliceArray lock_keys;
+        lock_keys.push_back(cmd.GetArguments()[0]);
+        lock_keys.push_back(cmd.GetArguments()[1]);
+        MultiKeyLockerGuard keylock(m_key_lock, ctx.currentDB, lock_keys);
         if (withnx)
         {
             RedisCommandFrame exists("Exists");
@@ -718,7 +722,14 @@ OP_NAMESPACE_BEGIN
         int count = 0;
         for (uint32 i = 0; i < cmd.GetArguments().size(); i++)
         {
-            count += DeleteKey(ctx, cmd.GetArguments()[i]);
+            if (m_cfg.lazyfree_lazy_del)
+            {
+                count += LazyDeleteKey(ctx, cmd.GetArguments()[i]);
+            }
+            else
+            {
+                count += DeleteKey(ctx, cmd.GetArguments()[i]);
+            }
         }
         fill_int_reply(ctx.reply, count);
         return 0;
@@ -0,0 +1,182 @@
+/*
+ *Copyright (c) 2013-2014, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ardb.hpp"
+
+namespace ardb
+{
+    /*
+     * Fills 'calls' and the cumulative count of every non empty bucket keyed by its upper bound, as LATENCY
+     * HISTOGRAM does in redis except that buckets are log-linear instead of powers of 2.
+     */
+    static void fill_histogram_reply(RedisReply& r, const LatencyHistogram& histogram)
+    {
+        r.type = REDIS_REPLY_ARRAY;
+        fill_str_reply(r.AddMember(), "calls");
+        fill_int_reply(r.AddMember(), histogram.Count());
+        fill_str_reply(r.AddMember(), "histogram_usec");
+        RedisReply& buckets = r.AddMember();
+        buckets.type = REDIS_REPLY_ARRAY;
+        uint64 cumulative = 0;
+        for (uint32 i = 0; i < LatencyHistogram::kBuckets; i++)
+        {
+            uint64 count = histogram.BucketCount(i);
+            if (count == 0)
+            {
+                continue;
+            }
+            cumulative += count;
+            fill_int_reply(buckets.AddMember(), LatencyHistogram::BucketUpperBound(i));
+            fill_int_reply(buckets.AddMember(), cumulative);
+        }
+    }
+
+    void Ardb::PrintLatencyStat(std::string& str)
+    {
+        LatencyHistograms& histograms = m_stat.GetLatencyHistograms();
+        for (uint32 i = 0; i < m_settings.size(); i++)
+        {
+            LatencyHistogram histogram;
+            if (!histograms.GetCommand(m_settings[i].id, histogram) || histogram.Count() == 0)
+            {
+                continue;
+            }
+            str.append("latency_percentiles_usec_").append(m_settings[i].name, m_settings[i].name_len);
+            str.append(":p50=").append(stringfromll(histogram.Percentile(50)));
+            str.append(",p99=").append(stringfromll(histogram.Percentile(99)));
+            str.append(",p99.9=").append(stringfromll(histogram.Percentile(99.9))).append("\r\n");
+        }
+        for (uint32 op = 0; op < ENGINE_OP_MAX; op++)
+        {
+            LatencyHistogram histogram;
+            histograms.GetEngine((EngineOperation) op, histogram);
+            str.append("latency_percentiles_usec_engine_").append(
+                    LatencyHistograms::EngineOperationName((EngineOperation) op));
+            str.append(":p50=").append(stringfromll(histogram.Percentile(50)));
+            str.append(",p99=").append(stringfromll(histogram.Percentile(99)));
+            str.append(",p99.9=").append(stringfromll(histogram.Percentile(99.9))).append("\r\n");
+        }
+        LatencyHistogram queue;
+        histograms.GetQueue(queue);
+        str.append("latency_percentiles_usec_queue");
+        str.append(":p50=").append(stringfromll(queue.Percentile(50)));
+        str.append(",p99=").append(stringfromll(queue.Percentile(99)));
+        str.append(",p99.9=").append(stringfromll(queue.Percentile(99.9))).append("\r\n");
+        str.append("latency_window_seconds:").append(stringfromll(time(NULL) - histograms.GetWindowStart())).append(
+                "\r\n");
+    }
+
+    /*
+     *  LATENCY HISTOGRAM [command ...]
+     *  LATENCY DUMP
+     *  LATENCY RESET
+     */
+    int Ardb::Latency(Context& ctx, RedisCommandFrame& cmd)
+    {
+        std::string subcmd = string_tolower(cmd.GetArguments()[0]);
+        LatencyHistograms& histograms = m_stat.GetLatencyHistograms();
+        if (subcmd == "histogram")
+        {
+            ctx.reply.type = REDIS_REPLY_ARRAY;
+            if (cmd.GetArguments().size() == 1)
+            {
+                for (uint32 i = 0; i < m_settings.size(); i++)
+                {
+                    LatencyHistogram histogram;
+                    if (!histograms.GetCommand(m_settings[i].id, histogram) || histogram.Count() == 0)
+                    {
+                        continue;
+                    }
+                    fill_str_reply(ctx.reply.AddMember(), std::string(m_settings[i].name, m_settings[i].name_len));
+                    fill_histogram_reply(ctx.reply.AddMember(), histogram);
+                }
+                return 0;
+            }
+            for (uint32 i = 1; i < cmd.GetArguments().size(); i++)
+            {
+                std::string name = string_tolower(cmd.GetArguments()[i]);
+                int32 id = LookupCommand(name);
+                if (id < 0)
+                {
+                    continue;
+                }
+                LatencyHistogram histogram;
+                if (!histograms.GetCommand(m_settings[id].id, histogram) || histogram.Count() == 0)
+                {
+                    continue;
+                }
+                fill_str_reply(ctx.reply.AddMember(), name);
+                fill_histogram_reply(ctx.reply.AddMember(), histogram);
+            }
+        }
+        else if (subcmd == "dump")
+        {
+            std::string json;
+            json.append("{\"window_start\":").append(stringfromll(histograms.GetWindowStart()));
+            json.append(",\"commands\":{");
+            bool first = true;
+            for (uint32 i = 0; i < m_settings.size(); i++)
+            {
+                LatencyHistogram histogram;
+                if (!histograms.GetCommand(m_settings[i].id, histogram) || histogram.Count() == 0)
+                {
+                    continue;
+                }
+                json.append(first ? "\"" : ",\"").append(m_settings[i].name, m_settings[i].name_len).append("\":");
+                histogram.PrintJson(json);
+                first = false;
+            }
+            json.append("},\"engine\":{");
+            for (uint32 op = 0; op < ENGINE_OP_MAX; op++)
+            {
+                json.append(op == 0 ? "\"" : ",\"").append(LatencyHistograms::EngineOperationName((EngineOperation) op)).append(
+                        "\":");
+                LatencyHistogram histogram;
+                histograms.GetEngine((EngineOperation) op, histogram);
+                histogram.PrintJson(json);
+            }
+            json.append("},\"queue\":");
+            LatencyHistogram queue;
+            histograms.GetQueue(queue);
+            queue.PrintJson(json);
+            json.append("}");
+            fill_str_reply(ctx.reply, json);
+        }
+        else if (subcmd == "reset")
+        {
+            histograms.Clear();
+            fill_status_reply(ctx.reply, "OK");
+        }
+        else
+        {
+            fill_error_reply(ctx.reply, "LATENCY subcommand must be one of HISTOGRAM, DUMP, RESET");
+        }
+        return 0;
+    }
+}
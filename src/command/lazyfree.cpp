@@ -0,0 +1,388 @@
+/*
+ *Copyright (c) 2013-2014, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "ardb.hpp"
+
+/*
+ * Lazy free: UNLINK drops the meta of a big collection and leaves a KEY_RECLAIM_ELEMENT entry behind,
+ * the element entries are then deleted in bounded batches by the db cron. The reclaim entries are persisted
+ * so that a restart resumes the pending reclaims.
+ */
+OP_NAMESPACE_BEGIN
+
+    static size_t reclaim_element_types(uint8 meta_type, KeyType* types)
+    {
+        switch (meta_type)
+        {
+            case SET_META:
+            {
+                types[0] = SET_ELEMENT;
+                return 1;
+            }
+            case ZSET_META:
+            {
+                types[0] = ZSET_ELEMENT_VALUE;
+                types[1] = ZSET_ELEMENT_SCORE;
+                types[2] = ZSET_ELEMENT_RANK;
+                return 3;
+            }
+            case HASH_META:
+            {
+                types[0] = HASH_FIELD;
+                return 1;
+            }
+            case LIST_META:
+            {
+                types[0] = LIST_ELEMENT;
+                types[1] = LIST_CHUNK;
+                types[2] = LIST_CHUNK_INDEX;
+                return 3;
+            }
+            case BITSET_META:
+            {
+                types[0] = BITSET_ELEMENT;
+                return 1;
+            }
+            default:
+            {
+                return 0;
+            }
+        }
+    }
+
+    int Ardb::LazyDeleteKey(Context& ctx, const Slice& key)
+    {
+        KeyLockerGuard keylock(m_key_lock, ctx.currentDB, key);
+        ValueObject meta;
+        meta.key.type = KEY_META;
+        meta.key.db = ctx.currentDB;
+        meta.key.key = key;
+        if (0 != GetKeyValue(ctx, meta.key, &meta))
+        {
+            return 0;
+        }
+        KeyType types[3];
+        int64 len = meta.meta.Length();
+        if (0 == reclaim_element_types(meta.type, types) || meta.meta.Encoding() != COLLECTION_ENCODING_RAW
+                || (len >= 0 && len < m_cfg.lazyfree_min_elements))
+        {
+            /*
+             * elements are stored in the meta value or there are too few of them to be worth deferring.
+             */
+            return DeleteKey(ctx, key);
+        }
+        std::string keystr(key.data(), key.size());
+        DBItemKey item(ctx.currentDB, keystr);
+        ReclaimEntryArray entries;
+        {
+            LockGuard<SpinMutexLock> guard(m_reclaim_lock);
+            ReclaimKeyTable::iterator found = m_reclaim_keys.find(item);
+            if (found != m_reclaim_keys.end())
+            {
+                entries = found->second;
+            }
+        }
+        entries.push_back(ReclaimEntry(meta.type, meta.meta.version));
+        {
+            BatchWriteGuard guard(ctx);
+            SaveReclaimEntries(ctx, item, entries);
+            DelKeyValue(ctx, meta.key);
+            if (meta.meta.expireat > 0)
+            {
+                KeyObject expire;
+                expire.type = KEY_EXPIRATION_ELEMENT;
+                expire.db = ctx.currentDB;
+                expire.key = key;
+                expire.score.SetInt64(meta.meta.expireat);
+                DelKeyValue(ctx, expire);
+            }
+            if (!guard.Success())
+            {
+                return 0;
+            }
+        }
+        LockGuard<SpinMutexLock> guard(m_reclaim_lock);
+        m_reclaim_keys[item] = entries;
+        m_reclaim_pending++;
+        return 1;
+    }
+
+    /*
+     * Persist the pending reclaims of a key as a KEY_RECLAIM_ELEMENT entry holding (meta type, version) pairs,
+     * the entry is deleted once nothing is left to reclaim.
+     */
+    void Ardb::SaveReclaimEntries(Context& ctx, const DBItemKey& item, const ReclaimEntryArray& entries)
+    {
+        KeyObject rk;
+        rk.db = item.db;
+        rk.type = KEY_RECLAIM_ELEMENT;
+        rk.key = item.key;
+        rk.Encode();
+        Slice rkey(rk.encode_buf.GetRawReadBuffer(), rk.encode_buf.ReadableBytes());
+        if (entries.empty())
+        {
+            DelRaw(ctx, rkey);
+            return;
+        }
+        Buffer buf;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            buf.WriteByte((char) entries[i].meta_type);
+            BufferHelper::WriteVarUInt32(buf, entries[i].version);
+        }
+        SetRaw(ctx, rkey, Slice(buf.GetRawReadBuffer(), buf.ReadableBytes()));
+    }
+
+    /*
+     * A collection created while older versions of the key are still reclaimed gets a version above all of them,
+     * so its element keys never share a prefix with the unlinked elements.
+     */
+    uint32 Ardb::NewCollectionVersion(DBID db, const Slice& key)
+    {
+        if (0 == m_reclaim_pending)
+        {
+            return 0;
+        }
+        std::string keystr(key.data(), key.size());
+        LockGuard<SpinMutexLock> guard(m_reclaim_lock);
+        ReclaimKeyTable::iterator found = m_reclaim_keys.find(DBItemKey(db, keystr));
+        if (found == m_reclaim_keys.end())
+        {
+            return 0;
+        }
+        uint32 version = 0;
+        for (size_t i = 0; i < found->second.size(); i++)
+        {
+            if (found->second[i].version >= version)
+            {
+                version = found->second[i].version + 1;
+            }
+        }
+        return version;
+    }
+
+    /*
+     * Delete at most 'limit' element entries of an unlinked collection version, 'done' is set once no element
+     * is left.
+     */
+    uint64 Ardb::ReclaimElements(Context& ctx, const DBItemKey& item, const ReclaimEntry& entry, uint64 limit,
+            bool& done)
+    {
+        KeyType types[3];
+        size_t type_count = reclaim_element_types(entry.meta_type, types);
+        uint64 count = 0;
+        done = true;
+        for (size_t i = 0; i < type_count && done; i++)
+        {
+            KeyObject start;
+            start.db = item.db;
+            start.type = types[i];
+            start.key = item.key;
+            start.version = entry.version;
+            Iterator* iter = IteratorPrefix(start);
+            while (NULL != iter && iter->Valid())
+            {
+                if (count >= limit)
+                {
+                    done = false;
+                    break;
+                }
+                DelRaw(ctx, iter->Key());
+                count++;
+                iter->Next();
+            }
+            DELETE(iter);
+        }
+        return count;
+    }
+
+    /*
+     * Called by the db cron, reclaims pending keys batch by batch until nothing is left or the time budget is spent.
+     * This is the only place elements of unlinked keys are deleted, recreated keys use a newer version and
+     * never look at them.
+     */
+    void Ardb::ReclaimStep(uint64 max_millis)
+    {
+        uint64 start = get_current_epoch_millis();
+        while (m_reclaim_pending > 0 && get_current_epoch_millis() - start < max_millis)
+        {
+            DBItemKey item;
+            {
+                LockGuard<SpinMutexLock> guard(m_reclaim_lock);
+                if (m_reclaim_keys.empty())
+                {
+                    return;
+                }
+                item = m_reclaim_keys.begin()->first;
+            }
+            KeyLockerGuard keylock(m_key_lock, item.db, item.key);
+            ReclaimEntryArray entries;
+            {
+                LockGuard<SpinMutexLock> guard(m_reclaim_lock);
+                ReclaimKeyTable::iterator found = m_reclaim_keys.find(item);
+                if (found == m_reclaim_keys.end() || found->second.empty())
+                {
+                    /*
+                     * cleared by a flush meanwhile
+                     */
+                    continue;
+                }
+                entries = found->second;
+            }
+            Context tmpctx;
+            tmpctx.currentDB = item.db;
+            bool done = false;
+            uint64 count = 0;
+            {
+                BatchWriteGuard guard(tmpctx);
+                count = ReclaimElements(tmpctx, item, entries[0], m_cfg.lazyfree_batch_size, done);
+                if (done)
+                {
+                    entries.erase(entries.begin());
+                    SaveReclaimEntries(tmpctx, item, entries);
+                }
+                if (!guard.Success())
+                {
+                    return;
+                }
+            }
+            LockGuard<SpinMutexLock> guard(m_reclaim_lock);
+            m_reclaimed_elements += count;
+            if (done)
+            {
+                ReclaimKeyTable::iterator found = m_reclaim_keys.find(item);
+                if (found != m_reclaim_keys.end() && !found->second.empty())
+                {
+                    found->second.erase(found->second.begin());
+                    if (found->second.empty())
+                    {
+                        m_reclaim_keys.erase(found);
+                    }
+                    m_reclaim_pending--;
+                    m_reclaimed_keys++;
+                }
+            }
+        }
+    }
+
+    int Ardb::LoadReclaimKeys()
+    {
+        DBIDSet ids;
+        GetAllDBIDSet(ids);
+        DBIDSet::iterator it = ids.begin();
+        LockGuard<SpinMutexLock> guard(m_reclaim_lock);
+        while (it != ids.end())
+        {
+            DBID db = *it;
+            KeyObject start;
+            start.db = db;
+            start.type = KEY_RECLAIM_ELEMENT;
+            Iterator* iter = IteratorKeyValue(start, false);
+            while (NULL != iter && iter->Valid())
+            {
+                KeyObject k;
+                if (!decode_key(iter->Key(), k) || k.db != db || k.type != KEY_RECLAIM_ELEMENT)
+                {
+                    break;
+                }
+                /*
+                 * (meta type, version) pairs, entries written by older releases hold a single meta type byte
+                 */
+                Slice v = iter->Value();
+                Buffer buf(const_cast<char*>(v.data()), 0, v.size());
+                ReclaimEntryArray entries;
+                char meta_type = 0;
+                while (buf.ReadByte(meta_type))
+                {
+                    uint32 version = 0;
+                    if (buf.Readable() && !BufferHelper::ReadVarUInt32(buf, version))
+                    {
+                        break;
+                    }
+                    entries.push_back(ReclaimEntry((uint8) meta_type, version));
+                }
+                if (!entries.empty())
+                {
+                    std::string keystr(k.key.data(), k.key.size());
+                    m_reclaim_keys[DBItemKey(db, keystr)] = entries;
+                    m_reclaim_pending += entries.size();
+                }
+                iter->Next();
+            }
+            DELETE(iter);
+            it++;
+        }
+        if (m_reclaim_pending > 0)
+        {
+            INFO_LOG("Loaded %llu collections pending for lazy free.", m_reclaim_pending);
+        }
+        return 0;
+    }
+
+    /*
+     * Forget the pending reclaims of flushed db(s), the reclaim entries are deleted with the data.
+     */
+    void Ardb::ClearReclaimKeys(DBID db, bool all)
+    {
+        LockGuard<SpinMutexLock> guard(m_reclaim_lock);
+        if (all)
+        {
+            m_reclaim_keys.clear();
+        }
+        else
+        {
+            ReclaimKeyTable::iterator it = m_reclaim_keys.lower_bound(DBItemKey(db, ""));
+            while (it != m_reclaim_keys.end() && it->first.db == db)
+            {
+                m_reclaim_keys.erase(it++);
+            }
+        }
+        m_reclaim_pending = 0;
+        ReclaimKeyTable::iterator it = m_reclaim_keys.begin();
+        while (it != m_reclaim_keys.end())
+        {
+            m_reclaim_pending += it->second.size();
+            it++;
+        }
+    }
+
+    int Ardb::Unlink(Context& ctx, RedisCommandFrame& cmd)
+    {
+        if (ctx.IsSlave() && m_cfg.slave_ignore_del)
+        {
+            return 0;
+        }
+        int count = 0;
+        for (uint32 i = 0; i < cmd.GetArguments().size(); i++)
+        {
+            count += LazyDeleteKey(ctx, cmd.GetArguments()[i]);
+        }
+        fill_int_reply(ctx.reply, count);
+        return 0;
+    }
+OP_NAMESPACE_END
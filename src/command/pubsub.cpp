@@ -114,7 +114,7 @@ namespace ardb
         ctx.GetPubsub().pubsub_patterns.insert(pattern);
         {
             WriteLockGuard<SpinRWLock> guard(m_pubsub_ctx_lock);
-            m_pubsub_patterns[pattern].insert(&ctx);
+            m_pubsub_patterns.Insert(pattern).insert(&ctx);
         }
 
         if (notify && NULL != ctx.client)
@@ -134,14 +134,14 @@ namespace ardb
     {
         ctx.GetPubsub().pubsub_patterns.erase(pattern);
         WriteLockGuard<SpinRWLock> guard(m_pubsub_ctx_lock);
-        PubsubContextTable::iterator it = m_pubsub_patterns.find(pattern);
+        ContextSet* subscribers = m_pubsub_patterns.Find(pattern);
         int ret = 0;
-        if (it != m_pubsub_patterns.end())
+        if (NULL != subscribers)
         {
-            it->second.erase(&ctx);
-            if (it->second.empty())
+            subscribers->erase(&ctx);
+            if (subscribers->empty())
             {
-                m_pubsub_patterns.erase(it);
+                m_pubsub_patterns.Erase(pattern);
             }
             ret = 1;
         }
@@ -237,73 +237,164 @@ namespace ardb
         return 0;
     }
 
-    static void async_write_message(Channel* ch, void * data)
+    /*
+     * The frames of one published message, encoded once and shared by the per worker batches. The last batch
+     * written frees it.
+     */
+    struct PubsubDelivery
+    {
+            std::vector<std::string> frames;
+            volatile uint32_t refs;
+            PubsubDelivery() :
+                    refs(0)
+            {
+            }
+    };
+
+    /*
+     * Subscribers of one message served by the same worker, as (channel id, frame index).
+     */
+    struct PubsubBatch
+    {
+            ChannelService* service;
+            PubsubDelivery* delivery;
+            std::vector<std::pair<uint32, uint32> > targets;
+    };
+
+    static void encode_bulk(std::string& frame, const std::string& str)
+    {
+        char len[32];
+        sprintf(len, "$%u\r\n", (uint32) str.size());
+        frame.append(len).append(str).append("\r\n");
+    }
+
+    static void async_write_batch(Channel* ch, void * data)
     {
-        RedisReply* r = (RedisReply*) data;
-        if(!ch->Write(*r))
+        PubsubBatch* batch = (PubsubBatch*) data;
+        for (size_t i = 0; i < batch->targets.size(); i++)
         {
-            ch->Close();
+            Channel* client = batch->service->GetChannel(batch->targets[i].first);
+            if (NULL == client)
+            {
+                continue;
+            }
+            const std::string& frame = batch->delivery->frames[batch->targets[i].second];
+            Buffer content(const_cast<char*>(frame.data()), 0, frame.size());
+            if (!client->Write(content))
+            {
+                client->Close();
+            }
         }
-        DELETE(r);
+        if (atomic_sub_uint32(&batch->delivery->refs, 1) == 0)
+        {
+            DELETE(batch->delivery);
+        }
+        DELETE(batch);
     }
 
-    int Ardb::PublishMessage(Context& ctx, const std::string& channel, const std::string& message)
-    {
-        ReadLockGuard<SpinRWLock> guard(m_pubsub_ctx_lock);
-        PubsubContextTable::iterator fit = m_pubsub_channels.find(channel);
+    typedef std::vector<PubsubBatch*> PubsubBatchArray;
 
+    static int add_pubsub_targets(PubsubDelivery* delivery, PubsubBatchArray& batches, ContextSet& subscribers,
+            uint32 frame_idx)
+    {
         int receiver = 0;
-        if (fit != m_pubsub_channels.end())
+        ContextSet::iterator cit = subscribers.begin();
+        while (cit != subscribers.end())
         {
-            ContextSet::iterator cit = fit->second.begin();
-            while (cit != fit->second.end())
+            Context* cc = *cit;
+            if (NULL != cc && cc->client != NULL)
             {
-                Context* cc = *cit;
-                if (NULL != cc && cc->client != NULL)
+                ChannelService* service = &(cc->client->GetService());
+                PubsubBatch* batch = NULL;
+                for (size_t i = 0; i < batches.size(); i++)
+                {
+                    if (batches[i]->service == service)
+                    {
+                        batch = batches[i];
+                        break;
+                    }
+                }
+                if (NULL == batch)
                 {
-                    RedisReply* r = NULL;
-                    NEW(r, RedisReply);
-                    RedisReply& r1 = r->AddMember();
-                    RedisReply& r2 = r->AddMember();
-                    RedisReply& r3 = r->AddMember();
-                    fill_str_reply(r1, "message");
-                    fill_str_reply(r2, channel);
-                    fill_str_reply(r3, message);
-                    cc->client->GetService().AsyncIO(cc->client->GetID(), async_write_message, r);
-                    receiver++;
+                    NEW(batch, PubsubBatch);
+                    batch->service = service;
+                    batch->delivery = delivery;
+                    batches.push_back(batch);
                 }
-                cit++;
+                batch->targets.push_back(std::make_pair(cc->client->GetID(), frame_idx));
+                receiver++;
             }
+            cit++;
         }
-        PubsubContextTable::iterator pit = m_pubsub_patterns.begin();
-        while (pit != m_pubsub_patterns.end())
+        return receiver;
+    }
+
+    struct PubsubPatternVisitor
+    {
+            PubsubDelivery* delivery;
+            PubsubBatchArray& batches;
+            const std::string& channel;
+            const std::string& message;
+            int receiver;
+            PubsubPatternVisitor(PubsubDelivery* d, PubsubBatchArray& b, const std::string& c, const std::string& m) :
+                    delivery(d), batches(b), channel(c), message(m), receiver(0)
+            {
+            }
+            void operator()(const std::string& pattern, ContextSet& subscribers)
+            {
+                uint32 frame_idx = delivery->frames.size();
+                int count = add_pubsub_targets(delivery, batches, subscribers, frame_idx);
+                if (count > 0)
+                {
+                    delivery->frames.push_back("*4\r\n$8\r\npmessage\r\n");
+                    std::string& frame = delivery->frames.back();
+                    encode_bulk(frame, pattern);
+                    encode_bulk(frame, channel);
+                    encode_bulk(frame, message);
+                    receiver += count;
+                }
+            }
+    };
+
+    /*
+     * Patterns are matched through the literal prefix index, and every frame is encoded once no matter how
+     * many subscribers get it. Each worker gets one batch per message.
+     */
+    int Ardb::PublishMessage(Context& ctx, const std::string& channel, const std::string& message)
+    {
+        PubsubDelivery* delivery = NULL;
+        NEW(delivery, PubsubDelivery);
+        PubsubBatchArray batches;
+        int receiver = 0;
         {
-            const std::string& pattern = pit->first;
-            if (stringmatchlen(pattern.c_str(), pattern.size(), channel.c_str(), channel.size(), 0))
+            ReadLockGuard<SpinRWLock> guard(m_pubsub_ctx_lock);
+            PubsubContextTable::iterator fit = m_pubsub_channels.find(channel);
+            if (fit != m_pubsub_channels.end())
             {
-                ContextSet::iterator cit = pit->second.begin();
-                while (cit != pit->second.end())
+                receiver += add_pubsub_targets(delivery, batches, fit->second, 0);
+                if (receiver > 0)
                 {
-                    Context* cc = *cit;
-                    if (NULL != cc && cc->client != NULL)
-                    {
-                        RedisReply* r = NULL;
-                        NEW(r, RedisReply);
-                        RedisReply& r1 = r->AddMember();
-                        RedisReply& r2 = r->AddMember();
-                        RedisReply& r3 = r->AddMember();
-                        RedisReply& r4 = r->AddMember();
-                        fill_str_reply(r1, "pmessage");
-                        fill_str_reply(r2, pattern);
-                        fill_str_reply(r3, channel);
-                        fill_str_reply(r4, message);
-                        cc->client->GetService().AsyncIO(cc->client->GetID(), async_write_message, r);
-                        receiver++;
-                    }
-                    cit++;
+                    delivery->frames.push_back("*3\r\n$7\r\nmessage\r\n");
+                    encode_bulk(delivery->frames.back(), channel);
+                    encode_bulk(delivery->frames.back(), message);
                 }
             }
-            pit++;
+            if (!m_pubsub_patterns.Empty())
+            {
+                PubsubPatternVisitor visitor(delivery, batches, channel, message);
+                m_pubsub_patterns.Match(channel.data(), channel.size(), visitor);
+                receiver += visitor.receiver;
+            }
+        }
+        if (batches.empty())
+        {
+            DELETE(delivery);
+            return receiver;
+        }
+        delivery->refs = batches.size();
+        for (size_t i = 0; i < batches.size(); i++)
+        {
+            batches[i]->service->AsyncIO(0, async_write_batch, batches[i]);
         }
         return receiver;
     }
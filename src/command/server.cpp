@@ -64,6 +64,19 @@ namespace ardb
         uint32 now = time(NULL);
         ChannelService& serv = ctx.client->GetService();
         uint32 conn_id = ctx.client->GetID();
+        if (m_cfg.backup_checkpoint)
+        {
+            int ret = m_backup.Save();
+            if (ret == 0)
+            {
+                fill_status_reply(ctx.reply, "OK");
+            }
+            else
+            {
+                fill_error_reply(ctx.reply, ret > 0 ? "Background save already in progress" : "Save error");
+            }
+            return 0;
+        }
         if (m_cfg.backup_redis_format)
         {
             sprintf(tmp, "%s/dump-%u.rdb", m_cfg.backup_dir.c_str(), now);
@@ -90,7 +103,7 @@ namespace ardb
 
     int Ardb::LastSave(Context& ctx, RedisCommandFrame& cmd)
     {
-        int ret = GetDataDumpFile().LastSave();
+        int ret = m_cfg.backup_checkpoint ? m_backup.LastSave() : GetDataDumpFile().LastSave();
         fill_int_reply(ctx.reply, ret);
         return 0;
     }
@@ -99,6 +112,18 @@ namespace ardb
     {
         char tmp[1024];
         uint32 now = time(NULL);
+        if (m_cfg.backup_checkpoint)
+        {
+            if (m_backup.BGSave() == 0)
+            {
+                fill_status_reply(ctx.reply, "Background saving started");
+            }
+            else
+            {
+                fill_error_reply(ctx.reply, "Background save already in progress");
+            }
+            return 0;
+        }
         if (m_cfg.backup_redis_format)
         {
             sprintf(tmp, "%s/dump-%u.rdb", m_cfg.backup_dir.c_str(), now);
@@ -139,6 +164,7 @@ namespace ardb
         {
             ret = m_ardb_dump.Load(ctx.identity, file, RDBSaveLoadRoutine, &(ctx.client->GetService()));
         }
+        RebuildKeyCounts();
         if (serv.GetChannel(conn_id) != NULL)
         {
             if (ret == 0)
@@ -186,6 +212,7 @@ namespace ardb
             time_t uptime = time(NULL) - m_starttime;
             info.append("uptime_in_seconds:").append(stringfromll(uptime)).append("\r\n");
             info.append("uptime_in_days:").append(stringfromll(uptime / (3600 * 24))).append("\r\n");
+            info.append("log_dropped_records:").append(stringfromll(ArdbLogger::GetDroppedRecords())).append("\r\n");
             info.append("\r\n");
         }
         if (!strcasecmp(section.c_str(), "all") || !strcasecmp(section.c_str(), "clients"))
@@ -285,6 +312,7 @@ namespace ardb
                                 stringfromll(time(NULL) - m_slave.GetMasterLinkDownTime())).append("\r\n");
                     }
                     info.append("slave_priority:").append(stringfromll(m_cfg.slave_priority)).append("\r\n");
+                    m_slave.PrintApplyStat(info);
                 }
 
                 info.append("connected_slaves: ").append(stringfromll(m_master.ConnectedSlaves())).append("\r\n");
@@ -320,28 +348,74 @@ namespace ardb
             info.append(m_stat.PrintStat(tmp));
             WriteLockGuard<SpinRWLock> guard(m_pubsub_ctx_lock);
             info.append("pubsub_channels:").append(stringfromll(m_pubsub_channels.size())).append("\r\n");
-            info.append("pubsub_patterns:").append(stringfromll(m_pubsub_patterns.size())).append("\r\n");
+            info.append("pubsub_patterns:").append(stringfromll(m_pubsub_patterns.Size())).append("\r\n");
+            info.append("\r\n");
+        }
+
+        if (!strcasecmp(section.c_str(), "all") || !strcasecmp(section.c_str(), "keylock"))
+        {
+            info.append("# KeyLock\r\n");
+            std::string tmp;
+            info.append(m_key_lock.PrintStat(tmp));
+            info.append("\r\n");
+        }
+
+        if (!strcasecmp(section.c_str(), "all") || !strcasecmp(section.c_str(), "expire"))
+        {
+            info.append("# Expire\r\n");
+            std::string tmp;
+            info.append(m_expire.PrintStat(tmp));
+            info.append("\r\n");
+        }
+
+        if (!strcasecmp(section.c_str(), "all") || !strcasecmp(section.c_str(), "lazyfree"))
+        {
+            info.append("# LazyFree\r\n");
+            info.append("lazyfree_pending_keys:").append(stringfromll(m_reclaim_pending)).append("\r\n");
+            info.append("lazyfree_reclaimed_keys:").append(stringfromll(m_reclaimed_keys)).append("\r\n");
+            info.append("lazyfree_reclaimed_elements:").append(stringfromll(m_reclaimed_elements)).append("\r\n");
+            info.append("\r\n");
+        }
+
+        if (!strcasecmp(section.c_str(), "all") || !strcasecmp(section.c_str(), "rechunk"))
+        {
+            info.append("# Rechunk\r\n");
+            info.append("list_rechunk_pending_keys:").append(stringfromll(m_rechunk_pending)).append("\r\n");
+            info.append("list_rechunked_keys:").append(stringfromll(m_rechunked_keys)).append("\r\n");
+            info.append("list_rechunk_skipped_keys:").append(stringfromll(m_rechunk_skipped_keys)).append("\r\n");
+            info.append("zset_rank_pending_keys:").append(stringfromll(m_zrank_pending)).append("\r\n");
+            info.append("zset_rank_built_keys:").append(stringfromll(m_zrank_built_keys)).append("\r\n");
+            info.append("zset_rank_skipped_keys:").append(stringfromll(m_zrank_skipped_keys)).append("\r\n");
             info.append("\r\n");
         }
 
         if (!strcasecmp(section.c_str(), "all") || !strcasecmp(section.c_str(), "keyspace"))
         {
-            DBIDSet ids;
-            GetAllDBIDSet(ids);
-            if (!ids.empty())
+            static const char* type_names[] = { "keys", "strings", "bitsets", "sets", "zsets", "hashes", "lists" };
+            KeyCountTable counts;
             {
-                info.append("# Keyspace\r\n");
-                DBIDSet::iterator it = ids.begin();
-                while (it != ids.end())
+                LockGuard<SpinMutexLock> guard(m_key_counts_lock);
+                counts = m_key_counts;
+            }
+            info.append("# Keyspace\r\n");
+            info.append("keycount_verifying:").append(m_key_counts_dirty ? "1" : "0").append("\r\n");
+            KeyCountTable::iterator it = counts.begin();
+            while (it != counts.end())
+            {
+                if (it->second.counts[KEY_META] > 0)
                 {
-                    /*
-                     * Can NOT tell how many keys now
-                     */
-                    info.append("db").append(stringfromll(*it)).append(":").append("keys=-1").append("\r\n");
-                    it++;
+                    info.append("db").append(stringfromll(it->first)).append(":");
+                    for (uint8 type = KEY_META; type <= LIST_META; type++)
+                    {
+                        int64 count = it->second.counts[type];
+                        info.append(type == KEY_META ? "" : ",").append(type_names[type]).append("=").append(
+                                stringfromll(count > 0 ? count : 0));
+                    }
+                    info.append("\r\n");
                 }
-                info.append("\r\n");
+                it++;
             }
+            info.append("\r\n");
         }
 
         if (!strcasecmp(section.c_str(), "all") || !strcasecmp(section.c_str(), "cache"))
@@ -377,22 +451,27 @@ namespace ardb
         if (!strcasecmp(section.c_str(), "all") || !strcasecmp(section.c_str(), "commandstats"))
         {
             info.append("# Commandstats\r\n");
-            RedisCommandHandlerSettingTable::iterator cit = m_settings.begin();
-            while (cit != m_settings.end())
+            for (uint32 i = 0; i < m_settings.size(); i++)
             {
-                RedisCommandHandlerSetting& setting = cit->second;
-                if (setting.calls > 0)
+                RedisCommandHandlerSetting& setting = m_settings[i];
+                CommandStatistics::Counter counter = m_stat.GetCommandStat().Merge(setting.id);
+                if (counter.calls > 0)
                 {
-                    info.append("cmdstat_").append(setting.name).append(":").append("calls=").append(
-                            stringfromll(setting.calls)).append(",usec=").append(stringfromll(setting.microseconds)).append(
-                            ",usecpercall=").append(stringfromll(setting.microseconds / setting.calls)).append("\r\n");
+                    info.append("cmdstat_").append(setting.name, setting.name_len).append(":").append("calls=").append(
+                            stringfromll(counter.calls)).append(",usec=").append(stringfromll(counter.microseconds)).append(
+                            ",usecpercall=").append(stringfromll(counter.microseconds / counter.calls)).append("\r\n");
                 }
-
-                cit++;
             }
             info.append("\r\n");
         }
 
+        if (!strcasecmp(section.c_str(), "all") || !strcasecmp(section.c_str(), "latencystats"))
+        {
+            info.append("# Latencystats\r\n");
+            PrintLatencyStat(info);
+            info.append("\r\n");
+        }
+
         if (!strcasecmp(section.c_str(), "all") || !strcasecmp(section.c_str(), "misc"))
         {
             info.append("# Misc\r\n");
@@ -426,7 +505,7 @@ namespace ardb
 
     int Ardb::DBSize(Context& ctx, RedisCommandFrame& cmd)
     {
-        fill_int_reply(ctx.reply, file_size(m_cfg.data_base_path));
+        fill_int_reply(ctx.reply, GetKeyCount(ctx.currentDB, KEY_META));
         return 0;
     }
 
@@ -517,16 +596,17 @@ namespace ardb
                 elpased = (now <= activetime ? 0 : now - activetime) / 1000000;
                 info.append("idle=").append(stringfromll(elpased)).append(" ");
                 info.append("db=").append(stringfromll(it->second->currentDB)).append(" ");
+                info.append("obl=").append(stringfromll(conn->WritableBytes())).append(" ");
+                info.append("omem=").append(stringfromll(conn->GetOutputBuffer().Capacity())).append(" ");
+                info.append("tot-net-out=").append(stringfromll(conn->GetOutputBytes())).append(" ");
                 std::string cmd;
-                RedisCommandHandlerSettingTable::iterator cit = m_settings.begin();
-                while (cit != m_settings.end())
+                for (uint32 i = 0; i < m_settings.size(); i++)
                 {
-                    if (cit->second.type == it->second->current_cmd_type)
+                    if (m_settings[i].type == it->second->current_cmd_type && m_settings[i].name_len > 0)
                     {
-                        cmd = cit->first;
+                        cmd.assign(m_settings[i].name, m_settings[i].name_len);
                         break;
                     }
-                    cit++;
                 }
                 info.append("cmd=").append(cmd).append(" ");
                 info.append("\n");
@@ -708,6 +788,8 @@ namespace ardb
         k.type = KEY_META;
 
         m_cache.EvictAll();
+        ClearReclaimKeys(0, true);
+        ClearKeyCounts(0, true);
         BatchWriteGuard guard(ctx);
         Iterator* iter = IteratorKeyValue(k, false);
         if (NULL != iter)
@@ -728,6 +810,8 @@ namespace ardb
         k.type = KEY_META;
 
         m_cache.EvictDB(ctx.currentDB);
+        ClearReclaimKeys(ctx.currentDB, false);
+        ClearKeyCounts(ctx.currentDB, false);
 
         BatchWriteGuard guard(ctx);
         Iterator* iter = IteratorKeyValue(k, false);
@@ -786,10 +870,11 @@ namespace ardb
         }
         m_compacting = true;
         m_last_compact_start_time = time(NULL);
-        uint64 compact_start = get_current_epoch_millis();
+        uint64 compact_start = get_current_epoch_micros();
         GetKeyValueEngine().CompactRange(start, end);
-        uint64 compact_end = get_current_epoch_millis();
-        m_last_compact_duration = compact_end - compact_start;
+        uint64 compact_end = get_current_epoch_micros();
+        m_stat.GetLatencyHistograms().StatEngine(ENGINE_OP_COMPACT, compact_end - compact_start);
+        m_last_compact_duration = (compact_end - compact_start) / 1000;
         m_compacting = false;
         return 0;
     }
@@ -447,6 +447,7 @@ namespace ardb
             list_meta.key.db = ctx.currentDB;
             list_meta.type = LIST_META;
             list_meta.meta.SetEncoding(COLLECTION_ENCODING_ZIPLIST);
+            list_meta.meta.version = NewCollectionVersion(ctx.currentDB, options.store_dst);
 
             BatchWriteGuard guard(ctx);
             DataArray::iterator it = values.begin();
@@ -28,89 +28,30 @@
  */
 
 #include "ardb.hpp"
+#include "util/bit_helper.hpp"
 
 OP_NAMESPACE_BEGIN
-    static const unsigned long BITOP_AND = 0;
-    static const unsigned long BITOP_OR = 1;
-    static const unsigned long BITOP_XOR = 2;
-    static const unsigned long BITOP_NOT = 3;
-
     static const uint32 BIT_SUBSET_SIZE = 4096;
     static const uint32 BIT_SUBSET_BYTES_SIZE = BIT_SUBSET_SIZE >> 3;
-    //copy from redis
-    static long popcount(const void *s, long count)
-    {
-        long bits = 0;
-        unsigned char *p;
-        const uint32_t* p4 = (const uint32_t*) s;
-        static const unsigned char bitsinbyte[256] =
-            { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2,
-                    3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2, 2, 3,
-                    2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3,
-                    4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3,
-                    3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4,
-                    5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 2, 3, 3, 4, 3, 4, 4, 5,
-                    3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4,
-                    5, 5, 6, 5, 6, 6, 7, 4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8 };
-
-        /* Count bits 16 bytes at a time */
-        while (count >= 16)
-        {
-            uint32_t aux1, aux2, aux3, aux4;
-
-            aux1 = *p4++;
-            aux2 = *p4++;
-            aux3 = *p4++;
-            aux4 = *p4++;
-            count -= 16;
-
-            aux1 = aux1 - ((aux1 >> 1) & 0x55555555);
-            aux1 = (aux1 & 0x33333333) + ((aux1 >> 2) & 0x33333333);
-            aux2 = aux2 - ((aux2 >> 1) & 0x55555555);
-            aux2 = (aux2 & 0x33333333) + ((aux2 >> 2) & 0x33333333);
-            aux3 = aux3 - ((aux3 >> 1) & 0x55555555);
-            aux3 = (aux3 & 0x33333333) + ((aux3 >> 2) & 0x33333333);
-            aux4 = aux4 - ((aux4 >> 1) & 0x55555555);
-            aux4 = (aux4 & 0x33333333) + ((aux4 >> 2) & 0x33333333);
-            bits += ((((aux1 + (aux1 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24)
-                    + ((((aux2 + (aux2 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24)
-                    + ((((aux3 + (aux3 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24)
-                    + ((((aux4 + (aux4 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
-        }
-        /* Count the remaining bytes */
-        p = (unsigned char*) p4;
-        while (count--)
-            bits += bitsinbyte[*p++];
-        return bits;
-    }
 
-    static long popcount_bitval(const std::string& val, int32 offset, int32 limit)
+    static long popcount_bitval(const Slice& val, int32 offset, int32 limit)
     {
-        if (limit < 0)
+        if (limit < 0 || (size_t) limit >= val.size())
         {
             limit = val.size() - 1;
         }
-        if (val.size() > limit)
-        {
-            std::string tmp = val.substr(offset, limit - offset + 1);
-            return popcount(tmp.data(), tmp.size());
-        }
-        else if (val.size() <= limit && val.size() <= offset)
+        if (offset > limit)
         {
             return 0;
         }
-        else if (val.size() > offset)
-        {
-            std::string tmp = val.substr(offset);
-            return popcount(tmp.data(), tmp.size());
-        }
-        return 0;
+        return bits_popcount(val.data() + offset, limit - offset + 1);
     }
 
     int Ardb::String2BitSet(Context& ctx, ValueObject& meta)
     {
         meta.meta.str_value.ToString();
         int len = sdslen(meta.meta.str_value.value.sv);
+        meta.meta.version = NewCollectionVersion(ctx.currentDB, meta.key.key);
         BatchWriteGuard guard(ctx);
         const char* str = meta.meta.str_value.value.sv;
         int count = len / BIT_SUBSET_BYTES_SIZE;
@@ -125,6 +66,7 @@ OP_NAMESPACE_BEGIN
             bitvalue.key.type = BITSET_ELEMENT;
             bitvalue.key.db = ctx.currentDB;
             bitvalue.key.key = meta.key.key;
+            bitvalue.key.version = meta.meta.version;
             bitvalue.key.score.SetInt64(i + 1);
             bitvalue.type = BITSET_ELEMENT;
             int str_len = BIT_SUBSET_BYTES_SIZE;
@@ -134,7 +76,7 @@ OP_NAMESPACE_BEGIN
             }
             Slice ss(str + i * BIT_SUBSET_BYTES_SIZE, str_len);
             bitvalue.element.SetString(ss, false);
-            int bit_count = popcount(str + i * BIT_SUBSET_BYTES_SIZE, str_len);
+            int bit_count = bits_popcount(str + i * BIT_SUBSET_BYTES_SIZE, str_len);
             bitvalue.score.SetInt64(bit_count);
             SetKeyValue(ctx, bitvalue);
             total_bit_count += bit_count;
@@ -236,6 +178,7 @@ OP_NAMESPACE_BEGIN
             {
                 store_as_string = false;
                 set_changed = true;
+                meta.meta.version = NewCollectionVersion(ctx.currentDB, cmd.GetArguments()[0]);
             }
         }
 
@@ -261,6 +204,7 @@ OP_NAMESPACE_BEGIN
             bitvalue.key.type = BITSET_ELEMENT;
             bitvalue.key.db = ctx.currentDB;
             bitvalue.key.key = cmd.GetArguments()[0];
+            bitvalue.key.version = meta.meta.version;
             bitvalue.key.score.SetInt64(index);
             bitvalue.type = BITSET_ELEMENT;
 
@@ -325,6 +269,7 @@ OP_NAMESPACE_BEGIN
             k.type = BITSET_ELEMENT;
             k.db = ctx.currentDB;
             k.key = key;
+            k.version = meta.meta.version;
             k.score.SetInt64(index);
             ValueObject bitvalue;
             if (-1 == GetKeyValue(ctx, k, &bitvalue))
@@ -383,6 +328,7 @@ OP_NAMESPACE_BEGIN
             bk.type = BITSET_ELEMENT;
             bk.db = ctx.currentDB;
             bk.key = meta.key.key;
+            bk.version = meta.meta.version;
             bk.score.SetInt64(iter.Index());
             DelKeyValue(ctx, bk);
             iter.Next();
@@ -412,62 +358,16 @@ OP_NAMESPACE_BEGIN
                 }
             }
         }
-        while (maxlen % 8 != 0)
-        {
-            maxlen++;
-        }
-        if (metas[0].meta.str_value.StringLength() < maxlen)
-        {
-            metas[0].meta.str_value.value.sv = sdsgrowzero(metas[0].meta.str_value.value.sv, maxlen);
-        }
-        uint64* lres = (uint64*) (metas[0].meta.str_value.value.sv);
-        uint32 k = 1;
-        if (op == BITOP_NOT)
-        {
-            k = 0;
-        }
-        for (; k < metas.size(); k++)
+        std::vector<const void*> srcs(metas.size());
+        for (uint32 k = 0; k < metas.size(); k++)
         {
             if (metas[k].meta.str_value.StringLength() < maxlen)
             {
                 metas[k].meta.str_value.value.sv = sdsgrowzero(metas[k].meta.str_value.value.sv, maxlen);
             }
-            const uint64* lp = (const uint64*) (metas[k].meta.str_value.value.sv);
-            uint32 xst = 0;
-            uint32 xet = (maxlen / 8);
-            while (xst < xet)
-            {
-                switch (op)
-                {
-                    case BITOP_AND:
-                    {
-                        lres[xst] &= lp[xst];
-                        break;
-                    }
-                    case BITOP_OR:
-                    {
-                        lres[xst] |= lp[xst];
-                        break;
-                    }
-                    case BITOP_XOR:
-                    {
-                        lres[xst] ^= lp[xst];
-                        break;
-                    }
-                    case BITOP_NOT:
-                    {
-                        lres[xst] = ~lres[xst];
-                        break;
-                    }
-                    default:
-                    {
-                        break;
-                    }
-                }
-                xst++;
-            }
+            srcs[k] = metas[k].meta.str_value.value.sv;
         }
-        int64 count = popcount(metas[0].meta.str_value.value.sv, maxlen);
+        int64 count = bits_combine(op, metas[0].meta.str_value.value.sv, &srcs[0], srcs.size(), maxlen);
         if (NULL != targetkey)
         {
             ValueObject meta;
@@ -508,6 +408,7 @@ OP_NAMESPACE_BEGIN
 
         /* Lookup keys, and store pointers to the string objects into an array. */
         int64 start_index = 0, end_index = 0;
+        bool first = true;
         ValueObjectArray metas;
         metas.resize(keys.size());
         uint8 all_type = KEY_END;
@@ -538,24 +439,33 @@ OP_NAMESPACE_BEGIN
                     return 0;
                 }
             }
-            if (all_type == BITSET_META)
+            if (0 == err && metas[j].type == BITSET_META)
             {
-                if (start_index == 0 || start_index > metas[j].meta.min_index.value.iv)
+                int64 min_index = metas[j].meta.min_index.value.iv;
+                int64 max_index = metas[j].meta.max_index.value.iv;
+                /*
+                 * AND only covers the chunks all sources have, the others cover the chunks of any source.
+                 */
+                if (first || (op == BITOP_AND ? start_index < min_index : start_index > min_index))
                 {
-                    start_index = metas[j].meta.min_index.value.iv;
+                    start_index = min_index;
                 }
-                if (end_index == 0 || end_index > metas[j].meta.max_index.value.iv)
+                if (first || (op == BITOP_AND ? end_index > max_index : end_index < max_index))
                 {
-                    end_index = metas[j].meta.max_index.value.iv;
+                    end_index = max_index;
                 }
+                first = false;
             }
         }
+        uint32 target_version = 0;
         if (NULL != targetkey)
         {
             DeleteKey(ctx, *targetkey);
+            target_version = NewCollectionVersion(ctx.currentDB, *targetkey);
         }
         if (start_index > end_index)
         {
+            fill_int_reply(ctx.reply, 0);
             return 0;
         }
         BatchWriteGuard guard(ctx, targetkey != NULL);
@@ -564,125 +474,134 @@ OP_NAMESPACE_BEGIN
             StringBitSetOP(ctx, op, metas, targetkey);
             return 0;
         }
+        /*
+         * All sources are iterated in parallel by chunk index, every step combines the chunks sharing the
+         * current index in one kernel call. Chunks missing in a source are zeros, so AND skips that index
+         * while OR/XOR just leave the source out. BITOPCOUNT only counts the combined bits.
+         */
+        uint32 num = metas.size();
+        BitsetIterator* iters = new BitsetIterator[num];
+        std::vector<int64> indexes(num, -1);
+        for (uint32 j = 0; j < num; j++)
+        {
+            if (metas[j].type == BITSET_META)
+            {
+                BitsetIter(ctx, metas[j], start_index, iters[j]);
+                indexes[j] = iters[j].Valid() ? iters[j].Index() : -1;
+            }
+        }
+        SliceArray slices;
+        std::vector<const void*> chunks;
+        StringArray paddings;
+        std::string res;
         int64 total_count = 0;
         int64 min_idx = -1;
         int64 max_idx = -1;
-        for (int64 i = start_index; i <= end_index; i++)
+        while (true)
         {
-            StringArray strs;
-            uint32 maxlen = 0;
-            for (uint32 j = 0; j < metas.size(); j++)
+            int64 idx = -1;
+            bool exhausted = false;
+            for (uint32 j = 0; j < num; j++)
             {
-                KeyObject k;
-                k.type = BITSET_ELEMENT;
-                k.db = ctx.currentDB;
-                k.key = metas[j].key.key;
-                k.score.SetInt64(i);
-                ValueObject bitvalue;
-                std::string tmp;
-                if (0 == GetKeyValue(ctx, k, &bitvalue))
+                if (indexes[j] < 0)
                 {
-                    bitvalue.element.GetDecodeString(tmp);
+                    exhausted = exhausted || op == BITOP_AND;
+                    continue;
                 }
-                else
+                if (idx == -1 || (op == BITOP_AND ? indexes[j] > idx : indexes[j] < idx))
                 {
-                    if (op == BITOP_AND)
-                    {
-                        break;
-                    }
+                    idx = indexes[j];
                 }
-
-                if (op == BITOP_AND)
+            }
+            if (exhausted || idx == -1 || idx > end_index)
+            {
+                break;
+            }
+            if (op == BITOP_AND)
+            {
+                bool aligned = true;
+                for (uint32 j = 0; j < num; j++)
                 {
-                    if (tmp.size() < maxlen || maxlen == 0)
+                    while (indexes[j] >= 0 && indexes[j] < idx)
                     {
-                        maxlen = tmp.size();
+                        iters[j].Next();
+                        indexes[j] = iters[j].Valid() ? iters[j].Index() : -1;
                     }
+                    aligned = aligned && indexes[j] == idx;
                 }
-                else
+                if (!aligned)
                 {
-                    if (tmp.size() > maxlen)
-                    {
-                        maxlen = tmp.size();
-                    }
+                    continue;
                 }
-                strs.push_back(tmp);
             }
-            if (strs.size() != metas.size())
-            {
-                continue;
-            }
-            if (-1 == min_idx)
+            size_t maxlen = 0;
+            slices.clear();
+            for (uint32 j = 0; j < num; j++)
             {
-                min_idx = i;
+                if (indexes[j] != idx)
+                {
+                    continue;
+                }
+                Slice bits = iters[j].BitsSlice();
+                if (slices.empty() || (op == BITOP_AND ? bits.size() < maxlen : bits.size() > maxlen))
+                {
+                    maxlen = bits.size();
+                }
+                slices.push_back(bits);
             }
-            max_idx = i;
-            std::string res = strs[0];
-            while (maxlen % 8 != 0)
+            /*
+             * Shorter chunks are padded with zeros up to the longest one.
+             */
+            paddings.clear();
+            for (size_t c = 0; c < slices.size(); c++)
             {
-                maxlen++;
+                if (slices[c].size() < maxlen)
+                {
+                    paddings.push_back(std::string(slices[c].data(), slices[c].size()));
+                    paddings.back().resize(maxlen);
+                }
             }
-            res.resize(maxlen);
-            uint64* lres = (uint64*) &(res[0]);
-            uint32 k = 1;
-            if (op == BITOP_NOT)
+            chunks.clear();
+            for (size_t c = 0, padding_cursor = 0; c < slices.size(); c++)
             {
-                k = 0;
+                chunks.push_back(slices[c].size() < maxlen ? paddings[padding_cursor++].data() : slices[c].data());
             }
-            for (; k < strs.size(); k++)
+            if (-1 == min_idx)
             {
-                strs[k].resize(maxlen);
-
-                const uint64* lp = (const uint64*) (strs[k].data());
-                uint32 xst = 0;
-                uint32 xet = (maxlen / 8);
-                while (xst < xet)
-                {
-                    switch (op)
-                    {
-                        case BITOP_AND:
-                        {
-                            lres[xst] &= lp[xst];
-                            break;
-                        }
-                        case BITOP_OR:
-                        {
-                            lres[xst] |= lp[xst];
-                            break;
-                        }
-                        case BITOP_XOR:
-                        {
-                            lres[xst] ^= lp[xst];
-                            break;
-                        }
-                        case BITOP_NOT:
-                        {
-                            lres[xst] = ~lres[xst];
-                            break;
-                        }
-                        default:
-                        {
-                            break;
-                        }
-                    }
-                    xst++;
-                }
+                min_idx = idx;
             }
-            int64 count = popcount(res.data(), res.size());
-            total_count += count;
+            max_idx = idx;
+            int64 count = 0;
             if (NULL != targetkey)
             {
+                res.resize(maxlen);
+                count = bits_combine(op, &res[0], &chunks[0], chunks.size(), maxlen);
                 ValueObject bitvalue;
                 bitvalue.key.type = BITSET_ELEMENT;
                 bitvalue.key.db = ctx.currentDB;
                 bitvalue.key.key = *targetkey;
-                bitvalue.key.score.SetInt64(i);
+                bitvalue.key.version = target_version;
+                bitvalue.key.score.SetInt64(idx);
                 bitvalue.type = BITSET_ELEMENT;
                 bitvalue.element.SetString(res, false);
                 bitvalue.score.SetInt64(count);
                 SetKeyValue(ctx, bitvalue);
             }
+            else
+            {
+                count = bits_combine(op, NULL, &chunks[0], chunks.size(), maxlen);
+            }
+            total_count += count;
+            for (uint32 j = 0; j < num; j++)
+            {
+                if (indexes[j] == idx)
+                {
+                    iters[j].Next();
+                    indexes[j] = iters[j].Valid() ? iters[j].Index() : -1;
+                }
+            }
         }
+        delete[] iters;
         if (NULL != targetkey)
         {
             ValueObject meta;
@@ -693,6 +612,7 @@ OP_NAMESPACE_BEGIN
             meta.meta.min_index.SetInt64(min_idx);
             meta.meta.max_index.SetInt64(max_idx);
             meta.meta.len = total_count;
+            meta.meta.version = target_version;
             SetKeyValue(ctx, meta);
         }
         fill_int_reply(ctx.reply, total_count);
@@ -789,7 +709,7 @@ OP_NAMESPACE_BEGIN
 
         if(meta.type == STRING_META)
         {
-            count = popcount(meta.meta.str_value.value.sv + start, end - start + 1);
+            count = bits_popcount(meta.meta.str_value.value.sv + start, end - start + 1);
             fill_int_reply(ctx.reply, count);
             return 0;
         }
@@ -811,18 +731,18 @@ OP_NAMESPACE_BEGIN
             {
                 if (startIndex == endIndex)
                 {
-                    count += popcount_bitval(iter.Bits(), so, eo);
+                    count += popcount_bitval(iter.BitsSlice(), so, eo);
                     break;
                 }
                 else
                 {
                     if (iter.Index() == startIndex)
                     {
-                        count += popcount_bitval(iter.Bits(), so, -1);
+                        count += popcount_bitval(iter.BitsSlice(), so, -1);
                     }
                     else
                     {
-                        count += popcount_bitval(iter.Bits(), 0, eo);
+                        count += popcount_bitval(iter.BitsSlice(), 0, eo);
                     }
                 }
             }
@@ -857,6 +777,7 @@ OP_NAMESPACE_BEGIN
         dstmeta.key.type = KEY_META;
         dstmeta.key.key = dstkey;
         dstmeta.type = BITSET_META;
+        dstmeta.meta.version = NewCollectionVersion(dstdb, dstkey);
         BatchWriteGuard guard(ctx);
         while (iter.Valid())
         {
@@ -864,6 +785,7 @@ OP_NAMESPACE_BEGIN
             bv.key.type = BITSET_ELEMENT;
             bv.key.db = dstdb;
             bv.key.key = dstkey;
+            bv.key.version = dstmeta.meta.version;
             bv.key.score.SetInt64(iter.Index());
             bv.score.SetInt64(iter.Count());
             bv.element.SetString(iter.Bits(), false);
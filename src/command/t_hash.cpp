@@ -52,6 +52,7 @@ OP_NAMESPACE_BEGIN
                 v.key.type = HASH_FIELD;
                 v.key.db = meta.key.db;
                 v.key.key = meta.key.key;
+                v.key.version = meta.meta.version;
                 v.key.element = it->first;
                 err = SetKeyValue(ctx, v);
                 CHECK_WRITE_RETURN_VALUE(ctx, err);
@@ -100,6 +101,7 @@ OP_NAMESPACE_BEGIN
                     v.key.type = HASH_FIELD;
                     v.key.db = meta.key.db;
                     v.key.key = meta.key.key;
+                    v.key.version = meta.meta.version;
                     v.key.element = fit->first;
                     err = SetKeyValue(ctx, v);
                     CHECK_WRITE_RETURN_VALUE(ctx, err);
@@ -132,6 +134,7 @@ OP_NAMESPACE_BEGIN
             vv.key.type = HASH_FIELD;
             vv.key.db = meta.key.db;
             vv.key.key = meta.key.key;
+            vv.key.version = meta.meta.version;
             vv.key.element = field;
             int err = GetKeyValue(ctx, vv.key, &vv);
             if (0 == err)
@@ -186,6 +189,7 @@ OP_NAMESPACE_BEGIN
         meta.key.type = KEY_META;
         meta.type = HASH_META;
         meta.meta.SetEncoding(COLLECTION_ENCODING_ZIPMAP);
+        meta.meta.version = NewCollectionVersion(ctx.currentDB, meta.key.key);
         DataMap fs;
         for (uint32 i = 1; i < cmd.GetArguments().size(); i += 2)
         {
@@ -438,7 +442,34 @@ OP_NAMESPACE_BEGIN
         int err = GetMetaValue(ctx, cmd.GetArguments()[0], HASH_META, meta);
         CHECK_ARDB_RETURN_VALUE(ctx.reply, err);
         ctx.reply.type = REDIS_REPLY_ARRAY;
-        if (err == 0)
+        if (err == 0 && meta.meta.Encoding() != COLLECTION_ENCODING_ZIPMAP)
+        {
+            ValueObjectArray vs(cmd.GetArguments().size() - 1);
+            for (uint32 i = 0; i < vs.size(); i++)
+            {
+                vs[i].key.type = HASH_FIELD;
+                vs[i].key.db = meta.key.db;
+                vs[i].key.key = meta.key.key;
+                vs[i].key.version = meta.meta.version;
+                vs[i].key.element.SetString(cmd.GetArguments()[i + 1], true);
+            }
+            std::vector<int> errs;
+            MultiGetKeyValue(ctx, vs, errs);
+            for (uint32 i = 0; i < vs.size(); i++)
+            {
+                RedisReply& r = ctx.reply.AddMember();
+                if (0 == errs[i])
+                {
+                    r.type = REDIS_REPLY_STRING;
+                    vs[i].element.GetDecodeString(r.str);
+                }
+                else
+                {
+                    r.type = REDIS_REPLY_NIL;
+                }
+            }
+        }
+        else if (err == 0)
         {
             for (uint32 i = 1; i < cmd.GetArguments().size(); i++)
             {
@@ -643,6 +674,7 @@ OP_NAMESPACE_BEGIN
                         KeyObject k;
                         k.db = ctx.currentDB;
                         k.key = cmd.GetArguments()[0];
+                        k.version = meta.meta.version;
                         k.type = HASH_FIELD;
                         k.element = field;
                         DelKeyValue(ctx, k);
@@ -712,6 +744,7 @@ OP_NAMESPACE_BEGIN
             v.key.db = dstdb;
             v.key.key = dstkey;
             v.meta.expireat = 0;
+            v.meta.version = NewCollectionVersion(dstdb, dstkey);
             err = SetKeyValue(ctx, v);
             CHECK_WRITE_RETURN_VALUE(ctx, err);
         }
@@ -722,9 +755,11 @@ OP_NAMESPACE_BEGIN
             tmpctx.currentDB = dstdb;
             ValueObject dstmeta;
             dstmeta.key.type = KEY_META;
+            dstmeta.key.db = dstdb;
             dstmeta.key.key = dstkey;
             dstmeta.type = HASH_META;
             dstmeta.meta.SetEncoding(COLLECTION_ENCODING_ZIPMAP);
+            dstmeta.meta.version = NewCollectionVersion(dstdb, dstkey);
             BatchWriteGuard guard(ctx);
             while (iter.Valid())
             {
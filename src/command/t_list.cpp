@@ -59,6 +59,7 @@ OP_NAMESPACE_BEGIN
             v.element = meta.meta.ziplist[i];
             v.key.type = LIST_ELEMENT;
             v.key.key = meta.key.key;
+            v.key.version = meta.meta.version;
             v.key.db = ctx.currentDB;
             v.key.score.SetInt64(i);
             SetKeyValue(ctx, v);
@@ -67,6 +68,744 @@ OP_NAMESPACE_BEGIN
         meta.meta.ziplist.clear();
         return 0;
     }
+
+    static void list_chunk_key(ValueObject& meta, uint8 type, uint64 id, KeyObject& key)
+    {
+        key.type = type;
+        key.db = meta.key.db;
+        key.key = meta.key.key;
+        key.version = meta.meta.version;
+        key.score.SetInt64((int64) id);
+    }
+
+    static uint64 sum_chunk_entries(const ListChunkEntryArray& entries)
+    {
+        uint64 count = 0;
+        for (uint32 i = 0; i < entries.size(); i++)
+        {
+            count += entries[i].count;
+        }
+        return count;
+    }
+
+    static void add_path_counts(ListChunkPath& path, int64 delta)
+    {
+        for (uint32 i = 0; i < path.nodes.size(); i++)
+        {
+            path.nodes[i]->entries[path.pos[i]].count += delta;
+            path.nodes[i]->dirty = true;
+        }
+    }
+
+    /*
+     * Chunks of a list are worth rebuilding once they are less than a quarter full on average.
+     */
+    static bool list_chunks_fragmented(ListChunkNode* root, int64 len, int64 chunk_size)
+    {
+        return root->chunks > 2 && (int64) root->chunks * (chunk_size / 4) > len;
+    }
+
+    ListChunkCache& Ardb::GetListChunkCache(ValueObject& meta)
+    {
+        if (NULL == meta.attach.lchunk)
+        {
+            NEW(meta.attach.lchunk, ListChunkCache);
+        }
+        return *(meta.attach.lchunk);
+    }
+
+    int Ardb::ListChunkLoadNode(Context& ctx, ValueObject& meta, uint64 id, ListChunkNode*& node)
+    {
+        ListChunkCache& cache = GetListChunkCache(meta);
+        ListChunkNodeTable::iterator found = cache.nodes.find(id);
+        if (found != cache.nodes.end())
+        {
+            node = found->second;
+            return 0;
+        }
+        ValueObject v(LIST_CHUNK_INDEX);
+        list_chunk_key(meta, LIST_CHUNK_INDEX, id, v.key);
+        int err = GetKeyValue(ctx, v.key, &v);
+        if (0 != err)
+        {
+            ERROR_LOG("Failed to load chunk index node:%llu for list:%s", id, meta.key.key.data());
+            return err;
+        }
+        sds raw = v.element.RawString();
+        NEW(node, ListChunkNode);
+        Buffer buf(raw, 0, NULL == raw ? 0 : sdslen(raw));
+        if (NULL == raw || !node->Decode(buf) || node->entries.empty())
+        {
+            ERROR_LOG("Invalid chunk index node:%llu for list:%s", id, meta.key.key.data());
+            DELETE(node);
+            return -1;
+        }
+        cache.nodes[id] = node;
+        return 0;
+    }
+
+    int Ardb::ListChunkLoad(Context& ctx, ValueObject& meta, uint64 id, ListChunk*& chunk)
+    {
+        ListChunkCache& cache = GetListChunkCache(meta);
+        ListChunkTable::iterator found = cache.chunks.find(id);
+        if (found != cache.chunks.end())
+        {
+            chunk = found->second;
+            return 0;
+        }
+        NEW(chunk, ListChunk);
+        if (0 != ListChunkPeek(ctx, meta, id, *chunk, chunk))
+        {
+            DELETE(chunk);
+            return -1;
+        }
+        cache.chunks[id] = chunk;
+        return 0;
+    }
+
+    /*
+     * Read only access to a chunk, cached chunk is returned if current write already loaded it,
+     * or the chunk is decoded into 'owned'.
+     */
+    int Ardb::ListChunkPeek(Context& ctx, ValueObject& meta, uint64 id, ListChunk& owned, ListChunk*& chunk)
+    {
+        if (NULL != meta.attach.lchunk)
+        {
+            ListChunkTable::iterator found = meta.attach.lchunk->chunks.find(id);
+            if (found != meta.attach.lchunk->chunks.end())
+            {
+                chunk = found->second;
+                return 0;
+            }
+        }
+        ValueObject v(LIST_CHUNK);
+        list_chunk_key(meta, LIST_CHUNK, id, v.key);
+        int err = GetKeyValue(ctx, v.key, &v);
+        if (0 != err)
+        {
+            ERROR_LOG("Failed to load chunk:%llu for list:%s", id, meta.key.key.data());
+            return err;
+        }
+        sds raw = v.element.RawString();
+        Buffer buf(raw, 0, NULL == raw ? 0 : sdslen(raw));
+        owned.elements.clear();
+        if (NULL == raw || !owned.Decode(buf))
+        {
+            ERROR_LOG("Invalid chunk:%llu for list:%s", id, meta.key.key.data());
+            return -1;
+        }
+        chunk = &owned;
+        return 0;
+    }
+
+    uint64 Ardb::ListChunkNewNode(ValueObject& meta, ListChunkNode* root, uint32 level, ListChunkNode*& node)
+    {
+        uint64 id = root->next_id++;
+        root->dirty = true;
+        NEW(node, ListChunkNode);
+        node->level = level;
+        node->dirty = true;
+        GetListChunkCache(meta).nodes[id] = node;
+        return id;
+    }
+
+    uint64 Ardb::ListChunkNewChunk(ValueObject& meta, ListChunkNode* root, ListChunk*& chunk)
+    {
+        uint64 id = root->next_id++;
+        root->chunks++;
+        root->dirty = true;
+        NEW(chunk, ListChunk);
+        chunk->dirty = true;
+        GetListChunkCache(meta).chunks[id] = chunk;
+        return id;
+    }
+
+    /*
+     * Walk down from root by element counts to the chunk holding 'index', an index beyond the last
+     * element is located at the end of the last chunk.
+     */
+    int Ardb::ListChunkLocate(Context& ctx, ValueObject& meta, uint64 index, ListChunkPath& path)
+    {
+        path.nodes.clear();
+        path.pos.clear();
+        ListChunkNode* node = NULL;
+        if (0 != ListChunkLoadNode(ctx, meta, 0, node))
+        {
+            return -1;
+        }
+        while (true)
+        {
+            if (node->entries.empty())
+            {
+                return -1;
+            }
+            uint32 idx = 0;
+            while (idx + 1 < node->entries.size() && index >= node->entries[idx].count)
+            {
+                index -= node->entries[idx].count;
+                idx++;
+            }
+            path.nodes.push_back(node);
+            path.pos.push_back(idx);
+            if (node->level == 0)
+            {
+                path.chunk_id = node->entries[idx].child;
+                path.offset = index;
+                return 0;
+            }
+            if (0 != ListChunkLoadNode(ctx, meta, node->entries[idx].child, node))
+            {
+                return -1;
+            }
+        }
+        return -1;
+    }
+
+    /*
+     * Drop entry 'idx' of the leaf node in 'path' together with its chunk, then the index nodes left
+     * empty, and shrink the tree while root has a single child. Nodes of 'path' may be released.
+     */
+    int Ardb::ListChunkDrop(Context& ctx, ValueObject& meta, ListChunkPath& path, uint32 idx)
+    {
+        ListChunkCache& cache = GetListChunkCache(meta);
+        ListChunkNode* root = path.nodes[0];
+        ListChunkNode* leaf = path.nodes.back();
+        KeyObject ck;
+        list_chunk_key(meta, LIST_CHUNK, leaf->entries[idx].child, ck);
+        DelKeyValue(ctx, ck);
+        ListChunkTable::iterator found = cache.chunks.find(leaf->entries[idx].child);
+        if (found != cache.chunks.end())
+        {
+            DELETE(found->second);
+            cache.chunks.erase(found);
+        }
+        leaf->entries.erase(leaf->entries.begin() + idx);
+        leaf->dirty = true;
+        root->chunks--;
+        root->dirty = true;
+        for (uint32 i = path.nodes.size() - 1; i > 0 && path.nodes[i]->entries.empty(); i--)
+        {
+            ListChunkNode* parent = path.nodes[i - 1];
+            uint32 parent_idx = path.pos[i - 1];
+            KeyObject nk;
+            list_chunk_key(meta, LIST_CHUNK_INDEX, parent->entries[parent_idx].child, nk);
+            DelKeyValue(ctx, nk);
+            cache.nodes.erase(parent->entries[parent_idx].child);
+            DELETE(path.nodes[i]);
+            parent->entries.erase(parent->entries.begin() + parent_idx);
+            parent->dirty = true;
+        }
+        while (root->level > 0 && root->entries.size() == 1)
+        {
+            uint64 id = root->entries[0].child;
+            ListChunkNode* child = NULL;
+            if (0 != ListChunkLoadNode(ctx, meta, id, child))
+            {
+                return -1;
+            }
+            root->entries = child->entries;
+            root->level = child->level;
+            KeyObject nk;
+            list_chunk_key(meta, LIST_CHUNK_INDEX, id, nk);
+            DelKeyValue(ctx, nk);
+            cache.nodes.erase(id);
+            DELETE(child);
+        }
+        return 0;
+    }
+
+    int Ardb::ListChunkInsert(Context& ctx, ValueObject& meta, uint64 index, const Data& value)
+    {
+        ListChunkPath path;
+        ListChunk* chunk = NULL;
+        if (0 != ListChunkLocate(ctx, meta, index, path) || 0 != ListChunkLoad(ctx, meta, path.chunk_id, chunk)
+                || path.offset > chunk->elements.size())
+        {
+            return -1;
+        }
+        chunk->elements.insert(chunk->elements.begin() + path.offset, value);
+        chunk->dirty = true;
+        add_path_counts(path, 1);
+        uint64 max = m_cfg.list_chunk_size;
+        if (chunk->elements.size() <= max)
+        {
+            return 0;
+        }
+        //split the chunk at its middle
+        ListChunkNode* root = path.nodes[0];
+        ListChunkNode* leaf = path.nodes.back();
+        uint32 idx = path.pos.back();
+        uint32 half = chunk->elements.size() / 2;
+        ListChunk* right_chunk = NULL;
+        ListChunkEntry entry;
+        entry.child = ListChunkNewChunk(meta, root, right_chunk);
+        right_chunk->elements.assign(chunk->elements.begin() + half, chunk->elements.end());
+        chunk->elements.resize(half);
+        entry.count = right_chunk->elements.size();
+        leaf->entries[idx].count -= entry.count;
+        leaf->entries.insert(leaf->entries.begin() + idx + 1, entry);
+        //split full nodes from bottom to top
+        for (uint32 i = path.nodes.size(); i > 0; i--)
+        {
+            ListChunkNode* current = path.nodes[i - 1];
+            if (current->entries.size() <= max)
+            {
+                break;
+            }
+            uint32 node_half = current->entries.size() / 2;
+            if (current == root)
+            {
+                ListChunkNode* left = NULL;
+                ListChunkNode* right = NULL;
+                ListChunkEntry le, re;
+                le.child = ListChunkNewNode(meta, root, root->level, left);
+                re.child = ListChunkNewNode(meta, root, root->level, right);
+                left->entries.assign(root->entries.begin(), root->entries.begin() + node_half);
+                right->entries.assign(root->entries.begin() + node_half, root->entries.end());
+                le.count = sum_chunk_entries(left->entries);
+                re.count = sum_chunk_entries(right->entries);
+                root->entries.clear();
+                root->entries.push_back(le);
+                root->entries.push_back(re);
+                root->level++;
+                break;
+            }
+            ListChunkNode* parent = path.nodes[i - 2];
+            uint32 parent_idx = path.pos[i - 2];
+            ListChunkNode* right = NULL;
+            ListChunkEntry re;
+            re.child = ListChunkNewNode(meta, root, current->level, right);
+            right->entries.assign(current->entries.begin() + node_half, current->entries.end());
+            current->entries.resize(node_half);
+            re.count = sum_chunk_entries(right->entries);
+            parent->entries[parent_idx].count -= re.count;
+            parent->entries.insert(parent->entries.begin() + parent_idx + 1, re);
+        }
+        return 0;
+    }
+
+    int Ardb::ListChunkRemove(Context& ctx, ValueObject& meta, uint64 index, Data* value)
+    {
+        ListChunkPath path;
+        ListChunk* chunk = NULL;
+        if (0 != ListChunkLocate(ctx, meta, index, path) || 0 != ListChunkLoad(ctx, meta, path.chunk_id, chunk)
+                || path.offset >= chunk->elements.size())
+        {
+            return -1;
+        }
+        if (NULL != value)
+        {
+            *value = chunk->elements[path.offset];
+        }
+        chunk->elements.erase(chunk->elements.begin() + path.offset);
+        chunk->dirty = true;
+        add_path_counts(path, -1);
+        //merge small neighbour chunks in the same leaf node
+        uint64 max = m_cfg.list_chunk_size;
+        ListChunkEntryArray& entries = path.nodes.back()->entries;
+        uint32 idx = path.pos.back();
+        if (chunk->elements.empty())
+        {
+            return ListChunkDrop(ctx, meta, path, idx);
+        }
+        if (idx > 0 && entries[idx - 1].count + entries[idx].count <= max / 2)
+        {
+            ListChunk* left = NULL;
+            if (0 != ListChunkLoad(ctx, meta, entries[idx - 1].child, left))
+            {
+                return -1;
+            }
+            left->elements.insert(left->elements.end(), chunk->elements.begin(), chunk->elements.end());
+            left->dirty = true;
+            entries[idx - 1].count += entries[idx].count;
+            return ListChunkDrop(ctx, meta, path, idx);
+        }
+        if (idx + 1 < entries.size() && entries[idx].count + entries[idx + 1].count <= max / 2)
+        {
+            ListChunk* right = NULL;
+            if (0 != ListChunkLoad(ctx, meta, entries[idx + 1].child, right))
+            {
+                return -1;
+            }
+            chunk->elements.insert(chunk->elements.end(), right->elements.begin(), right->elements.end());
+            entries[idx].count += entries[idx + 1].count;
+            return ListChunkDrop(ctx, meta, path, idx + 1);
+        }
+        return 0;
+    }
+
+    /*
+     * Remove 'count' elements from head or tail, chunks covered entirely are dropped without being read.
+     */
+    int Ardb::ListChunkTrimEdge(Context& ctx, ValueObject& meta, bool head, uint64 count)
+    {
+        while (count > 0)
+        {
+            ListChunkPath path;
+            if (0 != ListChunkLocate(ctx, meta, head ? 0 : (uint64) -1, path))
+            {
+                return -1;
+            }
+            uint32 idx = path.pos.back();
+            uint64 n = path.nodes.back()->entries[idx].count;
+            if (n <= count)
+            {
+                add_path_counts(path, -(int64) n);
+                if (0 != ListChunkDrop(ctx, meta, path, idx))
+                {
+                    return -1;
+                }
+            }
+            else
+            {
+                ListChunk* chunk = NULL;
+                if (0 != ListChunkLoad(ctx, meta, path.chunk_id, chunk) || chunk->elements.size() < count)
+                {
+                    return -1;
+                }
+                if (head)
+                {
+                    chunk->elements.erase(chunk->elements.begin(), chunk->elements.begin() + count);
+                }
+                else
+                {
+                    chunk->elements.erase(chunk->elements.end() - count, chunk->elements.end());
+                }
+                chunk->dirty = true;
+                n = count;
+                add_path_counts(path, -(int64) n);
+            }
+            count -= n;
+        }
+        return 0;
+    }
+
+    /*
+     * Convert a raw list to chunked layout, or rebuild the chunks of a fragmented chunked list. Chunks &
+     * index nodes are filled half full bottom-up from the ordered elements and kept in the write cache of
+     * the meta, since pending batch writes are not visible to later reads of the same command.
+     */
+    int Ardb::ListChunkBuild(Context& ctx, ValueObject& meta)
+    {
+        bool chunked = meta.meta.IsChunkedList();
+        ListChunkNode* root = NULL;
+        NEW(root, ListChunkNode);
+        root->dirty = true;
+        ListChunkCache built;
+        built.nodes[0] = root;
+        if (chunked)
+        {
+            ListChunkNode* old_root = NULL;
+            if (0 != ListChunkLoadNode(ctx, meta, 0, old_root))
+            {
+                return -1;
+            }
+            root->next_id = old_root->next_id;
+        }
+        uint32 fill = m_cfg.list_chunk_size / 2;
+        std::vector<ListChunkEntryArray> levels(1);
+        ListChunk* chunk = NULL;
+        int64 len = 0;
+        ListIterator iter;
+        ListIter(ctx, meta, iter, false);
+        while (iter.Valid())
+        {
+            if (NULL == chunk)
+            {
+                NEW(chunk, ListChunk);
+                chunk->dirty = true;
+            }
+            chunk->elements.push_back(*(iter.Element()));
+            if (!chunked)
+            {
+                DelRaw(ctx, iter.CurrentRawKey());
+            }
+            len++;
+            iter.Next();
+            if (chunk->elements.size() < fill && iter.Valid())
+            {
+                continue;
+            }
+            ListChunkEntry entry;
+            entry.child = root->next_id++;
+            entry.count = chunk->elements.size();
+            built.chunks[entry.child] = chunk;
+            chunk = NULL;
+            root->chunks++;
+            levels[0].push_back(entry);
+            //close full nodes from bottom to top
+            for (uint32 level = 0; levels[level].size() >= fill; level++)
+            {
+                if (level + 1 == levels.size())
+                {
+                    levels.resize(level + 2);
+                }
+                ListChunkNode* node = NULL;
+                NEW(node, ListChunkNode);
+                node->level = level;
+                node->dirty = true;
+                node->entries.swap(levels[level]);
+                ListChunkEntry parent;
+                parent.child = root->next_id++;
+                parent.count = sum_chunk_entries(node->entries);
+                built.nodes[parent.child] = node;
+                levels[level + 1].push_back(parent);
+            }
+        }
+        if (0 == len || (chunked && len != meta.meta.Length()))
+        {
+            ERROR_LOG("Failed to rebuild chunks of list:%s with %lld elements read.", meta.key.key.data(), len);
+            return -1;
+        }
+        //close open nodes, the top level becomes root
+        for (uint32 level = 0; level < levels.size(); level++)
+        {
+            if (level + 1 == levels.size())
+            {
+                root->level = level;
+                root->entries.swap(levels[level]);
+                break;
+            }
+            if (!levels[level].empty())
+            {
+                ListChunkNode* node = NULL;
+                NEW(node, ListChunkNode);
+                node->level = level;
+                node->dirty = true;
+                node->entries.swap(levels[level]);
+                ListChunkEntry parent;
+                parent.child = root->next_id++;
+                parent.count = sum_chunk_entries(node->entries);
+                built.nodes[parent.child] = node;
+                levels[level + 1].push_back(parent);
+            }
+        }
+        while (root->level > 0 && root->entries.size() == 1)
+        {
+            uint64 id = root->entries[0].child;
+            ListChunkNode* child = built.nodes[id];
+            root->entries.swap(child->entries);
+            root->level = child->level;
+            built.nodes.erase(id);
+            DELETE(child);
+        }
+        ListChunkCache& cache = GetListChunkCache(meta);
+        if (chunked)
+        {
+            //all old nodes were loaded while iterating, drop them with their chunks
+            ListChunkNodeTable::iterator it = cache.nodes.begin();
+            while (it != cache.nodes.end())
+            {
+                KeyObject nk;
+                list_chunk_key(meta, LIST_CHUNK_INDEX, it->first, nk);
+                DelKeyValue(ctx, nk);
+                for (uint32 i = 0; 0 == it->second->level && i < it->second->entries.size(); i++)
+                {
+                    KeyObject ck;
+                    list_chunk_key(meta, LIST_CHUNK, it->second->entries[i].child, ck);
+                    DelKeyValue(ctx, ck);
+                }
+                it++;
+            }
+        }
+        cache.Clear();
+        cache.nodes.swap(built.nodes);
+        cache.chunks.swap(built.chunks);
+        meta.meta.len = len;
+        meta.meta.min_index.SetInt64(0);
+        meta.meta.max_index.SetInt64(0);
+        meta.meta.SetFlag(COLLECTION_FLAG_CHUNKLIST);
+        return 0;
+    }
+
+    int Ardb::ListChunkFlush(Context& ctx, ValueObject& meta)
+    {
+        if (NULL == meta.attach.lchunk)
+        {
+            return 0;
+        }
+        ListChunkNodeTable::iterator it = meta.attach.lchunk->nodes.begin();
+        while (it != meta.attach.lchunk->nodes.end())
+        {
+            ListChunkNode* node = it->second;
+            if (node->dirty)
+            {
+                Buffer buf;
+                node->Encode(buf);
+                ValueObject v(LIST_CHUNK_INDEX);
+                list_chunk_key(meta, LIST_CHUNK_INDEX, it->first, v.key);
+                v.element.SetString(Slice(buf.GetRawReadBuffer(), buf.ReadableBytes()), false);
+                int err = SetKeyValue(ctx, v);
+                if (0 != err)
+                {
+                    return err;
+                }
+                node->dirty = false;
+            }
+            it++;
+        }
+        ListChunkTable::iterator cit = meta.attach.lchunk->chunks.begin();
+        while (cit != meta.attach.lchunk->chunks.end())
+        {
+            ListChunk* chunk = cit->second;
+            if (chunk->dirty)
+            {
+                Buffer buf;
+                chunk->Encode(buf);
+                ValueObject v(LIST_CHUNK);
+                list_chunk_key(meta, LIST_CHUNK, cit->first, v.key);
+                v.element.SetString(Slice(buf.GetRawReadBuffer(), buf.ReadableBytes()), false);
+                int err = SetKeyValue(ctx, v);
+                if (0 != err)
+                {
+                    return err;
+                }
+                chunk->dirty = false;
+            }
+            cit++;
+        }
+        return 0;
+    }
+
+    /*
+     * Delete all chunks & index nodes of the list.
+     */
+    int Ardb::ListChunkClear(Context& ctx, ValueObject& meta)
+    {
+        uint8 types[] = { LIST_CHUNK, LIST_CHUNK_INDEX };
+        for (uint32 i = 0; i < arraysize(types); i++)
+        {
+            KeyObject start;
+            start.type = types[i];
+            start.db = meta.key.db;
+            start.key = meta.key.key;
+            start.version = meta.meta.version;
+            Iterator* iter = IteratorPrefix(start);
+            while (NULL != iter && iter->Valid())
+            {
+                KeyObject k;
+                if (!decode_key(iter->Key(), k) || k.type != start.type || k.db != start.db || k.key != start.key)
+                {
+                    break;
+                }
+                DelKeyValue(ctx, k);
+                iter->Next();
+            }
+            DELETE(iter);
+        }
+        ListChunkCache& cache = GetListChunkCache(meta);
+        ListChunkNodeTable::iterator it = cache.nodes.begin();
+        while (it != cache.nodes.end())
+        {
+            KeyObject nk;
+            list_chunk_key(meta, LIST_CHUNK_INDEX, it->first, nk);
+            DelKeyValue(ctx, nk);
+            it++;
+        }
+        ListChunkTable::iterator cit = cache.chunks.begin();
+        while (cit != cache.chunks.end())
+        {
+            KeyObject ck;
+            list_chunk_key(meta, LIST_CHUNK, cit->first, ck);
+            DelKeyValue(ctx, ck);
+            cit++;
+        }
+        cache.Clear();
+        return 0;
+    }
+
+    /*
+     * The cron rewrites a list in one batch under the key lock, lists above 'list-rechunk-max-len' elements keep
+     * their layout so that no key blocks its writers or the cron for a whole rewrite.
+     */
+    bool Ardb::ListRechunkTooLarge(ValueObject& meta)
+    {
+        return m_cfg.list_rechunk_max_len > 0 && meta.meta.Length() > m_cfg.list_rechunk_max_len;
+    }
+
+    /*
+     * Queue a list for the db cron to convert to chunked layout if it's a legacy list with out of order
+     * indexes, or to rebuild its chunks if they are fragmented.
+     */
+    void Ardb::ListRechunkLater(Context& ctx, ValueObject& meta)
+    {
+        if (meta.meta.Encoding() != COLLECTION_ENCODING_RAW || meta.meta.IsSequentialList()
+                || ListRechunkTooLarge(meta))
+        {
+            return;
+        }
+        if (meta.meta.IsChunkedList())
+        {
+            if (NULL == meta.attach.lchunk)
+            {
+                return;
+            }
+            ListChunkNodeTable::iterator found = meta.attach.lchunk->nodes.find(0);
+            if (found == meta.attach.lchunk->nodes.end()
+                    || !list_chunks_fragmented(found->second, meta.meta.Length(), m_cfg.list_chunk_size))
+            {
+                return;
+            }
+        }
+        DBItemKey item(ctx.currentDB, std::string(meta.key.key.data(), meta.key.key.size()));
+        LockGuard<SpinMutexLock> guard(m_rechunk_lock);
+        if (m_rechunk_keys.insert(item).second)
+        {
+            m_rechunk_pending++;
+        }
+    }
+
+    void Ardb::ListRechunkStep(uint64 max_millis)
+    {
+        uint64 start = get_current_epoch_millis();
+        while (m_rechunk_pending > 0 && get_current_epoch_millis() - start < max_millis)
+        {
+            DBItemKey item;
+            {
+                LockGuard<SpinMutexLock> guard(m_rechunk_lock);
+                if (m_rechunk_keys.empty())
+                {
+                    return;
+                }
+                item = *(m_rechunk_keys.begin());
+                m_rechunk_keys.erase(m_rechunk_keys.begin());
+                m_rechunk_pending--;
+            }
+            KeyLockerGuard keylock(m_key_lock, item.db, item.key);
+            Context tmpctx;
+            tmpctx.currentDB = item.db;
+            ValueObject meta;
+            if (0 != GetMetaValue(tmpctx, item.key, LIST_META, meta)
+                    || meta.meta.Encoding() != COLLECTION_ENCODING_RAW || meta.meta.IsSequentialList())
+            {
+                continue;
+            }
+            if (ListRechunkTooLarge(meta))
+            {
+                m_rechunk_skipped_keys++;
+                continue;
+            }
+            if (meta.meta.IsChunkedList())
+            {
+                ListChunkNode* root = NULL;
+                if (0 != ListChunkLoadNode(tmpctx, meta, 0, root)
+                        || !list_chunks_fragmented(root, meta.meta.Length(), m_cfg.list_chunk_size))
+                {
+                    continue;
+                }
+            }
+            BatchWriteGuard guard(tmpctx);
+            if (0 == ListChunkBuild(tmpctx, meta) && 0 == SetKeyValue(tmpctx, meta))
+            {
+                m_rechunked_keys++;
+            }
+            else
+            {
+                guard.MarkFailed();
+            }
+        }
+    }
+
     int Ardb::LIndex(Context& ctx, RedisCommandFrame& cmd)
     {
         int64 index;
@@ -115,8 +854,18 @@ OP_NAMESPACE_BEGIN
                     }
                 }
             }
+            else if (meta.meta.IsChunkedList())
+            {
+                err = ChunkedListIter(ctx, meta, iter, index);
+                if (0 == err && iter.Valid())
+                {
+                    fill_value_reply(ctx.reply, *(iter.Element()));
+                    return 0;
+                }
+            }
             else
             {
+                ListRechunkLater(ctx, meta);
                 err = ListIter(ctx, meta, iter, index < 0);
                 uint32 cursor = index < 0 ? 1 : 0;
                 while (iter.Valid())
@@ -211,6 +960,7 @@ OP_NAMESPACE_BEGIN
                     ValueObject lkv;
                     lkv.key.type = LIST_ELEMENT;
                     lkv.key.key = meta.key.key;
+                    lkv.key.version = meta.meta.version;
                     lkv.key.db = ctx.currentDB;
                     lkv.key.score = lpop ? meta.meta.min_index : meta.meta.max_index;
                     if (0 == GetKeyValue(ctx, lkv.key, &lkv))
@@ -230,6 +980,17 @@ OP_NAMESPACE_BEGIN
                     }
                 }
             }
+            else if (meta.meta.IsChunkedList())
+            {
+                Data element;
+                if (meta.meta.Length() > 0
+                        && 0 == ListChunkRemove(ctx, meta, lpop ? 0 : meta.meta.Length() - 1, &element))
+                {
+                    meta.meta.len--;
+                    poped = true;
+                    fill_value_reply(ctx.reply, element);
+                }
+            }
             else
             {
                 ListIterator iter;
@@ -244,6 +1005,7 @@ OP_NAMESPACE_BEGIN
                         KeyObject k;
                         k.type = LIST_ELEMENT;
                         k.key = meta.key.key;
+                        k.version = meta.meta.version;
                         k.db = ctx.currentDB;
                         k.score = *(iter.Score());
                         DelKeyValue(ctx, k);
@@ -278,6 +1040,10 @@ OP_NAMESPACE_BEGIN
                 }
                 else
                 {
+                    if (meta.meta.IsChunkedList())
+                    {
+                        ListChunkClear(ctx, meta);
+                    }
                     DelKeyValue(ctx, meta.key);
                 }
             }
@@ -294,6 +1060,97 @@ OP_NAMESPACE_BEGIN
         return ListPop(ctx, cmd.GetArguments()[0], true);
     }
 
+    /*
+     * Insert next to the first match of a raw list in place, the new element takes an index between its
+     * neighbours. Lists left with out of order indexes are packed into chunks later by the db cron.
+     */
+    int Ardb::ListRawInsert(Context& ctx, ValueObject& meta, const std::string& match, const std::string& value,
+            bool head)
+    {
+        ListIterator iter;
+        ListIter(ctx, meta, iter, false);
+        std::string tmp;
+        Data prev, current, next;
+        int64 pos = -1, cursor = 0;
+        while (iter.Valid())
+        {
+            if (pos >= 0)
+            {
+                next = *(iter.Score());
+                break;
+            }
+            if (iter.Element()->GetDecodeString(tmp) == match)
+            {
+                current = *(iter.Score());
+                pos = cursor;
+                if (head)
+                {
+                    break;
+                }
+            }
+            else
+            {
+                prev = *(iter.Score());
+            }
+            cursor++;
+            iter.Next();
+        }
+        if (pos < 0)
+        {
+            fill_int_reply(ctx.reply, 0);
+            return 0;
+        }
+        Data element;
+        element.SetString(value, true);
+        const Data& neighbour = head ? prev : next;
+        Data score = current;
+        if (neighbour.IsNil())
+        {
+            score.IncrBy(head ? -1 : 1);
+            if (head)
+            {
+                meta.meta.min_index = score;
+            }
+            else
+            {
+                meta.meta.max_index = score;
+            }
+        }
+        else
+        {
+            score.SetDouble((neighbour.NumberValue() + current.NumberValue()) / 2);
+            if (score == neighbour || score == current)
+            {
+                //no index left between the neighbours, the list can't wait for the cron to pack it
+                if (0 != ListChunkBuild(ctx, meta))
+                {
+                    fill_error_reply(ctx.reply, "failed to convert list into chunks");
+                    return 0;
+                }
+                int err = ListChunkInsert(ctx, meta, head ? pos : pos + 1, element);
+                CHECK_WRITE_RETURN_VALUE(ctx, err);
+                meta.meta.len++;
+                fill_int_reply(ctx.reply, meta.meta.Length());
+                return 0;
+            }
+            meta.meta.SetFlag(COLLECTION_FLAG_NORMAL);
+        }
+        meta.meta.len++;
+        ValueObject v;
+        v.type = LIST_ELEMENT;
+        v.element = element;
+        v.key.db = meta.key.db;
+        v.key.key = meta.key.key;
+        v.key.version = meta.meta.version;
+        v.key.type = LIST_ELEMENT;
+        v.key.score = score;
+        int err = SetKeyValue(ctx, v);
+        CHECK_WRITE_RETURN_VALUE(ctx, err);
+        ListRechunkLater(ctx, meta);
+        fill_int_reply(ctx.reply, meta.meta.Length());
+        return 0;
+    }
+
     int Ardb::ListInsert(Context& ctx, ValueObject& meta, const std::string* match, const std::string& value, bool head,
             bool abort_nonexist)
     {
@@ -350,79 +1207,34 @@ OP_NAMESPACE_BEGIN
             }
             else
             {
+                if (!meta.meta.IsChunkedList())
+                {
+                    return ListRawInsert(ctx, meta, *match, value, head);
+                }
                 ListIterator iter;
-                ListIter(ctx, meta, iter, false);
+                ChunkedListIter(ctx, meta, iter, 0);
                 std::string tmp;
-                Data prev, next;
-                Data current;
-                bool matched = false;
+                int64 pos = -1, cursor = 0;
                 while (iter.Valid())
                 {
                     if (iter.Element()->GetDecodeString(tmp) == (*match))
                     {
-                        current = *(iter.Score());
-                        matched = true;
-                        if (head)
-                        {
-                            break;
-                        }
-                    }
-                    if (head)
-                    {
-                        prev = *(iter.Score());
-                        iter.Next();
-                    }
-                    else
-                    {
-                        if (matched)
-                        {
-                            next = *(iter.Score());
-                            break;
-                        }
+                        pos = cursor;
+                        break;
                     }
+                    cursor++;
                     iter.Next();
                 }
-                if (!matched)
+                if (pos < 0)
                 {
                     fill_int_reply(ctx.reply, 0);
                     return 0;
                 }
-                Data score;
-                if (head)
-                {
-                    if (prev.IsNil())
-                    {
-                        score = current.IncrBy(-1);
-                    }
-                    else
-                    {
-                        score.SetDouble((prev.NumberValue() + current.NumberValue()) / 2);
-                        meta.meta.SetFlag(COLLECTION_FLAG_NORMAL);
-                    }
-                }
-                else
-                {
-                    if (next.IsNil())
-                    {
-                        score = current.IncrBy(1);
-                    }
-                    else
-                    {
-                        score.SetDouble((next.NumberValue() + current.NumberValue()) / 2);
-                        meta.meta.SetFlag(COLLECTION_FLAG_NORMAL);
-                    }
-                }
-
-                meta.meta.len++;
-                ValueObject v;
-                v.type = LIST_ELEMENT;
-                v.element.SetString(value, true);
-                v.key.db = meta.key.db;
-                v.key.key = meta.key.key;
-                v.key.type = LIST_ELEMENT;
-                v.key.score = score;
-                int err = SetKeyValue(ctx, v);
+                Data element;
+                element.SetString(value, true);
+                int err = ListChunkInsert(ctx, meta, head ? pos : pos + 1, element);
                 CHECK_WRITE_RETURN_VALUE(ctx, err);
+                meta.meta.len++;
             }
             fill_int_reply(ctx.reply, meta.meta.Length());
             return 0;
@@ -448,6 +1260,14 @@ OP_NAMESPACE_BEGIN
                     ZipListConvert(ctx, meta);
                 }
             }
+            else if (meta.meta.IsChunkedList())
+            {
+                Data element;
+                element.SetString(value, true);
+                int err = ListChunkInsert(ctx, meta, head ? 0 : meta.meta.Length(), element);
+                CHECK_WRITE_RETURN_VALUE(ctx, err);
+                meta.meta.len++;
+            }
             else
             {
                 meta.meta.len++;
@@ -456,6 +1276,7 @@ OP_NAMESPACE_BEGIN
                 v.element.SetString(value, true);
                 v.key.db = meta.key.db;
                 v.key.key = meta.key.key;
+                v.key.version = meta.meta.version;
                 v.key.type = LIST_ELEMENT;
 
                 if (head)
@@ -570,6 +1391,7 @@ OP_NAMESPACE_BEGIN
             bool head, bool abort_nonexist)
     {
         ValueObject meta;
+        KeyLockerGuard keylock(m_key_lock, ctx.currentDB, key);
         int err = GetMetaValue(ctx, key, LIST_META, meta);
         CHECK_ARDB_RETURN_VALUE(ctx.reply, err);
         BatchWriteGuard guard(ctx, meta.meta.Encoding() != COLLECTION_ENCODING_ZIPLIST);
@@ -657,9 +1479,16 @@ OP_NAMESPACE_BEGIN
         else
         {
             ListIterator iter;
-            if (meta.meta.IsSequentialList())
+            if (meta.meta.IsSequentialList() || meta.meta.IsChunkedList())
             {
-                SequencialListIter(ctx, meta, iter, start);
+                if (meta.meta.IsSequentialList())
+                {
+                    SequencialListIter(ctx, meta, iter, start);
+                }
+                else
+                {
+                    ChunkedListIter(ctx, meta, iter, start);
+                }
                 uint32 count = 0;
                 while (iter.Valid() && count < rangelen)
                 {
@@ -671,6 +1500,7 @@ OP_NAMESPACE_BEGIN
             }
             else
             {
+                ListRechunkLater(ctx, meta);
                 if (start > meta.meta.len / 2)
                 {
                     start -= meta.meta.len;
@@ -729,6 +1559,7 @@ OP_NAMESPACE_BEGIN
         }
         int64 toremove = std::abs(count);
         ValueObject meta;
+        KeyLockerGuard lock(m_key_lock, ctx.currentDB, cmd.GetArguments()[0]);
         int err = GetMetaValue(ctx, cmd.GetArguments()[0], LIST_META, meta);
         CHECK_ARDB_RETURN_VALUE(ctx.reply, err);
         if (0 != err)
@@ -738,7 +1569,6 @@ OP_NAMESPACE_BEGIN
         }
         Data element;
         element.SetString(cmd.GetArguments()[2], true);
-        KeyLockerGuard lock(m_key_lock, ctx.currentDB, cmd.GetArguments()[0]);
         if (meta.meta.Encoding() == COLLECTION_ENCODING_ZIPLIST)
         {
             uint32 oldlen = meta.meta.ziplist.size();
@@ -783,34 +1613,116 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         BatchWriteGuard guard(ctx);
-        ListIterator iter;
-        ListIter(ctx, meta, iter, count < 0);
         int64 remove = 0;
-        while (iter.Valid())
+        if (!meta.meta.IsChunkedList())
         {
-            if (iter.Element()->Compare(element) == 0)
+            //raw lists are served in place, the index gaps left behind are packed into chunks by the db cron
+            //the edge indexes are moved to the nearest survivors since iterators seek from them
+            ListIterator iter;
+            ListIter(ctx, meta, iter, count < 0);
+            Data near_edge, far_edge;
+            bool near_removed = false, far_removed = false, reached = false;
+            while (iter.Valid())
             {
-                meta.meta.len--;
-                meta.meta.SetFlag(COLLECTION_FLAG_NORMAL);
-                DelRaw(ctx, iter.CurrentRawKey());
-                //DelKeyValue(ctx, k);
-                remove++;
-                if (remove == toremove)
+                if (toremove > 0 && remove == toremove)
                 {
+                    if (near_edge.IsNil())
+                    {
+                        near_edge = *(iter.Score());
+                    }
+                    reached = true;
                     break;
                 }
+                far_removed = iter.Element()->Compare(element) == 0;
+                if (far_removed)
+                {
+                    DelRaw(ctx, iter.CurrentRawKey());
+                    meta.meta.len--;
+                    remove++;
+                    near_removed = near_removed || near_edge.IsNil();
+                }
+                else
+                {
+                    if (near_edge.IsNil())
+                    {
+                        near_edge = *(iter.Score());
+                    }
+                    far_edge = *(iter.Score());
+                }
+                if (count < 0)
+                {
+                    iter.Prev();
+                }
+                else
+                {
+                    iter.Next();
+                }
             }
-            if (count < 0)
+            Data& near_index = count < 0 ? meta.meta.max_index : meta.meta.min_index;
+            Data& far_index = count < 0 ? meta.meta.min_index : meta.meta.max_index;
+            if (near_removed && !near_edge.IsNil())
             {
-                iter.Prev();
+                near_index = near_edge;
             }
-            else
+            if (!reached && far_removed && !far_edge.IsNil())
             {
-                iter.Next();
+                far_index = far_edge;
+            }
+            if (remove > 0)
+            {
+                meta.meta.SetFlag(COLLECTION_FLAG_NORMAL);
+            }
+        }
+        else
+        {
+            ListIterator iter;
+            ChunkedListIter(ctx, meta, iter, count < 0 ? -1 : 0);
+            int64 cursor = count < 0 ? meta.meta.Length() - 1 : 0;
+            std::vector<int64> matched;
+            while (iter.Valid())
+            {
+                if (iter.Element()->Compare(element) == 0)
+                {
+                    matched.push_back(cursor);
+                    if (matched.size() == (uint64) toremove)
+                    {
+                        break;
+                    }
+                }
+                if (count < 0)
+                {
+                    cursor--;
+                    iter.Prev();
+                }
+                else
+                {
+                    cursor++;
+                    iter.Next();
+                }
+            }
+            //remove from tail to head so that positions ahead are not shifted
+            if (count >= 0)
+            {
+                std::reverse(matched.begin(), matched.end());
+            }
+            for (uint32 i = 0; i < matched.size(); i++)
+            {
+                if (0 != ListChunkRemove(ctx, meta, matched[i], NULL))
+                {
+                    break;
+                }
+                meta.meta.len--;
+                remove++;
             }
         }
-        if (remove > 0)
+        if (meta.meta.Length() == 0)
+        {
+            ListChunkClear(ctx, meta);
+            DelKeyValue(ctx, meta.key);
+        }
+        else
         {
+            ListRechunkLater(ctx, meta);
             SetKeyValue(ctx, meta);
         }
         fill_int_reply(ctx.reply, remove);
@@ -825,6 +1737,7 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         ValueObject meta;
+        KeyLockerGuard lock(m_key_lock, ctx.currentDB, cmd.GetArguments()[0]);
         int err = GetMetaValue(ctx, cmd.GetArguments()[0], LIST_META, meta);
         CHECK_ARDB_RETURN_VALUE(ctx.reply, err);
         if (0 != err)
@@ -862,6 +1775,7 @@ OP_NAMESPACE_BEGIN
                 ValueObject list_element;
                 list_element.key.db = meta.key.db;
                 list_element.key.key = meta.key.key;
+                list_element.key.version = meta.meta.version;
                 list_element.key.type = LIST_ELEMENT;
                 list_element.key.score = meta.meta.min_index;
                 if (index >= 0)
@@ -881,8 +1795,9 @@ OP_NAMESPACE_BEGIN
                     return 0;
                 }
             }
-            else
+            else if (!meta.meta.IsChunkedList())
             {
+                //out of order raw lists are walked in place until the db cron packs them into chunks
                 ListIterator iter;
                 ListIter(ctx, meta, iter, index < 0);
                 int64 cursor = index >= 0 ? 0 : -1;
@@ -893,33 +1808,46 @@ OP_NAMESPACE_BEGIN
                         ValueObject v;
                         v.key.db = meta.key.db;
                         v.key.key = meta.key.key;
+                        v.key.version = meta.meta.version;
                         v.key.type = LIST_ELEMENT;
                         v.key.score = *(iter.Score());
                         v.type = LIST_ELEMENT;
                         v.element.SetString(cmd.GetArguments()[2], true);
                         int err = SetKeyValue(ctx, v);
                         CHECK_WRITE_RETURN_VALUE(ctx, err);
+                        ListRechunkLater(ctx, meta);
                         fill_status_reply(ctx.reply, "OK");
                         return 0;
                     }
-                    if (cursor >= 0)
-                    {
-                        cursor++;
-                    }
-                    else
-                    {
-                        cursor--;
-                    }
                     if (index < 0)
                     {
+                        cursor--;
                         iter.Prev();
                     }
                     else
                     {
+                        cursor++;
                         iter.Next();
                     }
                 }
             }
+            else
+            {
+                BatchWriteGuard guard(ctx);
+                ListChunkPath path;
+                ListChunk* chunk = NULL;
+                if (0 == ListChunkLocate(ctx, meta, index >= 0 ? index : index + meta.meta.Length(), path)
+                        && 0 == ListChunkLoad(ctx, meta, path.chunk_id, chunk) && path.offset < chunk->elements.size())
+                {
+                    chunk->elements[path.offset].SetString(cmd.GetArguments()[2], true);
+                    chunk->dirty = true;
+                    err = SetKeyValue(ctx, meta);
+                    CHECK_WRITE_RETURN_VALUE(ctx, err);
+                    fill_status_reply(ctx.reply, "OK");
+                    return 0;
+                }
+                guard.MarkFailed();
+            }
             fill_error_reply(ctx.reply, "index out of range");
         }
         return 0;
@@ -933,6 +1861,7 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         ValueObject meta;
+        KeyLockerGuard lock(m_key_lock, ctx.currentDB, cmd.GetArguments()[0]);
         int err = GetMetaValue(ctx, cmd.GetArguments()[0], LIST_META, meta);
         CHECK_ARDB_RETURN_VALUE(ctx.reply, err);
         if (0 != err)
@@ -985,6 +1914,7 @@ OP_NAMESPACE_BEGIN
                     KeyObject lk;
                     lk.db = meta.key.db;
                     lk.key = meta.key.key;
+                    lk.version = meta.meta.version;
                     lk.type = LIST_ELEMENT;
                     lk.score = meta.meta.min_index.IncrBy(s);
                     meta.meta.len--;
@@ -994,29 +1924,57 @@ OP_NAMESPACE_BEGIN
                 meta.meta.min_index.IncrBy(start);
                 meta.meta.max_index.IncrBy(end);
             }
-            else
+            else if (!meta.meta.IsChunkedList())
             {
-                ListIterator iter;
-                ListIter(ctx, meta, iter, false);
-                int64 cursor = 0;
-                while (iter.Valid())
+                //drop the out of range elements from both edges in place, the db cron packs the rest into chunks
+                int64 listlen = meta.meta.Length();
+                for (int i = 0; i < 2; i++)
                 {
-                    if (cursor < start || cursor > end)
+                    bool tail = i > 0;
+                    int64 skip = tail ? listlen - 1 - end : start;
+                    ListIterator iter;
+                    ListIter(ctx, meta, iter, tail);
+                    while (iter.Valid())
                     {
+                        if (skip == 0)
+                        {
+                            if (tail)
+                            {
+                                meta.meta.max_index = *(iter.Score());
+                            }
+                            else
+                            {
+                                meta.meta.min_index = *(iter.Score());
+                            }
+                            break;
+                        }
                         DelRaw(ctx, iter.CurrentRawKey());
-                        meta.meta.len--;
-                    }
-                    if (cursor == start)
-                    {
-                        meta.meta.min_index = *(iter.Element());
-                    }
-                    else if (cursor == end)
-                    {
-                        meta.meta.max_index = *(iter.Element());
+                        skip--;
+                        if (tail)
+                        {
+                            iter.Prev();
+                        }
+                        else
+                        {
+                            iter.Next();
+                        }
                     }
-                    cursor++;
-                    iter.Next();
                 }
+                meta.meta.len = end - start + 1;
+                ListRechunkLater(ctx, meta);
+            }
+            else
+            {
+                int64 listlen = meta.meta.Length();
+                if (0 != ListChunkTrimEdge(ctx, meta, false, listlen - 1 - end)
+                        || 0 != ListChunkTrimEdge(ctx, meta, true, start))
+                {
+                    guard.MarkFailed();
+                    fill_error_reply(ctx.reply, "failed to trim list chunks");
+                    return 0;
+                }
+                meta.meta.len = end - start + 1;
+                ListRechunkLater(ctx, meta);
             }
             SetKeyValue(ctx, meta);
         }
@@ -1049,6 +2007,10 @@ OP_NAMESPACE_BEGIN
 
     int Ardb::RPopLPush(Context& ctx, RedisCommandFrame& cmd)
     {
+        SliceArray lock_keys;
+        lock_keys.push_back(cmd.GetArguments()[0]);
+        lock_keys.push_back(cmd.GetArguments()[1]);
+        MultiKeyLockerGuard keylock(m_key_lock, ctx.currentDB, lock_keys);
         std::string v;
         if (ListPop(ctx, cmd.GetArguments()[0], false) == 0 && ctx.reply.type == REDIS_REPLY_STRING)
         {
@@ -1195,7 +2157,11 @@ OP_NAMESPACE_BEGIN
     int Ardb::LClear(Context& ctx, ValueObject& meta)
     {
         BatchWriteGuard guard(ctx, meta.meta.Encoding() != COLLECTION_ENCODING_ZIPLIST);
-        if (meta.meta.Encoding() != COLLECTION_ENCODING_ZIPLIST)
+        if (meta.meta.IsChunkedList())
+        {
+            ListChunkClear(ctx, meta);
+        }
+        else if (meta.meta.Encoding() != COLLECTION_ENCODING_ZIPLIST)
         {
             ListIterator iter;
             meta.meta.len = 0;
@@ -1205,6 +2171,7 @@ OP_NAMESPACE_BEGIN
                 KeyObject fk;
                 fk.db = ctx.currentDB;
                 fk.key = meta.key.key;
+                fk.version = meta.meta.version;
                 fk.type = LIST_ELEMENT;
                 fk.score = *(iter.Score());
                 DelKeyValue(ctx, fk);
@@ -1236,20 +2203,23 @@ OP_NAMESPACE_BEGIN
             v.key.db = dstdb;
             v.key.key = dstkey;
             v.meta.expireat = 0;
+            v.meta.version = NewCollectionVersion(dstdb, dstkey);
             err = SetKeyValue(ctx, v);
             CHECK_WRITE_RETURN_VALUE(ctx, err);
         }
         else
         {
             ListIterator iter;
-            ListIter(ctx, v, iter, false);
+            ListIter(tmpctx, v, iter, false);
             tmpctx.currentDB = dstdb;
             ValueObject dstmeta;
             dstmeta.key.type = KEY_META;
+            dstmeta.key.db = dstdb;
             dstmeta.key.key = dstkey;
             dstmeta.type = LIST_META;
             dstmeta.meta.SetFlag(COLLECTION_FLAG_SEQLIST);
             dstmeta.meta.SetEncoding(COLLECTION_ENCODING_ZIPLIST);
+            dstmeta.meta.version = NewCollectionVersion(dstdb, dstkey);
             BatchWriteGuard guard(ctx);
             while (iter.Valid())
             {
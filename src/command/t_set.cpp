@@ -76,6 +76,7 @@ OP_NAMESPACE_BEGIN
                     v.type = SET_ELEMENT;
                     v.key.type = SET_ELEMENT;
                     v.key.key = meta.key.key;
+                    v.key.version = meta.meta.version;
                     v.key.db = ctx.currentDB;
                     v.key.element = *it;
                     SetKeyValue(ctx, v);
@@ -93,6 +94,7 @@ OP_NAMESPACE_BEGIN
             ValueObject v(SET_ELEMENT);
             v.key.type = SET_ELEMENT;
             v.key.key = meta.key.key;
+            v.key.version = meta.meta.version;
             v.key.db = ctx.currentDB;
             v.key.element.SetString(value, true);
             if (meta.meta.min_index > v.key.element)
@@ -125,6 +127,7 @@ OP_NAMESPACE_BEGIN
         meta.key.type = KEY_META;
         meta.type = SET_META;
         meta.meta.SetEncoding(COLLECTION_ENCODING_ZIPSET);
+        meta.meta.version = NewCollectionVersion(ctx.currentDB, meta.key.key);
         bool meta_change = false;
         meta.attach.force_zipsave = true;
         int64 count = 0;
@@ -222,6 +225,7 @@ OP_NAMESPACE_BEGIN
             KeyObject k;
             k.type = SET_ELEMENT;
             k.key = meta.key.key;
+            k.version = meta.meta.version;
             k.db = ctx.currentDB;
             k.element = element;
             exist = (0 == GetKeyValue(ctx, k, NULL));
@@ -247,6 +251,49 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
+    int Ardb::SMIsMember(Context& ctx, RedisCommandFrame& cmd)
+    {
+        ValueObject meta;
+        int err = GetMetaValue(ctx, cmd.GetArguments()[0], SET_META, meta);
+        CHECK_ARDB_RETURN_VALUE(ctx.reply, err);
+        ctx.reply.type = REDIS_REPLY_ARRAY;
+        uint32 count = cmd.GetArguments().size() - 1;
+        if (0 != err)
+        {
+            for (uint32 i = 0; i < count; i++)
+            {
+                fill_int_reply(ctx.reply.AddMember(), 0);
+            }
+            return 0;
+        }
+        if (meta.meta.Encoding() == COLLECTION_ENCODING_ZIPSET)
+        {
+            for (uint32 i = 0; i < count; i++)
+            {
+                Data element;
+                element.SetString(cmd.GetArguments()[i + 1], true);
+                fill_int_reply(ctx.reply.AddMember(), meta.meta.zipset.count(element) > 0 ? 1 : 0);
+            }
+            return 0;
+        }
+        ValueObjectArray vs(count);
+        for (uint32 i = 0; i < count; i++)
+        {
+            vs[i].key.type = SET_ELEMENT;
+            vs[i].key.db = ctx.currentDB;
+            vs[i].key.key = meta.key.key;
+            vs[i].key.version = meta.meta.version;
+            vs[i].key.element.SetString(cmd.GetArguments()[i + 1], true);
+        }
+        std::vector<int> errs;
+        MultiGetKeyValue(ctx, vs, errs);
+        for (uint32 i = 0; i < count; i++)
+        {
+            fill_int_reply(ctx.reply.AddMember(), 0 == errs[i] ? 1 : 0);
+        }
+        return 0;
+    }
+
     int Ardb::SetMembers(Context& ctx, const Slice& key)
     {
         ValueObject meta;
@@ -286,7 +333,10 @@ OP_NAMESPACE_BEGIN
 
     int Ardb::SMove(Context& ctx, RedisCommandFrame& cmd)
     {
-        KeyLockerGuard keylock(m_key_lock, ctx.currentDB, cmd.GetArguments()[0]);
+        SliceArray lock_keys;
+        lock_keys.push_back(cmd.GetArguments()[0]);
+        lock_keys.push_back(cmd.GetArguments()[1]);
+        MultiKeyLockerGuard keylock(m_key_lock, ctx.currentDB, lock_keys);
         RedisCommandFrame ismember("sismember");
         ismember.AddArg(cmd.GetArguments()[0]);
         ismember.AddArg(cmd.GetArguments()[2]);
@@ -346,6 +396,7 @@ OP_NAMESPACE_BEGIN
                     KeyObject k;
                     k.type = SET_ELEMENT;
                     k.key = meta.key.key;
+                    k.version = meta.meta.version;
                     k.db = ctx.currentDB;
                     k.element = *element;
                     DelKeyValue((ctx), k);
@@ -444,6 +495,7 @@ OP_NAMESPACE_BEGIN
                 KeyObject k;
                 k.type = SET_ELEMENT;
                 k.key = meta.key.key;
+                k.version = meta.meta.version;
                 k.db = ctx.currentDB;
                 k.element = element;
                 DelKeyValue(ctx, k);
@@ -586,6 +638,8 @@ OP_NAMESPACE_BEGIN
         {
             keystrs.insert(cmd.GetArguments()[i]);
         }
+        SliceArray lock_keys(cmd.GetArguments().begin(), cmd.GetArguments().end());
+        MultiKeyLockerGuard keylock(m_key_lock, ctx.currentDB, lock_keys);
         int64 count = 0;
         SetDiff(ctx, cmd.GetArguments()[1], keystrs, cmd.GetArgument(0), &count);
         return 0;
@@ -773,6 +827,8 @@ OP_NAMESPACE_BEGIN
         {
             keystrs.insert(cmd.GetArguments()[i]);
         }
+        SliceArray lock_keys(cmd.GetArguments().begin(), cmd.GetArguments().end());
+        MultiKeyLockerGuard keylock(m_key_lock, ctx.currentDB, lock_keys);
         int64 count = 0;
         SetInter(ctx, keystrs, cmd.GetArgument(0), &count);
         return 0;
@@ -886,6 +942,8 @@ OP_NAMESPACE_BEGIN
         {
             keystrs.insert(cmd.GetArguments()[i]);
         }
+        SliceArray lock_keys(cmd.GetArguments().begin(), cmd.GetArguments().end());
+        MultiKeyLockerGuard keylock(m_key_lock, ctx.currentDB, lock_keys);
         int64 count = 0;
         SetUnion(ctx, keystrs, cmd.GetArgument(0), &count);
         return 0;
@@ -1038,6 +1096,7 @@ OP_NAMESPACE_BEGIN
             v.key.db = dstdb;
             v.key.key = dstkey;
             v.meta.expireat = 0;
+            v.meta.version = NewCollectionVersion(dstdb, dstkey);
             err = SetKeyValue(ctx, v);
             CHECK_WRITE_RETURN_VALUE(ctx, err);
         }
@@ -1048,9 +1107,11 @@ OP_NAMESPACE_BEGIN
             tmpctx.currentDB = dstdb;
             ValueObject dstmeta;
             dstmeta.key.type = KEY_META;
+            dstmeta.key.db = dstdb;
             dstmeta.key.key = dstkey;
             dstmeta.type = SET_META;
             dstmeta.meta.SetEncoding(COLLECTION_ENCODING_ZIPSET);
+            dstmeta.meta.version = NewCollectionVersion(dstdb, dstkey);
             BatchWriteGuard guard(ctx);
             while (iter.Valid())
             {
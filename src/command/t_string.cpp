@@ -71,15 +71,21 @@ OP_NAMESPACE_BEGIN
     int Ardb::MGet(Context& ctx, RedisCommandFrame& cmd)
     {
         ctx.reply.type = REDIS_REPLY_ARRAY;
+        SliceArray keys;
         for (uint32 i = 0; i < cmd.GetArguments().size(); i++)
         {
-            ValueObject v;
+            keys.push_back(cmd.GetArguments()[i]);
+        }
+        ValueObjectArray vs;
+        std::vector<int> errs;
+        MultiGetMetaValue(ctx, keys, STRING_META, vs, errs);
+        for (uint32 i = 0; i < vs.size(); i++)
+        {
             RedisReply& reply = ctx.reply.AddMember();
-            int err = GetMetaValue(ctx, cmd.GetArguments()[i], STRING_META, v);
-            if (0 == err)
+            if (0 == errs[i])
             {
                 reply.type = REDIS_REPLY_STRING;
-                v.meta.str_value.GetDecodeString(reply.str);
+                vs[i].meta.str_value.GetDecodeString(reply.str);
             }
             else
             {
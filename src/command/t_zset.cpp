@@ -30,6 +30,12 @@
 #include <float.h>
 #include "geo/geohash_helper.hpp"
 
+/*
+ * Max members changed by one write while maintaining a zset rank index, a larger bulk write drops the index
+ * and the index would be rebuilt by the db cron.
+ */
+#define ZSET_RANK_MAX_PENDING_MEMBERS 65536
+
 OP_NAMESPACE_BEGIN
 
     static bool less_by_zset_score(const ZSetElement& v1, const ZSetElement& v2)
@@ -41,111 +47,693 @@ OP_NAMESPACE_BEGIN
         return v1.second.NumberValue() > v2.second.NumberValue();
     }
 
-//    int Ardb::ZSetUpdateScoreRangeTable(Context& ctx, ValueObject& meta, double score, DataOperation op)
-//    {
-//        if (op != OP_SET && op != OP_DELETE)
-//        {
-//            ERROR_LOG("Invalid operation.");
-//            return -1;
-//        }
-//        ScoreRanges::iterator fit = meta.meta.zset_score_range.lower_bound(score);
-//        if (fit == meta.meta.zset_score_range.end())
-//        {
-//            if (op == OP_SET)
-//            {
-//                if (meta.meta.zset_score_range.size() > 0)
-//                {
-//                    double last = meta.meta.zset_score_range.rbegin()->first;
-//                    uint32 count = meta.meta.zset_score_range.rbegin()->second;
-//                    meta.meta.zset_score_range.erase(last);
-//                    meta.meta.zset_score_range[score] = count + 1;
-//                }
-//                else
-//                {
-//                    meta.meta.zset_score_range[score] = 1;
-//                }
-//                fit = meta.meta.zset_score_range.find(score);
-//            }
-//            else
-//            {
-//                return 0;
-//            }
-//        }
-//        else
-//        {
-//            if (op == OP_SET)
-//            {
-//                fit->second++;
-//            }
-//            else
-//            {
-//                fit->second--;
-//            }
-//        }
-//        double range_score = fit->first;
-//        uint32 range_size = fit->second;
-//
-//        if (range_size > m_cfg.zset_max_score_range_size)
-//        {
-//            //merge small range
-//            ScoreRanges::iterator bit = meta.meta.zset_score_range.begin();
-//            uint32 prev_range_size;
-//            double prev_range_score;
-//            while (bit != meta.meta.zset_score_range.end())
-//            {
-//                if (bit != meta.meta.zset_score_range.begin())
-//                {
-//                    if (prev_range_size + bit->second < m_cfg.zset_max_score_range_size)
-//                    {
-//                        bit->second = prev_range_size + bit->second;
-//                        meta.meta.zset_score_range.erase(prev_range_score);
-//                        break;
-//                    }
-//                }
-//                prev_range_size = bit->second;
-//                prev_range_score = bit->first;
-//                bit++;
-//            }
-//
-//            if (meta.meta.zset_score_range.size() >= m_cfg.zset_max_range_table_size)
-//            {
-//                //do nothing since score range table size exceed limit
-//                return 1;
-//            }
-//
-//            //split range
-//            uint32 split_range_size = range_size / 2;
-//            uint32 new_range_size = 0;
-//            bool splitd = false;
-//            ZSetIterator iter;
-//            Data from;
-//            from.SetDouble(range_score);
-//            ZSetScoreIter(ctx, meta, from, iter, true);
-//            while (iter.Valid())
-//            {
-//                if (iter.Score()->Compare(from) <= 0)
-//                {
-//                    if (splitd)
-//                    {
-//                        meta.meta.zset_score_range[iter.Score()->NumberValue()] = range_size - new_range_size;
-//                        break;
-//                    }
-//                    new_range_size++;
-//                    if (new_range_size < range_size / 2)
-//                    {
-//                        fit->second = new_range_size;
-//                        splitd = true;
-//                    }
-//                }
-//                iter.Next();
-//            }
-//        }
-//        else if (range_size == 0)
-//        {
-//            meta.meta.zset_score_range.erase(fit);
-//        }
-//        return 1;
-//    }
+    static int compare_rank_entry(const ZSetRankEntry& entry, const ZSetRankMember& member)
+    {
+        int cmp = entry.score.Compare(member.score);
+        return 0 != cmp ? cmp : entry.element.Compare(member.element);
+    }
+
+    /*
+     * Return the index of last entry whose lower bound is not greater than member,
+     * the first entry of a node always has the lowest bound.
+     */
+    static uint32 locate_rank_entry(const ZSetRankNode& node, const ZSetRankMember& member)
+    {
+        uint32 low = 1, high = node.entries.size();
+        while (low < high)
+        {
+            uint32 mid = (low + high) / 2;
+            if (compare_rank_entry(node.entries[mid], member) <= 0)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        return low - 1;
+    }
+
+    static uint64 sum_rank_entries(const ZSetRankEntryArray& entries)
+    {
+        uint64 count = 0;
+        for (uint32 i = 0; i < entries.size(); i++)
+        {
+            count += entries[i].count;
+        }
+        return count;
+    }
+
+    ZSetRankCache& Ardb::GetZSetRankCache(ValueObject& meta)
+    {
+        if (NULL == meta.attach.zrank)
+        {
+            NEW(meta.attach.zrank, ZSetRankCache);
+        }
+        return *(meta.attach.zrank);
+    }
+
+    int Ardb::ZSetRankLoadNode(Context& ctx, ValueObject& meta, uint64 id, ZSetRankNode*& node)
+    {
+        ZSetRankCache& cache = GetZSetRankCache(meta);
+        ZSetRankNodeTable::iterator found = cache.nodes.find(id);
+        if (found != cache.nodes.end())
+        {
+            node = found->second;
+            return 0;
+        }
+        ValueObject v(ZSET_ELEMENT_RANK);
+        v.key.type = ZSET_ELEMENT_RANK;
+        v.key.db = ctx.currentDB;
+        v.key.key = meta.key.key;
+        v.key.version = meta.meta.version;
+        v.key.score.SetInt64((int64) id);
+        int err = GetKeyValue(ctx, v.key, &v);
+        if (0 != err)
+        {
+            ERROR_LOG("Failed to load rank index node:%llu for zset:%s", id, meta.key.key.data());
+            return err;
+        }
+        sds raw = v.element.RawString();
+        NEW(node, ZSetRankNode);
+        Buffer buf(raw, 0, NULL == raw ? 0 : sdslen(raw));
+        if (NULL == raw || !node->Decode(buf) || node->entries.empty())
+        {
+            ERROR_LOG("Invalid rank index node:%llu for zset:%s", id, meta.key.key.data());
+            DELETE(node);
+            return -1;
+        }
+        cache.nodes[id] = node;
+        return 0;
+    }
+
+    uint64 Ardb::ZSetRankNewNode(ValueObject& meta, ZSetRankNode* root, uint32 level, ZSetRankNode*& node)
+    {
+        uint64 id = root->next_id++;
+        root->dirty = true;
+        NEW(node, ZSetRankNode);
+        node->level = level;
+        node->dirty = true;
+        GetZSetRankCache(meta).nodes[id] = node;
+        return id;
+    }
+
+    /*
+     * Walk members in (score, element) order starting at 'from', merged with the members changed by
+     * current write. Stop at the member at offset 'skip', or at the first member not less than 'until'.
+     */
+    int Ardb::ZSetRankWalk(Context& ctx, ValueObject& meta, const ZSetRankMember& from, uint64 skip,
+            const ZSetRankMember* until, uint64& walked, ZSetRankMember* found)
+    {
+        walked = 0;
+        ZSetRankCache* cache = meta.attach.zrank;
+        ZSetRankMemberSet::iterator ait;
+        if (NULL != cache)
+        {
+            ait = cache->added.lower_bound(from);
+        }
+        KeyObject start;
+        start.type = ZSET_ELEMENT_SCORE;
+        start.db = ctx.currentDB;
+        start.key = meta.key.key;
+        start.version = meta.meta.version;
+        start.score = from.score;
+        start.element = from.element;
+        Iterator* iter = IteratorPrefix(start);
+        int err = -1;
+        while (true)
+        {
+            ZSetRankMember stored;
+            bool has_stored = false;
+            if (NULL != iter && iter->Valid())
+            {
+                KeyObject k;
+                if (decode_key(iter->Key(), k) && k.type == ZSET_ELEMENT_SCORE && k.db == start.db
+                        && k.key == start.key)
+                {
+                    stored.score = k.score;
+                    stored.element = k.element;
+                    has_stored = true;
+                }
+            }
+            bool has_added = NULL != cache && ait != cache->added.end();
+            if (!has_stored && !has_added)
+            {
+                break;
+            }
+            ZSetRankMember current;
+            int cmp = has_stored && has_added ? stored.Compare(*ait) : (has_stored ? -1 : 1);
+            if (cmp <= 0)
+            {
+                iter->Next();
+            }
+            if (cmp >= 0)
+            {
+                current = *ait;
+                ait++;
+            }
+            else
+            {
+                if (NULL != cache && cache->removed.count(stored) > 0)
+                {
+                    continue;
+                }
+                current = stored;
+            }
+            if (NULL != until && !(current < *until))
+            {
+                err = 0;
+                break;
+            }
+            if (walked == skip)
+            {
+                if (NULL != found)
+                {
+                    *found = current;
+                }
+                err = 0;
+                break;
+            }
+            walked++;
+        }
+        DELETE(iter);
+        return err;
+    }
+
+    /*
+     * Build the rank index bottom-up from the stored members. Only one open node per level is kept in memory.
+     */
+    int Ardb::ZSetRankBuild(Context& ctx, ValueObject& meta)
+    {
+        ZSetRankCache& cache = GetZSetRankCache(meta);
+        cache.Clear();
+        ZSetRankNode* root = NULL;
+        NEW(root, ZSetRankNode);
+        root->dirty = true;
+        cache.nodes[0] = root;
+
+        ZSetIterator iter;
+        Data from;
+        ZSetScoreIter(ctx, meta, from, iter, false);
+
+        uint32 fill = m_cfg.zset_rank_bucket_size / 2;
+        std::vector<ZSetRankEntryArray> levels(1);
+        std::vector<uint64> closed(1, 0);
+        while (iter.Valid())
+        {
+            ZSetRankEntryArray& buckets = levels[0];
+            if (buckets.empty() || buckets.back().count >= fill)
+            {
+                if (buckets.size() >= fill)
+                {
+                    //close full nodes from bottom to top
+                    for (uint32 level = 0; levels[level].size() >= fill; level++)
+                    {
+                        if (level + 1 == levels.size())
+                        {
+                            levels.resize(level + 2);
+                            closed.resize(level + 2, 0);
+                        }
+                        ZSetRankNode* node = NULL;
+                        ZSetRankEntry parent;
+                        parent.child = ZSetRankNewNode(meta, root, level, node);
+                        node->entries.swap(levels[level]);
+                        parent.score = node->entries[0].score;
+                        parent.element = node->entries[0].element;
+                        parent.count = sum_rank_entries(node->entries);
+                        levels[level + 1].push_back(parent);
+                        closed[level]++;
+                    }
+                }
+                ZSetRankEntry entry;
+                if (closed[0] > 0 || !levels[0].empty())
+                {
+                    entry.score = *(iter.Score());
+                    entry.element = *(iter.Element());
+                }
+                levels[0].push_back(entry);
+            }
+            levels[0].back().count++;
+            iter.Next();
+        }
+        for (uint32 level = 0; level < levels.size(); level++)
+        {
+            if (closed[level] == 0)
+            {
+                if (levels[level].empty())
+                {
+                    levels[level].push_back(ZSetRankEntry());
+                }
+                root->level = level;
+                root->entries.swap(levels[level]);
+                break;
+            }
+            if (!levels[level].empty())
+            {
+                if (level + 1 == levels.size())
+                {
+                    levels.resize(level + 2);
+                    closed.resize(level + 2, 0);
+                }
+                ZSetRankNode* node = NULL;
+                ZSetRankEntry parent;
+                parent.child = ZSetRankNewNode(meta, root, level, node);
+                node->entries.swap(levels[level]);
+                parent.score = node->entries[0].score;
+                parent.element = node->entries[0].element;
+                parent.count = sum_rank_entries(node->entries);
+                levels[level + 1].push_back(parent);
+                closed[level]++;
+            }
+        }
+        meta.meta.SetFlag(COLLECTION_FLAG_RANKINDEX);
+        return 0;
+    }
+
+    int Ardb::ZSetRankInsert(Context& ctx, ValueObject& meta, const Data& element, const Data& score)
+    {
+        ZSetRankCache& cache = GetZSetRankCache(meta);
+        ZSetRankMember member;
+        member.score = score;
+        member.element = element;
+        if (0 == cache.removed.erase(member))
+        {
+            cache.added.insert(member);
+        }
+        if (cache.added.size() + cache.removed.size() > ZSET_RANK_MAX_PENDING_MEMBERS)
+        {
+            ZSetRankClear(ctx, meta);
+            cache.Clear();
+            meta.meta.SetFlag(COLLECTION_FLAG_NORMAL);
+            ZSetRankLater(ctx, meta);
+            return 0;
+        }
+        ZSetRankNode* root = NULL;
+        if (0 != ZSetRankLoadNode(ctx, meta, 0, root))
+        {
+            return -1;
+        }
+        std::vector<ZSetRankNode*> path;
+        std::vector<uint32> pos;
+        ZSetRankNode* node = root;
+        while (true)
+        {
+            uint32 idx = locate_rank_entry(*node, member);
+            node->entries[idx].count++;
+            node->dirty = true;
+            path.push_back(node);
+            pos.push_back(idx);
+            if (node->level == 0)
+            {
+                break;
+            }
+            if (0 != ZSetRankLoadNode(ctx, meta, node->entries[idx].child, node))
+            {
+                return -1;
+            }
+        }
+        uint64 max = m_cfg.zset_rank_bucket_size;
+        ZSetRankNode* leaf = path.back();
+        uint32 idx = pos.back();
+        if (leaf->entries[idx].count > max)
+        {
+            //split the bucket at its median member
+            ZSetRankEntry& bucket = leaf->entries[idx];
+            ZSetRankMember from, median;
+            from.score = bucket.score;
+            from.element = bucket.element;
+            uint64 half = bucket.count / 2, walked = 0;
+            if (0 == ZSetRankWalk(ctx, meta, from, half, NULL, walked, &median))
+            {
+                ZSetRankEntry right;
+                right.score = median.score;
+                right.element = median.element;
+                right.count = bucket.count - half;
+                bucket.count = half;
+                leaf->entries.insert(leaf->entries.begin() + idx + 1, right);
+            }
+        }
+        for (uint32 i = path.size(); i > 0; i--)
+        {
+            ZSetRankNode* current = path[i - 1];
+            if (current->entries.size() <= max)
+            {
+                break;
+            }
+            uint32 half = current->entries.size() / 2;
+            ZSetRankNode* right = NULL;
+            if (current == root)
+            {
+                ZSetRankNode* left = NULL;
+                ZSetRankEntry le, re;
+                le.child = ZSetRankNewNode(meta, root, root->level, left);
+                re.child = ZSetRankNewNode(meta, root, root->level, right);
+                left->entries.assign(root->entries.begin(), root->entries.begin() + half);
+                right->entries.assign(root->entries.begin() + half, root->entries.end());
+                le.count = sum_rank_entries(left->entries);
+                re.score = right->entries[0].score;
+                re.element = right->entries[0].element;
+                re.count = sum_rank_entries(right->entries);
+                root->entries.clear();
+                root->entries.push_back(le);
+                root->entries.push_back(re);
+                root->level++;
+                break;
+            }
+            ZSetRankNode* parent = path[i - 2];
+            uint32 parent_idx = pos[i - 2];
+            ZSetRankEntry entry;
+            entry.child = ZSetRankNewNode(meta, root, current->level, right);
+            right->entries.assign(current->entries.begin() + half, current->entries.end());
+            current->entries.resize(half);
+            entry.score = right->entries[0].score;
+            entry.element = right->entries[0].element;
+            entry.count = sum_rank_entries(right->entries);
+            parent->entries[parent_idx].count -= entry.count;
+            parent->entries.insert(parent->entries.begin() + parent_idx + 1, entry);
+        }
+        return 0;
+    }
+
+    int Ardb::ZSetRankRemove(Context& ctx, ValueObject& meta, const Data& element, const Data& score)
+    {
+        ZSetRankCache& cache = GetZSetRankCache(meta);
+        ZSetRankMember member;
+        member.score = score;
+        member.element = element;
+        if (0 == cache.added.erase(member))
+        {
+            cache.removed.insert(member);
+        }
+        if (cache.added.size() + cache.removed.size() > ZSET_RANK_MAX_PENDING_MEMBERS)
+        {
+            ZSetRankClear(ctx, meta);
+            cache.Clear();
+            meta.meta.SetFlag(COLLECTION_FLAG_NORMAL);
+            ZSetRankLater(ctx, meta);
+            return 0;
+        }
+        ZSetRankNode* root = NULL;
+        if (0 != ZSetRankLoadNode(ctx, meta, 0, root))
+        {
+            return -1;
+        }
+        std::vector<ZSetRankNode*> path;
+        std::vector<uint32> pos;
+        ZSetRankNode* node = root;
+        while (true)
+        {
+            uint32 idx = locate_rank_entry(*node, member);
+            if (node->entries[idx].count > 0)
+            {
+                node->entries[idx].count--;
+            }
+            node->dirty = true;
+            path.push_back(node);
+            pos.push_back(idx);
+            if (node->level == 0)
+            {
+                break;
+            }
+            if (0 != ZSetRankLoadNode(ctx, meta, node->entries[idx].child, node))
+            {
+                return -1;
+            }
+        }
+        //merge small neighbour buckets, the first entry is kept since it's the lower bound of the node
+        uint64 max = m_cfg.zset_rank_bucket_size;
+        ZSetRankEntryArray& buckets = path.back()->entries;
+        uint32 idx = pos.back();
+        if (idx > 0 && (buckets[idx].count == 0 || buckets[idx - 1].count + buckets[idx].count <= max / 2))
+        {
+            buckets[idx - 1].count += buckets[idx].count;
+            buckets.erase(buckets.begin() + idx);
+        }
+        else if (idx + 1 < buckets.size() && buckets[idx].count + buckets[idx + 1].count <= max / 2)
+        {
+            buckets[idx].count += buckets[idx + 1].count;
+            buckets.erase(buckets.begin() + idx + 1);
+        }
+        //drop empty nodes
+        for (uint32 i = path.size() - 1; i > 0; i--)
+        {
+            ZSetRankNode* parent = path[i - 1];
+            uint32 parent_idx = pos[i - 1];
+            if (parent_idx == 0 || parent->entries[parent_idx].count > 0)
+            {
+                break;
+            }
+            uint64 id = parent->entries[parent_idx].child;
+            KeyObject nk;
+            nk.type = ZSET_ELEMENT_RANK;
+            nk.db = ctx.currentDB;
+            nk.key = meta.key.key;
+            nk.version = meta.meta.version;
+            nk.score.SetInt64((int64) id);
+            DelKeyValue(ctx, nk);
+            DELETE(cache.nodes[id]);
+            cache.nodes.erase(id);
+            parent->entries.erase(parent->entries.begin() + parent_idx);
+        }
+        //shrink the tree while root has only one child
+        while (root->level > 0 && root->entries.size() == 1)
+        {
+            uint64 id = root->entries[0].child;
+            ZSetRankNode* child = NULL;
+            if (0 != ZSetRankLoadNode(ctx, meta, id, child))
+            {
+                return -1;
+            }
+            root->entries = child->entries;
+            root->level = child->level;
+            KeyObject nk;
+            nk.type = ZSET_ELEMENT_RANK;
+            nk.db = ctx.currentDB;
+            nk.key = meta.key.key;
+            nk.version = meta.meta.version;
+            nk.score.SetInt64((int64) id);
+            DelKeyValue(ctx, nk);
+            DELETE(cache.nodes[id]);
+            cache.nodes.erase(id);
+        }
+        return 0;
+    }
+
+    int Ardb::ZSetRankOf(Context& ctx, ValueObject& meta, const Data& element, const Data& score, uint64& rank)
+    {
+        ZSetRankMember target;
+        target.score = score;
+        target.element = element;
+        rank = 0;
+        ZSetRankNode* node = NULL;
+        if (0 != ZSetRankLoadNode(ctx, meta, 0, node))
+        {
+            return -1;
+        }
+        while (true)
+        {
+            uint32 idx = locate_rank_entry(*node, target);
+            for (uint32 i = 0; i < idx; i++)
+            {
+                rank += node->entries[i].count;
+            }
+            if (node->level == 0)
+            {
+                ZSetRankMember from;
+                from.score = node->entries[idx].score;
+                from.element = node->entries[idx].element;
+                uint64 walked = 0;
+                int err = ZSetRankWalk(ctx, meta, from, (uint64) -1, &target, walked, NULL);
+                rank += walked;
+                return err;
+            }
+            if (0 != ZSetRankLoadNode(ctx, meta, node->entries[idx].child, node))
+            {
+                return -1;
+            }
+        }
+        return -1;
+    }
+
+    int Ardb::ZSetMemberAtRank(Context& ctx, ValueObject& meta, uint64 rank, ZSetRankMember& member)
+    {
+        ZSetRankNode* node = NULL;
+        if (0 != ZSetRankLoadNode(ctx, meta, 0, node))
+        {
+            return -1;
+        }
+        while (true)
+        {
+            uint32 idx = 0;
+            while (idx + 1 < node->entries.size() && rank >= node->entries[idx].count)
+            {
+                rank -= node->entries[idx].count;
+                idx++;
+            }
+            if (node->level == 0)
+            {
+                ZSetRankMember from;
+                from.score = node->entries[idx].score;
+                from.element = node->entries[idx].element;
+                uint64 walked = 0;
+                return ZSetRankWalk(ctx, meta, from, rank, NULL, walked, &member);
+            }
+            if (0 != ZSetRankLoadNode(ctx, meta, node->entries[idx].child, node))
+            {
+                return -1;
+            }
+        }
+        return -1;
+    }
+
+    int Ardb::ZSetRankFlush(Context& ctx, ValueObject& meta)
+    {
+        if (NULL == meta.attach.zrank)
+        {
+            return 0;
+        }
+        ZSetRankNodeTable::iterator it = meta.attach.zrank->nodes.begin();
+        while (it != meta.attach.zrank->nodes.end())
+        {
+            ZSetRankNode* node = it->second;
+            if (node->dirty)
+            {
+                Buffer buf;
+                node->Encode(buf);
+                ValueObject v(ZSET_ELEMENT_RANK);
+                v.key.type = ZSET_ELEMENT_RANK;
+                v.key.db = ctx.currentDB;
+                v.key.key = meta.key.key;
+                v.key.version = meta.meta.version;
+                v.key.score.SetInt64((int64) it->first);
+                v.element.SetString(Slice(buf.GetRawReadBuffer(), buf.ReadableBytes()), false);
+                int err = SetKeyValue(ctx, v);
+                if (0 != err)
+                {
+                    return err;
+                }
+                node->dirty = false;
+            }
+            it++;
+        }
+        return 0;
+    }
+
+    /*
+     * Delete all rank index nodes of the zset, and reset the index to an empty root.
+     */
+    int Ardb::ZSetRankClear(Context& ctx, ValueObject& meta)
+    {
+        ZSetRankCache& cache = GetZSetRankCache(meta);
+        KeyObject start;
+        start.type = ZSET_ELEMENT_RANK;
+        start.db = ctx.currentDB;
+        start.key = meta.key.key;
+        start.version = meta.meta.version;
+        Iterator* iter = IteratorPrefix(start);
+        while (NULL != iter && iter->Valid())
+        {
+            KeyObject k;
+            if (!decode_key(iter->Key(), k) || k.type != ZSET_ELEMENT_RANK || k.db != start.db
+                    || k.key != start.key)
+            {
+                break;
+            }
+            DelKeyValue(ctx, k);
+            iter->Next();
+        }
+        DELETE(iter);
+        ZSetRankNodeTable::iterator it = cache.nodes.begin();
+        while (it != cache.nodes.end())
+        {
+            KeyObject nk;
+            nk.type = ZSET_ELEMENT_RANK;
+            nk.db = ctx.currentDB;
+            nk.key = meta.key.key;
+            nk.version = meta.meta.version;
+            nk.score.SetInt64((int64) it->first);
+            DelKeyValue(ctx, nk);
+            DELETE(it->second);
+            it++;
+        }
+        cache.nodes.clear();
+        ZSetRankNode* root = NULL;
+        NEW(root, ZSetRankNode);
+        root->entries.resize(1);
+        root->dirty = true;
+        cache.nodes[0] = root;
+        return 0;
+    }
+
+    /*
+     * The cron builds an index in one batch under the key lock, zsets above 'zset-rank-build-max-len' members
+     * stay without index so that no key blocks its writers or the cron for a whole scan.
+     */
+    bool Ardb::ZSetRankTooLarge(ValueObject& meta)
+    {
+        return m_cfg.zset_rank_build_max_len > 0 && meta.meta.Length() > m_cfg.zset_rank_build_max_len;
+    }
+
+    /*
+     * Queue a raw zset without rank index for the db cron, building the index inline would make one write pay
+     * for scanning every member.
+     */
+    void Ardb::ZSetRankLater(Context& ctx, ValueObject& meta)
+    {
+        if (meta.meta.Encoding() != COLLECTION_ENCODING_RAW || meta.meta.HasRankIndex() || ZSetRankTooLarge(meta))
+        {
+            return;
+        }
+        DBItemKey item(ctx.currentDB, std::string(meta.key.key.data(), meta.key.key.size()));
+        LockGuard<SpinMutexLock> guard(m_zrank_lock);
+        if (m_zrank_keys.insert(item).second)
+        {
+            m_zrank_pending++;
+        }
+    }
+
+    void Ardb::ZSetRankStep(uint64 max_millis)
+    {
+        uint64 start = get_current_epoch_millis();
+        while (m_zrank_pending > 0 && get_current_epoch_millis() - start < max_millis)
+        {
+            DBItemKey item;
+            {
+                LockGuard<SpinMutexLock> guard(m_zrank_lock);
+                if (m_zrank_keys.empty())
+                {
+                    return;
+                }
+                item = *(m_zrank_keys.begin());
+                m_zrank_keys.erase(m_zrank_keys.begin());
+                m_zrank_pending--;
+            }
+            KeyLockerGuard keylock(m_key_lock, item.db, item.key);
+            Context tmpctx;
+            tmpctx.currentDB = item.db;
+            ValueObject meta;
+            if (0 != GetMetaValue(tmpctx, item.key, ZSET_META, meta)
+                    || meta.meta.Encoding() != COLLECTION_ENCODING_RAW || meta.meta.HasRankIndex())
+            {
+                continue;
+            }
+            if (ZSetRankTooLarge(meta))
+            {
+                m_zrank_skipped_keys++;
+                continue;
+            }
+            BatchWriteGuard guard(tmpctx);
+            if (0 == ZSetRankBuild(tmpctx, meta) && 0 == SetKeyValue(tmpctx, meta))
+            {
+                m_zrank_built_keys++;
+            }
+            else
+            {
+                guard.MarkFailed();
+            }
+        }
+    }
 
     int Ardb::ZSetAdd(Context& ctx, ValueObject& meta, const Data& element, const Data& score, Data* old_score)
     {
@@ -175,6 +763,7 @@ OP_NAMESPACE_BEGIN
                     v.score = it->second;
                     v.key.type = ZSET_ELEMENT_VALUE;
                     v.key.key = meta.key.key;
+                    v.key.version = meta.meta.version;
                     v.key.db = ctx.currentDB;
                     v.key.element = it->first;
                     SetKeyValue(ctx, v);
@@ -182,6 +771,7 @@ OP_NAMESPACE_BEGIN
                     ValueObject sv(ZSET_ELEMENT_SCORE);
                     sv.key.type = ZSET_ELEMENT_SCORE;
                     sv.key.key = meta.key.key;
+                    sv.key.version = meta.meta.version;
                     sv.key.db = ctx.currentDB;
                     sv.key.element = it->first;
                     sv.key.score = it->second;
@@ -189,15 +779,21 @@ OP_NAMESPACE_BEGIN
                     it++;
                 }
                 meta.meta.len = meta.meta.zipmap.size();
-                //meta.meta.zset_score_range[meta.meta.max_index.NumberValue()] = meta.meta.zipmap.size();
                 meta.meta.zipmap.clear();
+                ZSetRankLater(ctx, meta);
             }
         }
         else
         {
+            if (!meta.meta.HasRankIndex())
+            {
+                //zset created before rank index, or index dropped by a bulk write
+                ZSetRankLater(ctx, meta);
+            }
             ValueObject v(ZSET_ELEMENT_VALUE);
             v.key.type = ZSET_ELEMENT_VALUE;
             v.key.key = meta.key.key;
+            v.key.version = meta.meta.version;
             v.key.db = ctx.currentDB;
             v.key.element = element;
             bool found = false;
@@ -220,10 +816,15 @@ OP_NAMESPACE_BEGIN
                 KeyObject score_key;
                 score_key.db = ctx.currentDB;
                 score_key.key = meta.key.key;
+                score_key.version = meta.meta.version;
                 score_key.type = ZSET_ELEMENT_SCORE;
                 score_key.element = v.key.element;
                 score_key.score = v.score;
                 DelKeyValue(ctx, score_key);
+                if (meta.meta.HasRankIndex())
+                {
+                    ZSetRankRemove(ctx, meta, element, v.score);
+                }
             }
             else
             {
@@ -242,11 +843,15 @@ OP_NAMESPACE_BEGIN
             ValueObject sv(ZSET_ELEMENT_SCORE);
             sv.key.type = ZSET_ELEMENT_SCORE;
             sv.key.key = meta.key.key;
+            sv.key.version = meta.meta.version;
             sv.key.db = ctx.currentDB;
             sv.key.element = element;
             sv.key.score = score;
             SetKeyValue(ctx, sv);
-            //ZSetUpdateScoreRangeTable(ctx, meta, score.NumberValue(), OP_SET);
+            if (meta.meta.HasRankIndex())
+            {
+                ZSetRankInsert(ctx, meta, element, score);
+            }
         }
         count = meta.meta.Length() - oldlen;
         return count;
@@ -263,8 +868,7 @@ OP_NAMESPACE_BEGIN
         int err = GetMetaValue(ctx, cmd.GetArguments()[0], ZSET_META, meta);
         CHECK_ARDB_RETURN_VALUE(ctx.reply, err);
         uint32 count = 0;
-        BatchWriteGuard guard(ctx,
-                meta.meta.Encoding() != COLLECTION_ENCODING_RAW || cmd.GetArguments().size() > 3);
+        BatchWriteGuard guard(ctx);
         for (uint32 i = 1; i < cmd.GetArguments().size(); i += 2)
         {
             Data score;
@@ -299,53 +903,6 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
-    int Ardb::ZSetRankByScore(Context& ctx, ValueObject& meta, Data& sc, uint32& rank)
-    {
-        rank = 0;
-        if (meta.meta.min_index.Compare(sc) > 0)
-        {
-            return -1;
-        }
-        if (meta.meta.max_index.Compare(sc) < 0)
-        {
-            rank = meta.meta.Length() - 1;
-            return -1;
-        }
-        if (sc == meta.meta.min_index)
-        {
-            rank = 0;
-            return 0;
-        }
-        if (sc == meta.meta.max_index)
-        {
-            rank = meta.meta.Length() - 1;
-            return 0;
-        }
-
-        ZSetIterator iter;
-        ZSetScoreIter(ctx, meta, meta.meta.min_index, iter, true);
-        bool match_score = false;
-        while (iter.Valid())
-        {
-            int cmp = iter.Score()->Compare(sc);
-            if (cmp > 0)
-            {
-                break;
-            }
-            else if (cmp == 0)
-            {
-                match_score = true;
-                break;
-            }
-            else
-            {
-                rank++;
-                iter.Next();
-            }
-        }
-        return match_score ? 0 : -1;
-    }
-
     int Ardb::ZCount(Context& ctx, RedisCommandFrame& cmd)
     {
         ValueObject meta;
@@ -428,6 +985,7 @@ OP_NAMESPACE_BEGIN
             vv.key.type = ZSET_ELEMENT_VALUE;
             vv.key.db = ctx.currentDB;
             vv.key.key = meta.key.key;
+            vv.key.version = meta.meta.version;
             vv.key.element = value;
             vv.attach.fetch_loc = true;
             int err = GetKeyValue(ctx, vv.key, &vv);
@@ -461,6 +1019,7 @@ OP_NAMESPACE_BEGIN
         int ret = ZSetScore(ctx, meta, element, oldscore);
         Data newscore = oldscore;
         newscore.IncrBy(incr);
+        BatchWriteGuard guard(ctx);
         ZSetAdd(ctx, meta, element, newscore, ret == 0 ? (&oldscore) : NULL);
         err = SetKeyValue(ctx, meta);
         CHECK_WRITE_RETURN_VALUE(ctx, err);
@@ -468,26 +1027,6 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
-//    int Ardb::ZGetPrevRangeByRank(Context& ctx, ValueObject& meta, uint32 rank, double& prev_range_score,
-//            uint32& prev_rank)
-//    {
-//        ScoreRanges::iterator it = meta.meta.zset_score_range.begin();
-//        prev_range_score = meta.meta.min_index.NumberValue();
-//        prev_rank = 0;
-//        while (it != meta.meta.zset_score_range.end())
-//        {
-//            prev_rank += it->second;
-//            if (prev_rank >= rank)
-//            {
-//                prev_rank -= it->second;
-//                break;
-//            }
-//            prev_range_score = it->first;
-//            it++;
-//        }
-//        return 0;
-//    }
-
     int Ardb::ZSetRange(Context& ctx, const Slice& key, int64 start, int64 end, bool withscores, bool reverse,
             DataOperation op)
     {
@@ -558,7 +1097,29 @@ OP_NAMESPACE_BEGIN
         {
             uint32 rank_cursor = 0;
             ZSetIterator iter;
-            ZSetScoreIter(ctx, meta, reverse ? meta.meta.max_index : meta.meta.min_index, iter, op != OP_DELETE);
+            ZSetRankMember first;
+            uint64 first_rank = reverse ? meta.meta.Length() - 1 - start : start;
+            uint64 walked = 0;
+            if (meta.meta.HasRankIndex() ?
+                    0 == ZSetMemberAtRank(ctx, meta, first_rank, first) :
+                    0 == ZSetRankWalk(ctx, meta, ZSetRankMember(), first_rank, NULL, walked, &first))
+            {
+                KeyObject kk;
+                kk.type = ZSET_ELEMENT_SCORE;
+                kk.db = ctx.currentDB;
+                kk.key = meta.key.key;
+                kk.version = meta.meta.version;
+                kk.score = first.score;
+                kk.element = first.element;
+                iter.SetMeta(&meta);
+                iter.SetIter(IteratorKeyValue(kk, false));
+                rank_cursor = start;
+            }
+            else
+            {
+                ZSetScoreIter(ctx, meta, reverse ? meta.meta.max_index : meta.meta.min_index, iter,
+                        op != OP_DELETE);
+            }
             while (iter.Valid())
             {
                 bool match_value = false;
@@ -650,15 +1211,28 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         meta.meta.len--;
+        if (meta.meta.HasRankIndex())
+        {
+            if (meta.meta.len > 0)
+            {
+                ZSetRankRemove(ctx, meta, element, score);
+            }
+            else
+            {
+                ZSetRankClear(ctx, meta);
+            }
+        }
         KeyObject vk;
         vk.element = element;
         vk.db = ctx.currentDB;
         vk.type = ZSET_ELEMENT_VALUE;
         vk.key = meta.key.key;
+        vk.version = meta.meta.version;
         KeyObject sk;
         sk.db = ctx.currentDB;
         sk.type = ZSET_ELEMENT_SCORE;
         sk.key = meta.key.key;
+        sk.version = meta.meta.version;
         sk.element = element;
         sk.score = score;
         DelKeyValue(ctx, sk);
@@ -927,11 +1501,26 @@ OP_NAMESPACE_BEGIN
         }
         else
         {
-            if (0 != ZSetRankByScore(ctx, meta, score, rank))
+            uint64 index_rank = 0;
+            if (meta.meta.HasRankIndex())
+            {
+                err = ZSetRankOf(ctx, meta, element, score, index_rank);
+            }
+            else
+            {
+                //answered by a scan until the db cron builds the index
+                ZSetRankLater(ctx, meta);
+                ZSetRankMember from, target;
+                target.score = score;
+                target.element = element;
+                err = ZSetRankWalk(ctx, meta, from, (uint64) -1, &target, index_rank, NULL);
+            }
+            if (0 != err)
             {
                 ctx.reply.type = REDIS_REPLY_NIL;
                 return 0;
             }
+            rank = index_rank;
         }
         if (reverse)
         {
@@ -967,6 +1556,7 @@ OP_NAMESPACE_BEGIN
             vv.key.db = ctx.currentDB;
             vv.key.type = ZSET_ELEMENT_VALUE;
             vv.key.key = meta.key.key;
+            vv.key.version = meta.meta.version;
             if (0 == GetKeyValue((ctx), vv.key, &vv))
             {
                 ZSetDeleteElement(ctx, meta, element, vv.score);
@@ -1029,6 +1619,9 @@ OP_NAMESPACE_BEGIN
             fill_error_reply(ctx.reply, "Invalid argument");
             return 0;
         }
+        SliceArray lock_keys(options.keys.begin(), options.keys.end());
+        lock_keys.push_back(cmd.GetArguments()[0]);
+        MultiKeyLockerGuard keylock(m_key_lock, ctx.currentDB, lock_keys);
         DeleteKey(ctx, cmd.GetArguments()[0]);
         ValueObject meta;
         meta.type = ZSET_META;
@@ -1036,6 +1629,7 @@ OP_NAMESPACE_BEGIN
         meta.key.type = KEY_META;
         meta.key.key = cmd.GetArguments()[0];
         meta.meta.SetEncoding(COLLECTION_ENCODING_ZIPZSET);
+        meta.meta.version = NewCollectionVersion(ctx.currentDB, meta.key.key);
 
         fill_int_reply(ctx.reply, 0); //default reply value
 
@@ -1132,6 +1726,9 @@ OP_NAMESPACE_BEGIN
             fill_error_reply(ctx.reply, "Invalid argument");
             return 0;
         }
+        SliceArray lock_keys(options.keys.begin(), options.keys.end());
+        lock_keys.push_back(cmd.GetArguments()[0]);
+        MultiKeyLockerGuard keylock(m_key_lock, ctx.currentDB, lock_keys);
         int err = DeleteKey(ctx, cmd.GetArguments()[0]);
         CHECK_WRITE_RETURN_VALUE(ctx, err);
         ValueObject meta;
@@ -1140,6 +1737,7 @@ OP_NAMESPACE_BEGIN
         meta.key.db = ctx.currentDB;
         meta.key.type = KEY_META;
         meta.key.key = cmd.GetArguments()[0];
+        meta.meta.version = NewCollectionVersion(ctx.currentDB, meta.key.key);
 
         ValueObjectArray metas;
         StringArray::iterator sit = options.keys.begin();
@@ -1353,18 +1951,24 @@ OP_NAMESPACE_BEGIN
                 KeyObject fk;
                 fk.db = ctx.currentDB;
                 fk.key = meta.key.key;
+                fk.version = meta.meta.version;
                 fk.type = ZSET_ELEMENT_VALUE;
                 fk.element = *(iter.Element());
                 DelKeyValue(ctx, fk);
                 KeyObject sk;
                 sk.db = ctx.currentDB;
                 sk.key = meta.key.key;
+                sk.version = meta.meta.version;
                 sk.type = ZSET_ELEMENT_SCORE;
                 sk.element = *(iter.Element());
                 sk.score = *(iter.Score());
                 DelKeyValue((ctx), sk);
                 iter.Next();
             }
+            if (meta.meta.HasRankIndex())
+            {
+                ZSetRankClear(ctx, meta);
+            }
         }
         int err = DelKeyValue((ctx), meta.key);
         CHECK_WRITE_RETURN_VALUE(ctx, err);
@@ -1516,6 +2120,7 @@ OP_NAMESPACE_BEGIN
             v.key.db = dstdb;
             v.key.key = dstkey;
             v.meta.expireat = 0;
+            v.meta.version = NewCollectionVersion(dstdb, dstkey);
             err = SetKeyValue(ctx, v);
             CHECK_WRITE_RETURN_VALUE(ctx, err);
         }
@@ -1527,9 +2132,11 @@ OP_NAMESPACE_BEGIN
             tmpctx.currentDB = dstdb;
             ValueObject dstmeta;
             dstmeta.key.type = KEY_META;
+            dstmeta.key.db = dstdb;
             dstmeta.key.key = dstkey;
             dstmeta.type = ZSET_META;
             dstmeta.meta.SetEncoding(COLLECTION_ENCODING_ZIPZSET);
+            dstmeta.meta.version = NewCollectionVersion(dstdb, dstkey);
             BatchWriteGuard guard(ctx);
             while (iter.Valid())
             {
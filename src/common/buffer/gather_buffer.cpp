@@ -0,0 +1,104 @@
+ /*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gather_buffer.hpp"
+#include <errno.h>
+using namespace ardb;
+
+int GatherBuffer::FillIOVec(struct iovec* vec, int max) const
+{
+	const char* head = m_head.GetRawBuffer();
+	size_t head_idx = 0;
+	size_t pos = 0;
+	int count = 0;
+	for (size_t i = 0; i <= m_segments.size() && count < max; i++)
+	{
+		size_t head_end = i < m_segments.size() ? m_segments[i].mark : m_head.GetWriteIndex();
+		const char* pieces[2] = { head + head_idx, i < m_segments.size() ? m_segments[i].data : NULL };
+		size_t lens[2] = { head_end - head_idx, i < m_segments.size() ? m_segments[i].len : 0 };
+		head_idx = head_end;
+		for (int j = 0; j < 2 && count < max; j++)
+		{
+			if (lens[j] == 0 || pos + lens[j] <= m_written_bytes)
+			{
+				pos += lens[j];
+				continue;
+			}
+			size_t skip = m_written_bytes > pos ? m_written_bytes - pos : 0;
+			vec[count].iov_base = (void*) (pieces[j] + skip);
+			vec[count].iov_len = lens[j] - skip;
+			count++;
+			pos += lens[j];
+		}
+	}
+	return count;
+}
+
+int GatherBuffer::WriteFD(int fd, int& err)
+{
+	struct iovec vec[MAX_IOVEC_COUNT];
+	int total = 0;
+	while (ReadableBytes() > 0)
+	{
+		int count = FillIOVec(vec, MAX_IOVEC_COUNT);
+		size_t expected = 0;
+		for (int i = 0; i < count; i++)
+		{
+			expected += vec[i].iov_len;
+		}
+		ssize_t n = ::writev(fd, vec, count);
+		if (n < 0)
+		{
+			err = errno;
+			return total > 0 ? total : -1;
+		}
+		m_written_bytes += n;
+		total += n;
+		if ((size_t) n < expected)
+		{
+			break;
+		}
+	}
+	return total;
+}
+
+void GatherBuffer::Flatten(Buffer& out)
+{
+	struct iovec vec[MAX_IOVEC_COUNT];
+	out.EnsureWritableBytes(ReadableBytes());
+	while (ReadableBytes() > 0)
+	{
+		int count = FillIOVec(vec, MAX_IOVEC_COUNT);
+		for (int i = 0; i < count; i++)
+		{
+			out.Write(vec[i].iov_base, vec[i].iov_len);
+			m_written_bytes += vec[i].iov_len;
+		}
+	}
+}
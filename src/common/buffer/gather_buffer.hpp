@@ -0,0 +1,128 @@
+ /*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GATHER_BUFFER_HPP_
+#define GATHER_BUFFER_HPP_
+
+#include "buffer.hpp"
+#include <sys/uio.h>
+#include <vector>
+
+namespace ardb
+{
+	/**
+	 * An output buffer made of small encoded fragments plus references to
+	 * large bodies owned by the caller.
+	 *
+	 *       +--------+-----------+--------+-----------+--------+
+	 *       | head   | body ref  | head   | body ref  | head   |
+	 *       +--------+-----------+--------+-----------+--------+
+	 *
+	 * Referenced bodies are NOT copied, they must stay valid until the
+	 * buffer is written or flattened, so a GatherBuffer never outlives the
+	 * reply it was encoded from.
+	 */
+	class GatherBuffer
+	{
+		public:
+			static const size_t MIN_REFERENCE_SIZE = 4096;
+			static const int MAX_IOVEC_COUNT = 64;
+		private:
+			struct Segment
+			{
+					size_t mark;
+					const char* data;
+					size_t len;
+			};
+			typedef std::vector<Segment> SegmentArray;
+			Buffer m_head;
+			SegmentArray m_segments;
+			size_t m_referenced_bytes;
+			size_t m_written_bytes;
+			int FillIOVec(struct iovec* vec, int max) const;
+		public:
+			GatherBuffer() :
+					m_referenced_bytes(0), m_written_bytes(0)
+			{
+			}
+			inline Buffer& Head()
+			{
+				return m_head;
+			}
+			inline bool HasReference() const
+			{
+				return !m_segments.empty();
+			}
+			inline size_t ReferencedBytes() const
+			{
+				return m_referenced_bytes;
+			}
+			inline size_t ReadableBytes() const
+			{
+				return m_head.GetWriteIndex() + m_referenced_bytes - m_written_bytes;
+			}
+			/*
+			 * Bodies smaller than MIN_REFERENCE_SIZE are cheaper to copy than to
+			 * pass as an extra iovec.
+			 */
+			inline void Reference(const char* data, size_t len)
+			{
+				if (len < MIN_REFERENCE_SIZE)
+				{
+					m_head.Write(data, len);
+					return;
+				}
+				Segment seg;
+				seg.mark = m_head.GetWriteIndex();
+				seg.data = data;
+				seg.len = len;
+				m_segments.push_back(seg);
+				m_referenced_bytes += len;
+			}
+			/*
+			 * Write the unwritten part with writev, returns the written bytes, or
+			 * -1 with 'err' set if nothing could be written.
+			 */
+			int WriteFD(int fd, int& err);
+			/*
+			 * Append the unwritten part to 'out', after which this buffer is
+			 * fully consumed.
+			 */
+			void Flatten(Buffer& out);
+			inline void Clear()
+			{
+				m_head.Clear();
+				m_segments.clear();
+				m_referenced_bytes = 0;
+				m_written_bytes = 0;
+			}
+	};
+}
+
+#endif /* GATHER_BUFFER_HPP_ */
@@ -63,11 +63,11 @@ void Channel::IOEventCallback(struct aeEventLoop *eventLoop, int fd, void *clien
 }
 
 Channel::Channel(Channel* parent, ChannelService& service) :
-        m_user_configed(false), m_has_removed(false), m_parent_id(0), m_service(&service), m_id(0), m_fd(-1), m_flush_timertask_id(
+        m_user_configed(false), m_has_removed(false), m_parent_id(0), m_service(&service), m_id(0), m_fd(-1), m_output_bytes(0), m_flush_timertask_id(
                 -1), m_pipeline_initializor(
         NULL), m_pipeline_initailizor_user_data(NULL), m_pipeline_finallizer(
         NULL), m_pipeline_finallizer_user_data(NULL), m_detached(false), m_close_after_write(false), m_block_read(
-                false), m_file_sending(
+                false), m_corked(false), m_file_sending(
         NULL), m_attach(NULL), m_attach_destructor(NULL)
 {
 
@@ -300,6 +300,17 @@ int32 Channel::WriteNow(Buffer* buffer)
     }
     uint32 buf_len = NULL != buffer ? buffer->ReadableBytes() : 0;
 
+    if (m_corked)
+    {
+        if (m_options.max_write_buffer_size > 0
+                && (m_outputBuffer.ReadableBytes() + buf_len) > (uint32) m_options.max_write_buffer_size)
+        {
+            WARN_LOG("Channel:%u write buffer exceed limit:%d", m_id, m_options.max_write_buffer_size);
+            return 0;
+        }
+        m_outputBuffer.Write(buffer, buf_len);
+        return buf_len;
+    }
     if (m_outputBuffer.Readable())
     {
         if (m_options.max_write_buffer_size > 0) //write buffer size limit enable
@@ -387,6 +398,88 @@ int32 Channel::WriteNow(Buffer* buffer)
     }
 }
 
+/*
+ * Same policy as WriteNow, but large bodies are only referenced by the gather
+ * buffer: they go to the socket with writev, and are copied exactly once into
+ * the output buffer when the socket can not take them right now.
+ */
+int32 Channel::WriteGather(GatherBuffer* buffer)
+{
+    if (!buffer->HasReference())
+    {
+        return WriteNow(&buffer->Head());
+    }
+    if (NULL != m_file_sending)
+    {
+        WARN_LOG("Can NOT write fd since channel is sending file.");
+        return 0;
+    }
+    uint32 buf_len = buffer->ReadableBytes();
+    bool enable_writing = IsEnableWriting();
+    if (m_corked && m_outputBuffer.Readable() && !enable_writing && !m_options.async_write)
+    {
+        /*
+         * Appending to the corked output would copy the referenced bodies, so the output corked so far
+         * is sent now instead, and this buffer still goes out with writev below. The channel stays corked.
+         */
+        if (!DoFlush())
+        {
+            return 0;
+        }
+    }
+    if (m_outputBuffer.Readable() || enable_writing || m_options.async_write)
+    {
+        if (m_options.max_write_buffer_size > 0
+                && (m_outputBuffer.ReadableBytes() + buf_len) > (uint32) m_options.max_write_buffer_size)
+        {
+            WARN_LOG("Channel:%u write buffer exceed limit:%d", m_id, m_options.max_write_buffer_size);
+            return 0;
+        }
+        buffer->Flatten(m_outputBuffer);
+        if (!enable_writing && !m_corked)
+        {
+            if (m_options.async_write)
+            {
+                EnableWriting();
+            }
+            else
+            {
+                Flush();
+            }
+        }
+        return buf_len;
+    }
+    int err;
+    int ret = buffer->WriteFD(GetWriteFD(), err);
+    if (ret < 0)
+    {
+        if (IO_ERR_RW_RETRIABLE(err))
+        {
+            if (m_options.max_write_buffer_size == 0)
+            {
+                return 0;
+            }
+            buffer->Flatten(m_outputBuffer);
+            EnableWriting();
+            return buf_len;
+        }
+        else
+        {
+            return HandleIOError(err);
+        }
+    }
+    else if (ret == 0)
+    {
+        return HandleExceptionEvent(CHANNEL_EVENT_EOF);
+    }
+    if ((size_t) ret < buf_len)
+    {
+        buffer->Flatten(m_outputBuffer);
+        EnableWriting();
+    }
+    return buf_len;
+}
+
 bool Channel::DoConfigure(const ChannelOptions& options)
 {
     if (options.user_write_buffer_water_mark > 0)
@@ -520,7 +613,16 @@ void Channel::OnRead()
     {
         //TRACE_LOG(
         //        "DataReceived with %d bytes in channel %u.", m_inputBuffer.ReadableBytes(), GetID());
+        ChannelService* serv = m_service;
+        uint32 id = m_id;
         fire_message_received<Buffer>(this, &m_inputBuffer, NULL);
+        /*
+         * Skip it if the channel was closed or handed over to another service by the handlers.
+         */
+        if (serv->GetChannel(id) == this && !m_has_removed && !IsClosed())
+        {
+            fire_channel_read_complete(this);
+        }
     }
     else
     {
@@ -636,6 +738,7 @@ bool Channel::Connect(Address* remote)
 
 bool Channel::Flush()
 {
+    m_corked = false;
     if (IsEnableWriting())
     {
         return false;
@@ -652,6 +755,37 @@ bool Channel::Flush()
     return true;
 }
 
+bool Channel::Uncork()
+{
+    m_corked = false;
+    if (!m_outputBuffer.Readable() || !IsWriteReady() || IsEnableWriting())
+    {
+        return true;
+    }
+    if (m_options.async_write)
+    {
+        EnableWriting();
+        return true;
+    }
+    if (!DoFlush())
+    {
+        return false;
+    }
+    if (m_outputBuffer.Readable())
+    {
+        EnableWriting();
+    }
+    return true;
+}
+
+void Channel::DiscardCorkedOutput(uint32 len)
+{
+    if (m_corked && m_outputBuffer.ReadableBytes() > len)
+    {
+        m_outputBuffer.SetWriteIndex(m_outputBuffer.GetReadIndex() + len);
+    }
+}
+
 bool Channel::DoClose(bool inDestructor)
 {
     bool hasfd = false;
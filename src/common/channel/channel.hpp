@@ -32,6 +32,7 @@
 #include "common.hpp"
 #include "channel/redis/ae.h"
 #include "buffer/buffer_helper.hpp"
+#include "buffer/gather_buffer.hpp"
 #include "channel/channel_pipeline.hpp"
 #include "util/helpers.hpp"
 #include <map>
@@ -170,6 +171,7 @@ namespace ardb
             int m_fd;
             Buffer m_inputBuffer;
             Buffer m_outputBuffer;
+            uint64 m_output_bytes;
             int32 m_flush_timertask_id;
             ChannelPipelineInitializer* m_pipeline_initializor;
             void* m_pipeline_initailizor_user_data;
@@ -178,6 +180,7 @@ namespace ardb
             bool m_detached;
             bool m_close_after_write;
             bool m_block_read;
+            bool m_corked;
 
             SendFileSetting* m_file_sending;
             void* m_attach;
@@ -201,6 +204,7 @@ namespace ardb
             virtual bool DoClose();
             virtual bool DoFlush();
             virtual int32 WriteNow(Buffer* buffer);
+            int32 WriteGather(GatherBuffer* buffer);
             virtual int32 ReadNow(Buffer* buffer);
             virtual int32 HandleExceptionEvent(int32 event);
             int HandleIOError(int err);
@@ -239,6 +243,14 @@ namespace ardb
                 return m_outputBuffer;
             }
 
+            /*
+             * Total bytes accepted for writing since the channel opened.
+             */
+            inline uint64 GetOutputBytes() const
+            {
+                return m_output_bytes;
+            }
+
             inline uint32 ReadableBytes()
             {
                 return m_inputBuffer.ReadableBytes();
@@ -355,6 +367,23 @@ namespace ardb
             int SendFile(const SendFileSetting& setting);
 
             bool Flush();
+            /*
+             * While corked, writes only append to the output buffer, Uncork() or Flush() sends them at once.
+             * A gather buffer referencing large bodies is not copied in, it sends the corked output first.
+             */
+            inline void Cork()
+            {
+                m_corked = true;
+            }
+            inline bool IsCorked()
+            {
+                return m_corked;
+            }
+            bool Uncork();
+            /*
+             * Drops corked output written after the first 'len' buffered bytes.
+             */
+            void DiscardCorkedOutput(uint32 len);
             virtual const Address* GetLocalAddress()
             {
                 return NULL;
@@ -62,6 +62,8 @@ namespace ardb
 
 	bool fire_channel_writable(Channel* channel);
 
+	bool fire_channel_read_complete(Channel* channel);
+
 	//bool openChannel(Channel* channel);
 	//bool bindChannel(Channel* channel, Address* localAddress);
 	//ChannelEvent* unbindChannel(Channel* channel);
@@ -197,6 +197,23 @@ bool ChannelService::EventSunk(ChannelPipeline* pipeline, MessageEvent<Buffer>&
     RETURN_FALSE_IF_NULL(buffer);
     uint32 len = buffer->ReadableBytes();
     int32 ret = e.GetChannel()->WriteNow(buffer);
+    if (ret > 0)
+    {
+        e.GetChannel()->m_output_bytes += ret;
+    }
+    return ret >= 0 ? (len == (uint32) ret) : false;
+}
+
+bool ChannelService::EventSunk(ChannelPipeline* pipeline, MessageEvent<GatherBuffer>& e)
+{
+    GatherBuffer* buffer = e.GetMessage();
+    RETURN_FALSE_IF_NULL(buffer);
+    uint32 len = buffer->ReadableBytes();
+    int32 ret = e.GetChannel()->WriteGather(buffer);
+    if (ret > 0)
+    {
+        e.GetChannel()->m_output_bytes += ret;
+    }
     return ret >= 0 ? (len == (uint32) ret) : false;
 }
 
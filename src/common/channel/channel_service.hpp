@@ -116,6 +116,7 @@ namespace ardb
             }
             bool EventSunk(ChannelPipeline* pipeline, ChannelStateEvent& e);
             bool EventSunk(ChannelPipeline* pipeline, MessageEvent<Buffer>& e);
+            bool EventSunk(ChannelPipeline* pipeline, MessageEvent<GatherBuffer>& e);
             bool EventSunk(ChannelPipeline* pipeline, MessageEvent<DatagramPacket>& e);
 
             void OnSoftSignal(uint32 soft_signo, uint32 appendinfo);
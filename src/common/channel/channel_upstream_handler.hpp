@@ -74,6 +74,14 @@ namespace ardb
 			{
 				ctx.SendUpstream(e);
 			}
+			/*
+			 * Fired once all messages decoded from one socket read were received.
+			 */
+			virtual void ChannelReadComplete(ChannelHandlerContext& ctx,
+					ChannelStateEvent& e)
+			{
+				ctx.SendUpstream(e);
+			}
 			virtual void MessageReceived(ChannelHandlerContext& ctx,
 					MessageEvent<T>& e) = 0;
 			bool CanHandleUpstream()
@@ -111,6 +119,11 @@ namespace ardb
 						ChannelWritable(ctx, e);
 						break;
 					}
+					case READ_COMPLETE:
+					{
+						ChannelReadComplete(ctx, e);
+						break;
+					}
 					default:
 					{
 						ctx.SendUpstream(e);
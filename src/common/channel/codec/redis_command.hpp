@@ -32,6 +32,7 @@
 
 #include <deque>
 #include <string>
+#include "resp_scanner.hpp"
 
 namespace ardb
 {
@@ -216,6 +217,10 @@ namespace ardb
             REDIS_CMD_SREPLACE = 176,
 
             REDIS_CMD_CLUSTER = 177,  //used in cluster mode
+
+            REDIS_CMD_SMISMEMBER = 178,
+            REDIS_CMD_UNLINK = 179,
+            REDIS_CMD_LATENCY = 180,
         };
 
         class RedisCommandDecoder;
@@ -224,8 +229,16 @@ namespace ardb
         {
             private:
                 RedisCommandType type;
+                /*
+                 * Index of the resolved handler in server's command table, -1 until the command is looked up
+                 */
+                int32 m_cmd_id;
                 bool m_is_inline;
                 bool m_cmd_seted;
+                /*
+                 * Epoch micros when the frame was decoded, 0 for commands built by the server itself
+                 */
+                uint64 m_recv_micros;
                 std::string m_cmd;
                 ArgumentArray m_args;
                 /*
@@ -246,14 +259,32 @@ namespace ardb
                         m_cmd_seted = true;
                     }
                 }
+                /*
+                 * Takes ownership of a fully validated frame in one pass; the first slice
+                 * is the command name.
+                 */
+                inline void FillArguments(const RedisArgumentSlice* slices, size_t count)
+                {
+                    if (0 == count)
+                    {
+                        return;
+                    }
+                    m_cmd.assign(slices[0].data, slices[0].size);
+                    m_cmd_seted = true;
+                    m_args.resize(count - 1);
+                    for (size_t i = 1; i < count; i++)
+                    {
+                        m_args[i - 1].assign(slices[i].data, slices[i].size);
+                    }
+                }
                 friend class RedisCommandDecoder;
             public:
                 RedisCommandFrame(const std::string& cmd = "") :
-                        type(REDIS_CMD_INVALID), m_is_inline(false), m_cmd_seted(false), m_cmd(cmd), m_raw_data_size(0)
+                        type(REDIS_CMD_INVALID), m_cmd_id(-1), m_is_inline(false), m_cmd_seted(false), m_recv_micros(0), m_cmd(cmd), m_raw_data_size(0)
                 {
                 }
                 RedisCommandFrame(ArgumentArray& cmd) :
-                        type(REDIS_CMD_INVALID), m_is_inline(false), m_cmd_seted(false), m_raw_data_size(0)
+                        type(REDIS_CMD_INVALID), m_cmd_id(-1), m_is_inline(false), m_cmd_seted(false), m_recv_micros(0), m_raw_data_size(0)
                 {
                     m_cmd = cmd.front();
                     cmd.pop_front();
@@ -299,6 +330,7 @@ namespace ardb
                     }
                     m_cmd = m_args.front();
                     m_args.pop_front();
+                    m_cmd_id = -1;
                 }
 
                 inline uint32 GetRawDataSize()
@@ -313,6 +345,22 @@ namespace ardb
                 {
                     return this->type;
                 }
+                inline void SetCommandId(int32 id)
+                {
+                    m_cmd_id = id;
+                }
+                inline int32 GetCommandId() const
+                {
+                    return m_cmd_id;
+                }
+                inline void SetRecvTime(uint64 micros)
+                {
+                    m_recv_micros = micros;
+                }
+                inline uint64 GetRecvTime() const
+                {
+                    return m_recv_micros;
+                }
                 bool IsInLine() const
                 {
                     return m_is_inline;
@@ -340,6 +388,7 @@ namespace ardb
                 void SetCommand(const std::string& cmd)
                 {
                     m_cmd = cmd;
+                    m_cmd_id = -1;
                 }
                 const std::string* GetArgument(uint32 index) const
                 {
@@ -365,6 +414,8 @@ namespace ardb
                 }
                 void Clear()
                 {
+                    m_cmd_id = -1;
+                    m_recv_micros = 0;
                     m_cmd_seted = false;
                     m_cmd.clear();
                     m_args.clear();
@@ -31,8 +31,10 @@
 #include "channel/all_includes.hpp"
 #include "redis_command_codec.hpp"
 #include "util/exception/api_exception.hpp"
+#include "util/time_helper.hpp"
 
 #include <limits.h>
+#include <vector>
 
 using ardb::BufferHelper;
 using namespace ardb::codec;
@@ -41,15 +43,15 @@ using namespace ardb;
 /* Client request types */
 static const uint32 REDIS_REQ_INLINE = 1;
 static const uint32 REDIS_REQ_MULTIBULK = 2;
-static const char* kCRLF = "\r\n";
 
 int RedisCommandDecoder::ProcessInlineBuffer(Buffer& buffer, RedisCommandFrame& frame)
 {
-    int index = buffer.IndexOf(kCRLF, 2);
+    int index = resp_find_crlf(buffer.GetRawReadBuffer(), buffer.ReadableBytes());
     if (-1 == index)
     {
         return 0;
     }
+    index += buffer.GetReadIndex();
     while (true)
     {
         char ch;
@@ -85,95 +87,99 @@ int RedisCommandDecoder::ProcessInlineBuffer(Buffer& buffer, RedisCommandFrame&
     return 1;
 }
 
+static void fire_protocol_error(Channel* channel, const char* msg)
+{
+    if (NULL != channel)
+    {
+        APIException ex(msg);
+        fire_exception_caught(channel, ex);
+    }
+}
+
+/*
+ * The whole request is scanned and validated before anything is copied, so a frame
+ * split across several reads costs only a rescan of its headers instead of
+ * allocating every argument and throwing them away again.
+ */
 int RedisCommandDecoder::ProcessMultibulkBuffer(Channel* channel, Buffer& buffer, RedisCommandFrame& frame)
 {
-    int index = buffer.IndexOf(kCRLF, 2);
-    if (-1 == index)
+    const char* start = buffer.GetRawReadBuffer();
+    const char* end = start + buffer.ReadableBytes();
+    const char* cursor = start;
+    int line = resp_find_crlf(cursor, end - cursor);
+    if (-1 == line)
     {
         return 0;
     }
-    char *eptr = NULL;
-    const char* raw = buffer.GetRawReadBuffer();
-    int32 multibulklen = strtol(raw, &eptr, 10);
+    int64 multibulklen = 0;
+    resp_parse_int(cursor, line, multibulklen);
+    cursor += line + 2;
     if (multibulklen <= 0)
     {
-        buffer.SetReadIndex(index + 2);
+        buffer.AdvanceReadIndex(cursor - start);
         return 1;
     }
     else if (multibulklen > 512 * 1024 * 1024)
     {
-        if(NULL != channel)
-        {
-            APIException ex("Protocol error: invalid multibulk length");
-            fire_exception_caught(channel, ex);
-        }
+        fire_protocol_error(channel, "Protocol error: invalid multibulk length");
         return -1;
     }
-    buffer.SetReadIndex(index + 2);
-    while (multibulklen > 0)
+
+    RedisArgumentSlice inline_slices[16];
+    std::vector<RedisArgumentSlice> heap_slices;
+    RedisArgumentSlice* slices = inline_slices;
+    if (multibulklen > 16)
     {
-        int newline_index = buffer.IndexOf(kCRLF, 2);
-        if (-1 == newline_index)
-        {
-            return 0;
-        }
-        char ch;
-        if (!buffer.ReadByte(ch))
+        heap_slices.resize(multibulklen > 1024 ? 1024 : multibulklen);
+        slices = &heap_slices[0];
+    }
+    int64 count = 0;
+    while (count < multibulklen)
+    {
+        if (cursor >= end)
         {
             return 0;
         }
-        if (ch != '$')
+        if (*cursor != '$')
         {
-            if(NULL != channel)
-            {
-                char temp[100];
-                sprintf(temp, "Protocol error: expected '$', , got '%c'", ch);
-                APIException ex(temp);
-                fire_exception_caught(channel, ex);
-            }
+            char temp[100];
+            sprintf(temp, "Protocol error: expected '$', got '%c'", *cursor);
+            fire_protocol_error(channel, temp);
             return -1;
         }
-        if (!buffer.Readable())
+        cursor++;
+        line = resp_find_crlf(cursor, end - cursor);
+        if (-1 == line)
         {
             return 0;
         }
-        const char* raw = buffer.GetRawReadBuffer();
-        int32 arglen = (uint32) strtol(raw, &eptr, 10);
-        if (eptr[0] != '\r' || arglen < 0 || arglen > 512 * 1024 * 1024)
+        int64 arglen = 0;
+        if (line == 0 || resp_parse_int(cursor, line, arglen) != (size_t) line || arglen < 0
+                || arglen > 512 * 1024 * 1024)
         {
-            if(NULL != channel)
-            {
-                APIException ex("Protocol error: invalid bulk length");
-                fire_exception_caught(channel, ex);
-            }
+            fire_protocol_error(channel, "Protocol error: invalid bulk length");
             return -1;
         }
-        buffer.SetReadIndex(newline_index + 2);
-        if (!buffer.Readable())
+        cursor += line + 2;
+        if ((uint64) (end - cursor) < (uint64) arglen + 2)
         {
             return 0;
         }
-        if (buffer.ReadableBytes() < (uint32) (arglen + 2))
+        if (cursor[arglen] != '\r' || cursor[arglen + 1] != '\n')
         {
-            return 0;
+            fire_protocol_error(channel, "CRLF expected after argument.");
+            return -1;
         }
-        frame.FillNextArgument(buffer, arglen);
-        //Buffer* arg = frame.GetNextArgument(arglen);
-        //buffer.Read(arg, arglen);
-        char tempchs[2];
-        buffer.Read(tempchs, 2);
-        if (tempchs[0] != '\r' || tempchs[1] != '\n')
+        if (slices != inline_slices && (size_t) count == heap_slices.size())
         {
-            if(NULL != channel)
-            {
-                APIException ex("CRLF expected after argument.");
-                fire_exception_caught(channel, ex);
-            }
-            return -1;
+            heap_slices.resize(heap_slices.size() * 2);
+            slices = &heap_slices[0];
         }
-        //buffer.AdvanceReadIndex(arglen + 2);
-        multibulklen--;
+        slices[count++] = RedisArgumentSlice(cursor, (uint32) arglen);
+        cursor += arglen + 2;
     }
+    frame.FillArguments(slices, count);
+    buffer.AdvanceReadIndex(cursor - start);
     return 1;
 }
 
@@ -204,6 +210,7 @@ bool RedisCommandDecoder::Decode(Channel* channel,Buffer& buffer, RedisCommandFr
         if (ret > 0)
         {
             msg.m_raw_data_size = buffer.GetReadIndex() - mark_read_index;
+            msg.m_recv_micros = get_current_epoch_micros();
             return true;
         }
         else
@@ -112,6 +112,44 @@ bool RedisReplyEncoder::Encode(Buffer& buf, RedisReply& reply)
     return true;
 }
 
+bool RedisReplyEncoder::Encode(GatherBuffer& buf, RedisReply& reply)
+{
+    switch (reply.type)
+    {
+        case REDIS_REPLY_STRING:
+        {
+            buf.Head().Printf("$%d\r\n", reply.str.size());
+            buf.Reference(reply.str.data(), reply.str.size());
+            buf.Head().Printf("\r\n");
+            break;
+        }
+        case REDIS_REPLY_ARRAY:
+        {
+            if (NULL == reply.elements)
+            {
+                buf.Head().Printf("*0\r\n");
+                break;
+            }
+            buf.Head().Printf("*%d\r\n", reply.elements->size());
+            std::deque<RedisReply*>::iterator it = reply.elements->begin();
+            while (it != reply.elements->end())
+            {
+                if (!RedisReplyEncoder::Encode(buf, *(*it)))
+                {
+                    return false;
+                }
+                it++;
+            }
+            break;
+        }
+        default:
+        {
+            return RedisReplyEncoder::Encode(buf.Head(), reply);
+        }
+    }
+    return true;
+}
+
 bool RedisReplyEncoder::WriteRequested(ChannelHandlerContext& ctx, MessageEvent<RedisReply>& e)
 {
     RedisReply* msg = e.GetMessage();
@@ -63,10 +63,15 @@ namespace ardb
 		class RedisReplyEncoder: public ChannelDownstreamHandler<RedisReply>
 		{
 			private:
-		        Buffer m_buffer;
+				GatherBuffer m_buffer;
 				bool WriteRequested(ChannelHandlerContext& ctx, MessageEvent<RedisReply>& e);
 			public:
 				static bool Encode(Buffer& buf, RedisReply& reply);
+				/*
+				 * Bulk bodies are referenced instead of copied, so 'buf' is only
+				 * valid while 'reply' is alive and unchanged.
+				 */
+				static bool Encode(GatherBuffer& buf, RedisReply& reply);
 		};
 
 		class NullRedisReplyEncoder: public ChannelDownstreamHandler<RedisReply>
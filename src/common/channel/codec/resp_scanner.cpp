@@ -0,0 +1,152 @@
+/*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "resp_scanner.hpp"
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define ARDB_RESP_X86 1
+#endif
+
+namespace ardb
+{
+    namespace codec
+    {
+        typedef int FindCRLFFunc(const char* p, size_t len);
+
+        /*
+         * Checks the '\r' bytes flagged in 'mask' for the block at 'i', returns the crlf
+         * offset, -1 if the input ends right after a '\r', or -2 to keep scanning.
+         */
+        static inline int check_cr_mask(const char* p, size_t len, size_t i, uint32 mask)
+        {
+            while (mask != 0)
+            {
+                size_t pos = i + __builtin_ctz(mask);
+                if (pos + 1 >= len)
+                {
+                    return -1;
+                }
+                if (p[pos + 1] == '\n')
+                {
+                    return (int) pos;
+                }
+                mask &= mask - 1;
+            }
+            return -2;
+        }
+
+        static inline int find_crlf_tail(const char* p, size_t len, size_t i)
+        {
+#if defined(__SSE2__)
+            const __m128i cr16 = _mm_set1_epi8('\r');
+            for (; i + 16 <= len; i += 16)
+            {
+                uint32 mask = (uint32) _mm_movemask_epi8(
+                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (p + i)), cr16));
+                int found = check_cr_mask(p, len, i, mask);
+                if (found != -2)
+                {
+                    return found;
+                }
+            }
+#endif
+            while (i < len)
+            {
+                const char* cr = (const char*) memchr(p + i, '\r', len - i);
+                if (NULL == cr)
+                {
+                    return -1;
+                }
+                size_t pos = cr - p;
+                if (pos + 1 >= len)
+                {
+                    return -1;
+                }
+                if (p[pos + 1] == '\n')
+                {
+                    return (int) pos;
+                }
+                i = pos + 1;
+            }
+            return -1;
+        }
+
+        static int find_crlf_generic(const char* p, size_t len)
+        {
+            return find_crlf_tail(p, len, 0);
+        }
+
+#ifdef ARDB_RESP_X86
+        __attribute__((target("avx2")))
+        static int find_crlf_avx2(const char* p, size_t len)
+        {
+            size_t i = 0;
+            const __m256i cr32 = _mm256_set1_epi8('\r');
+            for (; i + 32 <= len; i += 32)
+            {
+                uint32 mask = (uint32) _mm256_movemask_epi8(
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (p + i)), cr32));
+                int found = check_cr_mask(p, len, i, mask);
+                if (found != -2)
+                {
+                    return found;
+                }
+            }
+            return find_crlf_tail(p, len, i);
+        }
+#endif
+
+        struct CRLFScanner
+        {
+                FindCRLFFunc* find;
+                CRLFScanner() :
+                        find(find_crlf_generic)
+                {
+#ifdef ARDB_RESP_X86
+                    __builtin_cpu_init();
+                    if (__builtin_cpu_supports("avx2"))
+                    {
+                        find = find_crlf_avx2;
+                    }
+#endif
+                }
+        };
+
+        static CRLFScanner& get_crlf_scanner()
+        {
+            static CRLFScanner scanner;
+            return scanner;
+        }
+
+        int resp_find_crlf(const char* p, size_t len)
+        {
+            return get_crlf_scanner().find(p, len);
+        }
+    }
+}
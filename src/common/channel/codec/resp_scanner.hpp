@@ -0,0 +1,98 @@
+/*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RESP_SCANNER_HPP_
+#define RESP_SCANNER_HPP_
+
+#include "common.hpp"
+#include <string.h>
+
+namespace ardb
+{
+    namespace codec
+    {
+        /*
+         * Returns the offset of the first "\r\n" in [p, p + len), or -1 if there is none.
+         * Candidate '\r' bytes are located 32(AVX2) or 16(SSE2) bytes at a time, the AVX2
+         * kernel is picked at startup by the running CPU. The tail and non x86 builds fall
+         * back to memchr.
+         */
+        int resp_find_crlf(const char* p, size_t len);
+
+        /*
+         * Parses the decimal integer at the head of [p, p + len) the way strtol would,
+         * but without locale lookups or errno. Returns the number of bytes consumed,
+         * 0 if there are no digits; values longer than 18 digits are rejected.
+         */
+        inline size_t resp_parse_int(const char* p, size_t len, int64& value)
+        {
+            size_t i = 0;
+            bool negative = false;
+            if (len > 0 && (p[0] == '-' || p[0] == '+'))
+            {
+                negative = p[0] == '-';
+                i++;
+            }
+            size_t digits_start = i;
+            int64 v = 0;
+            while (i < len && p[i] >= '0' && p[i] <= '9')
+            {
+                if (i - digits_start >= 18)
+                {
+                    return 0;
+                }
+                v = v * 10 + (p[i] - '0');
+                i++;
+            }
+            if (i == digits_start)
+            {
+                return 0;
+            }
+            value = negative ? -v : v;
+            return i;
+        }
+
+        /*
+         * A view of one argument inside the decoder's input buffer. It is only valid
+         * until the buffer is advanced, so the decoder turns slices into owned strings
+         * once a whole frame has been validated.
+         */
+        struct RedisArgumentSlice
+        {
+                const char* data;
+                uint32 size;
+                RedisArgumentSlice(const char* d = NULL, uint32 s = 0) :
+                        data(d), size(s)
+                {
+                }
+        };
+    }
+}
+
+#endif /* RESP_SCANNER_HPP_ */
@@ -0,0 +1,128 @@
+/*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARENA_HPP_
+#define ARENA_HPP_
+#include "common.hpp"
+#include <stdlib.h>
+#include <vector>
+namespace ardb
+{
+    /*
+     * Bump allocator for request scoped objects, everything allocated is released at once by Reset().
+     * Allocate returns NULL once 'max_size' bytes are in use so callers can fall back to the heap,
+     * a connection running one huge request does not keep its peak memory after Reset().
+     */
+    class Arena
+    {
+        private:
+            std::vector<char*> m_blocks;
+            char* m_ptr;
+            size_t m_remaining;
+            size_t m_block_size;
+            size_t m_max_size;
+            size_t m_usage;
+            char* NewBlock(size_t size)
+            {
+                char* block = (char*) malloc(size);
+                m_blocks.push_back(block);
+                m_usage += size;
+                return block;
+            }
+            Arena(const Arena&);
+            Arena& operator=(const Arena&);
+        public:
+            Arena(size_t block_size = 4096, size_t max_size = 1024 * 1024) :
+                    m_ptr(NULL), m_remaining(0), m_block_size(block_size), m_max_size(max_size), m_usage(0)
+            {
+            }
+            void* Allocate(size_t bytes)
+            {
+                bytes = (bytes + 7) & ~((size_t) 7);
+                if (m_blocks.empty())
+                {
+                    /* the first block is always a regular one, it is the block Reset() keeps */
+                    m_ptr = NewBlock(m_block_size);
+                    m_remaining = m_block_size;
+                }
+                if (bytes <= m_remaining)
+                {
+                    char* p = m_ptr;
+                    m_ptr += bytes;
+                    m_remaining -= bytes;
+                    return p;
+                }
+                if (m_max_size > 0 && m_usage + (bytes > m_block_size ? bytes : m_block_size) > m_max_size)
+                {
+                    return NULL;
+                }
+                if (bytes > m_block_size / 4)
+                {
+                    /* large object gets its own block, the current block keeps serving small ones */
+                    return NewBlock(bytes);
+                }
+                m_ptr = NewBlock(m_block_size);
+                m_remaining = m_block_size - bytes;
+                char* p = m_ptr;
+                m_ptr += bytes;
+                return p;
+            }
+            /*
+             * Frees all blocks except the first one, which is kept for the next request.
+             */
+            void Reset()
+            {
+                if (m_blocks.empty())
+                {
+                    return;
+                }
+                for (size_t i = 1; i < m_blocks.size(); i++)
+                {
+                    free(m_blocks[i]);
+                }
+                m_blocks.resize(1);
+                m_usage = m_block_size;
+                m_ptr = m_blocks[0];
+                m_remaining = m_block_size;
+            }
+            size_t MemoryUsage() const
+            {
+                return m_usage;
+            }
+            ~Arena()
+            {
+                for (size_t i = 0; i < m_blocks.size(); i++)
+                {
+                    free(m_blocks[i]);
+                }
+            }
+    };
+}
+
+#endif /* ARENA_HPP_ */
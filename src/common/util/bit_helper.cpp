@@ -0,0 +1,290 @@
+ /*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/bit_helper.hpp"
+#include <string.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define ARDB_BITS_X86 1
+#if defined(__clang__) || __GNUC__ >= 8
+#define ARDB_BITS_AVX512 1
+#endif
+#endif
+
+namespace ardb
+{
+    typedef uint64 BitsCombineFunc(uint32 op, uint8* dst, const uint8* const * srcs, uint32 num, size_t len);
+
+    static inline uint8 combine_byte(uint32 op, const uint8* const * srcs, uint32 num, size_t i)
+    {
+        uint8 acc = srcs[0][i];
+        if (op == BITOP_NOT)
+        {
+            return ~acc;
+        }
+        for (uint32 k = 1; k < num; k++)
+        {
+            switch (op)
+            {
+                case BITOP_AND:
+                    acc &= srcs[k][i];
+                    break;
+                case BITOP_OR:
+                    acc |= srcs[k][i];
+                    break;
+                default:
+                    acc ^= srcs[k][i];
+                    break;
+            }
+        }
+        return acc;
+    }
+
+    /*
+     * Bytes left after the vector loops.
+     */
+    static uint64 combine_tail(uint32 op, uint8* dst, const uint8* const * srcs, uint32 num, size_t from, size_t len)
+    {
+        uint64 bits = 0;
+        for (size_t i = from; i < len; i++)
+        {
+            uint8 acc = combine_byte(op, srcs, num, i);
+            if (NULL != dst)
+            {
+                dst[i] = acc;
+            }
+            bits += __builtin_popcount(acc);
+        }
+        return bits;
+    }
+
+    static inline __attribute__((always_inline)) uint64 combine_words(uint32 op, uint8* dst,
+            const uint8* const * srcs, uint32 num, size_t len)
+    {
+        uint64 bits = 0;
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8)
+        {
+            uint64 acc, v;
+            memcpy(&acc, srcs[0] + i, 8);
+            if (op == BITOP_NOT)
+            {
+                acc = ~acc;
+            }
+            for (uint32 k = 1; k < num; k++)
+            {
+                memcpy(&v, srcs[k] + i, 8);
+                switch (op)
+                {
+                    case BITOP_AND:
+                        acc &= v;
+                        break;
+                    case BITOP_OR:
+                        acc |= v;
+                        break;
+                    default:
+                        acc ^= v;
+                        break;
+                }
+            }
+            if (NULL != dst)
+            {
+                memcpy(dst + i, &acc, 8);
+            }
+            bits += __builtin_popcountll(acc);
+        }
+        return bits + combine_tail(op, dst, srcs, num, i, len);
+    }
+
+    static uint64 combine_generic(uint32 op, uint8* dst, const uint8* const * srcs, uint32 num, size_t len)
+    {
+        return combine_words(op, dst, srcs, num, len);
+    }
+
+#ifdef ARDB_BITS_X86
+    __attribute__((target("popcnt")))
+    static uint64 combine_popcnt(uint32 op, uint8* dst, const uint8* const * srcs, uint32 num, size_t len)
+    {
+        return combine_words(op, dst, srcs, num, len);
+    }
+
+    __attribute__((target("avx2")))
+    static uint64 combine_avx2(uint32 op, uint8* dst, const uint8* const * srcs, uint32 num, size_t len)
+    {
+        /*
+         * Popcount by nibble lookups, byte counts are summed into 64bit lanes by _mm256_sad_epu8.
+         */
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3,
+                1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_mask = _mm256_set1_epi8(0x0f);
+        const __m256i ones = _mm256_set1_epi8(-1);
+        __m256i total = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32)
+        {
+            __m256i acc = _mm256_loadu_si256((const __m256i*) (srcs[0] + i));
+            if (op == BITOP_NOT)
+            {
+                acc = _mm256_xor_si256(acc, ones);
+            }
+            for (uint32 k = 1; k < num; k++)
+            {
+                __m256i v = _mm256_loadu_si256((const __m256i*) (srcs[k] + i));
+                switch (op)
+                {
+                    case BITOP_AND:
+                        acc = _mm256_and_si256(acc, v);
+                        break;
+                    case BITOP_OR:
+                        acc = _mm256_or_si256(acc, v);
+                        break;
+                    default:
+                        acc = _mm256_xor_si256(acc, v);
+                        break;
+                }
+            }
+            if (NULL != dst)
+            {
+                _mm256_storeu_si256((__m256i*) (dst + i), acc);
+            }
+            __m256i lo = _mm256_and_si256(acc, low_mask);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(acc, 4), low_mask);
+            __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+        }
+        uint64 lanes[4];
+        _mm256_storeu_si256((__m256i*) lanes, total);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + combine_tail(op, dst, srcs, num, i, len);
+    }
+#endif
+
+#ifdef ARDB_BITS_AVX512
+    __attribute__((target("avx512f,avx512vpopcntdq")))
+    static uint64 combine_avx512(uint32 op, uint8* dst, const uint8* const * srcs, uint32 num, size_t len)
+    {
+        const __m512i ones = _mm512_set1_epi64(-1);
+        __m512i total = _mm512_setzero_si512();
+        size_t i = 0;
+        for (; i + 64 <= len; i += 64)
+        {
+            __m512i acc = _mm512_loadu_si512((const void*) (srcs[0] + i));
+            if (op == BITOP_NOT)
+            {
+                acc = _mm512_xor_si512(acc, ones);
+            }
+            for (uint32 k = 1; k < num; k++)
+            {
+                __m512i v = _mm512_loadu_si512((const void*) (srcs[k] + i));
+                switch (op)
+                {
+                    case BITOP_AND:
+                        acc = _mm512_and_si512(acc, v);
+                        break;
+                    case BITOP_OR:
+                        acc = _mm512_or_si512(acc, v);
+                        break;
+                    default:
+                        acc = _mm512_xor_si512(acc, v);
+                        break;
+                }
+            }
+            if (NULL != dst)
+            {
+                _mm512_storeu_si512((void*) (dst + i), acc);
+            }
+            total = _mm512_add_epi64(total, _mm512_popcnt_epi64(acc));
+        }
+        uint64 lanes[8];
+        _mm512_storeu_si512((void*) lanes, total);
+        uint64 count = 0;
+        for (int k = 0; k < 8; k++)
+        {
+            count += lanes[k];
+        }
+        return count + combine_tail(op, dst, srcs, num, i, len);
+    }
+#endif
+
+    struct BitsKernel
+    {
+            BitsCombineFunc* combine;
+            const char* name;
+            BitsKernel() :
+                    combine(combine_generic), name("generic")
+            {
+#ifdef ARDB_BITS_X86
+                __builtin_cpu_init();
+#ifdef ARDB_BITS_AVX512
+                if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+                {
+                    combine = combine_avx512;
+                    name = "avx512";
+                    return;
+                }
+#endif
+                if (__builtin_cpu_supports("avx2"))
+                {
+                    combine = combine_avx2;
+                    name = "avx2";
+                }
+                else if (__builtin_cpu_supports("popcnt"))
+                {
+                    combine = combine_popcnt;
+                    name = "popcnt";
+                }
+#endif
+            }
+    };
+
+    static BitsKernel& get_bits_kernel()
+    {
+        static BitsKernel kernel;
+        return kernel;
+    }
+
+    uint64 bits_combine(uint32 op, void* dst, const void* const * srcs, uint32 num, size_t len)
+    {
+        if (0 == num || 0 == len)
+        {
+            return 0;
+        }
+        return get_bits_kernel().combine(op, (uint8*) dst, (const uint8* const *) srcs, num, len);
+    }
+
+    uint64 bits_popcount(const void* s, size_t len)
+    {
+        return bits_combine(BITOP_OR, NULL, &s, 1, len);
+    }
+
+    const char* bits_kernel_name()
+    {
+        return get_bits_kernel().name;
+    }
+}
+
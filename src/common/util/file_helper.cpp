@@ -180,6 +180,44 @@ namespace ardb
         return 0;
     }
 
+    int copy_file(const std::string& src, const std::string& dest)
+    {
+        int in = open(src.c_str(), O_RDONLY);
+        if (in < 0)
+        {
+            return -1;
+        }
+        int out = open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0)
+        {
+            close(in);
+            return -1;
+        }
+        char buf[65536];
+        int ret = 0;
+        while (true)
+        {
+            ssize_t n = read(in, buf, sizeof(buf));
+            if (n <= 0)
+            {
+                ret = n < 0 ? -1 : 0;
+                break;
+            }
+            if (write(out, buf, n) != n)
+            {
+                ret = -1;
+                break;
+            }
+        }
+        if (0 == ret && 0 != fsync(out))
+        {
+            ret = -1;
+        }
+        close(in);
+        close(out);
+        return ret;
+    }
+
     int file_read_full(const std::string& path, Buffer& content)
     {
         FILE *fp;
@@ -47,6 +47,7 @@ namespace ardb
 
     int file_read_full(const std::string& path, Buffer& content);
     int file_write_content(const std::string& path, const std::string& content);
+    int copy_file(const std::string& src, const std::string& dest);
 
     int list_subdirs(const std::string& path, std::deque<std::string>& dirs);
     int list_subfiles(const std::string& path, std::deque<std::string>& fs);
@@ -0,0 +1,224 @@
+/*
+ *Copyright (c) 2013-2014, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LATENCY_HISTOGRAM_HPP_
+#define LATENCY_HISTOGRAM_HPP_
+#include "common.hpp"
+#include "util/atomic.hpp"
+#include "util/string_helper.hpp"
+#include <string.h>
+namespace ardb
+{
+    /*
+     * Lock free log-linear (HDR style) latency histogram. Latencies under 16us get a bucket per microsecond, above
+     * that every power of 2 range is split into 8 linear sub-buckets, so the bucket a latency falls in is never wider
+     * than 12.5% of it. Percentiles are reported as the upper bound of their bucket, capped by the max latency.
+     */
+    class LatencyHistogram
+    {
+        public:
+            static const uint32 kSubBucketBits = 3;
+            static const uint32 kSubBuckets = 1 << kSubBucketBits;
+            static const uint32 kLinearBuckets = kSubBuckets << 1;
+            static const uint32 kMaxBits = 39;
+            static const uint32 kBuckets = kLinearBuckets + (kMaxBits - kSubBucketBits) * kSubBuckets;
+        private:
+            volatile uint64 m_buckets[kBuckets];
+            volatile uint64 m_count;
+            volatile uint64 m_total;
+            volatile uint64 m_max;
+        public:
+            LatencyHistogram()
+            {
+                Clear();
+            }
+            static uint32 BucketIndex(uint64 micros)
+            {
+                if (micros < kLinearBuckets)
+                {
+                    return (uint32) micros;
+                }
+                uint32 msb = 63 - __builtin_clzll(micros);
+                if (msb > kMaxBits)
+                {
+                    return kBuckets - 1;
+                }
+                uint32 sub = (micros >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+                return kLinearBuckets + (msb - kSubBucketBits - 1) * kSubBuckets + sub;
+            }
+            /*
+             * The largest latency counted in bucket 'idx'.
+             */
+            static uint64 BucketUpperBound(uint32 idx)
+            {
+                if (idx < kLinearBuckets)
+                {
+                    return idx;
+                }
+                uint32 shift = (idx - kLinearBuckets) / kSubBuckets + 1;
+                uint64 lower = (uint64) (kSubBuckets + (idx - kLinearBuckets) % kSubBuckets) << shift;
+                return lower + (1ULL << shift) - 1;
+            }
+            void Add(uint64 micros)
+            {
+                atomic_add_uint64(&m_buckets[BucketIndex(micros)], 1);
+                atomic_add_uint64(&m_count, 1);
+                atomic_add_uint64(&m_total, micros);
+                uint64 max = m_max;
+                while (micros > max && !atomic_cmp_set_uint64(&m_max, max, micros))
+                {
+                    max = m_max;
+                }
+            }
+            /*
+             * Same as Add() for a histogram only written by the calling thread, without atomic operations.
+             */
+            void AddSingleThread(uint64 micros)
+            {
+                m_buckets[BucketIndex(micros)]++;
+                m_count++;
+                m_total += micros;
+                if (micros > m_max)
+                {
+                    m_max = micros;
+                }
+            }
+            /*
+             * Adds the counts of 'other' into this histogram.
+             */
+            void Merge(const LatencyHistogram& other)
+            {
+                for (uint32 i = 0; i < kBuckets; i++)
+                {
+                    m_buckets[i] += other.m_buckets[i];
+                }
+                m_count += other.m_count;
+                m_total += other.m_total;
+                if (other.m_max > m_max)
+                {
+                    m_max = other.m_max;
+                }
+            }
+            uint64 Count() const
+            {
+                return m_count;
+            }
+            uint64 Max() const
+            {
+                return m_max;
+            }
+            uint64 Average() const
+            {
+                return m_count == 0 ? 0 : m_total / m_count;
+            }
+            uint64 BucketCount(uint32 idx) const
+            {
+                return idx < kBuckets ? m_buckets[idx] : 0;
+            }
+            /*
+             * 'percentile' in (0, 100], returns 0 if nothing was recorded.
+             */
+            uint64 Percentile(double percentile) const
+            {
+                uint64 total = 0;
+                for (uint32 i = 0; i < kBuckets; i++)
+                {
+                    total += m_buckets[i];
+                }
+                if (total == 0)
+                {
+                    return 0;
+                }
+                uint64 rank = (uint64) (total * percentile / 100);
+                if (rank == 0)
+                {
+                    rank = 1;
+                }
+                uint64 seen = 0;
+                for (uint32 i = 0; i < kBuckets; i++)
+                {
+                    seen += m_buckets[i];
+                    if (seen >= rank)
+                    {
+                        uint64 upper = BucketUpperBound(i);
+                        return upper < m_max ? upper : m_max;
+                    }
+                }
+                return m_max;
+            }
+            void Clear()
+            {
+                memset((void*) m_buckets, 0, sizeof(m_buckets));
+                m_count = 0;
+                m_total = 0;
+                m_max = 0;
+            }
+            /*
+             * Appends '<name>_count', '<name>_avg_usec', percentiles & max in INFO format.
+             */
+            const std::string& PrintStat(const std::string& name, std::string& str) const
+            {
+                str.append(name).append("_count:").append(stringfromll(m_count)).append("\r\n");
+                str.append(name).append("_avg_usec:").append(stringfromll(Average())).append("\r\n");
+                str.append(name).append("_p50_usec:").append(stringfromll(Percentile(50))).append("\r\n");
+                str.append(name).append("_p99_usec:").append(stringfromll(Percentile(99))).append("\r\n");
+                str.append(name).append("_p999_usec:").append(stringfromll(Percentile(99.9))).append("\r\n");
+                str.append(name).append("_max_usec:").append(stringfromll(m_max)).append("\r\n");
+                return str;
+            }
+            /*
+             * Appends the histogram as a JSON object, 'buckets' lists [upper bound, count] of non empty buckets.
+             */
+            const std::string& PrintJson(std::string& str) const
+            {
+                str.append("{\"count\":").append(stringfromll(m_count));
+                str.append(",\"avg_usec\":").append(stringfromll(Average()));
+                str.append(",\"p50_usec\":").append(stringfromll(Percentile(50)));
+                str.append(",\"p99_usec\":").append(stringfromll(Percentile(99)));
+                str.append(",\"p999_usec\":").append(stringfromll(Percentile(99.9)));
+                str.append(",\"max_usec\":").append(stringfromll(m_max));
+                str.append(",\"buckets\":[");
+                bool first = true;
+                for (uint32 i = 0; i < kBuckets; i++)
+                {
+                    if (m_buckets[i] == 0)
+                    {
+                        continue;
+                    }
+                    str.append(first ? "[" : ",[").append(stringfromll(BucketUpperBound(i))).append(",").append(
+                            stringfromll(m_buckets[i])).append("]");
+                    first = false;
+                }
+                str.append("]}");
+                return str;
+            }
+    };
+}
+
+#endif /* LATENCY_HISTOGRAM_HPP_ */
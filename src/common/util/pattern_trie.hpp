@@ -0,0 +1,277 @@
+/*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PATTERN_TRIE_HPP_
+#define PATTERN_TRIE_HPP_
+#include "common.hpp"
+#include "string_helper.hpp"
+#include <string>
+#include <map>
+namespace ardb
+{
+    /*
+     * Glob patterns indexed by their literal prefix(the part before the first '*', '?', '[' or '\') in a
+     * radix tree. Matching a string walks the tree along the string once, and only the patterns hanging on
+     * the visited nodes run the glob matcher against the rest of the string.
+     */
+    template<typename T>
+    class PatternTrie
+    {
+        private:
+            struct Node
+            {
+                    typedef typename TreeMap<char, Node*>::Type ChildTable;
+                    /* std::map keeps the values in place, Insert and Find hand out references to them */
+                    typedef std::map<std::string, T> PatternTable;
+                    std::string label;
+                    ChildTable children;
+                    PatternTable patterns;
+                    ~Node()
+                    {
+                        typename ChildTable::iterator it = children.begin();
+                        while (it != children.end())
+                        {
+                            delete it->second;
+                            it++;
+                        }
+                    }
+            };
+            Node m_root;
+            size_t m_size;
+
+            static size_t LiteralPrefix(const std::string& pattern)
+            {
+                size_t i = 0;
+                while (i < pattern.size() && pattern[i] != '*' && pattern[i] != '?' && pattern[i] != '['
+                        && pattern[i] != '\\')
+                {
+                    i++;
+                }
+                return i;
+            }
+            Node* Locate(const char* prefix, size_t len, bool create)
+            {
+                Node* node = &m_root;
+                size_t i = 0;
+                while (i < len)
+                {
+                    typename Node::ChildTable::iterator it = node->children.find(prefix[i]);
+                    if (it == node->children.end())
+                    {
+                        if (!create)
+                        {
+                            return NULL;
+                        }
+                        Node* leaf = new Node;
+                        leaf->label.assign(prefix + i, len - i);
+                        node->children[prefix[i]] = leaf;
+                        return leaf;
+                    }
+                    Node* child = it->second;
+                    size_t common = 0;
+                    while (common < child->label.size() && i + common < len && child->label[common] == prefix[i + common])
+                    {
+                        common++;
+                    }
+                    if (common < child->label.size())
+                    {
+                        if (!create)
+                        {
+                            return NULL;
+                        }
+                        /* split the edge where the new prefix leaves it */
+                        Node* mid = new Node;
+                        mid->label = child->label.substr(0, common);
+                        child->label.erase(0, common);
+                        mid->children[child->label[0]] = child;
+                        it->second = mid;
+                        child = mid;
+                    }
+                    node = child;
+                    i += common;
+                }
+                return node;
+            }
+            /*
+             * Drops the empty nodes on the path of prefix, and merges a node left with one child into it.
+             */
+            void Prune(Node* node, const char* prefix, size_t len)
+            {
+                if (0 == len)
+                {
+                    return;
+                }
+                typename Node::ChildTable::iterator it = node->children.find(prefix[0]);
+                if (it == node->children.end())
+                {
+                    return;
+                }
+                Node* child = it->second;
+                size_t label_len = child->label.size();
+                if (label_len > len)
+                {
+                    return;
+                }
+                Prune(child, prefix + label_len, len - label_len);
+                if (!child->patterns.empty())
+                {
+                    return;
+                }
+                if (child->children.empty())
+                {
+                    node->children.erase(it);
+                    delete child;
+                }
+                else if (child->children.size() == 1)
+                {
+                    Node* grandchild = child->children.begin()->second;
+                    grandchild->label = child->label + grandchild->label;
+                    child->children.clear();
+                    it->second = grandchild;
+                    delete child;
+                }
+            }
+        public:
+            PatternTrie() :
+                    m_size(0)
+            {
+            }
+            size_t Size() const
+            {
+                return m_size;
+            }
+            bool Empty() const
+            {
+                return 0 == m_size;
+            }
+            /*
+             * Returns the value of pattern, default constructed if the pattern is new.
+             */
+            T& Insert(const std::string& pattern)
+            {
+                Node* node = Locate(pattern.data(), LiteralPrefix(pattern), true);
+                std::pair<typename Node::PatternTable::iterator, bool> ret = node->patterns.insert(
+                        typename Node::PatternTable::value_type(pattern, T()));
+                if (ret.second)
+                {
+                    m_size++;
+                }
+                return ret.first->second;
+            }
+            T* Find(const std::string& pattern)
+            {
+                Node* node = Locate(pattern.data(), LiteralPrefix(pattern), false);
+                if (NULL == node)
+                {
+                    return NULL;
+                }
+                typename Node::PatternTable::iterator it = node->patterns.find(pattern);
+                return it == node->patterns.end() ? NULL : &(it->second);
+            }
+            bool Erase(const std::string& pattern)
+            {
+                size_t prefix_len = LiteralPrefix(pattern);
+                Node* node = Locate(pattern.data(), prefix_len, false);
+                if (NULL == node || 0 == node->patterns.erase(pattern))
+                {
+                    return false;
+                }
+                m_size--;
+                Prune(&m_root, pattern.data(), prefix_len);
+                return true;
+            }
+            /*
+             * Calls visitor(pattern, value) for every pattern matching str.
+             */
+            template<typename V>
+            void Match(const char* str, size_t len, V& visitor)
+            {
+                Node* node = &m_root;
+                size_t depth = 0;
+                while (true)
+                {
+                    typename Node::PatternTable::iterator pit = node->patterns.begin();
+                    while (pit != node->patterns.end())
+                    {
+                        const std::string& pattern = pit->first;
+                        if (stringmatchlen(pattern.data() + depth, pattern.size() - depth, str + depth, len - depth, 0))
+                        {
+                            visitor(pattern, pit->second);
+                        }
+                        pit++;
+                    }
+                    if (depth >= len)
+                    {
+                        break;
+                    }
+                    typename Node::ChildTable::iterator it = node->children.find(str[depth]);
+                    if (it == node->children.end())
+                    {
+                        break;
+                    }
+                    Node* child = it->second;
+                    if (depth + child->label.size() > len
+                            || memcmp(child->label.data(), str + depth, child->label.size()) != 0)
+                    {
+                        break;
+                    }
+                    depth += child->label.size();
+                    node = child;
+                }
+            }
+            /*
+             * Calls visitor(pattern, value) for every pattern.
+             */
+            template<typename V>
+            void Visit(V& visitor)
+            {
+                Visit(&m_root, visitor);
+            }
+        private:
+            template<typename V>
+            void Visit(Node* node, V& visitor)
+            {
+                typename Node::PatternTable::iterator pit = node->patterns.begin();
+                while (pit != node->patterns.end())
+                {
+                    visitor(pit->first, pit->second);
+                    pit++;
+                }
+                typename Node::ChildTable::iterator it = node->children.begin();
+                while (it != node->children.end())
+                {
+                    Visit(it->second, visitor);
+                    it++;
+                }
+            }
+            PatternTrie(const PatternTrie&);
+            PatternTrie& operator=(const PatternTrie&);
+    };
+}
+#endif /* PATTERN_TRIE_HPP_ */
@@ -33,6 +33,58 @@
 
 namespace ardb
 {
+    bool CommonComparator::Bytewise()
+    {
+        return KeyObject::CodecVersion() >= ARDB_CODEC_MEMCMP;
+    }
+
+    size_t CommonComparator::PrefixLength(const char* kbuf, size_t ksiz)
+    {
+        if (ksiz < 4)
+        {
+            return 0;
+        }
+        if (Bytewise())
+        {
+            /* expiration entries start with the deadline after the header */
+            if ((uint8) kbuf[3] == KEY_EXPIRATION_ELEMENT)
+            {
+                return 0;
+            }
+            /* versioned element keys include their version in the prefix */
+            size_t version_size = ((uint8) kbuf[3] != KEY_END && ((uint8) kbuf[3] & KEY_VERSION_FLAG)) ? sizeof(uint32) : 0;
+            for (size_t i = 4; i + 1 < ksiz; i++)
+            {
+                if (kbuf[i] == 0 && kbuf[i + 1] == 1)
+                {
+                    return i + 2 + version_size <= ksiz ? i + 2 + version_size : 0;
+                }
+                if (kbuf[i] == 0)
+                {
+                    i++;
+                }
+            }
+            return 0;
+        }
+        uint32 header;
+        memcpy(&header, kbuf, sizeof(header));
+        if ((header & 0xFF) == KEY_EXPIRATION_ELEMENT)
+        {
+            return 0;
+        }
+        Buffer buf(const_cast<char*>(kbuf), sizeof(header), ksiz);
+        Slice key;
+        if (!BufferHelper::ReadVarSlice(buf, key))
+        {
+            return 0;
+        }
+        if ((header & 0xFF) != KEY_END && (header & KEY_VERSION_FLAG))
+        {
+            return buf.ReadableBytes() >= sizeof(uint32) ? buf.GetReadIndex() + sizeof(uint32) : 0;
+        }
+        return buf.GetReadIndex();
+    }
+
     int CommonComparator::Compare(const char* akbuf, size_t aksiz, const char* bkbuf, size_t bksiz)
     {
         if(aksiz < 4 || bksiz < 4)
@@ -63,10 +115,23 @@ namespace ardb
                 return cmp;
             }
         }
+        if (type != KEY_END && (type & KEY_VERSION_FLAG))
+        {
+            uint32 aversion = 0, bversion = 0;
+            BufferHelper::ReadFixUInt32(abuf, aversion);
+            BufferHelper::ReadFixUInt32(bbuf, bversion);
+            if (aversion != bversion)
+            {
+                return aversion < bversion ? -1 : 1;
+            }
+            type &= ~KEY_VERSION_FLAG;
+        }
         switch (type)
         {
             case KEY_META:
             case SCRIPT:
+            case KEY_RECLAIM_ELEMENT:
+            case KEY_COUNT_ELEMENT:
             {
                 return 0;
             }
@@ -75,6 +140,9 @@ namespace ardb
             case HASH_FIELD:
             case LIST_ELEMENT:
             case BITSET_ELEMENT:
+            case ZSET_ELEMENT_RANK:
+            case LIST_CHUNK:
+            case LIST_CHUNK_INDEX:
             {
                 Data a, b;
                 a.Decode(abuf);
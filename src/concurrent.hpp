@@ -35,6 +35,10 @@
 #include "thread/thread_local.hpp"
 #include "thread/lock_guard.hpp"
 #include "thread/spin_rwlock.hpp"
+#include "thread/spin_mutex_lock.hpp"
+#include "util/time_helper.hpp"
+#include "util/string_helper.hpp"
+#include "util/atomic.hpp"
 #include "codec.hpp"
 #include <stack>
 
@@ -101,37 +105,94 @@ OP_NAMESPACE_BEGIN
             }
     };
 
-    struct KeyLocker
+    /*
+     * One stripe of the key lock table, every stripe has its own spin lock, barrier table & barrier pool,
+     * so that writers on different keys rarely contend on the same cache line.
+     */
+    struct KeyLockerShard
     {
             typedef TreeMap<DBItemStackKey, Barrier*>::Type ThreadMutexLockTable;
             typedef std::stack<Barrier*> ThreadMutexLockStack;
-            SpinRWLock m_barrier_lock;
-            typedef ReadLockGuard<SpinRWLock> SpinReadLockGuard;
-            typedef WriteLockGuard<SpinRWLock> SpinWriteLockGuard;
-            ThreadMutexLockStack m_barrier_pool;
-            ThreadMutexLockTable m_barrier_table;
+            SpinMutexLock lock;
+            ThreadMutexLockStack barrier_pool;
+            ThreadMutexLockTable barrier_table;
+            volatile uint64 lock_count;
+            volatile uint64 contention_count;
+            volatile uint64 wait_micros;
+            volatile uint64 max_wait_micros;
+            KeyLockerShard() :
+                    lock_count(0), contention_count(0), wait_micros(0), max_wait_micros(0)
+            {
+            }
+            ~KeyLockerShard()
+            {
+                while (!barrier_pool.empty())
+                {
+                    Barrier* p = barrier_pool.top();
+                    delete p;
+                    barrier_pool.pop();
+                }
+            }
+    };
+
+    struct KeyLocker
+    {
+            typedef KeyLockerShard::ThreadMutexLockTable ThreadMutexLockTable;
+            typedef LockGuard<SpinMutexLock> SpinLockGuard;
+            KeyLockerShard* m_shards;
+            uint32 m_shard_count;
             uint32 m_pool_size;
             KeyLocker() :
-                    m_pool_size(0)
+                    m_shards(NULL), m_shard_count(0), m_pool_size(0)
             {
             }
-            void Init(uint32 thread_num)
+            void Init(uint32 thread_num, uint32 shard_count)
             {
+                if (shard_count == 0)
+                {
+                    shard_count = 1;
+                }
                 m_pool_size = thread_num;
-                for (uint32 i = 0; i < thread_num; i++)
+                m_shard_count = shard_count;
+                m_shards = new KeyLockerShard[m_shard_count];
+                /*
+                 * Pre-allocate barriers for each shard, at most 'thread_num' keys could be locked at the same time.
+                 */
+                uint32 per_shard = thread_num / m_shard_count + 1;
+                for (uint32 i = 0; i < m_shard_count; i++)
                 {
-                    Barrier* lock = new Barrier;
-                    m_barrier_pool.push(lock);
+                    for (uint32 j = 0; j < per_shard; j++)
+                    {
+                        m_shards[i].barrier_pool.push(new Barrier);
+                    }
                 }
             }
             ~KeyLocker()
             {
-                while (!m_barrier_pool.empty())
+                DELETE_A(m_shards);
+            }
+            static uint32 HashKey(const DBID& db, const Slice& key)
+            {
+                /*
+                 * FNV-1a over db & key bytes
+                 */
+                uint32 h = 2166136261U;
+                for (uint32 i = 0; i < sizeof(DBID); i++)
                 {
-                    Barrier* p = m_barrier_pool.top();
-                    delete p;
-                    m_barrier_pool.pop();
+                    h ^= (uint8) (db >> (i * 8));
+                    h *= 16777619U;
+                }
+                const uint8* p = (const uint8*) key.data();
+                for (size_t i = 0; i < key.size(); i++)
+                {
+                    h ^= p[i];
+                    h *= 16777619U;
                 }
+                return h;
+            }
+            KeyLockerShard& GetShard(const DBID& db, const Slice& key)
+            {
+                return m_shards[HashKey(db, key) % m_shard_count];
             }
             Barrier* AddLockKey(const DBID& db, const Slice& key)
             {
@@ -139,15 +200,18 @@ OP_NAMESPACE_BEGIN
                 {
                     return NULL;
                 }
+                KeyLockerShard& shard = GetShard(db, key);
+                atomic_add_uint64(&shard.lock_count, 1);
+                uint64 wait_start = 0;
                 while (true)
                 {
                     Barrier* barrier = NULL;
                     {
-                        SpinWriteLockGuard guard(m_barrier_lock);
+                        SpinLockGuard guard(shard.lock);
                         /*
                          * Merge find/insert operations into one 'insert' invocation
                          */
-                        std::pair<ThreadMutexLockTable::iterator, bool> insert = m_barrier_table.insert(
+                        std::pair<ThreadMutexLockTable::iterator, bool> insert = shard.barrier_table.insert(
                                 std::make_pair(DBItemStackKey(db, key), (Barrier*) NULL));
                         if (!insert.second && NULL != insert.first->second)
                         {
@@ -160,10 +224,10 @@ OP_NAMESPACE_BEGIN
                         }
                         else
                         {
-                            if (!m_barrier_pool.empty())
+                            if (!shard.barrier_pool.empty())
                             {
-                                barrier = m_barrier_pool.top();
-                                m_barrier_pool.pop();
+                                barrier = shard.barrier_pool.top();
+                                shard.barrier_pool.pop();
                             }
                             else
                             {
@@ -172,11 +236,27 @@ OP_NAMESPACE_BEGIN
                             barrier->AddLockRef();
                             barrier->pid = pthread_self();
                             insert.first->second = barrier;
+                            if (wait_start > 0)
+                            {
+                                uint64 waited = get_current_epoch_micros() - wait_start;
+                                atomic_add_uint64(&shard.wait_micros, waited);
+                                uint64 max_wait = shard.max_wait_micros;
+                                while (waited > max_wait
+                                        && !atomic_cmp_set_uint64(&shard.max_wait_micros, max_wait, waited))
+                                {
+                                    max_wait = shard.max_wait_micros;
+                                }
+                            }
                             return barrier;
                         }
                     }
                     if (NULL != barrier)
                     {
+                        if (wait_start == 0)
+                        {
+                            wait_start = get_current_epoch_micros();
+                            atomic_add_uint64(&shard.contention_count, 1);
+                        }
                         LockGuard<ThreadMutexLock> guard(*barrier);
                         if (barrier->in_lock > 0)
                         {
@@ -188,6 +268,45 @@ OP_NAMESPACE_BEGIN
                 }
                 return NULL;
             }
+            /*
+             * Same as AddLockKey, but fails instead of waiting while another thread holds the key.
+             */
+            bool TryAddLockKey(const DBID& db, const Slice& key, Barrier*& barrier)
+            {
+                barrier = NULL;
+                if (m_pool_size <= 1)
+                {
+                    return true;
+                }
+                KeyLockerShard& shard = GetShard(db, key);
+                SpinLockGuard guard(shard.lock);
+                std::pair<ThreadMutexLockTable::iterator, bool> insert = shard.barrier_table.insert(
+                        std::make_pair(DBItemStackKey(db, key), (Barrier*) NULL));
+                if (!insert.second && NULL != insert.first->second)
+                {
+                    if (insert.first->second->pid != pthread_self())
+                    {
+                        return false;
+                    }
+                    barrier = insert.first->second;
+                    barrier->AddLockRef();
+                    return true;
+                }
+                if (!shard.barrier_pool.empty())
+                {
+                    barrier = shard.barrier_pool.top();
+                    shard.barrier_pool.pop();
+                }
+                else
+                {
+                    barrier = new Barrier;
+                }
+                barrier->AddLockRef();
+                barrier->pid = pthread_self();
+                insert.first->second = barrier;
+                atomic_add_uint64(&shard.lock_count, 1);
+                return true;
+            }
             void ClearLockKey(const DBID& db, const Slice& key, Barrier* barrier)
             {
                 if (m_pool_size <= 1)
@@ -199,10 +318,11 @@ OP_NAMESPACE_BEGIN
                     bool recycle = (barrier->DecLockRef() == 0);
                     if (recycle)
                     {
+                        KeyLockerShard& shard = GetShard(db, key);
                         {
-                            SpinWriteLockGuard guard(m_barrier_lock);
+                            SpinLockGuard guard(shard.lock);
                             barrier->pid = 0;
-                            m_barrier_table.erase(DBItemStackKey(db, key));
+                            shard.barrier_table.erase(DBItemStackKey(db, key));
                         }
                         {
                             LockGuard<ThreadMutexLock> guard(*barrier);
@@ -212,13 +332,42 @@ OP_NAMESPACE_BEGIN
                             }
                         }
                         {
-                            SpinWriteLockGuard guard(m_barrier_lock);
-                            m_barrier_pool.push(barrier);
+                            SpinLockGuard guard(shard.lock);
+                            shard.barrier_pool.push(barrier);
                         }
 
                     }
                 }
             }
+            const std::string& PrintStat(std::string& str)
+            {
+                uint64 locks = 0, contentions = 0, wait_micros = 0, max_wait = 0, max_shard_contentions = 0;
+                for (uint32 i = 0; i < m_shard_count; i++)
+                {
+                    KeyLockerShard& shard = m_shards[i];
+                    locks += shard.lock_count;
+                    contentions += shard.contention_count;
+                    wait_micros += shard.wait_micros;
+                    if (shard.max_wait_micros > max_wait)
+                    {
+                        max_wait = shard.max_wait_micros;
+                    }
+                    if (shard.contention_count > max_shard_contentions)
+                    {
+                        max_shard_contentions = shard.contention_count;
+                    }
+                }
+                str.append("keylock_shards:").append(stringfromll(m_shard_count)).append("\r\n");
+                str.append("keylock_acquires:").append(stringfromll(locks)).append("\r\n");
+                str.append("keylock_contentions:").append(stringfromll(contentions)).append("\r\n");
+                str.append("keylock_wait_usec:").append(stringfromll(wait_micros)).append("\r\n");
+                str.append("keylock_avg_wait_usec:").append(
+                        contentions == 0 ? "0" : stringfromll(wait_micros / contentions)).append("\r\n");
+                str.append("keylock_max_wait_usec:").append(stringfromll(max_wait)).append("\r\n");
+                str.append("keylock_max_shard_contentions:").append(stringfromll(max_shard_contentions)).append(
+                        "\r\n");
+                return str;
+            }
     };
 
     struct KeyLockerGuard
@@ -237,5 +386,42 @@ OP_NAMESPACE_BEGIN
                 locker.ClearLockKey(db, key, barrier);
             }
     };
+
+    /*
+     * Lock several keys for multi-key write commands(SMOVE/RENAME/SINTERSTORE...).
+     * Keys are always locked in the same global order, so two multi-key commands on
+     * overlapping keys can NOT dead lock each other.
+     */
+    struct MultiKeyLockerGuard
+    {
+            typedef std::vector<std::pair<DBItemStackKey, Barrier*> > LockedKeyArray;
+            KeyLocker& locker;
+            LockedKeyArray locked;
+            MultiKeyLockerGuard(KeyLocker& loc, const DBID& id, const SliceArray& keys) :
+                    locker(loc)
+            {
+                TreeSet<DBItemStackKey>::Type sorted;
+                for (uint32 i = 0; i < keys.size(); i++)
+                {
+                    sorted.insert(DBItemStackKey(id, keys[i]));
+                }
+                TreeSet<DBItemStackKey>::Type::iterator it = sorted.begin();
+                while (it != sorted.end())
+                {
+                    Barrier* barrier = locker.AddLockKey(it->db, it->key);
+                    locked.push_back(std::make_pair(*it, barrier));
+                    it++;
+                }
+            }
+            ~MultiKeyLockerGuard()
+            {
+                LockedKeyArray::reverse_iterator it = locked.rbegin();
+                while (it != locked.rend())
+                {
+                    locker.ClearLockKey(it->first.db, it->first.key, it->second);
+                    it++;
+                }
+            }
+    };
 OP_NAMESPACE_END
 #endif /* CONCURRENT_HPP_ */
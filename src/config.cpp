@@ -45,6 +45,61 @@ OP_NAMESPACE_BEGIN
             ERROR_LOG("[Config]Password is longer than %u", ARDB_AUTHPASS_MAX_LEN);
             return false;
         }
+        if (cfg.key_lock_shards <= 0)
+        {
+            ERROR_LOG("[Config]Invalid value for 'key-lock-shards', it must be greater than 0.");
+            return false;
+        }
+        if (cfg.log_async && (cfg.log_async_buffer_size < 4096 || cfg.log_async_buffer_size > 64 * 1024 * 1024))
+        {
+            ERROR_LOG("[Config]Invalid value for 'log-async-buffer-size', it must be between 4096 and 64mb.");
+            return false;
+        }
+        if (cfg.slave_apply_threads < 0 || cfg.slave_apply_threads > 64)
+        {
+            ERROR_LOG("[Config]Invalid value for 'slave-apply-threads', it must be between 0 and 64.");
+            return false;
+        }
+        if (cfg.pipeline_batch_writes < 0)
+        {
+            ERROR_LOG("[Config]Invalid value for 'pipeline-batch-writes', it must not be negative.");
+            return false;
+        }
+        if (cfg.lazyfree_batch_size <= 0)
+        {
+            ERROR_LOG("[Config]Invalid value for 'lazyfree-batch-size', it must be greater than 0.");
+            return false;
+        }
+        if (cfg.L1_cache_shards <= 0 || (cfg.L1_cache_shards & (cfg.L1_cache_shards - 1)) != 0)
+        {
+            ERROR_LOG("[Config]Invalid value for 'L1-cache-shards', it must be a power of 2.");
+            return false;
+        }
+        if (cfg.dump_threads <= 0 || cfg.dump_threads > 64)
+        {
+            ERROR_LOG("[Config]Invalid value for 'dump-threads', it must be between 1 and 64.");
+            return false;
+        }
+        if (cfg.expire_sweeper_threads <= 0)
+        {
+            ERROR_LOG("[Config]Invalid value for 'expire-sweeper-threads', it must be greater than 0.");
+            return false;
+        }
+        if (cfg.active_expire_effort < 1 || cfg.active_expire_effort > 10)
+        {
+            ERROR_LOG("[Config]Invalid value for 'active-expire-effort', it must be between 1 and 10.");
+            return false;
+        }
+        if (cfg.zset_rank_bucket_size < 4)
+        {
+            ERROR_LOG("[Config]Invalid value for 'zset-rank-bucket-size', it must be at least 4.");
+            return false;
+        }
+        if (cfg.list_chunk_size < 4)
+        {
+            ERROR_LOG("[Config]Invalid value for 'list-chunk-size', it must be at least 4.");
+            return false;
+        }
         if (cfg.maxdb > 0xFFFFFF)
         {
             ERROR_LOG("[Config]databases is greater than %u", 0xFFFFFF);
@@ -85,6 +140,7 @@ OP_NAMESPACE_BEGIN
         conf_get_int64(props, "unixsocketperm", unixsocketperm);
         conf_get_int64(props, "slowlog-log-slower-than", slowlog_log_slower_than);
         conf_get_int64(props, "slowlog-max-len", slowlog_max_len);
+        conf_get_int64(props, "latency-histogram-window", latency_histogram_window);
         conf_get_int64(props, "maxclients", max_clients);
         Properties::const_iterator listen_it = props.find("listen");
         if (listen_it != props.end())
@@ -163,11 +219,19 @@ OP_NAMESPACE_BEGIN
         {
             backup_redis_format = true;
         }
+        else if (!strcasecmp(backup_file_format.c_str(), "checkpoint"))
+        {
+            backup_checkpoint = true;
+        }
+
+        conf_get_int64(props, "dump-threads", dump_threads);
 
         conf_get_string(props, "zookeeper-servers", zookeeper_servers);
 
         conf_get_string(props, "loglevel", loglevel);
         conf_get_string(props, "logfile", logfile);
+        conf_get_bool(props, "log-async", log_async);
+        conf_get_int64(props, "log-async-buffer-size", log_async_buffer_size);
         conf_get_bool(props, "daemonize", daemonize);
 
         conf_get_int64(props, "repl-backlog-size", repl_backlog_size);
@@ -186,12 +250,22 @@ OP_NAMESPACE_BEGIN
         conf_get_int64(props, "list-max-ziplist-value", list_max_ziplist_value);
         conf_get_int64(props, "zset-max-ziplist-entries", zset_max_ziplist_entries);
         conf_get_int64(props, "zset_max_ziplist_value", zset_max_ziplist_value);
+        conf_get_int64(props, "zset-rank-bucket-size", zset_rank_bucket_size);
+        conf_get_int64(props, "zset-rank-build-max-len", zset_rank_build_max_len);
+        conf_get_int64(props, "list-chunk-size", list_chunk_size);
+        conf_get_int64(props, "list-rechunk-max-len", list_rechunk_max_len);
 
         conf_get_int64(props, "L1-zset-max-cache-size", L1_zset_max_cache_size);
         conf_get_int64(props, "L1-set-max-cache-size", L1_set_max_cache_size);
         conf_get_int64(props, "L1-hash-max-cache-size", L1_hash_max_cache_size);
         conf_get_int64(props, "L1-list-max-cache-size", L1_list_max_cache_size);
         conf_get_int64(props, "L1-string-max-cache-size", L1_string_max_cache_size);
+        conf_get_int64(props, "L1-zset-max-cache-memory", L1_zset_max_cache_memory);
+        conf_get_int64(props, "L1-set-max-cache-memory", L1_set_max_cache_memory);
+        conf_get_int64(props, "L1-hash-max-cache-memory", L1_hash_max_cache_memory);
+        conf_get_int64(props, "L1-list-max-cache-memory", L1_list_max_cache_memory);
+        conf_get_int64(props, "L1-string-max-cache-memory", L1_string_max_cache_memory);
+        conf_get_int64(props, "L1-cache-shards", L1_cache_shards);
 
         conf_get_bool(props, "L1-zset-read-fill-cache", L1_zset_read_fill_cache);
         conf_get_bool(props, "L1-zset-seek-load-cache", L1_zset_seek_load_cache);
@@ -208,6 +282,7 @@ OP_NAMESPACE_BEGIN
         conf_get_bool(props, "slave-read-only", slave_readonly);
         conf_get_bool(props, "slave-serve-stale-data", slave_serve_stale_data);
         conf_get_int64(props, "slave-priority", slave_priority);
+        conf_get_int64(props, "slave-apply-threads", slave_apply_threads);
         conf_get_bool(props, "slave-ignore-expire", slave_ignore_expire);
         conf_get_bool(props, "slave-ignore-del", slave_ignore_del);
 
@@ -302,6 +377,16 @@ OP_NAMESPACE_BEGIN
 
         conf_get_int64(props, "databases", maxdb);
 
+        conf_get_int64(props, "key-lock-shards", key_lock_shards);
+        conf_get_int64(props, "pipeline-batch-writes", pipeline_batch_writes);
+
+        conf_get_bool(props, "lazyfree-lazy-del", lazyfree_lazy_del);
+        conf_get_bool(props, "lazyfree-lazy-expire", lazyfree_lazy_expire);
+        conf_get_int64(props, "lazyfree-min-elements", lazyfree_min_elements);
+        conf_get_int64(props, "lazyfree-batch-size", lazyfree_batch_size);
+        conf_get_int64(props, "expire-sweeper-threads", expire_sweeper_threads);
+        conf_get_int64(props, "active-expire-effort", active_expire_effort);
+
         trusted_ip.clear();
         Properties::const_iterator ip_it = props.find("trusted-ip");
         if (ip_it != props.end())
@@ -61,10 +61,13 @@ OP_NAMESPACE_BEGIN
             std::string data_base_path;
             int64 slowlog_log_slower_than;
             int64 slowlog_max_len;
+            int64 latency_histogram_window;
 
             std::string repl_data_dir;
             std::string backup_dir;
             bool backup_redis_format;
+            bool backup_checkpoint;
+            int64 dump_threads;
 
             int64 repl_ping_slave_period;
             int64 repl_timeout;
@@ -75,6 +78,7 @@ OP_NAMESPACE_BEGIN
             bool slave_readonly;
             bool slave_serve_stale_data;
             int64 slave_priority;
+            int64 slave_apply_threads;
 
             int64 lua_time_limit;
 
@@ -87,6 +91,8 @@ OP_NAMESPACE_BEGIN
             //int64 worker_count;
             std::string loglevel;
             std::string logfile;
+            bool log_async;
+            int64 log_async_buffer_size;
 
             std::string pidfile;
 
@@ -106,12 +112,22 @@ OP_NAMESPACE_BEGIN
             int64 zset_max_ziplist_value;
             int64 set_max_ziplist_entries;
             int64 set_max_ziplist_value;
+            int64 zset_rank_bucket_size;
+            int64 zset_rank_build_max_len;
+            int64 list_chunk_size;
+            int64 list_rechunk_max_len;
 
             int64 L1_zset_max_cache_size;
             int64 L1_set_max_cache_size;
             int64 L1_list_max_cache_size;
             int64 L1_hash_max_cache_size;
             int64 L1_string_max_cache_size;
+            int64 L1_zset_max_cache_memory;
+            int64 L1_set_max_cache_memory;
+            int64 L1_list_max_cache_memory;
+            int64 L1_hash_max_cache_memory;
+            int64 L1_string_max_cache_memory;
+            int64 L1_cache_shards;
 
             bool L1_zset_read_fill_cache;
             bool L1_zset_seek_load_cache;
@@ -157,16 +173,30 @@ OP_NAMESPACE_BEGIN
 
             int64 maxdb;
 
+            int64 key_lock_shards;
+
+            int64 pipeline_batch_writes;
+
+            bool lazyfree_lazy_del;
+            bool lazyfree_lazy_expire;
+            int64 lazyfree_min_elements;
+            int64 lazyfree_batch_size;
+
+            int64 expire_sweeper_threads;
+            int64 active_expire_effort;
+
             ArdbConfig() :
                     daemonize(false), unixsocketperm(755), max_clients(10000), tcp_keepalive(0), timeout(0), slowlog_log_slower_than(
-                            10000), slowlog_max_len(128), repl_data_dir("./repl"), backup_dir("./backup"), backup_redis_format(
-                            false), repl_ping_slave_period(10), repl_timeout(60), repl_backlog_size(100 * 1024 * 1024), repl_state_persist_period(
+                            10000), slowlog_max_len(128), latency_histogram_window(300), repl_data_dir("./repl"), backup_dir("./backup"), backup_redis_format(
+                            false), backup_checkpoint(false), dump_threads(4), repl_ping_slave_period(10), repl_timeout(60), repl_backlog_size(100 * 1024 * 1024), repl_state_persist_period(
                             1), repl_backlog_time_limit(3600), slave_cleardb_before_fullresync(true), slave_readonly(
-                            true), slave_serve_stale_data(true), slave_priority(100), lua_time_limit(0), master_port(0), loglevel(
-                            "INFO"), hash_max_ziplist_entries(128), hash_max_ziplist_value(256), list_max_ziplist_entries(
+                            true), slave_serve_stale_data(true), slave_priority(100), slave_apply_threads(4), lua_time_limit(0), master_port(0), loglevel(
+                            "INFO"), log_async(true), log_async_buffer_size(256 * 1024), hash_max_ziplist_entries(128), hash_max_ziplist_value(256), list_max_ziplist_entries(
                             128), list_max_ziplist_value(256), zset_max_ziplist_entries(128), zset_max_ziplist_value(
-                            256), set_max_ziplist_entries(128), set_max_ziplist_value(256), L1_zset_max_cache_size(0), L1_set_max_cache_size(
-                            0), L1_list_max_cache_size(0), L1_hash_max_cache_size(0), L1_string_max_cache_size(0), L1_zset_read_fill_cache(
+                            256), set_max_ziplist_entries(128), set_max_ziplist_value(256), zset_rank_bucket_size(64), zset_rank_build_max_len(100000), list_chunk_size(128), list_rechunk_max_len(100000), L1_zset_max_cache_size(0), L1_set_max_cache_size(
+                            0), L1_list_max_cache_size(0), L1_hash_max_cache_size(0), L1_string_max_cache_size(0), L1_zset_max_cache_memory(
+                            0), L1_set_max_cache_memory(0), L1_list_max_cache_memory(0), L1_hash_max_cache_memory(0), L1_string_max_cache_memory(
+                            0), L1_cache_shards(16), L1_zset_read_fill_cache(
                             false), L1_zset_seek_load_cache(false), L1_set_read_fill_cache(false), L1_set_seek_load_cache(
                             false), L1_hash_read_fill_cache(false), L1_hash_seek_load_cache(false), L1_list_read_fill_cache(
                             false), L1_list_seek_load_cache(false), L1_string_read_fill_cache(false), check_type_before_set_string(
@@ -175,7 +205,10 @@ OP_NAMESPACE_BEGIN
                             5000), primary_port(0), slave_client_output_buffer_limit(256 * 1024 * 1024), pubsub_client_output_buffer_limit(
                             32 * 1024 * 1024), slave_ignore_expire(false), slave_ignore_del(false), repl_disable_tcp_nodelay(
                             false), scan_redis_compatible(true), scan_cursor_expire_after(60), max_string_bitset_value(
-                            1024 * 1024), maxdb(16)
+                            1024 * 1024), maxdb(16), key_lock_shards(64), pipeline_batch_writes(
+                            128), lazyfree_lazy_del(false), lazyfree_lazy_expire(
+                            false), lazyfree_min_elements(1024), lazyfree_batch_size(1000), expire_sweeper_threads(
+                            2), active_expire_effort(1)
             {
             }
             bool Parse(const Properties& props);
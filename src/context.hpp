@@ -49,6 +49,30 @@ using namespace ardb::codec;
 OP_NAMESPACE_BEGIN
 
     typedef TreeSet<DBItemKey>::Type WatchKeySet;
+    typedef TreeMap<DBItemKey, uint8>::Type MetaTypeTable;
+
+    struct KeyCountChange
+    {
+            DBID db;
+            uint8 old_type;
+            uint8 new_type;
+            KeyCountChange(DBID d, uint8 o, uint8 n) :
+                    db(d), old_type(o), new_type(n)
+            {
+            }
+    };
+    typedef std::vector<KeyCountChange> KeyCountChangeArray;
+
+    struct ReplicationFeed
+    {
+            DBID db;
+            RedisCommandFrame cmd;
+            ReplicationFeed(DBID d, const RedisCommandFrame& c) :
+                    db(d), cmd(c)
+            {
+            }
+    };
+    typedef std::vector<ReplicationFeed> ReplicationFeedArray;
 
     struct ListBlockContext
     {
@@ -104,6 +128,10 @@ OP_NAMESPACE_BEGIN
             PubSubContext* pubsub;
             LUAContext* lua;
             ListBlockContext* block;
+            /*
+             * Scratch memory of the running command, reset after each command is processed.
+             */
+            Arena* arena;
 
             Channel* client;
             DBID currentDB;
@@ -127,11 +155,26 @@ OP_NAMESPACE_BEGIN
             uint8 identity;
 
             int64 sequence;  //recv command sequence in the server, start from 1
+            /*
+             * Meta type(KEY_END if absent) of the keys read or written by the running write command,
+             * it saves the existence lookup when the key count is updated.
+             */
+            MetaTypeTable meta_types;
+            DBItemKey meta_type_lookup; /* reused to look up 'meta_types' without allocating */
+            /*
+             * Key count changes of the batch write opened by this context, applied once the batch commits.
+             */
+            KeyCountChangeArray key_count_changes;
+            /*
+             * Commands to feed to slaves once the batch write opened by this context commits.
+             */
+            ReplicationFeedArray repl_feeds;
+            uint32 batch_depth;
             Context() :
-                    transc(NULL), pubsub(NULL), lua(NULL), block(NULL), client(
+                    transc(NULL), pubsub(NULL), lua(NULL), block(NULL), arena(NULL), client(
                     NULL), currentDB(0), authenticated(true), data_change(false), write_success(true),current_cmd(NULL), current_cmd_type(
                             REDIS_CMD_INVALID), born_time(0), last_interaction_ustime(0), processing(false), close_after_processed(
-                            false), cmd_setting_flags(0), identity(CONTEXT_NORMAL_CONNECTION),sequence(0)
+                            false), cmd_setting_flags(0), identity(CONTEXT_NORMAL_CONNECTION),sequence(0), batch_depth(0)
             {
             }
             TranscContext& GetTransc()
@@ -158,6 +201,14 @@ OP_NAMESPACE_BEGIN
                 }
                 return *lua;
             }
+            Arena& GetArena()
+            {
+                if (NULL == arena)
+                {
+                    arena = new Arena;
+                }
+                return *arena;
+            }
             ListBlockContext& GetBlockContext()
             {
                 if (NULL == block)
@@ -198,6 +249,13 @@ OP_NAMESPACE_BEGIN
             {
                 DELETE(block);
             }
+            void ResetArena()
+            {
+                if (NULL != arena)
+                {
+                    arena->Reset();
+                }
+            }
             void ClearState()
             {
                 reply.Clear();
@@ -211,6 +269,7 @@ OP_NAMESPACE_BEGIN
                 ClearPubsub();
                 ClearLua();
                 ClearBlockContext();
+                DELETE(arena);
             }
     };
 
@@ -31,64 +31,6 @@
 
 OP_NAMESPACE_BEGIN
 
-    struct ExpireCheck: public Runnable
-    {
-            DBIDSet checkdbs;
-            void Run()
-            {
-                if (!g_db->GetConfig().master_host.empty())
-                {
-                    /*
-                     * no expire on slave, master would sync the expire/del operations to slaves.
-                     */
-                    return;
-                }
-                if (checkdbs.empty())
-                {
-                    g_db->GetAllDBIDSet(checkdbs);
-                    if (checkdbs.empty())
-                    {
-                        return;
-                    }
-                }
-                DBID db = *(checkdbs.begin());
-                checkdbs.erase(db);
-
-                KeyObject start;
-                start.db = db;
-                start.type = KEY_EXPIRATION_ELEMENT;
-                start.score.SetInt64(0);
-                Iterator* iter = g_db->IteratorKeyValue(start, false);
-                while (NULL != iter && iter->Valid())
-                {
-                    KeyObject k;
-                    decode_key(iter->Key(), k);
-                    if (k.db != db || k.type != KEY_EXPIRATION_ELEMENT)
-                    {
-                        break;
-                    }
-                    if (k.score.value.iv <= get_current_epoch_millis())
-                    {
-                        Context tmpctx;
-                        tmpctx.currentDB = db;
-                        g_db->DeleteKey(tmpctx, k.key);
-                        iter->Next();
-
-                        RedisCommandFrame del("del");
-                        std::string keystr;
-                        keystr.assign(k.key.data(), k.key.size());
-                        del.AddArg(keystr);
-                        g_db->m_master.FeedSlaves(db, del);
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-                DELETE(iter);
-            }
-    };
-
     struct CompactTask: public Runnable
     {
 
@@ -187,6 +129,19 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    struct LatencyHistogramWindowTask: public Runnable
+    {
+            void Run()
+            {
+                int64 window = g_db->GetConfig().latency_histogram_window;
+                LatencyHistograms& histograms = g_db->GetStatistics().GetLatencyHistograms();
+                if (window > 0 && time(NULL) - histograms.GetWindowStart() >= window)
+                {
+                    histograms.Clear();
+                }
+            }
+    };
+
     struct RedisCursorClearTask: public Runnable
     {
             void Run()
@@ -195,18 +150,54 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    struct ReclaimTask: public Runnable
+    {
+            void Run()
+            {
+                g_db->ReclaimStep(50);
+            }
+    };
+
+    struct ListRechunkTask: public Runnable
+    {
+            void Run()
+            {
+                g_db->ListRechunkStep(50);
+            }
+    };
+
+    struct ZSetRankTask: public Runnable
+    {
+            void Run()
+            {
+                g_db->ZSetRankStep(50);
+            }
+    };
+
+    struct KeyCountReconcileTask: public Runnable
+    {
+            void Run()
+            {
+                g_db->ReconcileKeyCounts();
+            }
+    };
+
     CronManager::CronManager()
     {
 
     }
     void CronManager::Start()
     {
-        m_db_cron.serv.GetTimer().ScheduleHeapTask(new ExpireCheck, 100, 100, MILLIS);
         m_db_cron.serv.GetTimer().ScheduleHeapTask(new CompactTask, 10, 10, SECONDS);
+        m_db_cron.serv.GetTimer().ScheduleHeapTask(new ReclaimTask, 100, 100, MILLIS);
+        m_db_cron.serv.GetTimer().ScheduleHeapTask(new ListRechunkTask, 100, 100, MILLIS);
+        m_db_cron.serv.GetTimer().ScheduleHeapTask(new ZSetRankTask, 100, 100, MILLIS);
+        m_db_cron.serv.GetTimer().ScheduleHeapTask(new KeyCountReconcileTask, 10, 10, SECONDS);
 
         m_misc_cron.serv.GetTimer().ScheduleHeapTask(new ConnectionTimeout, 100, 100, MILLIS);
         m_misc_cron.serv.GetTimer().ScheduleHeapTask(new TrackOpsTask, 1, 1, SECONDS);
         m_misc_cron.serv.GetTimer().ScheduleHeapTask(new LatencyStatClearTask, 5, 5, MINUTES);
+        m_misc_cron.serv.GetTimer().ScheduleHeapTask(new LatencyHistogramWindowTask, 1, 1, SECONDS);
         m_misc_cron.serv.GetTimer().ScheduleHeapTask(new RedisCursorClearTask, 1, 1, SECONDS);
 
         m_db_cron.Start();
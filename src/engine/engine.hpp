@@ -32,6 +32,8 @@
 
 #include "common/common.hpp"
 #include "slice.hpp"
+#include <vector>
+#include <string>
 
 OP_NAMESPACE_BEGIN
     struct Iterator
@@ -53,8 +55,18 @@ OP_NAMESPACE_BEGIN
     {
             bool read_fill_cache;
             bool seek_fill_cache;
+            /*
+             * Exclusive upper bound for iterators created by Find. When set, every key between the seek key and
+             * the bound shares the seek key's (db, type, key) prefix, so engines may use prefix filters.
+             */
+            Slice upper_bound;
+            /*
+             * Snapshot from KeyValueEngine::NewSnapshot read by iterators created by Find, NULL to read the
+             * snapshot of the calling thread.
+             */
+            const void* snapshot;
             Options() :
-                    read_fill_cache(true),seek_fill_cache(false)
+                    read_fill_cache(true),seek_fill_cache(false),snapshot(NULL)
             {
             }
     };
@@ -70,6 +82,31 @@ OP_NAMESPACE_BEGIN
             virtual Iterator* Find(const Slice& findkey, const Options& options) = 0;
             virtual int MaxOpenFiles() = 0;
 
+            /*
+             * Batched point lookups, errs[i] is 0 if keys[i] was found. Callers pass keys in comparator order,
+             * engines without a native batch read fall back to one Get per key.
+             */
+            virtual void MultiGet(const std::vector<Slice>& keys, std::vector<std::string>& values,
+                    std::vector<int>& errs, const Options& options)
+            {
+                values.resize(keys.size());
+                errs.resize(keys.size());
+                for (size_t i = 0; i < keys.size(); i++)
+                {
+                    errs[i] = Get(keys[i], &values[i], options);
+                }
+            }
+
+            /*
+             * Existence check without disk reads: 0 if 'key' does not exist, 1 if it was found in memory with its
+             * value stored in 'value', -1 if that can not be told without reading the disk. Engines without such
+             * a check just read the key.
+             */
+            virtual int KeyMayExist(const Slice& key, std::string* value, const Options& options)
+            {
+                return 0 == Get(key, value, options) ? 1 : 0;
+            }
+
             virtual const std::string Stats()
             {
                 return "";
@@ -77,6 +114,33 @@ OP_NAMESPACE_BEGIN
             virtual void CompactRange(const Slice& begin, const Slice& end)
             {
             }
+            /*
+             * Write an openable point-in-time copy of the data into 'dir', which must not exist yet. Engines link
+             * their immutable files where they can, -1 if the engine can not make checkpoints.
+             */
+            virtual int Checkpoint(const std::string& dir)
+            {
+                return -1;
+            }
+            /*
+             * Estimate at most parts-1 raw keys cutting the data into ranges of similar size, in comparator
+             * order, from engine metadata only. -1 if the engine keeps no such metadata.
+             */
+            virtual int EstimateSplitKeys(uint32 parts, std::vector<std::string>& keys)
+            {
+                return -1;
+            }
+            /*
+             * Pin a point-in-time view that iterators of any thread may read through Options::snapshot, until
+             * ReleaseSnapshot. NULL if the engine can not share snapshots across threads.
+             */
+            virtual const void* NewSnapshot()
+            {
+                return NULL;
+            }
+            virtual void ReleaseSnapshot(const void* snapshot)
+            {
+            }
             virtual ~KeyValueEngine()
             {
             }
@@ -96,6 +160,10 @@ OP_NAMESPACE_BEGIN
     struct CommonComparator
     {
             static int Compare(const char* akbuf, size_t aksiz, const char* bkbuf, size_t bksiz);
+            /* true if keys are memcmp ordered and engines should keep their default bytewise comparator */
+            static bool Bytewise();
+            /* length of the (db, type, key) prefix of an encoded key, 0 if the key has no such prefix */
+            static size_t PrefixLength(const char* kbuf, size_t ksiz);
     };
 
 OP_NAMESPACE_END
@@ -143,7 +143,8 @@ namespace ardb
         m_engine->ReleaseContextSnapshot();
     }
 
-    ForestDBEngine::ForestDBEngine()
+    ForestDBEngine::ForestDBEngine() :
+            m_bytewise(false)
     {
 
     }
@@ -164,6 +165,7 @@ namespace ardb
         m_cfg = cfg;
         make_dir(cfg.path);
         m_db_path = cfg.path;
+        m_bytewise = CommonComparator::Bytewise();
 
         fdb_status ret = fdb_init(&m_options);
         if (0 != ret)
@@ -201,16 +203,26 @@ namespace ardb
             std::string fname = m_cfg.path + "/ardb.data";
             char* kvs_names[1];
             kvs_names[0] = ARDB_KV;
-            fdb_custom_cmp_variable cmp = __ardb_compare_keys;
-            ret = fdb_open_custom_cmp(&holder.file, fname.c_str(), &m_options,
-                    1, kvs_names, &cmp);
+            if (m_bytewise)
+            {
+                ret = fdb_open(&holder.file, fname.c_str(), &m_options);
+            }
+            else
+            {
+                fdb_custom_cmp_variable cmp = __ardb_compare_keys;
+                ret = fdb_open_custom_cmp(&holder.file, fname.c_str(), &m_options,
+                        1, kvs_names, &cmp);
+            }
             CHECK_FDB_RETURN(ret);
         }
         if (NULL == holder.kv && FDB_RESULT_SUCCESS == ret)
         {
             fdb_kvs_config kvs_config;
             kvs_config = fdb_get_default_kvs_config();
-            kvs_config.custom_cmp = __ardb_compare_keys;
+            if (!m_bytewise)
+            {
+                kvs_config.custom_cmp = __ardb_compare_keys;
+            }
             ret = fdb_kvs_open(holder.file, &holder.kv, ARDB_KV, &kvs_config);
             CHECK_FDB_RETURN(ret);
         }
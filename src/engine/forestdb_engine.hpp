@@ -105,6 +105,7 @@ namespace ardb
             };
             ThreadLocal<ContextHolder> m_context;
             std::string m_db_path;
+            bool m_bytewise;
 
             ForestDBConfig m_cfg;
             fdb_config m_options;
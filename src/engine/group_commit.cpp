@@ -0,0 +1,143 @@
+/*
+ *Copyright (c) 2013-2014, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "group_commit.hpp"
+#include "util/time_helper.hpp"
+
+OP_NAMESPACE_BEGIN
+    GroupCommitter::GroupCommitter() :
+            m_queued_bytes(0), m_write(NULL), m_engine(NULL), m_max_delay_micros(0), m_max_bytes(0), m_groups(0), m_batches(
+                    0)
+    {
+    }
+
+    void GroupCommitter::Init(void* engine, BatchWriter* write, int64 max_delay_micros, int64 max_bytes)
+    {
+        m_engine = engine;
+        m_write = write;
+        m_max_delay_micros = max_delay_micros;
+        m_max_bytes = max_bytes;
+    }
+
+    int GroupCommitter::Commit(void* batch, uint32 bytes)
+    {
+        uint64 start = get_current_epoch_micros();
+        Writer w(batch, bytes);
+        m_lock.Lock();
+        m_writers.push_back(&w);
+        m_queued_bytes += bytes;
+        if (m_writers.size() > 1 && m_queued_bytes >= (uint64) m_max_bytes)
+        {
+            /*
+             * Wake up the leader waiting for followers.
+             */
+            m_lock.NotifyAll();
+        }
+        while (!w.done && &w != m_writers.front())
+        {
+            m_lock.Wait();
+        }
+        if (w.done)
+        {
+            m_lock.Unlock();
+            m_commit_latency.Add(get_current_epoch_micros() - start);
+            return w.ret;
+        }
+        if (m_max_delay_micros > 0)
+        {
+            uint64 deadline = start + m_max_delay_micros;
+            uint64 now = start;
+            while (m_queued_bytes < (uint64) m_max_bytes && now < deadline)
+            {
+                m_lock.Wait(deadline - now, MICROS);
+                now = get_current_epoch_micros();
+            }
+        }
+        std::vector<Writer*> group;
+        uint64 group_bytes = 0;
+        WriterQueue::iterator it = m_writers.begin();
+        while (it != m_writers.end())
+        {
+            if (!group.empty() && group_bytes + (*it)->bytes > (uint64) m_max_bytes)
+            {
+                break;
+            }
+            group_bytes += (*it)->bytes;
+            group.push_back(*it);
+            it++;
+        }
+        m_lock.Unlock();
+
+        /*
+         * The group goes to the engine as one write, so it is either applied and synced as a whole or not at
+         * all, whatever log file the engine writes it to, and its status is the status of every writer.
+         */
+        uint64 sync_start = get_current_epoch_micros();
+        std::vector<void*> batches(group.size());
+        for (size_t i = 0; i < group.size(); i++)
+        {
+            batches[i] = group[i]->batch;
+        }
+        int ret = m_write(m_engine, &batches[0], batches.size(), true);
+        for (size_t i = 0; i < group.size(); i++)
+        {
+            group[i]->ret = ret;
+        }
+        m_sync_latency.Add(get_current_epoch_micros() - sync_start);
+        atomic_add_uint64(&m_groups, 1);
+        atomic_add_uint64(&m_batches, group.size());
+
+        m_lock.Lock();
+        for (size_t i = 0; i < group.size(); i++)
+        {
+            group[i]->done = true;
+            m_queued_bytes -= group[i]->bytes;
+            m_writers.pop_front();
+        }
+        /*
+         * Wakes up the finished followers & the leader of the next group.
+         */
+        m_lock.NotifyAll();
+        m_lock.Unlock();
+        m_commit_latency.Add(get_current_epoch_micros() - start);
+        return w.ret;
+    }
+
+    const std::string& GroupCommitter::PrintStat(std::string& str)
+    {
+        uint64 groups = m_groups;
+        str.append("group_commit_groups:").append(stringfromll(groups)).append("\r\n");
+        str.append("group_commit_batches:").append(stringfromll(m_batches)).append("\r\n");
+        str.append("group_commit_avg_group_size:").append(
+                groups == 0 ? "0" : stringfromll(m_batches / groups)).append("\r\n");
+        m_sync_latency.PrintStat("group_commit_sync", str);
+        m_commit_latency.PrintStat("group_commit_latency", str);
+        return str;
+    }
+OP_NAMESPACE_END
@@ -0,0 +1,88 @@
+/*
+ *Copyright (c) 2013-2014, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GROUP_COMMIT_HPP_
+#define GROUP_COMMIT_HPP_
+
+#include "common/common.hpp"
+#include "thread/thread_mutex_lock.hpp"
+#include "util/latency_histogram.hpp"
+#include <deque>
+#include <vector>
+
+OP_NAMESPACE_BEGIN
+    /*
+     * Group commit for durable writes. Threads committing at the same time queue up, the one at the head
+     * becomes the leader: it writes the batches of the queued writers as one synced engine write, the others
+     * just wait for its status.
+     */
+    class GroupCommitter
+    {
+        public:
+            /*
+             * Writes 'count' engine write batches in order as one atomic engine write, durable if 'sync' is set.
+             */
+            typedef int BatchWriter(void* engine, void** batches, size_t count, bool sync);
+        private:
+            struct Writer
+            {
+                    void* batch;
+                    uint32 bytes;
+                    int ret;
+                    bool done;
+                    Writer(void* b, uint32 size) :
+                            batch(b), bytes(size), ret(0), done(false)
+                    {
+                    }
+            };
+            typedef std::deque<Writer*> WriterQueue;
+            ThreadMutexLock m_lock;
+            WriterQueue m_writers;
+            uint64 m_queued_bytes;
+            BatchWriter* m_write;
+            void* m_engine;
+            int64 m_max_delay_micros;
+            int64 m_max_bytes;
+            volatile uint64 m_groups;
+            volatile uint64 m_batches;
+            LatencyHistogram m_commit_latency;
+            LatencyHistogram m_sync_latency;
+        public:
+            GroupCommitter();
+            /*
+             * The leader waits at most 'max_delay_micros' for followers, unless 'max_bytes' are queued
+             * already, and writes at most 'max_bytes' (but at least its own batch) per group.
+             */
+            void Init(void* engine, BatchWriter* write, int64 max_delay_micros, int64 max_bytes);
+            int Commit(void* batch, uint32 bytes);
+            const std::string& PrintStat(std::string& str);
+    };
+OP_NAMESPACE_END
+
+#endif /* GROUP_COMMIT_HPP_ */
@@ -85,6 +85,9 @@ namespace ardb
         conf_get_int64(props, "leveldb.batch_commit_watermark", cfg.batch_commit_watermark);
         conf_get_string(props, "leveldb.compression", cfg.compression);
         conf_get_bool(props, "leveldb.logenable", cfg.logenable);
+        conf_get_bool(props, "leveldb.sync", cfg.sync);
+        conf_get_int64(props, "leveldb.group_commit_max_delay_us", cfg.group_commit_max_delay_us);
+        conf_get_int64(props, "leveldb.group_commit_max_bytes", cfg.group_commit_max_bytes);
     }
 
     KeyValueEngine* LevelDBEngineFactory::CreateDB(const std::string& name)
@@ -145,7 +148,16 @@ namespace ardb
     }
     bool LevelDBIterator::Valid()
     {
-        return m_iter->Valid();
+        if (!m_iter->Valid())
+        {
+            return false;
+        }
+        if (m_upper_bound.empty())
+        {
+            return true;
+        }
+        leveldb::Slice key = m_iter->key();
+        return m_engine->m_options.comparator->Compare(key, m_upper_bound) < 0;
     }
 
     LevelDBEngine::LevelDBEngine() :
@@ -162,8 +174,12 @@ namespace ardb
     int LevelDBEngine::Init(const LevelDBConfig& cfg)
     {
         m_cfg = cfg;
+        m_group_commit.Init(this, WriteGroupBatch, cfg.group_commit_max_delay_us, cfg.group_commit_max_bytes);
         m_options.create_if_missing = true;
-        m_options.comparator = &m_comparator;
+        if (!CommonComparator::Bytewise())
+        {
+            m_options.comparator = &m_comparator;
+        }
         if (cfg.block_cache_size > 0)
         {
             leveldb::Cache* cache = leveldb::NewLRUCache(cfg.block_cache_size);
@@ -252,8 +268,50 @@ namespace ardb
 
     int LevelDBEngine::FlushWriteBatch(ContextHolder& holder)
     {
-        leveldb::Status s = m_db->Write(leveldb::WriteOptions(), &holder.batch);
+        int ret = Write(holder.batch, holder.bytes);
         holder.Clear();
+        return ret;
+    }
+
+    /*
+     * Copies the operations of a write batch into another one.
+     */
+    class LevelDBBatchAppender: public leveldb::WriteBatch::Handler
+    {
+        private:
+            leveldb::WriteBatch& m_dst;
+        public:
+            LevelDBBatchAppender(leveldb::WriteBatch& dst) :
+                    m_dst(dst)
+            {
+            }
+            void Put(const leveldb::Slice& key, const leveldb::Slice& value)
+            {
+                m_dst.Put(key, value);
+            }
+            void Delete(const leveldb::Slice& key)
+            {
+                m_dst.Delete(key);
+            }
+    };
+
+    int LevelDBEngine::WriteGroupBatch(void* engine, void** batches, size_t count, bool sync)
+    {
+        LevelDBEngine* self = (LevelDBEngine*) engine;
+        leveldb::WriteOptions options;
+        options.sync = sync;
+        leveldb::WriteBatch* batch = (leveldb::WriteBatch*) batches[0];
+        leveldb::WriteBatch merged;
+        if (count > 1)
+        {
+            LevelDBBatchAppender appender(merged);
+            for (size_t i = 0; i < count; i++)
+            {
+                ((leveldb::WriteBatch*) batches[i])->Iterate(&appender);
+            }
+            batch = &merged;
+        }
+        leveldb::Status s = self->m_db->Write(options, batch);
         if (!s.ok())
         {
             WARN_LOG("Failed to write batch data for reason:%s", s.ToString().c_str());
@@ -262,6 +320,19 @@ namespace ardb
         return 0;
     }
 
+    /*
+     * With 'leveldb.sync' set, concurrent writers share one log sync through the group committer.
+     */
+    int LevelDBEngine::Write(leveldb::WriteBatch& batch, uint32 bytes)
+    {
+        if (m_cfg.sync)
+        {
+            return m_group_commit.Commit(&batch, bytes);
+        }
+        void* batches[] = { &batch };
+        return WriteGroupBatch(this, batches, 1, false);
+    }
+
     void LevelDBEngine::CompactRange(const Slice& begin, const Slice& end)
     {
         leveldb::Slice s(begin.data(), begin.size());
@@ -271,15 +342,74 @@ namespace ardb
         m_db->CompactRange(start, endpos);
     }
 
+    /*
+     * LevelDB can neither pin its live files nor stop deleting them, so the checkpoint is a new db built
+     * from a snapshot iterator. Keys arrive sorted, so it is written with few compactions.
+     */
+    int LevelDBEngine::Checkpoint(const std::string& dir)
+    {
+        if (is_dir_exist(dir) || is_file_exist(dir))
+        {
+            ERROR_LOG("Checkpoint dir %s already exists.", dir.c_str());
+            return -1;
+        }
+        leveldb::Options options = m_options;
+        options.block_cache = NULL;
+        options.info_log = NULL;
+        options.error_if_exists = true;
+        options.write_buffer_size = 64 * 1024 * 1024;
+        leveldb::DB* checkpoint = NULL;
+        leveldb::Status s = leveldb::DB::Open(options, dir.c_str(), &checkpoint);
+        if (!s.ok())
+        {
+            ERROR_LOG("Failed to create checkpoint at %s for reason:%s", dir.c_str(), s.ToString().c_str());
+            return -1;
+        }
+        leveldb::ReadOptions read_options;
+        read_options.fill_cache = false;
+        read_options.snapshot = m_db->GetSnapshot();
+        leveldb::Iterator* iter = m_db->NewIterator(read_options);
+        leveldb::WriteBatch batch;
+        size_t batch_bytes = 0;
+        for (iter->SeekToFirst(); s.ok() && iter->Valid(); iter->Next())
+        {
+            batch.Put(iter->key(), iter->value());
+            batch_bytes += iter->key().size() + iter->value().size();
+            if (batch_bytes >= 4 * 1024 * 1024)
+            {
+                s = checkpoint->Write(leveldb::WriteOptions(), &batch);
+                batch.Clear();
+                batch_bytes = 0;
+            }
+        }
+        if (s.ok())
+        {
+            leveldb::WriteOptions write_options;
+            write_options.sync = true;
+            s = checkpoint->Write(write_options, &batch);
+        }
+        delete iter;
+        m_db->ReleaseSnapshot(read_options.snapshot);
+        delete checkpoint;
+        if (!s.ok())
+        {
+            ERROR_LOG("Failed to write checkpoint at %s for reason:%s", dir.c_str(), s.ToString().c_str());
+            return -1;
+        }
+        return 0;
+    }
+
     void LevelDBEngine::ContextHolder::Put(const Slice& key, const Slice& value)
     {
         batch.Put(LEVELDB_SLICE(key), LEVELDB_SLICE(value));
         count++;
+        bytes += key.size() + value.size();
     }
     void LevelDBEngine::ContextHolder::Del(const Slice& key)
     {
         batch.Delete(LEVELDB_SLICE(key));
         count++;
+        bytes += key.size();
     }
 
     int LevelDBEngine::Put(const Slice& key, const Slice& value, const Options& options)
@@ -295,6 +425,12 @@ namespace ardb
                 ret = FlushWriteBatch(holder);
             }
         }
+        else if (m_cfg.sync)
+        {
+            leveldb::WriteBatch batch;
+            batch.Put(LEVELDB_SLICE(key), LEVELDB_SLICE(value));
+            ret = Write(batch, key.size() + value.size());
+        }
         else
         {
             s = m_db->Put(leveldb::WriteOptions(), LEVELDB_SLICE(key), LEVELDB_SLICE(value));
@@ -327,6 +463,12 @@ namespace ardb
                 FlushWriteBatch(holder);
             }
         }
+        else if (m_cfg.sync)
+        {
+            leveldb::WriteBatch batch;
+            batch.Delete(LEVELDB_SLICE(key));
+            return Write(batch, key.size());
+        }
         else
         {
             s = m_db->Delete(leveldb::WriteOptions(), LEVELDB_SLICE(key));
@@ -342,16 +484,23 @@ namespace ardb
     {
         leveldb::ReadOptions read_options;
         read_options.fill_cache = options.seek_fill_cache;
-        ContextHolder& holder = m_context.GetValue();
-        if (NULL == holder.snapshot)
+        if (NULL != options.snapshot)
         {
-            holder.snapshot = m_db->GetSnapshot();
+            read_options.snapshot = (const leveldb::Snapshot*) options.snapshot;
+        }
+        else
+        {
+            ContextHolder& holder = m_context.GetValue();
+            if (NULL == holder.snapshot)
+            {
+                holder.snapshot = m_db->GetSnapshot();
+            }
+            holder.snapshot_ref++;
+            read_options.snapshot = holder.snapshot;
         }
-        holder.snapshot_ref++;
-        read_options.snapshot = holder.snapshot;
         leveldb::Iterator* iter = m_db->NewIterator(read_options);
         iter->Seek(LEVELDB_SLICE(findkey));
-        return new LevelDBIterator(this, iter);
+        return new LevelDBIterator(this, iter, options.upper_bound, NULL == options.snapshot);
     }
 
     void LevelDBEngine::ReleaseContextSnapshot()
@@ -368,13 +517,26 @@ namespace ardb
         }
     }
 
+    const void* LevelDBEngine::NewSnapshot()
+    {
+        return m_db->GetSnapshot();
+    }
+
+    void LevelDBEngine::ReleaseSnapshot(const void* snapshot)
+    {
+        m_db->ReleaseSnapshot((const leveldb::Snapshot*) snapshot);
+    }
+
     const std::string LevelDBEngine::Stats()
     {
         std::string str, version_info;
         version_info.append("LevelDB version:").append(stringfromll(leveldb::kMajorVersion)).append(".").append(
                 stringfromll(leveldb::kMinorVersion)).append("\r\n");
         m_db->GetProperty("leveldb.stats", &str);
-
+        if (m_cfg.sync)
+        {
+            m_group_commit.PrintStat(version_info);
+        }
         return version_info + str;
     }
 
@@ -386,7 +548,10 @@ namespace ardb
     LevelDBIterator::~LevelDBIterator()
     {
         delete m_iter;
-        m_engine->ReleaseContextSnapshot();
+        if (m_context_snapshot)
+        {
+            m_engine->ReleaseContextSnapshot();
+        }
     }
 
 }
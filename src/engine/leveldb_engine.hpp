@@ -35,6 +35,7 @@
 #include "leveldb/cache.h"
 #include "leveldb/filter_policy.h"
 #include "engine.hpp"
+#include "group_commit.hpp"
 #include "util/config_helper.hpp"
 #include "thread/thread_local.hpp"
 #include <stack>
@@ -47,6 +48,8 @@ namespace ardb
         private:
             LevelDBEngine* m_engine;
             leveldb::Iterator* m_iter;
+            std::string m_upper_bound;
+            bool m_context_snapshot;
             void Next();
             void Prev();
             Slice Key() const;
@@ -56,8 +59,10 @@ namespace ardb
             void SeekToLast();
             void Seek(const Slice& target);
         public:
-            LevelDBIterator(LevelDBEngine* engine, leveldb::Iterator* iter) :
-                    m_engine(engine), m_iter(iter)
+            LevelDBIterator(LevelDBEngine* engine, leveldb::Iterator* iter, const Slice& upper_bound,
+                    bool context_snapshot) :
+                    m_engine(engine), m_iter(iter), m_upper_bound(upper_bound.data(), upper_bound.size()), m_context_snapshot(
+                            context_snapshot)
             {
 
             }
@@ -114,9 +119,13 @@ namespace ardb
             int64 batch_commit_watermark;
             std::string compression;
             bool logenable;
+            bool sync;
+            int64 group_commit_max_delay_us;
+            int64 group_commit_max_bytes;
             LevelDBConfig() :
                     block_cache_size(0), write_buffer_size(0), max_open_files(10240), block_size(0), block_restart_interval(
-                            0), bloom_bits(10), batch_commit_watermark(1024),compression("snappy"),logenable(false)
+                            0), bloom_bits(10), batch_commit_watermark(1024),compression("snappy"),logenable(false), sync(
+                            false), group_commit_max_delay_us(0), group_commit_max_bytes(1024 * 1024)
             {
             }
     };
@@ -131,6 +140,7 @@ namespace ardb
                     leveldb::WriteBatch batch;
                     uint32 ref;
                     uint32 count;
+                    uint32 bytes;
                     const leveldb::Snapshot* snapshot;
                     uint32 snapshot_ref;
 
@@ -151,11 +161,12 @@ namespace ardb
                     {
                         batch.Clear();
                         count = 0;
+                        bytes = 0;
                     }
                     void Put(const Slice& key, const Slice& value);
                     void Del(const Slice& key);
                     ContextHolder() :
-                            ref(0), count(0), snapshot(NULL), snapshot_ref(0)
+                            ref(0), count(0), bytes(0), snapshot(NULL), snapshot_ref(0)
                     {
                     }
             };
@@ -164,8 +175,12 @@ namespace ardb
 
             LevelDBConfig m_cfg;
             leveldb::Options m_options;
+            GroupCommitter m_group_commit;
             friend class LevelDBEngineFactory;
+            friend class LevelDBIterator;
             int FlushWriteBatch(ContextHolder& holder);
+            int Write(leveldb::WriteBatch& batch, uint32 bytes);
+            static int WriteGroupBatch(void* engine, void** batches, size_t count, bool sync);
         public:
             LevelDBEngine();
             ~LevelDBEngine();
@@ -179,7 +194,10 @@ namespace ardb
             Iterator* Find(const Slice& findkey, const Options& options);
             const std::string Stats();
             void CompactRange(const Slice& begin, const Slice& end);
+            int Checkpoint(const std::string& dir);
             void ReleaseContextSnapshot();
+            const void* NewSnapshot();
+            void ReleaseSnapshot(const void* snapshot);
             int MaxOpenFiles();
     };
 
@@ -150,6 +150,27 @@ namespace ardb
 
     }
 
+    /*
+     * mdb_env_copy copies the env inside one read transaction, so writers are not blocked. The vendored
+     * LMDB(0.9.13) predates mdb_env_copy2, so free pages are copied too.
+     */
+    int LMDBEngine::Checkpoint(const std::string& dir)
+    {
+        if (is_dir_exist(dir) || is_file_exist(dir))
+        {
+            ERROR_LOG("Checkpoint dir %s already exists.", dir.c_str());
+            return -1;
+        }
+        make_dir(dir);
+        int rc = mdb_env_copy(m_env, dir.c_str());
+        if (0 != rc)
+        {
+            ERROR_LOG("Failed to create checkpoint at %s for reason:%s", dir.c_str(), mdb_strerror(rc));
+            return -1;
+        }
+        return 0;
+    }
+
     void LMDBEngine::Run()
     {
         while (m_running)
@@ -264,7 +285,10 @@ namespace ardb
             ERROR_LOG("Failed to open mdb:%s for reason:%s\n", name.c_str(), mdb_strerror(rc));
             return -1;
         }
-        mdb_set_compare(txn, m_dbi, LMDBCompareFunc);
+        if (!CommonComparator::Bytewise())
+        {
+            mdb_set_compare(txn, m_dbi, LMDBCompareFunc);
+        }
         mdb_txn_commit(txn);
         m_running = true;
         m_background = new Thread(this);
@@ -129,6 +129,7 @@ namespace ardb
             int DiscardBatchWrite();
             const std::string Stats();
             Iterator* Find(const Slice& findkey, const Options& options);
+            int Checkpoint(const std::string& dir);
             void Close();
             void Clear();
             int MaxOpenFiles();
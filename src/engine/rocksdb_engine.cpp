@@ -34,10 +34,13 @@
 #include "rocksdb/rate_limiter.h"
 #include "rocksdb/table.h"
 #include <string.h>
+#include <algorithm>
 #include <stdarg.h>
 
 #define ROCKSDB_SLICE(slice) rocksdb::Slice(slice.data(), slice.size())
 #define ARDB_SLICE(slice) Slice(slice.data(), slice.size())
+/* marks data dirs whose sst files were all written with the prefix extractor */
+#define ROCKSDB_PREFIX_MARK "ARDB_PREFIX_FILTERS"
 
 namespace ardb
 {
@@ -60,6 +63,21 @@ namespace ardb
         return CommonComparator::Compare(a.data(), a.size(), b.data(), b.size());
     }
 
+    rocksdb::Slice RocksDBPrefixExtractor::Transform(const rocksdb::Slice& src) const
+    {
+        return rocksdb::Slice(src.data(), CommonComparator::PrefixLength(src.data(), src.size()));
+    }
+
+    bool RocksDBPrefixExtractor::InDomain(const rocksdb::Slice& src) const
+    {
+        return CommonComparator::PrefixLength(src.data(), src.size()) > 0;
+    }
+
+    bool RocksDBPrefixExtractor::InRange(const rocksdb::Slice& dst) const
+    {
+        return CommonComparator::PrefixLength(dst.data(), dst.size()) == dst.size();
+    }
+
     void RocksDBComparator::FindShortestSeparator(std::string* start, const rocksdb::Slice& limit) const
     {
     }
@@ -91,6 +109,14 @@ namespace ardb
         conf_get_int64(props, "rocksdb.flush_compact_rate_bytes_per_sec", cfg.flush_compact_rate_bytes_per_sec);
         conf_get_double(props, "rocksdb.hard_rate_limit", cfg.hard_rate_limit);
         conf_get_bool(props, "rocksdb.disableWAL", cfg.disableWAL);
+        conf_get_bool(props, "rocksdb.sync", cfg.sync);
+        conf_get_int64(props, "rocksdb.group_commit_max_delay_us", cfg.group_commit_max_delay_us);
+        conf_get_int64(props, "rocksdb.group_commit_max_bytes", cfg.group_commit_max_bytes);
+        if (cfg.sync && cfg.disableWAL)
+        {
+            WARN_LOG("[Config]'rocksdb.sync' is ignored since 'rocksdb.disableWAL' is set.");
+            cfg.sync = false;
+        }
         conf_get_int64(props, "rocksdb.max_manifest_file_size", cfg.max_manifest_file_size);
         conf_get_string(props, "rocksdb.compacton_style", cfg.compacton_style);
     }
@@ -168,8 +194,12 @@ namespace ardb
     int RocksDBEngine::Init(const RocksDBConfig& cfg)
     {
         m_cfg = cfg;
+        m_group_commit.Init(this, WriteGroupBatch, cfg.group_commit_max_delay_us, cfg.group_commit_max_bytes);
         m_options.create_if_missing = true;
-        m_options.comparator = &m_comparator;
+        if (!CommonComparator::Bytewise())
+        {
+            m_options.comparator = &m_comparator;
+        }
         rocksdb::BlockBasedTableOptions block_options;
         if (cfg.block_cache_size > 0)
         {
@@ -197,6 +227,20 @@ namespace ardb
             //m_options.filter_policy = rocksdb::NewBloomFilterPolicy(cfg.bloom_bits);
         }
         m_options.table_factory.reset(rocksdb::NewBlockBasedTableFactory(block_options));
+        /*
+         * SST files written without the extractor have no prefix filter entries, and rocksdb would read their
+         * whole-key filters as prefix filters, so prefix seeks on an older data dir miss existing keys.
+         * Only dirs created with the extractor (marked by ROCKSDB_PREFIX_MARK) enable it.
+         */
+        bool new_dir = !is_file_exist(cfg.path + "/CURRENT");
+        if (new_dir || is_file_exist(cfg.path + "/" + ROCKSDB_PREFIX_MARK))
+        {
+            m_options.prefix_extractor.reset(new RocksDBPrefixExtractor);
+        }
+        else
+        {
+            WARN_LOG("Prefix filters disabled for data dir:%s created without them.", cfg.path.c_str());
+        }
 
         if (cfg.write_buffer_size > 0)
         {
@@ -261,6 +305,11 @@ namespace ardb
                 break;
             }
         } while (1);
+        if (status.ok() && new_dir && file_write_content(cfg.path + "/" + ROCKSDB_PREFIX_MARK, "") != 0)
+        {
+            ERROR_LOG("Failed to write %s under %s", ROCKSDB_PREFIX_MARK, cfg.path.c_str());
+            return -1;
+        }
         return status.ok() ? 0 : -1;
     }
 
@@ -289,10 +338,55 @@ namespace ardb
 
     int RocksDBEngine::FlushWriteBatch(ContextHolder& holder)
     {
-        rocksdb::WriteOptions options;
-        options.disableWAL = m_cfg.disableWAL;
-        rocksdb::Status s = m_db->Write(options, &holder.batch);
+        int ret = Write(holder.batch);
         holder.Clear();
+        return ret;
+    }
+
+    /*
+     * Copies the operations of a write batch into another one.
+     */
+    class RocksDBBatchAppender: public rocksdb::WriteBatch::Handler
+    {
+        private:
+            rocksdb::WriteBatch& m_dst;
+        public:
+            RocksDBBatchAppender(rocksdb::WriteBatch& dst) :
+                    m_dst(dst)
+            {
+            }
+            void Put(const rocksdb::Slice& key, const rocksdb::Slice& value)
+            {
+                m_dst.Put(key, value);
+            }
+            void Merge(const rocksdb::Slice& key, const rocksdb::Slice& value)
+            {
+                m_dst.Merge(key, value);
+            }
+            void Delete(const rocksdb::Slice& key)
+            {
+                m_dst.Delete(key);
+            }
+    };
+
+    int RocksDBEngine::WriteGroupBatch(void* engine, void** batches, size_t count, bool sync)
+    {
+        RocksDBEngine* self = (RocksDBEngine*) engine;
+        rocksdb::WriteOptions options;
+        options.disableWAL = self->m_cfg.disableWAL;
+        options.sync = sync;
+        rocksdb::WriteBatch* batch = (rocksdb::WriteBatch*) batches[0];
+        rocksdb::WriteBatch merged;
+        if (count > 1)
+        {
+            RocksDBBatchAppender appender(merged);
+            for (size_t i = 0; i < count; i++)
+            {
+                ((rocksdb::WriteBatch*) batches[i])->Iterate(&appender);
+            }
+            batch = &merged;
+        }
+        rocksdb::Status s = self->m_db->Write(options, batch);
         if (!s.ok())
         {
             WARN_LOG("Failed to write batch data for reason:%s", s.ToString().c_str());
@@ -301,6 +395,19 @@ namespace ardb
         return 0;
     }
 
+    /*
+     * With 'rocksdb.sync' set, concurrent writers share one log sync through the group committer.
+     */
+    int RocksDBEngine::Write(rocksdb::WriteBatch& batch)
+    {
+        if (m_cfg.sync)
+        {
+            return m_group_commit.Commit(&batch, batch.GetDataSize());
+        }
+        void* batches[] = { &batch };
+        return WriteGroupBatch(this, batches, 1, false);
+    }
+
     void RocksDBEngine::CompactRange(const Slice& begin, const Slice& end)
     {
         rocksdb::Slice s(begin.data(), begin.size());
@@ -310,6 +417,74 @@ namespace ardb
         m_db->CompactRange(start, endpos);
     }
 
+    /*
+     * Live SST files are hard linked, the manifest is copied and the memtable is flushed first, so
+     * no WAL replay is needed to open the checkpoint.
+     */
+    int RocksDBEngine::Checkpoint(const std::string& dir)
+    {
+        rocksdb::Checkpoint* checkpoint = NULL;
+        rocksdb::Status s = rocksdb::Checkpoint::Create(m_db, &checkpoint);
+        if (s.ok())
+        {
+            s = checkpoint->CreateCheckpoint(dir);
+        }
+        DELETE(checkpoint);
+        if (!s.ok())
+        {
+            ERROR_LOG("Failed to create checkpoint at %s for reason:%s", dir.c_str(), s.ToString().c_str());
+            return -1;
+        }
+        if (NULL != m_options.prefix_extractor.get() && file_write_content(dir + "/" + ROCKSDB_PREFIX_MARK, "") != 0)
+        {
+            ERROR_LOG("Failed to write %s under checkpoint %s", ROCKSDB_PREFIX_MARK, dir.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    /*
+     * Live sst files sorted by smallest key, a file starts a new range once the sizes before it pass the
+     * next share. Overlapping L0 files make the cuts approximate, which is enough to balance scans.
+     */
+    int RocksDBEngine::EstimateSplitKeys(uint32 parts, std::vector<std::string>& keys)
+    {
+        std::vector<rocksdb::LiveFileMetaData> files;
+        m_db->GetLiveFilesMetaData(&files);
+        if (files.empty() || parts <= 1)
+        {
+            return -1;
+        }
+        struct FileCompare
+        {
+                const rocksdb::Comparator* cmp;
+                bool operator()(const rocksdb::LiveFileMetaData& a, const rocksdb::LiveFileMetaData& b) const
+                {
+                    return cmp->Compare(a.smallestkey, b.smallestkey) < 0;
+                }
+        } file_cmp;
+        file_cmp.cmp = m_options.comparator;
+        std::sort(files.begin(), files.end(), file_cmp);
+        uint64 total = 0;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            total += files[i].size;
+        }
+        uint64 acc = 0;
+        for (size_t i = 0; i < files.size() && keys.size() + 1 < parts; i++)
+        {
+            if (acc >= total / parts * (keys.size() + 1) && acc > 0)
+            {
+                if (keys.empty() || m_options.comparator->Compare(keys.back(), files[i].smallestkey) < 0)
+                {
+                    keys.push_back(files[i].smallestkey);
+                }
+            }
+            acc += files[i].size;
+        }
+        return 0;
+    }
+
     void RocksDBEngine::ContextHolder::Put(const Slice& key, const Slice& value)
     {
         batch.Put(ROCKSDB_SLICE(key), ROCKSDB_SLICE(value));
@@ -333,6 +508,12 @@ namespace ardb
                 return FlushWriteBatch(holder);
             }
         }
+        else if (m_cfg.sync)
+        {
+            rocksdb::WriteBatch batch;
+            batch.Put(ROCKSDB_SLICE(key), ROCKSDB_SLICE(value));
+            return Write(batch);
+        }
         else
         {
             rocksdb::WriteOptions options;
@@ -355,6 +536,43 @@ namespace ardb
         rocksdb::Status s = m_db->Get(read_options, ROCKSDB_SLICE(key), value);
         return s.ok() ? 0 : -1;
     }
+    /*
+     * Only the memtables, bloom filters and the block cache are looked at.
+     */
+    int RocksDBEngine::KeyMayExist(const Slice& key, std::string* value, const Options& options)
+    {
+        rocksdb::ReadOptions read_options;
+        read_options.verify_checksums = false;
+        ContextHolder& holder = m_context.GetValue();
+        read_options.snapshot = holder.snapshot;
+        bool found = false;
+        if (!m_db->KeyMayExist(read_options, ROCKSDB_SLICE(key), value, &found))
+        {
+            return 0;
+        }
+        return found ? 1 : -1;
+    }
+    void RocksDBEngine::MultiGet(const std::vector<Slice>& keys, std::vector<std::string>& values,
+            std::vector<int>& errs, const Options& options)
+    {
+        rocksdb::ReadOptions read_options;
+        read_options.fill_cache = options.read_fill_cache;
+        read_options.verify_checksums = false;
+        ContextHolder& holder = m_context.GetValue();
+        read_options.snapshot = holder.snapshot;
+        std::vector<rocksdb::Slice> rkeys;
+        rkeys.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            rkeys.push_back(ROCKSDB_SLICE(keys[i]));
+        }
+        std::vector<rocksdb::Status> ss = m_db->MultiGet(read_options, rkeys, &values);
+        errs.resize(keys.size());
+        for (size_t i = 0; i < ss.size(); i++)
+        {
+            errs[i] = ss[i].ok() ? 0 : -1;
+        }
+    }
     int RocksDBEngine::Del(const Slice& key, const Options& options)
     {
         rocksdb::Status s = rocksdb::Status::OK();
@@ -367,6 +585,12 @@ namespace ardb
                 return FlushWriteBatch(holder);
             }
         }
+        else if (m_cfg.sync)
+        {
+            rocksdb::WriteBatch batch;
+            batch.Delete(ROCKSDB_SLICE(key));
+            return Write(batch);
+        }
         else
         {
             s = m_db->Delete(rocksdb::WriteOptions(), ROCKSDB_SLICE(key));
@@ -382,16 +606,34 @@ namespace ardb
     {
         rocksdb::ReadOptions read_options;
         read_options.fill_cache = options.seek_fill_cache;
-        ContextHolder& holder = m_context.GetValue();
-        if (NULL == holder.snapshot)
+        RocksDBIterator* iter = new RocksDBIterator(this, options.upper_bound);
+        if (NULL != options.snapshot)
         {
-            holder.snapshot = m_db->GetSnapshot();
+            read_options.snapshot = (const rocksdb::Snapshot*) options.snapshot;
+            iter->m_context_snapshot = false;
         }
-        holder.snapshot_ref++;
-        read_options.snapshot = holder.snapshot;
-        rocksdb::Iterator* iter = m_db->NewIterator(read_options);
-        iter->Seek(ROCKSDB_SLICE(findkey));
-        return new RocksDBIterator(this, iter);
+        else
+        {
+            ContextHolder& holder = m_context.GetValue();
+            if (NULL == holder.snapshot)
+            {
+                holder.snapshot = m_db->GetSnapshot();
+            }
+            holder.snapshot_ref++;
+            read_options.snapshot = holder.snapshot;
+        }
+        if (options.upper_bound.empty())
+        {
+            /* unbounded scans may cross prefixes, which prefix seek does not order */
+            read_options.total_order_seek = true;
+        }
+        else
+        {
+            read_options.iterate_upper_bound = &(iter->m_upper_bound_slice);
+        }
+        iter->m_iter = m_db->NewIterator(read_options);
+        iter->m_iter->Seek(ROCKSDB_SLICE(findkey));
+        return iter;
     }
 
     void RocksDBEngine::ReleaseContextSnapshot()
@@ -408,6 +650,16 @@ namespace ardb
         }
     }
 
+    const void* RocksDBEngine::NewSnapshot()
+    {
+        return m_db->GetSnapshot();
+    }
+
+    void RocksDBEngine::ReleaseSnapshot(const void* snapshot)
+    {
+        m_db->ReleaseSnapshot((const rocksdb::Snapshot*) snapshot);
+    }
+
     const std::string RocksDBEngine::Stats()
     {
         std::string all, str, version_info;
@@ -447,6 +699,10 @@ namespace ardb
         {
             all.append("estimate-table-readers-mem:").append(sv).append("\r\n");
         }
+        if (m_cfg.sync)
+        {
+            m_group_commit.PrintStat(all);
+        }
         m_db->GetProperty("rocksdb.stats", &str);
         all.append(str);
         return all;
@@ -460,7 +716,10 @@ namespace ardb
     RocksDBIterator::~RocksDBIterator()
     {
         delete m_iter;
-        m_engine->ReleaseContextSnapshot();
+        if (m_context_snapshot)
+        {
+            m_engine->ReleaseContextSnapshot();
+        }
     }
 
 }
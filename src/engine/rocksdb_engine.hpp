@@ -34,8 +34,11 @@
 #include "rocksdb/comparator.h"
 #include "rocksdb/cache.h"
 #include "rocksdb/filter_policy.h"
+#include "rocksdb/slice_transform.h"
+#include "rocksdb/utilities/checkpoint.h"
 
 #include "engine.hpp"
+#include "group_commit.hpp"
 #include "util/config_helper.hpp"
 #include "thread/thread_local.hpp"
 #include <stack>
@@ -48,6 +51,9 @@ namespace ardb
         private:
             RocksDBEngine* m_engine;
             rocksdb::Iterator* m_iter;
+            std::string m_upper_bound;
+            rocksdb::Slice m_upper_bound_slice;
+            bool m_context_snapshot;
             void Next();
             void Prev();
             Slice Key() const;
@@ -56,15 +62,33 @@ namespace ardb
             void SeekToFirst();
             void SeekToLast();
             void Seek(const Slice& target);
+            friend class RocksDBEngine;
         public:
-            RocksDBIterator(RocksDBEngine* engine, rocksdb::Iterator* iter) :
-                    m_engine(engine), m_iter(iter)
+            RocksDBIterator(RocksDBEngine* engine, const Slice& upper_bound) :
+                    m_engine(engine), m_iter(NULL), m_upper_bound(upper_bound.data(), upper_bound.size()), m_context_snapshot(
+                            true)
             {
-
+                m_upper_bound_slice = rocksdb::Slice(m_upper_bound);
             }
             ~RocksDBIterator();
     };
 
+    /*
+     * Extracts the (db, type, key) prefix of encoded keys, so that a collection's sub-keys share one
+     * prefix bloom entry and prefix bounded iterators can skip files without the collection.
+     */
+    class RocksDBPrefixExtractor: public rocksdb::SliceTransform
+    {
+        public:
+            const char* Name() const
+            {
+                return "ArdbKeyPrefix";
+            }
+            rocksdb::Slice Transform(const rocksdb::Slice& src) const;
+            bool InDomain(const rocksdb::Slice& src) const;
+            bool InRange(const rocksdb::Slice& dst) const;
+    };
+
     class RocksDBComparator: public rocksdb::Comparator
     {
         public:
@@ -120,13 +144,17 @@ namespace ardb
             double hard_rate_limit;
             int64 flush_compact_rate_bytes_per_sec;
             bool disableWAL;
+            bool sync;
+            int64 group_commit_max_delay_us;
+            int64 group_commit_max_bytes;
             int64 max_manifest_file_size;
             std::string compacton_style;
             RocksDBConfig() :
                     block_cache_size(0), block_cache_compressed_size(0), write_buffer_size(0), max_open_files(10240), block_size(
                             0), block_restart_interval(0), bloom_bits(10), batch_commit_watermark(1024), compression(
                             "snappy"), logenable(false), skip_log_error_on_recovery(false), hard_rate_limit(2.0), flush_compact_rate_bytes_per_sec(
-                            0), disableWAL(false),max_manifest_file_size(0),compacton_style("level")
+                            0), disableWAL(false), sync(false), group_commit_max_delay_us(0), group_commit_max_bytes(
+                            1024 * 1024), max_manifest_file_size(0),compacton_style("level")
             {
             }
     };
@@ -174,14 +202,20 @@ namespace ardb
 
             RocksDBConfig m_cfg;
             rocksdb::Options m_options;
+            GroupCommitter m_group_commit;
             friend class RocksDBEngineFactory;
             int FlushWriteBatch(ContextHolder& holder);
+            int Write(rocksdb::WriteBatch& batch);
+            static int WriteGroupBatch(void* engine, void** batches, size_t count, bool sync);
         public:
             RocksDBEngine();
             ~RocksDBEngine();
             int Init(const RocksDBConfig& cfg);
             int Put(const Slice& key, const Slice& value, const Options& options);
             int Get(const Slice& key, std::string* value, const Options& options);
+            int KeyMayExist(const Slice& key, std::string* value, const Options& options);
+            void MultiGet(const std::vector<Slice>& keys, std::vector<std::string>& values, std::vector<int>& errs,
+                    const Options& options);
             int Del(const Slice& key, const Options& options);
             int BeginBatchWrite();
             int CommitBatchWrite();
@@ -189,7 +223,11 @@ namespace ardb
             Iterator* Find(const Slice& findkey, const Options& options);
             const std::string Stats();
             void CompactRange(const Slice& begin, const Slice& end);
+            int Checkpoint(const std::string& dir);
+            int EstimateSplitKeys(uint32 parts, std::vector<std::string>& keys);
             void ReleaseContextSnapshot();
+            const void* NewSnapshot();
+            void ReleaseSnapshot(const void* snapshot);
             int MaxOpenFiles();
     };
 
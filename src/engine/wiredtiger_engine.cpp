@@ -297,6 +297,15 @@ namespace ardb
         }
         ret = m_db->add_collator(m_db, "ardb_comparator", &ardb_comparator, NULL);
         CHECK_WT_RETURN(ret);
+        if (m_cfg.init_table_options.empty())
+        {
+            m_cfg.init_table_options = "key_format=u,value_format=u,prefix_compression=true";
+        }
+        if (!CommonComparator::Bytewise()
+                && m_cfg.init_table_options.find("collator=ardb_comparator") == std::string::npos)
+        {
+            m_cfg.init_table_options.append(",collator=ardb_comparator");
+        }
 //        m_running = true;
 //        m_background = new Thread(this);
 //        m_background->Start();
@@ -315,18 +324,6 @@ namespace ardb
             }
             else
             {
-                if (m_cfg.init_table_options.empty())
-                {
-                    m_cfg.init_table_options =
-                            "key_format=u,value_format=u,prefix_compression=true,collator=ardb_comparator";
-                }
-                else
-                {
-                    if (m_cfg.init_table_options.find("collator=ardb_comparator") == std::string::npos)
-                    {
-                        m_cfg.init_table_options.append(",collator=ardb_comparator");
-                    }
-                }
                 ret = holder.session->create(holder.session, ARDB_TABLE, m_cfg.init_table_options.c_str());
                 CHECK_WT_RETURN(ret);
             }
@@ -678,6 +675,56 @@ namespace ardb
 
     }
 
+    /*
+     * A backup cursor lists the files of the last checkpoint and keeps them stable until it is closed.
+     * WiredTiger rewrites its files in place, so they are copied instead of linked.
+     */
+    int WiredTigerEngine::Checkpoint(const std::string& dir)
+    {
+        if (is_dir_exist(dir) || is_file_exist(dir))
+        {
+            ERROR_LOG("Checkpoint dir %s already exists.", dir.c_str());
+            return -1;
+        }
+        WT_SESSION* session = NULL;
+        int ret = m_db->open_session(m_db, NULL, NULL, &session);
+        if (0 != ret)
+        {
+            ERROR_LOG("Error opening a session on %s: %s", m_cfg.path.c_str(), wiredtiger_strerror(ret));
+            return -1;
+        }
+        ret = session->checkpoint(session, NULL);
+        WT_CURSOR* cursor = NULL;
+        if (0 == ret)
+        {
+            ret = session->open_cursor(session, "backup:", NULL, NULL, &cursor);
+        }
+        if (0 == ret)
+        {
+            make_dir(dir);
+            const char* filename = NULL;
+            while (0 == ret && (ret = cursor->next(cursor)) == 0)
+            {
+                cursor->get_key(cursor, &filename);
+                std::string src = m_cfg.path + "/" + filename;
+                if (0 != copy_file(src, dir + "/" + filename))
+                {
+                    ERROR_LOG("Failed to copy %s into checkpoint %s", src.c_str(), dir.c_str());
+                    ret = -1;
+                }
+            }
+            cursor->close(cursor);
+            ret = (ret == WT_NOTFOUND ? 0 : ret);
+        }
+        session->close(session, NULL);
+        if (0 != ret)
+        {
+            ERROR_LOG("Failed to create checkpoint at %s", dir.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
     int WiredTigerEngine::MaxOpenFiles()
     {
         //return m_options.max_open_files;
@@ -140,6 +140,7 @@ namespace ardb
             Iterator* Find(const Slice& findkey, const Options& options);
             const std::string Stats();
             void CompactRange(const Slice& begin, const Slice& end);
+            int Checkpoint(const std::string& dir);
             int MaxOpenFiles();
     };
 
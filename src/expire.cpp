@@ -0,0 +1,304 @@
+/*
+ *Copyright (c) 2013-2014, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "expire.hpp"
+#include "ardb.hpp"
+#include "util/atomic.hpp"
+
+OP_NAMESPACE_BEGIN
+
+    static const uint32 kExpireCycleIntervalMillis = 100;
+    static const uint32 kExpireFastCycleIntervalMillis = 5;
+
+    void ExpireSweeper::Run()
+    {
+        while (running)
+        {
+            uint32 wait = manager.Cycle(*this);
+            while (running && wait > 0)
+            {
+                uint32 step = wait > 10 ? 10 : wait;
+                Thread::Sleep(step);
+                wait -= step;
+            }
+        }
+    }
+
+    ExpireManager::ExpireManager() :
+            m_expired_keys(0), m_stale_entries(0), m_cycles(0), m_fast_cycles(0), m_max_lag_millis(0)
+    {
+    }
+
+    /*
+     * Delete at most 'max_keys' expired keys of db in one write batch, 'more' is set if expired keys are left
+     * behind. The deleted keys are added to 'del' as one DEL/UNLINK only if the batch committed, returns the
+     * number of index entries handled, or -1 if the batch failed.
+     */
+    int ExpireManager::ExpireBatch(DBID db, uint32 max_keys, bool& more, uint64& lag, RedisCommandFrame& del,
+            uint32& stale)
+    {
+        more = false;
+        stale = 0;
+        uint64 now = get_current_epoch_millis();
+        KeyObject start;
+        start.db = db;
+        start.type = KEY_EXPIRATION_ELEMENT;
+        start.score.SetInt64(0);
+        StringArray keys;
+        std::vector<uint64> expireats;
+        Iterator* iter = g_db->IteratorKeyValue(start, false);
+        while (NULL != iter && iter->Valid())
+        {
+            KeyObject k;
+            if (!decode_key(iter->Key(), k) || k.db != db || k.type != KEY_EXPIRATION_ELEMENT)
+            {
+                break;
+            }
+            if (k.score.value.iv > (int64) now)
+            {
+                break;
+            }
+            if (keys.size() >= max_keys)
+            {
+                more = true;
+                break;
+            }
+            if (keys.empty())
+            {
+                lag = now - k.score.value.iv;
+            }
+            keys.push_back(std::string(k.key.data(), k.key.size()));
+            expireats.push_back(k.score.value.iv);
+            iter->Next();
+        }
+        DELETE(iter);
+        if (keys.empty())
+        {
+            return 0;
+        }
+
+        bool lazy = g_db->GetConfig().lazyfree_lazy_expire;
+        RedisCommandFrame deleted(lazy ? "unlink" : "del");
+        SliceArray lock_keys;
+        for (uint32 i = 0; i < keys.size(); i++)
+        {
+            lock_keys.push_back(keys[i]);
+        }
+        MultiKeyLockerGuard keylock(g_db->m_key_lock, db, lock_keys);
+        Context tmpctx;
+        tmpctx.currentDB = db;
+        {
+            BatchWriteGuard guard(tmpctx);
+            for (uint32 i = 0; i < keys.size(); i++)
+            {
+                ValueObject meta;
+                meta.key.type = KEY_META;
+                meta.key.db = db;
+                meta.key.key = keys[i];
+                if (0 == g_db->GetKeyValue(tmpctx, meta.key, &meta) && meta.meta.expireat == expireats[i])
+                {
+                    if (lazy)
+                    {
+                        g_db->LazyDeleteKey(tmpctx, keys[i]);
+                    }
+                    else
+                    {
+                        g_db->DeleteKey(tmpctx, keys[i]);
+                    }
+                    deleted.AddArg(keys[i]);
+                }
+                else
+                {
+                    /*
+                     * the key was deleted or got a new ttl, only the index entry is left.
+                     */
+                    KeyObject expire;
+                    expire.type = KEY_EXPIRATION_ELEMENT;
+                    expire.db = db;
+                    expire.key = keys[i];
+                    expire.score.SetInt64(expireats[i]);
+                    g_db->DelKeyValue(tmpctx, expire);
+                    stale++;
+                }
+            }
+        }
+        if (!tmpctx.write_success)
+        {
+            /*
+             * nothing was deleted, the index entries are still there for the next cycle.
+             */
+            WARN_LOG("Failed to commit expired keys of db:%u", db);
+            more = false;
+            stale = 0;
+            return -1;
+        }
+        del = deleted;
+        return keys.size();
+    }
+
+    /*
+     * Expire one batch of db and feed the deleted keys to slaves as one command.
+     */
+    uint32 ExpireManager::SweepDB(DBID db, uint32 max_keys, bool& more, uint64& lag)
+    {
+        RedisCommandFrame del;
+        uint32 stale = 0;
+        int count = ExpireBatch(db, max_keys, more, lag, del, stale);
+        if (count <= 0)
+        {
+            return 0;
+        }
+        if (!del.GetArguments().empty())
+        {
+            g_db->m_master.FeedSlaves(db, del);
+            atomic_add_uint64(&m_expired_keys, del.GetArguments().size());
+        }
+        if (stale > 0)
+        {
+            atomic_add_uint64(&m_stale_entries, stale);
+        }
+        return count;
+    }
+
+    uint32 ExpireManager::Cycle(ExpireSweeper& sweeper)
+    {
+        if (!g_db->GetConfig().master_host.empty())
+        {
+            /*
+             * no expire on slave, master would sync the expire/del operations to slaves.
+             */
+            sweeper.lag_millis = 0;
+            return kExpireCycleIntervalMillis;
+        }
+        DBIDSet ids;
+        g_db->GetAllDBIDSet(ids);
+
+        int64 effort = g_db->GetConfig().active_expire_effort - 1;
+        uint32 batch_keys = 128 + 64 * effort;
+        uint64 budget_millis = 25 + 10 * effort;
+        bool backlog = false;
+        uint64 max_lag = 0;
+        DBIDSet::iterator it = ids.begin();
+        while (sweeper.running && it != ids.end())
+        {
+            DBID db = *it;
+            it++;
+            if (db % m_sweepers.size() != sweeper.index)
+            {
+                continue;
+            }
+            uint64 start = get_current_epoch_millis();
+            uint64 lag = 0;
+            bool more = true;
+            bool first = true;
+            while (more && sweeper.running && get_current_epoch_millis() - start < budget_millis)
+            {
+                uint64 batch_lag = 0;
+                SweepDB(db, batch_keys, more, batch_lag);
+                if (first)
+                {
+                    lag = batch_lag;
+                    first = false;
+                }
+            }
+            if (more)
+            {
+                backlog = true;
+            }
+            if (lag > max_lag)
+            {
+                max_lag = lag;
+            }
+        }
+        sweeper.lag_millis = max_lag;
+        if (max_lag > m_max_lag_millis)
+        {
+            m_max_lag_millis = max_lag;
+        }
+        atomic_add_uint64(&m_cycles, 1);
+        if (backlog)
+        {
+            atomic_add_uint64(&m_fast_cycles, 1);
+            return kExpireFastCycleIntervalMillis;
+        }
+        return kExpireCycleIntervalMillis;
+    }
+
+    void ExpireManager::Start(uint32 threads)
+    {
+        for (uint32 i = 0; i < threads; i++)
+        {
+            ExpireSweeper* sweeper = new ExpireSweeper(*this, i);
+            m_sweepers.push_back(sweeper);
+        }
+        for (uint32 i = 0; i < m_sweepers.size(); i++)
+        {
+            m_sweepers[i]->Start();
+        }
+    }
+
+    void ExpireManager::StopSelf()
+    {
+        for (uint32 i = 0; i < m_sweepers.size(); i++)
+        {
+            m_sweepers[i]->running = false;
+        }
+        for (uint32 i = 0; i < m_sweepers.size(); i++)
+        {
+            m_sweepers[i]->Join();
+            DELETE(m_sweepers[i]);
+        }
+        m_sweepers.clear();
+    }
+
+    const std::string& ExpireManager::PrintStat(std::string& str)
+    {
+        uint64 lag = 0;
+        for (uint32 i = 0; i < m_sweepers.size(); i++)
+        {
+            if (m_sweepers[i]->lag_millis > lag)
+            {
+                lag = m_sweepers[i]->lag_millis;
+            }
+        }
+        str.append("expire_sweepers:").append(stringfromll(m_sweepers.size())).append("\r\n");
+        str.append("expired_keys:").append(stringfromll(m_expired_keys)).append("\r\n");
+        str.append("expire_stale_entries:").append(stringfromll(m_stale_entries)).append("\r\n");
+        str.append("expire_cycles:").append(stringfromll(m_cycles)).append("\r\n");
+        str.append("expire_fast_cycles:").append(stringfromll(m_fast_cycles)).append("\r\n");
+        str.append("expire_lag_ms:").append(stringfromll(lag)).append("\r\n");
+        str.append("expire_max_lag_ms:").append(stringfromll(m_max_lag_millis)).append("\r\n");
+        return str;
+    }
+
+    ExpireManager::~ExpireManager()
+    {
+        StopSelf();
+    }
+
+OP_NAMESPACE_END
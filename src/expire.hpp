@@ -0,0 +1,87 @@
+/*
+ *Copyright (c) 2013-2014, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef EXPIRE_HPP_
+#define EXPIRE_HPP_
+#include <vector>
+#include <string>
+#include "common.hpp"
+#include "codec.hpp"
+#include "thread/thread.hpp"
+#include "channel/all_includes.hpp"
+
+namespace ardb
+{
+    class ExpireManager;
+    struct ExpireSweeper: public Thread
+    {
+            ExpireManager& manager;
+            uint32 index;
+            volatile bool running;
+            volatile uint64 lag_millis; /* age of the oldest expired key seen by the last cycle */
+            ExpireSweeper(ExpireManager& m, uint32 idx) :
+                    manager(m), index(idx), running(true), lag_millis(0)
+            {
+            }
+            void Run();
+    };
+
+    /*
+     * Active expiration: every db is owned by one sweeper thread (db % threads), a sweeper walks the
+     * time ordered KEY_EXPIRATION_ELEMENT index of its dbs, deletes the expired keys in batches and
+     * replicates every batch as one DEL/UNLINK. It keeps sweeping while a batch comes back full and the
+     * cycle budget allows, and shortens its sleep when a cycle ends with expired keys left behind.
+     */
+    class ExpireManager
+    {
+        private:
+            typedef std::vector<ExpireSweeper*> SweeperArray;
+            SweeperArray m_sweepers;
+
+            volatile uint64 m_expired_keys;
+            volatile uint64 m_stale_entries;
+            volatile uint64 m_cycles;
+            volatile uint64 m_fast_cycles;
+            volatile uint64 m_max_lag_millis;
+
+            uint32 Cycle(ExpireSweeper& sweeper);
+            uint32 SweepDB(DBID db, uint32 max_keys, bool& more, uint64& lag);
+            friend struct ExpireSweeper;
+        public:
+            ExpireManager();
+            void Start(uint32 threads);
+            int ExpireBatch(DBID db, uint32 max_keys, bool& more, uint64& lag, codec::RedisCommandFrame& del,
+                    uint32& stale);
+            void StopSelf();
+            const std::string& PrintStat(std::string& str);
+            ~ExpireManager();
+    };
+}
+
+#endif /* EXPIRE_HPP_ */
@@ -43,7 +43,7 @@ OP_NAMESPACE_BEGIN
     }
 
     ListIterator::ListIterator() :
-            m_zip_cursor(0)
+            m_zip_cursor(0), m_ctx(NULL), m_index(0), m_chunk_start(0), m_chunk(NULL)
     {
 
     }
@@ -57,6 +57,10 @@ OP_NAMESPACE_BEGIN
         {
             return &(m_meta->meta.ziplist[m_zip_cursor]);
         }
+        else if (m_meta->meta.IsChunkedList())
+        {
+            return &(m_chunk->elements[m_index - m_chunk_start]);
+        }
         else
         {
             return &(m_current_value.element);
@@ -71,6 +75,11 @@ OP_NAMESPACE_BEGIN
             default_score.SetInt64(0);
             return &default_score;
         }
+        else if (m_meta->meta.IsChunkedList())
+        {
+            m_index_score.SetInt64(m_index);
+            return &m_index_score;
+        }
         else
         {
             return &(m_current_key.score);
@@ -82,6 +91,10 @@ OP_NAMESPACE_BEGIN
         {
             m_zip_cursor--;
         }
+        else if (m_meta->meta.IsChunkedList())
+        {
+            m_index--;
+        }
         else
         {
             m_iter->Prev();
@@ -95,6 +108,10 @@ OP_NAMESPACE_BEGIN
         {
             m_zip_cursor++;
         }
+        else if (m_meta->meta.IsChunkedList())
+        {
+            m_index++;
+        }
         else
         {
             m_iter->Next();
@@ -111,6 +128,30 @@ OP_NAMESPACE_BEGIN
             }
             return true;
         }
+        if (m_meta->meta.IsChunkedList())
+        {
+            if (m_index < 0 || m_index >= m_meta->meta.Length())
+            {
+                return false;
+            }
+            if (NULL != m_chunk && m_index >= m_chunk_start
+                    && m_index < m_chunk_start + (int64) m_chunk->elements.size())
+            {
+                return true;
+            }
+            m_chunk = NULL;
+            ListChunkPath path;
+            ListChunk* chunk = NULL;
+            if (0 != g_db->ListChunkLocate(*m_ctx, *m_meta, m_index, path)
+                    || 0 != g_db->ListChunkPeek(*m_ctx, *m_meta, path.chunk_id, m_owned_chunk, chunk)
+                    || path.offset >= chunk->elements.size())
+            {
+                return false;
+            }
+            m_chunk = chunk;
+            m_chunk_start = m_index - path.offset;
+            return true;
+        }
         if (NULL == m_iter || !m_iter->Valid())
         {
             return false;
@@ -119,7 +160,8 @@ OP_NAMESPACE_BEGIN
         m_current_raw_value = m_iter->Value();
         if (decode_key(m_current_raw_key, m_current_key) && decode_value(m_current_raw_value, m_current_value))
         {
-            if (m_current_key.db == m_meta->key.db && m_current_key.key == m_meta->key.key)
+            if (m_current_key.db == m_meta->key.db && m_current_key.key == m_meta->key.key
+                    && m_current_key.version == m_meta->meta.version)
             {
                 return true;
             }
@@ -135,10 +177,15 @@ OP_NAMESPACE_BEGIN
             iter.m_zip_cursor = reverse ? meta.meta.ziplist.size() - 1 : 0;
             return 0;
         }
+        if (meta.meta.IsChunkedList())
+        {
+            return ChunkedListIter(ctx, meta, iter, reverse ? -1 : 0);
+        }
         KeyObject kk;
         kk.type = LIST_ELEMENT;
         kk.db = ctx.currentDB;
         kk.key = meta.key.key;
+        kk.version = meta.meta.version;
         if (reverse)
         {
             kk.score = meta.meta.max_index;
@@ -164,6 +211,7 @@ OP_NAMESPACE_BEGIN
         kk.type = LIST_ELEMENT;
         kk.db = ctx.currentDB;
         kk.key = meta.key.key;
+        kk.version = meta.meta.version;
         kk.score = meta.meta.min_index;
         if(index >= 0)
         {
@@ -177,6 +225,20 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
+    int Ardb::ChunkedListIter(Context& ctx, ValueObject& meta, ListIterator& iter, int64 index)
+    {
+        if (!meta.meta.IsChunkedList() || meta.meta.Encoding() == COLLECTION_ENCODING_ZIPLIST)
+        {
+            ERROR_LOG("Can NOT create chunked list iterator.");
+            return -1;
+        }
+        iter.SetMeta(&meta);
+        iter.m_ctx = &ctx;
+        iter.m_chunk = NULL;
+        iter.m_index = index >= 0 ? index : meta.meta.Length() + index;
+        return 0;
+    }
+
     const Data* HashIterator::Field()
     {
         if (m_meta->meta.Encoding() == COLLECTION_ENCODING_ZIPMAP)
@@ -229,7 +291,8 @@ OP_NAMESPACE_BEGIN
         m_current_raw_value = m_iter->Value();
         if (decode_key(m_current_raw_key, m_current_key) && decode_value(m_current_raw_value, m_current_value))
         {
-            if (m_current_key.db == m_meta->key.db && m_current_key.key == m_meta->key.key)
+            if (m_current_key.db == m_meta->key.db && m_current_key.key == m_meta->key.key
+                    && m_current_key.version == m_meta->meta.version)
             {
                 return true;
             }
@@ -240,6 +303,7 @@ OP_NAMESPACE_BEGIN
     int Ardb::HashIter(Context& ctx, ValueObject& meta, const std::string& from, HashIterator& iter, bool readonly)
     {
         iter.SetMeta(&meta);
+        iter.SetArena(&ctx.GetArena());
         if (meta.meta.Encoding() == COLLECTION_ENCODING_ZIPMAP)
         {
             if (from == "")
@@ -258,8 +322,9 @@ OP_NAMESPACE_BEGIN
         kk.type = HASH_FIELD;
         kk.db = ctx.currentDB;
         kk.key = meta.key.key;
+        kk.version = meta.meta.version;
         kk.element.SetString(from, true);
-        Iterator* it = IteratorKeyValue(kk, false);
+        Iterator* it = IteratorPrefix(kk);
         iter.SetIter(it);
         return 0;
     }
@@ -304,7 +369,8 @@ OP_NAMESPACE_BEGIN
         m_current_raw_key = m_iter->Key();
         if (decode_key(m_current_raw_key, m_current_key))
         {
-            if (m_current_key.db == m_meta->key.db && m_current_key.key == m_meta->key.key)
+            if (m_current_key.db == m_meta->key.db && m_current_key.key == m_meta->key.key
+                    && m_current_key.version == m_meta->meta.version)
             {
                 return true;
             }
@@ -315,6 +381,7 @@ OP_NAMESPACE_BEGIN
     int Ardb::SetIter(Context& ctx, ValueObject& meta, Data& from, SetIterator& iter, bool readonly)
     {
         iter.SetMeta(&meta);
+        iter.SetArena(&ctx.GetArena());
         if (meta.meta.Encoding() == COLLECTION_ENCODING_ZIPSET)
         {
             if (from.IsNil())
@@ -333,8 +400,9 @@ OP_NAMESPACE_BEGIN
         kk.type = SET_ELEMENT;
         kk.db = ctx.currentDB;
         kk.key = meta.key.key;
+        kk.version = meta.meta.version;
         kk.element = from;
-        Iterator* it = IteratorKeyValue(kk, false);
+        Iterator* it = IteratorPrefix(kk);
         iter.SetIter(it);
         return 0;
     }
@@ -495,6 +563,7 @@ OP_NAMESPACE_BEGIN
             kk.type = ZSET_ELEMENT_SCORE;
             kk.db = m_meta->key.db;
             kk.key = m_meta->key.key;
+            kk.version = m_meta->meta.version;
             kk.score = score;
             g_db->IteratorSeek(m_iter, kk);
         }
@@ -533,7 +602,8 @@ OP_NAMESPACE_BEGIN
         }
         if (decode_key(m_current_raw_key, m_current_key))
         {
-            if (m_current_key.db == m_meta->key.db && m_current_key.key == m_meta->key.key)
+            if (m_current_key.db == m_meta->key.db && m_current_key.key == m_meta->key.key
+                    && m_current_key.version == m_meta->meta.version)
             {
                 if (m_iter_by_value)
                 {
@@ -563,6 +633,7 @@ OP_NAMESPACE_BEGIN
     int Ardb::ZSetScoreIter(Context& ctx, ValueObject& meta, const Data& from, ZSetIterator& iter, bool readonly)
     {
         iter.SetMeta(&meta);
+        iter.SetArena(&ctx.GetArena());
         iter.m_iter_by_value = false;
         if (meta.meta.Encoding() == COLLECTION_ENCODING_ZIPZSET)
         {
@@ -613,6 +684,7 @@ OP_NAMESPACE_BEGIN
         kk.type = ZSET_ELEMENT_SCORE;
         kk.db = ctx.currentDB;
         kk.key = meta.key.key;
+        kk.version = meta.meta.version;
         kk.score = from;
         Iterator* it = IteratorKeyValue(kk, false);
         iter.SetIter(it);
@@ -621,6 +693,7 @@ OP_NAMESPACE_BEGIN
     int Ardb::ZSetValueIter(Context& ctx, ValueObject& meta, Data& from, ZSetIterator& iter, bool readonly)
     {
         iter.SetMeta(&meta);
+        iter.SetArena(&ctx.GetArena());
         iter.m_iter_by_value = true;
         if (meta.meta.Encoding() == COLLECTION_ENCODING_ZIPZSET)
         {
@@ -643,6 +716,7 @@ OP_NAMESPACE_BEGIN
         kk.type = ZSET_ELEMENT_VALUE;
         kk.db = ctx.currentDB;
         kk.key = meta.key.key;
+        kk.version = meta.meta.version;
         kk.element = from;
         Iterator* it = IteratorKeyValue(kk, false);
         iter.SetIter(it);
@@ -666,6 +740,14 @@ OP_NAMESPACE_BEGIN
         }
         return str;
     }
+    Slice BitsetIterator::BitsSlice()
+    {
+        if (NULL != m_current_value.element.value.sv)
+        {
+            return Slice(m_current_value.element.value.sv, sdslen(m_current_value.element.value.sv));
+        }
+        return Slice();
+    }
     int64 BitsetIterator::Count()
     {
         return m_current_value.score.value.iv;
@@ -685,7 +767,8 @@ OP_NAMESPACE_BEGIN
         m_current_raw_value = m_iter->Value();
         if (decode_key(m_current_raw_key, m_current_key) && decode_value(m_current_raw_value, m_current_value))
         {
-            if (m_current_key.db == m_meta->key.db && m_current_key.key == m_meta->key.key)
+            if (m_current_key.db == m_meta->key.db && m_current_key.key == m_meta->key.key
+                    && m_current_key.version == m_meta->meta.version)
             {
                 return true;
             }
@@ -700,8 +783,9 @@ OP_NAMESPACE_BEGIN
         kk.type = BITSET_ELEMENT;
         kk.db = ctx.currentDB;
         kk.key = meta.key.key;
+        kk.version = meta.meta.version;
         kk.score.SetInt64(index);
-        Iterator* it = IteratorKeyValue(kk, false);
+        Iterator* it = IteratorPrefix(kk);
         iter.SetIter(it);
         return 0;
     }
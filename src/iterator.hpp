@@ -40,6 +40,7 @@ using namespace ardb::codec;
 OP_NAMESPACE_BEGIN
 
     class Ardb;
+    struct Context;
 
     class KVIterator
     {
@@ -61,6 +62,15 @@ OP_NAMESPACE_BEGIN
             {
                 m_iter = iter;
             }
+            /*
+             * Strings decoded from the current entry are allocated in 'arena' instead of the heap,
+             * they stay readable until the arena is reset.
+             */
+            void SetArena(Arena* arena)
+            {
+                m_current_key.arena = arena;
+                m_current_value.arena = arena;
+            }
             Slice& CurrentRawKey()
             {
                 return m_current_raw_key;
@@ -77,6 +87,10 @@ OP_NAMESPACE_BEGIN
             int64 Index();
             ValueObject& Value();
             std::string Bits();
+            /*
+             * Refers to the current chunk without copying, valid until the iterator moves.
+             */
+            Slice BitsSlice();
             int64 Count();
             bool Next();
             bool Valid();
@@ -146,6 +160,16 @@ OP_NAMESPACE_BEGIN
     {
         private:
             uint32 m_zip_cursor;
+            /*
+             * Chunked list position, the chunk holding it is located on demand and refers to either the
+             * write cache of the meta or the owned copy.
+             */
+            Context* m_ctx;
+            int64 m_index;
+            int64 m_chunk_start;
+            ListChunk* m_chunk;
+            ListChunk m_owned_chunk;
+            Data m_index_score;
             friend class Ardb;
         public:
             ListIterator();
@@ -30,9 +30,16 @@
 #include "logger.hpp"
 #include "util/helpers.hpp"
 #include "thread/thread_mutex.hpp"
+#include "thread/thread_mutex_lock.hpp"
 #include "thread/lock_guard.hpp"
+#include "util/concurrent_queue.hpp"
+#include "util/atomic.hpp"
 #include <stdarg.h>
 #include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <algorithm>
 #include <sstream>
 namespace ardb
 {
@@ -97,9 +104,335 @@ namespace ardb
         rename(kLogFilePath.c_str(), path.c_str());
     }
 
+    static void rollover_if_necessary()
+    {
+        if (!kLogFilePath.empty() && kLogFile != stdout)
+        {
+            long file_size = ftell(kLogFile);
+            if (file_size < 0)
+            {
+                reopen_default_logfile();
+            }
+            else if ((uint32) file_size >= k_max_file_size)
+            {
+                rollover_default_logfile();
+                reopen_default_logfile();
+            }
+        }
+    }
+
+    /*
+     * Async logging: every thread appends records to its own single producer ring, the flusher thread is the
+     * only consumer. Records are laid out as a header followed by the formatted message, a record never wraps
+     * around the ring end, the unused tail is skipped by a padding header instead.
+     */
+    struct LogRecordHeader
+    {
+            uint32 size;  //whole record size, 8 bytes aligned
+            uint32 level; //0 for padding, only 'size' & 'level' of padding are written
+            uint64 micros;
+            uint32 text_len;
+            uint32 reserved;
+    };
+    static const uint32 k_log_record_align = 8;
+    static const uint32 k_log_flush_interval_mills = 10;
+    static const uint64 k_log_flush_timeout_micros = 500 * 1000;
+
+    struct LogRing
+    {
+            char* buffer;
+            uint32 size; //power of 2
+            volatile uint64 head;
+            volatile uint64 tail;
+            volatile uint64 dropped;
+            volatile bool closed;
+            LogRing(uint32 buf_size) :
+                    buffer(NULL), size(buf_size), head(0), tail(0), dropped(0), closed(false)
+            {
+                buffer = (char*) malloc(size);
+            }
+            ~LogRing()
+            {
+                free(buffer);
+            }
+            bool Push(LogLevel level, uint64 micros, const char* text, uint32 text_len)
+            {
+                uint32 max_text = size / 4 - sizeof(LogRecordHeader);
+                if (text_len > max_text)
+                {
+                    text_len = max_text;
+                }
+                uint32 need = (sizeof(LogRecordHeader) + text_len + k_log_record_align - 1) & ~(k_log_record_align - 1);
+                uint64 pos = head;
+                uint32 offset = pos & (size - 1);
+                uint32 contiguous = size - offset;
+                uint32 total = contiguous < need ? contiguous + need : need;
+                if (pos + total - load_consume(&tail) > size)
+                {
+                    atomic_add_uint64(&dropped, 1);
+                    return false;
+                }
+                if (contiguous < need)
+                {
+                    LogRecordHeader* pad = (LogRecordHeader*) (buffer + offset);
+                    pad->size = contiguous;
+                    pad->level = 0;
+                    pos += contiguous;
+                    offset = 0;
+                }
+                LogRecordHeader* header = (LogRecordHeader*) (buffer + offset);
+                header->size = need;
+                header->level = level;
+                header->micros = micros;
+                header->text_len = text_len;
+                memcpy(buffer + offset + sizeof(LogRecordHeader), text, text_len);
+                store_release(const_cast<uint64*>(&head), pos + need);
+                return true;
+            }
+    };
+    typedef std::vector<LogRing*> LogRingArray;
+
+    struct LogRecordRef
+    {
+            uint64 micros;
+            LogRing* ring;
+            uint64 pos;
+            bool operator<(const LogRecordRef& other) const
+            {
+                return micros < other.micros;
+            }
+    };
+
+    static volatile bool kAsyncLogging = false;
+    static volatile bool kAsyncLoggingStop = false;
+    static volatile bool kLogCrashing = false;
+    static uint32 kLogRingSize = 0;
+    static pthread_key_t kLogRingKey;
+    static pthread_t kLogFlusher;
+    static ThreadMutexLock kLogRingLock; //guards kLogRings & wakes up the flusher
+    static LogRingArray kLogRings;
+    static uint64 kRetiredDroppedRecords = 0; //dropped by exited threads
+    static uint64 kReportedDroppedRecords = 0;
+    static volatile uint64 kLogIdleFlushes = 0; //flusher passes that found nothing to write
+    static const int kLogCrashSignals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+    static struct sigaction kLogPrevCrashActions[arraysize(kLogCrashSignals)];
+
+    static void close_log_ring(void* data)
+    {
+        LogRing* ring = (LogRing*) data;
+        ring->closed = true;
+    }
+
+    static LogRing* get_log_ring()
+    {
+        LogRing* ring = (LogRing*) pthread_getspecific(kLogRingKey);
+        if (NULL == ring)
+        {
+            ring = new LogRing(kLogRingSize);
+            pthread_setspecific(kLogRingKey, ring);
+            LockGuard<ThreadMutexLock> guard(kLogRingLock);
+            kLogRings.push_back(ring);
+        }
+        return ring;
+    }
+
+    static void write_log_record(LogLevel level, uint64 micros, const char* text, uint32 text_len)
+    {
+        char timetag[64];
+        time_t secs = micros / 1000000;
+        struct tm tm;
+        localtime_r(&secs, &tm);
+        strftime(timetag, sizeof(timetag), "%m-%d %H:%M:%S", &tm);
+        const char* levelstr = level > 0 && level < ALL_LOG_LEVEL ? kLogLevelNames[level - 1] : "???";
+        fprintf(kLogFile, "[%u] %s,%03u %s %.*s\n", getpid(), timetag, (uint32) ((micros / 1000) % 1000), levelstr,
+                (int) text_len, text);
+    }
+
+    /*
+     * Writes all records available now ordered by time, returns the number of records written.
+     */
+    static uint32 flush_log_rings(std::vector<LogRecordRef>& records)
+    {
+        LogRingArray rings;
+        uint64 dropped = 0;
+        {
+            LockGuard<ThreadMutexLock> guard(kLogRingLock);
+            rings = kLogRings;
+            dropped = kRetiredDroppedRecords;
+        }
+        records.clear();
+        std::vector<uint64> heads(rings.size());
+        for (size_t i = 0; i < rings.size(); i++)
+        {
+            LogRing* ring = rings[i];
+            heads[i] = load_consume(&ring->head);
+            uint64 pos = ring->tail;
+            while (pos < heads[i])
+            {
+                LogRecordHeader* header = (LogRecordHeader*) (ring->buffer + (pos & (ring->size - 1)));
+                if (header->level > 0)
+                {
+                    LogRecordRef ref;
+                    ref.micros = header->micros;
+                    ref.ring = ring;
+                    ref.pos = pos;
+                    records.push_back(ref);
+                }
+                pos += header->size;
+            }
+            dropped += ring->dropped;
+        }
+        std::stable_sort(records.begin(), records.end());
+        LockGuard<ThreadMutex> guard(kLogMutex);
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            LogRing* ring = records[i].ring;
+            LogRecordHeader* header = (LogRecordHeader*) (ring->buffer + (records[i].pos & (ring->size - 1)));
+            write_log_record((LogLevel) header->level, header->micros, (char*) header + sizeof(LogRecordHeader),
+                    header->text_len);
+        }
+        if (dropped > kReportedDroppedRecords)
+        {
+            char msg[128];
+            int len = snprintf(msg, sizeof(msg), "%llu log records dropped since the log buffers were full.",
+                    (unsigned long long) (dropped - kReportedDroppedRecords));
+            write_log_record(WARN_LOG_LEVEL, get_current_epoch_micros(), msg, len);
+            kReportedDroppedRecords = dropped;
+        }
+        if (!records.empty())
+        {
+            fflush(kLogFile);
+            rollover_if_necessary();
+        }
+        for (size_t i = 0; i < rings.size(); i++)
+        {
+            store_release(const_cast<uint64*>(&rings[i]->tail), heads[i]);
+        }
+        /*
+         * Rings of exited threads are freed once drained.
+         */
+        LockGuard<ThreadMutexLock> ring_guard(kLogRingLock);
+        LogRingArray::iterator it = kLogRings.begin();
+        while (it != kLogRings.end())
+        {
+            LogRing* ring = *it;
+            if (ring->closed && ring->tail == load_consume(&ring->head))
+            {
+                kRetiredDroppedRecords += ring->dropped;
+                delete ring;
+                it = kLogRings.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+        return records.size();
+    }
+
+    static void* log_flusher_loop(void* data)
+    {
+        std::vector<LogRecordRef> records;
+        while (!kAsyncLoggingStop)
+        {
+            if (0 == flush_log_rings(records))
+            {
+                atomic_add_uint64(&kLogIdleFlushes, 1);
+                if (!kLogCrashing)
+                {
+                    LockGuard<ThreadMutexLock> guard(kLogRingLock);
+                    kLogRingLock.Wait(k_log_flush_interval_mills, MILLIS);
+                }
+            }
+        }
+        /*
+         * Bounded drain on shutdown, writers may still be logging.
+         */
+        uint64 deadline = get_current_epoch_micros() + k_log_flush_timeout_micros;
+        while (flush_log_rings(records) > 0 && get_current_epoch_micros() < deadline)
+        {
+        }
+        return NULL;
+    }
+
+    /*
+     * Waits a bounded time for the flusher to write out what was logged before, used for FATAL records &
+     * crashes. The second idle pass counted from now has started after the call, so everything pushed before
+     * is written once it's seen. Only atomic loads & nanosleep are used, so it is usable in signal handlers.
+     */
+    static void wait_log_flushed()
+    {
+        uint64 idle = load_consume(&kLogIdleFlushes);
+        uint64 deadline = get_current_epoch_micros() + k_log_flush_timeout_micros;
+        struct timespec interval = { 0, 1000 * 1000 };
+        while (load_consume(&kLogIdleFlushes) < idle + 2 && get_current_epoch_micros() < deadline)
+        {
+            nanosleep(&interval, NULL);
+        }
+    }
+
+    /*
+     * Flushes the log, then hands the signal over to the handler installed before StartAsyncLogging.
+     */
+    static void log_crash_handler(int sig)
+    {
+        kLogCrashing = true;
+        wait_log_flushed();
+        for (uint32 i = 0; i < arraysize(kLogCrashSignals); i++)
+        {
+            if (kLogCrashSignals[i] == sig)
+            {
+                sigaction(sig, &kLogPrevCrashActions[i], NULL);
+                break;
+            }
+        }
+        raise(sig);
+    }
+
+    static void async_loghandler(LogLevel level, const char* format, va_list args)
+    {
+        uint64 micros = get_current_epoch_micros();
+        char content[1024];
+        va_list aq;
+        va_copy(aq, args);
+        int sz = vsnprintf(content, sizeof(content), format, aq);
+        va_end(aq);
+        if (sz < 0)
+        {
+            return;
+        }
+        LogRing* ring = get_log_ring();
+        if ((size_t) sz < sizeof(content))
+        {
+            ring->Push(level, micros, content, sz);
+        }
+        else
+        {
+            char* large = (char*) malloc(sz + 1);
+            vsnprintf(large, sz + 1, format, args);
+            ring->Push(level, micros, large, sz);
+            free(large);
+        }
+        if (level <= FATAL_LOG_LEVEL)
+        {
+            kLogRingLock.Lock();
+            kLogRingLock.Notify();
+            kLogRingLock.Unlock();
+            wait_log_flushed();
+        }
+    }
+
     static void default_loghandler(LogLevel level, const char* filename, const char* function, int line,
                     const char* format, ...)
     {
+        if (kAsyncLogging)
+        {
+            va_list args;
+            va_start(args, format);
+            async_loghandler(level, format, args);
+            va_end(args);
+            return;
+        }
         const char* levelstr = 0;
         uint64_t timestamp = get_current_epoch_millis();
         if (level > 0 && level < ALL_LOG_LEVEL)
@@ -147,19 +480,7 @@ namespace ardb
         LockGuard<ThreadMutex> guard(kLogMutex);
         fprintf(kLogFile, "[%u] %s,%03u %s %s\n", getpid(), timetag, mills, levelstr, record.c_str());
         fflush(kLogFile);
-        if (!kLogFilePath.empty() && kLogFile != stdout)
-        {
-            long file_size = ftell(kLogFile);
-            if (file_size < 0)
-            {
-                reopen_default_logfile();
-            }
-            else if ((uint32) file_size >= k_max_file_size)
-            {
-                rollover_default_logfile();
-                reopen_default_logfile();
-            }
-        }
+        rollover_if_necessary();
     }
 
     static bool default_logchcker(LogLevel level)
@@ -212,8 +533,57 @@ namespace ardb
         SetLogLevel(level);
     }
 
+    void ArdbLogger::StartAsyncLogging(uint32_t buffer_size)
+    {
+        if (kAsyncLogging)
+        {
+            return;
+        }
+        kLogRingSize = 4096;
+        while (kLogRingSize < buffer_size)
+        {
+            kLogRingSize <<= 1;
+        }
+        pthread_key_create(&kLogRingKey, close_log_ring);
+        kAsyncLoggingStop = false;
+        if (0 != pthread_create(&kLogFlusher, NULL, log_flusher_loop, NULL))
+        {
+            WARN_LOG("Failed to create log flusher thread, log synchronously.");
+            return;
+        }
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = log_crash_handler;
+        sigemptyset(&action.sa_mask);
+        for (uint32 i = 0; i < arraysize(kLogCrashSignals); i++)
+        {
+            sigaction(kLogCrashSignals[i], &action, &kLogPrevCrashActions[i]);
+        }
+        kAsyncLogging = true;
+    }
+
+    uint64_t ArdbLogger::GetDroppedRecords()
+    {
+        LockGuard<ThreadMutexLock> guard(kLogRingLock);
+        uint64 dropped = kRetiredDroppedRecords;
+        for (size_t i = 0; i < kLogRings.size(); i++)
+        {
+            dropped += kLogRings[i]->dropped;
+        }
+        return dropped;
+    }
+
     void ArdbLogger::DestroyDefaultLogger()
     {
+        if (kAsyncLogging)
+        {
+            kAsyncLoggingStop = true;
+            kLogRingLock.Lock();
+            kLogRingLock.Notify();
+            kLogRingLock.Unlock();
+            pthread_join(kLogFlusher, NULL);
+            kAsyncLogging = false;
+        }
         if (kLogFile != stdout)
         {
             fclose(kLogFile);
@@ -31,6 +31,8 @@
 #define LOGGER_MACROS_HPP_
 
 #include <string>
+#include <stdint.h>
+#include <stdio.h>
 
 namespace ardb
 {
@@ -71,6 +73,12 @@ namespace ardb
             static void InitDefaultLogger(const std::string& level,
                             const std::string& logfile);
             static void SetLogLevel(const std::string& level);
+            /*
+             * Moves file writes & rotation of the default logger to a background flusher, every thread logs
+             * into its own 'buffer_size' bytes ring buffer, records are dropped while it is full.
+             */
+            static void StartAsyncLogging(uint32_t buffer_size);
+            static uint64_t GetDroppedRecords();
             static void DestroyDefaultLogger();
             static FILE* GetLogStream();
     };
@@ -61,6 +61,7 @@ void usage()
     fprintf(stderr, "Usage: ./ardb-server [/path/to/ardb.conf] [options]\n");
     fprintf(stderr, "       ./ardb-server -v or --version\n");
     fprintf(stderr, "       ./ardb-server -h or --help\n");
+    fprintf(stderr, "       ./ardb-server /path/to/ardb.conf --migrate-codec (offline upgrade of stored keys to memcmp codec)\n");
     fprintf(stderr, "Examples:\n");
     fprintf(stderr,
                     "       ./ardb-server (run the server with default conf)\n");
@@ -79,6 +80,7 @@ int main(int argc, char** argv)
 {
     Properties props;
     std::string confpath;
+    bool migrate_codec = false;
     if (argc >= 2)
     {
         int j = 1; /* First option to parse in argv[] */
@@ -103,6 +105,13 @@ int main(int argc, char** argv)
                 confpath = readpath_buf;
             }
         }
+        for (; j < argc; j++)
+        {
+            if (strcmp(argv[j], "--migrate-codec") == 0)
+            {
+                migrate_codec = true;
+            }
+        }
     }
     else
     {
@@ -119,6 +128,14 @@ int main(int argc, char** argv)
     }
     SelectedDBEngineFactory engine(props);
     Ardb server(engine);
+    if (migrate_codec)
+    {
+        std::string target_dir = cfg.data_base_path + "/.migrating";
+        Properties target_props = props;
+        conf_set(target_props, "data-dir", target_dir);
+        SelectedDBEngineFactory target(target_props);
+        return server.MigrateStorageCodec(cfg, target, target_dir);
+    }
     if(0 == server.Init(cfg))
     {
         server.GetConfig().conf_path = confpath;
@@ -58,11 +58,171 @@ OP_NAMESPACE_BEGIN
     {
         m_ctx.client = ctx.GetChannel();
         RedisCommandFrame* cmd = e.GetMessage();
+        /*
+         * Replies of all commands in this read are sent by one flush in ChannelReadComplete.
+         */
+        m_ctx.client->Cork();
+        if (!BatchWrite(*cmd))
+        {
+            CommitBatchWrite();
+            Process(*cmd);
+        }
+    }
+
+    void RedisRequestHandler::ChannelReadComplete(ChannelHandlerContext& ctx, ChannelStateEvent& e)
+    {
+        CommitBatchWrite();
+        if (ctx.GetChannel()->IsCorked())
+        {
+            ctx.GetChannel()->Uncork();
+        }
+    }
+
+    /*
+     * Write commands whose keys are all known from their arguments, and which neither discard the thread's write
+     * batch on failure nor wake up other clients, could share the write batch with other pipelined writes.
+     */
+    static bool batchable_write_command(RedisCommandType type)
+    {
+        switch (type)
+        {
+            case REDIS_CMD_SET:
+            case REDIS_CMD_SETEX:
+            case REDIS_CMD_SETNX:
+            case REDIS_CMD_APPEND:
+            case REDIS_CMD_INCR:
+            case REDIS_CMD_DECR:
+            case REDIS_CMD_INCRBY:
+            case REDIS_CMD_DECRBY:
+            case REDIS_CMD_INCRBYFLOAT:
+            case REDIS_CMD_HSET:
+            case REDIS_CMD_HSETNX:
+            case REDIS_CMD_HMSET:
+            case REDIS_CMD_HDEL:
+            case REDIS_CMD_HINCR:
+            case REDIS_CMD_HINCRBYFLOAT:
+            case REDIS_CMD_SADD:
+            case REDIS_CMD_SREM:
+            case REDIS_CMD_ZINCRBY:
+            case REDIS_CMD_ZREM:
+            case REDIS_CMD_PFADD:
+            case REDIS_CMD_EXPIRE:
+            case REDIS_CMD_PEXPIRE:
+            case REDIS_CMD_EXPIREAT:
+            case REDIS_CMD_PEXPIREAT:
+            case REDIS_CMD_PERSIST:
+            case REDIS_CMD_DEL:
+            {
+                return true;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
+    /*
+     * Runs a pipelined write within the write batch shared with the previous writes of the same read. Returns false
+     * if the command has to run on its own, the caller commits the batch first then.
+     * Since pending writes are invisible to readers, the keys of the batch are locked until it is committed. Those
+     * locks are only tried, never waited for, so that holding them could not deadlock with other writers.
+     */
+    bool RedisRequestHandler::BatchWrite(RedisCommandFrame& cmd)
+    {
+        const ArdbConfig& cfg = m_db->GetConfig();
+        if (cfg.pipeline_batch_writes <= 1 || !m_ctx.authenticated || m_ctx.InTransc() || m_ctx.IsSubscribedConn()
+                || cmd.GetArguments().empty())
+        {
+            return false;
+        }
+        Ardb::RedisCommandHandlerSetting* setting = m_db->FindRedisCommandHandlerSetting(cmd);
+        if (NULL == setting || !batchable_write_command(setting->type))
+        {
+            return false;
+        }
+        const ArgumentArray& args = cmd.GetArguments();
+        uint32 key_count = setting->type == REDIS_CMD_DEL ? args.size() : 1;
+        if (m_batch_cmds >= (uint32) cfg.pipeline_batch_writes)
+        {
+            CommitBatchWrite();
+        }
+        for (uint32 i = 0; i < key_count; i++)
+        {
+            if (m_batch_keys.count(DBItemKey(m_ctx.currentDB, args[i])) > 0)
+            {
+                /*
+                 * Writes on the same key are applied in order by committing the previous ones first.
+                 */
+                CommitBatchWrite();
+                break;
+            }
+        }
+        for (uint32 i = 0; i < key_count; i++)
+        {
+            std::pair<BatchKeyLockTable::iterator, bool> ret = m_batch_keys.insert(
+                    BatchKeyLockTable::value_type(DBItemKey(m_ctx.currentDB, args[i]), (Barrier*) NULL));
+            if (!ret.second)
+            {
+                continue;
+            }
+            if (!m_db->m_key_lock.TryAddLockKey(m_ctx.currentDB, ret.first->first.key, ret.first->second))
+            {
+                m_batch_keys.erase(ret.first);
+                return false;
+            }
+        }
+        if (NULL == m_batch_guard)
+        {
+            m_batch_reply_mark = m_ctx.client->WritableBytes();
+            NEW(m_batch_guard, BatchWriteGuard(m_ctx));
+        }
+        m_batch_cmds++;
+        Process(cmd);
+        return true;
+    }
+
+    void RedisRequestHandler::CommitBatchWrite()
+    {
+        if (m_batch_guard != NULL)
+        {
+            m_ctx.write_success = true;
+            DELETE(m_batch_guard);
+            if (!m_ctx.write_success)
+            {
+                /*
+                 * Replies of the batched commands are still corked, replace them by errors.
+                 */
+                ERROR_LOG("Failed to commit write batch of %u pipelined commands.", m_batch_cmds);
+                m_ctx.client->DiscardCorkedOutput(m_batch_reply_mark);
+                for (uint32 i = 0; i < m_batch_cmds; i++)
+                {
+                    m_ctx.reply.Clear();
+                    fill_error_reply(m_ctx.reply, "Storage engine internal error.");
+                    m_ctx.client->Write(m_ctx.reply);
+                }
+            }
+        }
+        BatchKeyLockTable::iterator it = m_batch_keys.begin();
+        while (it != m_batch_keys.end())
+        {
+            m_db->m_key_lock.ClearLockKey(it->first.db, it->first.key, it->second);
+            it++;
+        }
+        m_batch_keys.clear();
+        m_batch_cmds = 0;
+    }
+
+    /*
+     * Returns false if this handler should not be used any more.
+     */
+    bool RedisRequestHandler::Process(RedisCommandFrame& cmd)
+    {
         ChannelService& serv = m_ctx.client->GetService();
-        uint32 channel_id = ctx.GetChannel()->GetID();
+        uint32 channel_id = m_ctx.client->GetID();
         m_ctx.processing = true;
         m_ctx.reply.pool->Clear();
-        int ret = m_db->Call(m_ctx, *cmd, 0);
+        int ret = m_db->Call(m_ctx, cmd, 0);
         if (ret >= 0 && m_ctx.reply.type != 0)
         {
             m_ctx.client->Write(m_ctx.reply);
@@ -70,11 +230,12 @@ OP_NAMESPACE_BEGIN
         if (m_delete_after_processing)
         {
             delete this;
-            return;
+            return false;
         }
         if (ret < 0 && serv.GetChannel(channel_id) != NULL)
         {
             m_ctx.client->Close();
+            return false;
         }
         else
         {
@@ -83,11 +244,15 @@ OP_NAMESPACE_BEGIN
             {
                 //delete this;
                 m_ctx.client->Close();
+                return false;
             }
         }
+        return true;
     }
+
     void RedisRequestHandler::ChannelClosed(ChannelHandlerContext& ctx, ChannelStateEvent& e)
     {
+        CommitBatchWrite();
         m_db->FreeClientContext(m_ctx);
         m_db->GetStatistics().IncAcceptedClient(m_ctx.server_address, -1);
     }
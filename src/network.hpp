@@ -36,18 +36,33 @@ using namespace ardb::codec;
 
 OP_NAMESPACE_BEGIN
     class Ardb;
+    class BatchWriteGuard;
     class RedisRequestHandler: public ChannelUpstreamHandler<RedisCommandFrame>
     {
         private:
+            typedef TreeMap<DBItemKey, Barrier*>::Type BatchKeyLockTable;
             Ardb* m_db;
             Context m_ctx;
             bool m_delete_after_processing;
+
+            /*
+             * Pipelined writes of the current read sharing one engine write batch, their keys stay locked
+             * until the batch is committed.
+             */
+            BatchWriteGuard* m_batch_guard;
+            BatchKeyLockTable m_batch_keys;
+            uint32 m_batch_cmds;
+            uint32 m_batch_reply_mark;
             void MessageReceived(ChannelHandlerContext& ctx, MessageEvent<RedisCommandFrame>& e);
+            void ChannelReadComplete(ChannelHandlerContext& ctx, ChannelStateEvent& e);
             void ChannelClosed(ChannelHandlerContext& ctx, ChannelStateEvent& e);
             void ChannelConnected(ChannelHandlerContext& ctx, ChannelStateEvent& e);
+            bool Process(RedisCommandFrame& cmd);
+            bool BatchWrite(RedisCommandFrame& cmd);
+            void CommitBatchWrite();
         public:
             RedisRequestHandler(Ardb* s) :
-                m_db(s), m_delete_after_processing(false)
+                m_db(s), m_delete_after_processing(false), m_batch_guard(NULL), m_batch_cmds(0), m_batch_reply_mark(0)
             {
             }
             static void PipelineInit(ChannelPipeline* pipeline, void* data);
@@ -305,6 +305,25 @@ OP_NAMESPACE_BEGIN
             int Parse(const std::deque<std::string>& args, std::string& err, uint32 off = 0);
 
     };
+
+    typedef std::pair<uint64, uint64> GeoScoreRange; // [start, end) of 60bits geohashes
+    typedef std::vector<GeoScoreRange> GeoScoreRangeArray;
+    /*
+     * Kept across the passes of a GEOSEARCH which widens its radius, the geohash ranges scanned by earlier
+     * passes are not fetched again and their points are reused.
+     */
+    struct GeoSearchState
+    {
+            bool center_resolved;
+            bool members_fetched;
+            double x, y; // mercator coordinates of the center
+            GeoScoreRangeArray scanned; // sorted & disjoint
+            GeoPointArray candidates; // fetched points which passed the INCLUDE/EXCLUDE filters
+            GeoSearchState() :
+                    center_resolved(false), members_fetched(false), x(0), y(0)
+            {
+            }
+    };
 OP_NAMESPACE_END
 
 #endif /* OPTIONS_HPP_ */
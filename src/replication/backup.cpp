@@ -15,6 +15,10 @@ namespace ardb
 	{
 
 	}
+	/*
+	 * The checkpoint mirrors the data dir layout(.storage.cfg plus the engine dir), so it can be used as
+	 * 'data-dir' directly to restore.
+	 */
 	int Backup::Save()
 	{
 		if (m_is_saving)
@@ -26,52 +30,37 @@ namespace ardb
 			ERROR_LOG("Empty bakup dir for backup.");
 			return -1;
 		}
-		//m_server->m_db->CloseAll();
 		m_is_saving = true;
-		int ret = 0;
-		char cmd[m_server->GetConfig().data_base_path.size() + 256];
 		make_dir(m_server->GetConfig().backup_dir);
-
-		char dest[m_server->GetConfig().backup_dir.size() + 256];
-		char shasumfile[m_server->GetConfig().backup_dir.size() + 256];
 		uint32 now = time(NULL);
-		sprintf(dest, "%s/dbsave-%u.tar", m_server->GetConfig().backup_dir.c_str(), now);
-		sprintf(shasumfile, "%s/dbsave-%u.sha", m_server->GetConfig().backup_dir.c_str(), now);
-		std::string source = m_server->GetConfig().data_base_path;
-		if (0 == chdir(m_server->GetConfig().data_base_path.c_str()))
-		{
-			source = "*";
-		}
-		sprintf(cmd, "tar cf %s %s;", dest, source.c_str());
-		ret = system(cmd);
-		if (0 != chdir(m_server->GetConfig().home.c_str()))
+		uint64 start = get_current_epoch_millis();
+		char dest[m_server->GetConfig().backup_dir.size() + 256];
+		sprintf(dest, "%s/checkpoint-%u", m_server->GetConfig().backup_dir.c_str(), now);
+		std::string engine_dir = std::string(dest) + "/" + m_server->m_engine_factory.GetName();
+		make_dir(dest);
+		int ret = m_server->GetKeyValueEngine().Checkpoint(engine_dir);
+		if (0 == ret)
 		{
-			WARN_LOG("Failed to change dir to home:%s", m_server->GetConfig().home.c_str());
+			ret = copy_file(m_server->GetConfig().data_base_path + "/.storage.cfg", std::string(dest) + "/.storage.cfg");
 		}
-		if (-1 == ret)
+		if (0 != ret)
 		{
-			ERROR_LOG( "Failed to create backup data archive:%s", dest);
+			ERROR_LOG("Failed to create checkpoint:%s", dest);
 		}
 		else
 		{
-			std::string sha1sum_str;
-			ret = sha1sum_file(dest, sha1sum_str);
-			if (-1 == ret)
-			{
-				ERROR_LOG( "Failed to compute sha1sum for data archive:%s", dest);
-			}
-			else
-			{
-				INFO_LOG("Save file SHA1sum is %s", sha1sum_str.c_str());
-				file_write_content(shasumfile, sha1sum_str);
-				m_last_save = now;
-			}
+			INFO_LOG("Checkpoint %s created in %llums.", dest, get_current_epoch_millis() - start);
+			m_last_save = now;
 		}
 		m_is_saving = false;
 		return ret;
 	}
 	int Backup::BGSave()
 	{
+		if (m_is_saving)
+		{
+			return -1;
+		}
 		struct BGTask: public Thread
 		{
 				Backup* serv;
@@ -19,7 +19,7 @@ namespace ardb
 	class Backup
 	{
 		private:
-			bool m_is_saving;
+			volatile bool m_is_saving;
 			Ardb* m_server;
 			uint32 m_last_save;
 		public:
@@ -30,6 +30,10 @@ namespace ardb
 			{
 				return m_last_save;
 			}
+			bool IsSaving()
+			{
+				return m_is_saving;
+			}
 	};
 }
 
@@ -30,7 +30,7 @@ namespace ardb
      * Master
      */
     Master::Master() :
-            m_dumping_rdb(false), m_dumping_ardb(false), m_dump_rdb_offset(-1), m_dump_ardb_offset(-1), m_repl_no_slaves_since(
+            m_dumping_rdb(false), m_dumping_ardb(false), m_dump_rdb_offset(-1), m_dump_ardb_offset(-1), m_dump_ardb_cksm(0), m_dump_ardb_id(0), m_repl_no_slaves_since(
                     0), m_backlog_enable(true)
     {
         g_master = this;
@@ -252,6 +252,8 @@ namespace ardb
         INFO_LOG("[Master]Start dump ardb data to file:%s", dump_file_path.c_str());
         m_dumping_ardb = true;
         m_dump_ardb_offset = g_db->m_repl_backlog.GetReplEndOffset();
+        m_dump_ardb_cksm = g_db->m_repl_backlog.GetChecksum();
+        m_dump_ardb_id = 0;
         slave.sync_offset = m_dump_ardb_offset;
 
         //force master generate 'select' later for master
@@ -267,6 +269,7 @@ namespace ardb
             INFO_LOG("[REPL]Saved ardb dump file:%s", dump_file_path.c_str());
             if (0 == rdb.Rename("dump.ardb"))
             {
+                m_dump_ardb_id = rdb.GetDumpID();
                 OnArdbDumpComplete();
             }
             else
@@ -285,6 +288,27 @@ namespace ardb
         }
     }
 
+    /*
+     * A slave disconnected while receiving dump.ardb continues from the bytes it has, if that dump is still
+     * the current one and the backlog still covers its offset.
+     */
+    bool Master::CanResumeArdbDump(SlaveConnection& slave)
+    {
+        if (slave.isRedisSlave || 0 == slave.resume_dump_id || m_dumping_ardb
+                || slave.resume_dump_id != m_dump_ardb_id || !g_db->m_repl_backlog.IsValidOffset(m_dump_ardb_offset))
+        {
+            return false;
+        }
+        std::string dump_file_path = g_db->GetConfig().repl_data_dir + "/dump.ardb";
+        struct stat st;
+        if (0 != stat(dump_file_path.c_str(), &st) || slave.resume_dump_bytes <= 0
+                || slave.resume_dump_bytes >= st.st_size)
+        {
+            return false;
+        }
+        return true;
+    }
+
     void Master::FullResyncRedisSlave(SlaveConnection& slave)
     {
         char tmpfile[1024];
@@ -437,14 +461,15 @@ namespace ardb
             slave.conn->Close();
             return;
         }
-        setting.file_offset = 0;
+        setting.file_offset = slave.resume_dump_bytes;
+        slave.resume_dump_bytes = 0;
         struct stat st;
         fstat(setting.fd, &st);
         Buffer header;
-        header.Printf("$%llu\r\n", st.st_size);
+        header.Printf("$%llu\r\n", st.st_size - setting.file_offset);
         slave.conn->Write(header);
 
-        setting.file_rest_len = st.st_size;
+        setting.file_rest_len = st.st_size - setting.file_offset;
         setting.on_complete = OnDumpFileSendComplete;
         setting.on_failure = OnDumpFileSendFailure;
         std::pair<void*, void*>* cb = new std::pair<void*, void*>;
@@ -487,6 +512,18 @@ namespace ardb
                 //FULLRESYNC
                 uint64 offset = g_db->m_repl_backlog.GetReplEndOffset();
                 uint64 cksm = g_db->m_repl_backlog.GetChecksum();
+                if (CanResumeArdbDump(slave))
+                {
+                    INFO_LOG("[Master]Slave resumes dump %llu from byte %lld", slave.resume_dump_id,
+                            slave.resume_dump_bytes);
+                    msg.Printf("+FULLRESYNC %s %lld %llu %lld\r\n", g_db->m_repl_backlog.GetServerKey(),
+                            m_dump_ardb_offset, m_dump_ardb_cksm, slave.resume_dump_bytes);
+                    slave.conn->Write(msg);
+                    slave.sync_offset = m_dump_ardb_offset;
+                    SendArdbDumpToSlave(slave);
+                    return;
+                }
+                slave.resume_dump_bytes = 0;
                 if (slave.isRedisSlave)
                 {
                     msg.Printf("+FULLRESYNC %s %lld\r\n", g_db->m_repl_backlog.GetServerKey(), offset);
@@ -655,7 +692,19 @@ namespace ardb
                 conn.isRedisSlave = false;
                 for (uint32 i = 2; i < cmd.GetArguments().size(); i += 2)
                 {
-                    if (cmd.GetArguments()[i] == "cksm")
+                    if (i + 1 >= cmd.GetArguments().size())
+                    {
+                        break;
+                    }
+                    if (cmd.GetArguments()[i] == "dump-id")
+                    {
+                        string_touint64(cmd.GetArguments()[i + 1], conn.resume_dump_id);
+                    }
+                    else if (cmd.GetArguments()[i] == "dump-bytes")
+                    {
+                        string_toint64(cmd.GetArguments()[i + 1], conn.resume_dump_bytes);
+                    }
+                    else if (cmd.GetArguments()[i] == "cksm")
                     {
                         if (!string_touint64(cmd.GetArguments()[i + 1], conn.sync_cksm))
                         {
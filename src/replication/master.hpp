@@ -64,10 +64,16 @@ namespace ardb
             int repldbfd;
             bool isRedisSlave;
             uint8 state;
+            /*
+             * Id and received bytes of a partially received ardb dump, sent by a reconnecting slave
+             */
+            uint64 resume_dump_id;
+            int64 resume_dump_bytes;
 
             std::string GetAddress();
             SlaveConnection() :
-                    conn(NULL), sync_offset(0), sync_cksm(0), acktime(0), port(0), repldbfd(-1), isRedisSlave(false), state(0)
+                    conn(NULL), sync_offset(0), sync_cksm(0), acktime(0), port(0), repldbfd(-1), isRedisSlave(false), state(0), resume_dump_id(
+                            0), resume_dump_bytes(0)
             {
             }
             ~SlaveConnection();
@@ -84,6 +90,8 @@ namespace ardb
             bool m_dumping_ardb;
             int64 m_dump_rdb_offset;
             int64 m_dump_ardb_offset;
+            uint64 m_dump_ardb_cksm;
+            uint64 m_dump_ardb_id;
 
             time_t m_repl_no_slaves_since;
             volatile bool m_backlog_enable;
@@ -95,6 +103,7 @@ namespace ardb
 
             void FullResyncRedisSlave(SlaveConnection& slave);
             void FullResyncArdbSlave(SlaveConnection& slave);
+            bool CanResumeArdbDump(SlaveConnection& slave);
             void SyncSlave(SlaveConnection& slave);
 
             void ClearNilSlave();
@@ -45,6 +45,9 @@ extern "C"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <deque>
+#include "thread/thread_mutex_lock.hpp"
+#include "thread/lock_guard.hpp"
 #include "ardb.hpp"
 
 #define RETURN_NEGATIVE_EXPR(x)  do\
@@ -57,7 +60,11 @@ extern "C"
 
 #define REDIS_RDB_VERSION 6
 
-#define ARDB_RDB_VERSION 1
+/*
+ * version 2 appends the key codec of the dumped raw keys after the magic header
+ * version 3 appends a dump id after the codec and a checksum to every chunk
+ */
+#define ARDB_RDB_VERSION 3
 
 /* Defines related to the dump file format. To store 32 bits lengths for short
  * keys requires a lot of space, so we check the most significant 2 bits of
@@ -190,15 +197,23 @@ namespace ardb
             m_write_fp = NULL;
         }
     }
-    int DataDumpFile::OpenWriteFile(const std::string& file)
+    int DataDumpFile::OpenWriteFile(const std::string& file, bool append)
     {
         this->m_file_path = file;
-        if ((m_write_fp = fopen(m_file_path.c_str(), "w")) == NULL)
+        if ((m_write_fp = fopen(m_file_path.c_str(), append ? "a" : "w")) == NULL)
         {
             ERROR_LOG("Failed to open ardb dump file:%s to write", m_file_path.c_str());
             return -1;
         }
         m_writed_data_size = 0;
+        if (append)
+        {
+            struct stat st;
+            if (0 == fstat(fileno(m_write_fp), &st))
+            {
+                m_writed_data_size = st.st_size;
+            }
+        }
         return 0;
     }
 
@@ -256,6 +271,7 @@ namespace ardb
 
         size_t max_write_bytes = 1024 * 1024 * 2;
         const char* data = (const char*) buf;
+        m_writed_data_size += buflen;
         while (buflen)
         {
             size_t bytes_to_write = (max_write_bytes < buflen) ? max_write_bytes : buflen;
@@ -266,7 +282,6 @@ namespace ardb
             data += bytes_to_write;
             buflen -= bytes_to_write;
         }
-        m_writed_data_size += buflen;
         return 0;
     }
 
@@ -1501,6 +1516,14 @@ namespace ardb
                         case ZSET_META:
                         case SET_META:
                         {
+                            if (vv.type == LIST_META && vv.meta.IsChunkedList())
+                            {
+                                //chunked list elements are dumped from the chunk records directly
+                                vv.key.db = kk.db;
+                                vv.key.key = kk.key;
+                                vv.key.type = KEY_META;
+                                break;
+                            }
                             if (vv.meta.Encoding() == COLLECTION_ENCODING_RAW)
                             {
                                 iter->Next();
@@ -1600,6 +1623,18 @@ namespace ardb
                     }
                     case LIST_META:
                     {
+                        if (vv.meta.IsChunkedList())
+                        {
+                            DUMP_CHECK_WRITE(WriteLen(vv.meta.Length()));
+                            ListIterator list_iter;
+                            m_db->ListIter(tmpctx, vv, list_iter, false);
+                            while (list_iter.Valid())
+                            {
+                                DUMP_CHECK_WRITE(WriteStringObject(*(list_iter.Element())));
+                                list_iter.Next();
+                            }
+                            break;
+                        }
                         DUMP_CHECK_WRITE(WriteLen(vv.meta.ziplist.size()));
                         DataArray::iterator it = vv.meta.ziplist.begin();
                         while (it != vv.meta.ziplist.end())
@@ -1664,7 +1699,257 @@ namespace ardb
     /*
      * Ardb dump file, used for backup data & import data
      */
-    ArdbDumpFile::ArdbDumpFile()
+    static const uint32 kdump_chunk_size = 1024 * 1024;
+
+    struct ArdbDumpChunk
+    {
+            uint8 type;
+            uint32 rawlen;
+            uint64 cksm;
+            std::string data;
+            ArdbDumpChunk() :
+                    type(0), rawlen(0), cksm(0)
+            {
+            }
+    };
+
+    /*
+     * Bounded chunk queue between the dump file thread and the range scanning/loading workers. Chunks carry
+     * whole key values, so they are written and applied in any order.
+     */
+    struct ArdbDumpChunkQueue: public ThreadMutexLock
+    {
+            std::deque<ArdbDumpChunk*> chunks;
+            size_t limit;
+            uint32 producers;
+            uint32 consumers;
+            volatile bool abort;
+            ArdbDumpChunkQueue(size_t max) :
+                    limit(max), producers(0), consumers(0), abort(false)
+            {
+            }
+            bool Push(ArdbDumpChunk* chunk)
+            {
+                LockGuard<ThreadMutexLock> guard(*this);
+                while (chunks.size() >= limit && !abort)
+                {
+                    Wait(100);
+                }
+                if (abort)
+                {
+                    DELETE(chunk);
+                    return false;
+                }
+                chunks.push_back(chunk);
+                NotifyAll();
+                return true;
+            }
+            ArdbDumpChunk* Pop(uint64 wait_ms)
+            {
+                LockGuard<ThreadMutexLock> guard(*this);
+                if (chunks.empty() && producers > 0 && !abort)
+                {
+                    Wait(wait_ms);
+                }
+                if (abort || chunks.empty())
+                {
+                    return NULL;
+                }
+                ArdbDumpChunk* chunk = chunks.front();
+                chunks.pop_front();
+                NotifyAll();
+                return chunk;
+            }
+            bool Drained()
+            {
+                LockGuard<ThreadMutexLock> guard(*this);
+                return abort || (producers == 0 && chunks.empty());
+            }
+            bool ConsumersDone()
+            {
+                LockGuard<ThreadMutexLock> guard(*this);
+                return consumers == 0;
+            }
+            void WaitConsumers(uint64 wait_ms)
+            {
+                LockGuard<ThreadMutexLock> guard(*this);
+                if (consumers > 0)
+                {
+                    Wait(wait_ms);
+                }
+            }
+            void ProducerDone()
+            {
+                LockGuard<ThreadMutexLock> guard(*this);
+                producers--;
+                NotifyAll();
+            }
+            void ConsumerDone()
+            {
+                LockGuard<ThreadMutexLock> guard(*this);
+                consumers--;
+                NotifyAll();
+            }
+            void Abort()
+            {
+                LockGuard<ThreadMutexLock> guard(*this);
+                abort = true;
+                NotifyAll();
+            }
+            ~ArdbDumpChunkQueue()
+            {
+                while (!chunks.empty())
+                {
+                    DELETE(chunks.front());
+                    chunks.pop_front();
+                }
+            }
+    };
+
+    static int compare_raw_key(const Slice& a, const Slice& b)
+    {
+        if (CommonComparator::Bytewise())
+        {
+            return a.compare(b);
+        }
+        return CommonComparator::Compare(a.data(), a.size(), b.data(), b.size());
+    }
+
+    static ArdbDumpChunk* new_dump_chunk(Buffer& buffer)
+    {
+        ArdbDumpChunk* chunk = NULL;
+        NEW(chunk, ArdbDumpChunk);
+        chunk->rawlen = buffer.ReadableBytes();
+        snappy::Compress(buffer.GetRawReadBuffer(), buffer.ReadableBytes(), &chunk->data);
+        if (chunk->data.size() > (chunk->rawlen + 4))
+        {
+            chunk->type = ARDB_RDB_TYPE_CHUNK;
+            chunk->data.assign(buffer.GetRawReadBuffer(), buffer.ReadableBytes());
+        }
+        else
+        {
+            chunk->type = ARDB_RDB_TYPE_SNAPPY_CHUNK;
+        }
+        chunk->cksm = crc64(0, (unsigned char *) chunk->data.data(), chunk->data.size());
+        buffer.Clear();
+        return chunk;
+    }
+
+    /*
+     * Scans [begin, end) of the engine, an empty end means the last range. All ranges of a dump read the same
+     * engine snapshot.
+     */
+    class ArdbDumpRangeTask: public Thread
+    {
+        private:
+            KeyValueEngine& m_engine;
+            ArdbDumpChunkQueue& m_queue;
+            const void* m_snapshot;
+            std::string m_begin;
+            std::string m_end;
+        public:
+            ArdbDumpRangeTask(KeyValueEngine& engine, ArdbDumpChunkQueue& queue, const void* snapshot,
+                    const std::string& begin, const std::string& end) :
+                    m_engine(engine), m_queue(queue), m_snapshot(snapshot), m_begin(begin), m_end(end)
+            {
+            }
+            void Run()
+            {
+                Options options;
+                options.read_fill_cache = false;
+                options.snapshot = m_snapshot;
+                Iterator* iter = m_engine.Find(m_begin, options);
+                Buffer buffer;
+                bool success = true;
+                while (NULL != iter && iter->Valid() && success)
+                {
+                    Slice key = iter->Key();
+                    if (!m_end.empty() && compare_raw_key(key, m_end) >= 0)
+                    {
+                        break;
+                    }
+                    BufferHelper::WriteVarSlice(buffer, key);
+                    BufferHelper::WriteVarSlice(buffer, iter->Value());
+                    if (buffer.ReadableBytes() >= kdump_chunk_size)
+                    {
+                        success = m_queue.Push(new_dump_chunk(buffer));
+                    }
+                    iter->Next();
+                }
+                DELETE(iter);
+                if (success && buffer.Readable())
+                {
+                    m_queue.Push(new_dump_chunk(buffer));
+                }
+                m_queue.ProducerDone();
+            }
+    };
+
+    class ArdbDumpLoadTask: public Thread
+    {
+        private:
+            ArdbDumpFile& m_dump;
+            ArdbDumpChunkQueue& m_queue;
+            Context m_ctx;
+            bool m_verify_cksm;
+            bool Load(ArdbDumpChunk& chunk)
+            {
+                if (m_verify_cksm && crc64(0, (unsigned char *) chunk.data.data(), chunk.data.size()) != chunk.cksm)
+                {
+                    ERROR_LOG("Wrong checksum of dump chunk with %u bytes.", (uint32) chunk.data.size());
+                    return false;
+                }
+                std::string origin;
+                if (chunk.type == ARDB_RDB_TYPE_SNAPPY_CHUNK)
+                {
+                    origin.reserve(chunk.rawlen);
+                    if (!snappy::Uncompress(chunk.data.data(), chunk.data.size(), &origin))
+                    {
+                        ERROR_LOG("Failed to uncompress dump chunk.");
+                        return false;
+                    }
+                }
+                else
+                {
+                    origin.swap(chunk.data);
+                }
+                Buffer readbuf(const_cast<char*>(origin.data()), 0, origin.size());
+                BatchWriteGuard guard(m_ctx);
+                return m_dump.LoadBuffer(m_ctx, readbuf) >= 0;
+            }
+        public:
+            ArdbDumpLoadTask(ArdbDumpFile& dump, ArdbDumpChunkQueue& queue, uint8 identity, bool verify_cksm) :
+                    m_dump(dump), m_queue(queue), m_verify_cksm(verify_cksm)
+            {
+                m_ctx.identity = identity;
+            }
+            void Run()
+            {
+                while (true)
+                {
+                    ArdbDumpChunk* chunk = m_queue.Pop(100);
+                    if (NULL == chunk)
+                    {
+                        if (m_queue.Drained())
+                        {
+                            break;
+                        }
+                        continue;
+                    }
+                    bool success = Load(*chunk);
+                    DELETE(chunk);
+                    if (!success)
+                    {
+                        m_queue.Abort();
+                        break;
+                    }
+                }
+                m_queue.ConsumerDone();
+            }
+    };
+
+    ArdbDumpFile::ArdbDumpFile() :
+            m_key_codec(ARDB_CODEC_VARINT), m_dump_id(0)
     {
     }
 
@@ -1672,7 +1957,37 @@ namespace ardb
     {
         char magic[10];
         snprintf(magic, sizeof(magic), "ARDB%04d", ARDB_RDB_VERSION);
-        return Write(magic, 8);
+        RETURN_NEGATIVE_EXPR(Write(magic, 8));
+        uint8 codec = (uint8) KeyObject::CodecVersion();
+        RETURN_NEGATIVE_EXPR(Write(&codec, 1));
+        m_dump_id = get_current_epoch_micros();
+        uint64 id = m_dump_id;
+        memrev64ifbe(&id);
+        return Write(&id, sizeof(id));
+    }
+
+    int ArdbDumpFile::ReadDumpID(const std::string& file, uint64& id)
+    {
+        char header[17];
+        FILE* fp = fopen(file.c_str(), "r");
+        if (NULL == fp)
+        {
+            return -1;
+        }
+        size_t n = fread(header, 1, sizeof(header), fp);
+        fclose(fp);
+        if (n != sizeof(header) || memcmp(header, "ARDB", 4) != 0)
+        {
+            return -1;
+        }
+        std::string verstr(header + 4, 4);
+        if (atoi(verstr.c_str()) < 3)
+        {
+            return -1;
+        }
+        memcpy(&id, header + 9, sizeof(id));
+        memrev64ifbe(&id);
+        return 0;
     }
 
     int ArdbDumpFile::WriteType(uint8 type)
@@ -1680,27 +1995,21 @@ namespace ardb
         return Write(&type, 1);
     }
 
-    int ArdbDumpFile::SaveRawKeyValue(const Slice& key, const Slice& value)
+    /*
+     * type, raw length, [compressed length], checksum of the payload, payload
+     */
+    int ArdbDumpFile::WriteChunk(ArdbDumpChunk& chunk)
     {
-        /*
-         * routine callback every 100ms
-         */
-        if (NULL != m_routine_cb && get_current_epoch_millis() - m_routinetime >= 100)
+        RETURN_NEGATIVE_EXPR(WriteType(chunk.type));
+        RETURN_NEGATIVE_EXPR(WriteLen(chunk.rawlen));
+        if (chunk.type == ARDB_RDB_TYPE_SNAPPY_CHUNK)
         {
-            int cbret = m_routine_cb(m_routine_cbdata);
-            if(0 != cbret)
-            {
-                return cbret;
-            }
-            m_routinetime = get_current_epoch_millis();
+            RETURN_NEGATIVE_EXPR(WriteLen(chunk.data.size()));
         }
-        BufferHelper::WriteVarSlice(m_write_buffer, key);
-        BufferHelper::WriteVarSlice(m_write_buffer, value);
-        if (m_write_buffer.ReadableBytes() >= 1024 * 1024)
-        {
-            return FlushWriteBuffer();
-        }
-        return 0;
+        uint64 cksm = chunk.cksm;
+        memrev64ifbe(&cksm);
+        RETURN_NEGATIVE_EXPR(Write(&cksm, sizeof(cksm)));
+        return Write(chunk.data.data(), chunk.data.size());
     }
 
     int ArdbDumpFile::WriteLen(uint32 len)
@@ -1722,31 +2031,35 @@ namespace ardb
         return 0;
     }
 
-    int ArdbDumpFile::FlushWriteBuffer()
+    /*
+     * Engine size estimates first, otherwise every db starts a range.
+     */
+    void ArdbDumpFile::SplitDumpRanges(uint32 parts, std::vector<std::string>& keys)
     {
-        if (m_write_buffer.Readable())
+        if (parts <= 1)
         {
-            std::string compressed;
-            snappy::Compress(m_write_buffer.GetRawReadBuffer(), m_write_buffer.ReadableBytes(), &compressed);
-            if (compressed.size() > (m_write_buffer.ReadableBytes() + 4))
-            {
-                RETURN_NEGATIVE_EXPR(WriteType(ARDB_RDB_TYPE_CHUNK));
-                uint32 len = m_write_buffer.ReadableBytes();
-                RETURN_NEGATIVE_EXPR(WriteLen(len));
-                RETURN_NEGATIVE_EXPR(Write(m_write_buffer.GetRawReadBuffer(), m_write_buffer.ReadableBytes()));
-            }
-            else
+            return;
+        }
+        if (0 == m_db->GetKeyValueEngine().EstimateSplitKeys(parts, keys) && !keys.empty())
+        {
+            return;
+        }
+        keys.clear();
+        DBIDSet dbs;
+        m_db->GetAllDBIDSet(dbs);
+        std::vector<DBID> ids(dbs.begin(), dbs.end());
+        for (uint32 i = 1; i < parts && i < ids.size(); i++)
+        {
+            KeyObject k;
+            k.db = ids[i * ids.size() / parts];
+            k.type = KEY_META;
+            k.Encode();
+            std::string key(k.encode_buf.GetRawReadBuffer(), k.encode_buf.ReadableBytes());
+            if (keys.empty() || compare_raw_key(keys.back(), key) < 0)
             {
-                RETURN_NEGATIVE_EXPR(WriteType(ARDB_RDB_TYPE_SNAPPY_CHUNK));
-                uint32 rawlen = m_write_buffer.ReadableBytes();
-                RETURN_NEGATIVE_EXPR(WriteLen(rawlen));
-                RETURN_NEGATIVE_EXPR(WriteLen(compressed.size()));
-                RETURN_NEGATIVE_EXPR(Write(compressed.data(), compressed.size()));
+                keys.push_back(key);
             }
-            m_write_buffer.Clear();
         }
-        Flush();
-        return 0;
     }
 
     int ArdbDumpFile::DoSave()
@@ -1756,30 +2069,79 @@ namespace ardb
         KeyObject k;
         k.db = 0;
         k.type = KEY_META;
-        BatchWriteGuard guard(*m_dump_ctx);
-        Iterator* iter = m_db->IteratorKeyValue(k, false);
-        if (NULL != iter)
+        k.Encode();
+        std::string begin(k.encode_buf.GetRawReadBuffer(), k.encode_buf.ReadableBytes());
+        KeyValueEngine& engine = m_db->GetKeyValueEngine();
+        std::vector<std::string> split_keys;
+        const void* snapshot = engine.NewSnapshot();
+        if (NULL != snapshot)
         {
-            while (iter->Valid())
+            SplitDumpRanges(m_db->GetConfig().dump_threads, split_keys);
+        }
+        else if (m_db->GetConfig().dump_threads > 1)
+        {
+            /*
+             * a single iterator is the only consistent view of engines without shared snapshots
+             */
+            INFO_LOG("Engine can not share snapshots across threads, dump data in one range.");
+        }
+        split_keys.push_back("");
+
+        ArdbDumpChunkQueue queue(split_keys.size() * 2);
+        std::vector<ArdbDumpRangeTask*> tasks;
+        for (size_t i = 0; i < split_keys.size(); i++)
+        {
+            if (!split_keys[i].empty() && compare_raw_key(split_keys[i], begin) <= 0)
             {
-                //DelRaw(ctx, iter->Key());
-                int ret = SaveRawKeyValue(iter->Key(), iter->Value());
-                if(0 != ret)
-                {
-                    DELETE(iter);
-                    Close();
-                    return ret;
-                }
-                iter->Next();
+                continue;
             }
+            tasks.push_back(new ArdbDumpRangeTask(engine, queue, snapshot, begin, split_keys[i]));
+            begin = split_keys[i];
         }
-        DELETE(iter);
-        FlushWriteBuffer();
-        WriteType(REDIS_RDB_OPCODE_EOF);
+        queue.producers = tasks.size();
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+            tasks[i]->Start();
+        }
+        INFO_LOG("Dump data in %u ranges.", (uint32) tasks.size());
+        int err = 0;
+        while (0 == err && !queue.Drained())
+        {
+            ArdbDumpChunk* chunk = queue.Pop(100);
+            if (NULL != chunk)
+            {
+                err = WriteChunk(*chunk);
+                DELETE(chunk);
+            }
+            else if (NULL != m_routine_cb && get_current_epoch_millis() - m_routinetime >= 100)
+            {
+                err = m_routine_cb(m_routine_cbdata);
+                m_routinetime = get_current_epoch_millis();
+            }
+        }
+        if (0 != err)
+        {
+            queue.Abort();
+        }
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+            tasks[i]->Join();
+            DELETE(tasks[i]);
+        }
+        if (NULL != snapshot)
+        {
+            engine.ReleaseSnapshot(snapshot);
+        }
+        if (0 != err)
+        {
+            Close();
+            return err;
+        }
+        WriteType(ARDB_RDB_TYPE_EOF);
         uint64 cksm = m_cksm;
         memrev64ifbe(&cksm);
         Write(&cksm, sizeof(cksm));
-        FlushWriteBuffer();
+        Flush();
         return 0;
     }
 
@@ -1791,25 +2153,33 @@ namespace ardb
         return type;
     }
 
-    int ArdbDumpFile::LoadBuffer(Buffer& buffer)
+    int ArdbDumpFile::LoadBuffer(Context& ctx, Buffer& buffer)
     {
         while (buffer.Readable())
         {
             Slice key, value;
             RETURN_NEGATIVE_EXPR(BufferHelper::ReadVarSlice(buffer, key));
             RETURN_NEGATIVE_EXPR(BufferHelper::ReadVarSlice(buffer, value));
-            Context& tmpctx = *m_dump_ctx;
-            if(tmpctx.identity == CONTEXT_DUMP_SYNC_LOADING)
+            KeyObject k;
+            if (ctx.identity == CONTEXT_DUMP_SYNC_LOADING || m_key_codec != KeyObject::CodecVersion())
             {
-                uint32 header;
-                memcpy(&header, key.data(), sizeof(header));
-                DBID db = header >> 8;
-                if(!g_db->m_slave.SupportDBID(db))
+                if (!decode_key(key, k, m_key_codec))
                 {
+                    WARN_LOG("Invalid key entry in dump file.");
                     continue;
                 }
+                if (ctx.identity == CONTEXT_DUMP_SYNC_LOADING && !g_db->m_slave.SupportDBID(k.db))
+                {
+                    continue;
+                }
+                if (m_key_codec != KeyObject::CodecVersion())
+                {
+                    /* dumped by a server using another key codec */
+                    k.Encode();
+                    key = Slice(k.encode_buf.GetRawReadBuffer(), k.encode_buf.ReadableBytes());
+                }
             }
-            m_db->SetRaw(tmpctx, key, value);
+            m_db->SetRaw(ctx, key, value);
         }
         return 0;
     }
@@ -1818,12 +2188,12 @@ namespace ardb
     {
         char buf[1024];
         int rdbver, type;
-        std::string key;
         std::string verstr;
         uint32 len = 0;
         uint32 rawlen, compressedlen;
-        std::string origin;
-        BatchWriteGuard guard(*m_dump_ctx);
+        uint32 threads = m_db->GetConfig().dump_threads;
+        ArdbDumpChunkQueue queue(threads * 2);
+        std::vector<ArdbDumpLoadTask*> tasks;
         if (!Read(buf, 8, true))
             goto eoferr;
         buf[9] = '\0';
@@ -1840,7 +2210,31 @@ namespace ardb
             WARN_LOG("Can't handle ARDB format version %d", rdbver);
             return -1;
         }
+        m_key_codec = ARDB_CODEC_VARINT;
+        if (rdbver >= 2)
+        {
+            uint8 codec;
+            if (!Read(&codec, 1, true))
+                goto eoferr;
+            m_key_codec = codec;
+        }
+        if (rdbver >= 3)
+        {
+            if (!Read(&m_dump_id, sizeof(m_dump_id), true))
+                goto eoferr;
+            memrev64ifbe(&m_dump_id);
+        }
 
+        /*
+         * Chunks are read here and applied by the loading threads.
+         */
+        queue.producers = 1;
+        queue.consumers = threads;
+        for (uint32 i = 0; i < threads; i++)
+        {
+            tasks.push_back(new ArdbDumpLoadTask(*this, queue, m_dump_ctx->identity, rdbver >= 3));
+            tasks.back()->Start();
+        }
         while (true)
         {
             /* Read type. */
@@ -1850,48 +2244,67 @@ namespace ardb
             if (type == ARDB_RDB_TYPE_EOF)
                 break;
 
-            /* Handle SELECT DB opcode as a special case */
+            ArdbDumpChunk* chunk = NULL;
             if (type == ARDB_RDB_TYPE_CHUNK)
             {
-                RETURN_NEGATIVE_EXPR(ReadLen(len));
-                char* newbuf = NULL;
-                NEW(newbuf, char[len]);
-                if (!Read(newbuf, len, true))
-                {
-                    DELETE_A(newbuf);
+                if (ReadLen(len) < 0)
                     goto eoferr;
-                }
-                Buffer readbuf(newbuf, 0, len);
-                RETURN_NEGATIVE_EXPR(LoadBuffer(readbuf));
+                rawlen = compressedlen = len;
             }
             else if (type == ARDB_RDB_TYPE_SNAPPY_CHUNK)
             {
-                RETURN_NEGATIVE_EXPR(ReadLen(rawlen));
-                RETURN_NEGATIVE_EXPR(ReadLen(compressedlen));
-                char* newbuf = NULL;
-                NEW(newbuf, char[compressedlen]);
-                if (!Read(newbuf, compressedlen, true))
-                {
-                    DELETE_A(newbuf);
+                if (ReadLen(rawlen) < 0 || ReadLen(compressedlen) < 0)
                     goto eoferr;
-                }
-                origin.clear();
-                origin.reserve(rawlen);
-                if (!snappy::Uncompress(newbuf, compressedlen, &origin))
+            }
+            else
+            {
+                ERROR_LOG("Invalid type:%d.", type);
+                goto eoferr;
+            }
+            NEW(chunk, ArdbDumpChunk);
+            chunk->type = type;
+            chunk->rawlen = rawlen;
+            if (rdbver >= 3)
+            {
+                if (!Read(&chunk->cksm, sizeof(chunk->cksm), true))
                 {
-                    DELETE_A(newbuf);
+                    DELETE(chunk);
                     goto eoferr;
                 }
-                DELETE_A(newbuf);
-                Buffer readbuf(const_cast<char*>(origin.data()), 0, origin.size());
-                RETURN_NEGATIVE_EXPR(LoadBuffer(readbuf));
+                memrev64ifbe(&chunk->cksm);
             }
-            else
+            chunk->data.resize(compressedlen);
+            if (!Read(&chunk->data[0], compressedlen, true))
             {
-                ERROR_LOG("Invalid type:%d.", type);
+                DELETE(chunk);
                 goto eoferr;
             }
+            if (!queue.Push(chunk))
+            {
+                goto eoferr;
+            }
+        }
 
+        queue.ProducerDone();
+        while (!queue.Drained() || !queue.ConsumersDone())
+        {
+            queue.WaitConsumers(100);
+            if (NULL != m_routine_cb && get_current_epoch_millis() - m_routinetime >= 100)
+            {
+                m_routine_cb(m_routine_cbdata);
+                m_routinetime = get_current_epoch_millis();
+            }
+        }
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+            tasks[i]->Join();
+            DELETE(tasks[i]);
+        }
+        if (queue.abort)
+        {
+            Close();
+            WARN_LOG("Failed to load dump chunks.");
+            return -1;
         }
 
         if (true)
@@ -1900,7 +2313,9 @@ namespace ardb
             uint64_t cksum, expected = m_cksm;
             if (!Read(&cksum, 8, true))
             {
-                goto eoferr;
+                Close();
+                WARN_LOG("Short read loading DB.");
+                return -1;
             }memrev64ifbe(&cksum);
             if (cksum == 0)
             {
@@ -1916,7 +2331,13 @@ namespace ardb
         Close();
         INFO_LOG("Ardb dump file load finished.");
         return 0;
-        eoferr: Close();
+        eoferr: queue.Abort();
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+            tasks[i]->Join();
+            DELETE(tasks[i]);
+        }
+        Close();
         WARN_LOG("Short read or OOM loading DB. Unrecoverable error, aborting now.");
         return -1;
     }
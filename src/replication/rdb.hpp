@@ -30,6 +30,7 @@
 #ifndef RDB_HPP_
 #define RDB_HPP_
 #include <string>
+#include <vector>
 #include "common.hpp"
 #include "buffer/buffer_helper.hpp"
 #include "codec.hpp"
@@ -73,9 +74,13 @@ namespace ardb
             }
             void SetExpectedDataSize(int64 size);
             int64 DumpLeftDataSize();
+            int64 WritedDataSize()
+            {
+                return m_writed_data_size;
+            }
             int64 ProcessLeftDataSize();
             int Write(const void* buf, size_t buflen);
-            int OpenWriteFile(const std::string& file);
+            int OpenWriteFile(const std::string& file, bool append = false);
             int OpenReadFile(const std::string& file);
             int Load(uint8 ctx_identity, const std::string& file, DumpRoutine* cb, void *data);
             int Save(const std::string& file, DumpRoutine* cb, void *data);
@@ -132,22 +137,35 @@ namespace ardb
             ~RedisDumpFile();
     };
 
+    struct ArdbDumpChunk;
+    class ArdbDumpLoadTask;
     class ArdbDumpFile: public DataDumpFile
     {
         private:
-            Buffer m_write_buffer;
+            int m_key_codec;
+            uint64 m_dump_id;
             int WriteLen(uint32 len);
             int ReadLen(uint32& len);
             int WriteMagicHeader();
             int WriteType(uint8 type);
-            int SaveRawKeyValue(const Slice& key, const Slice& value);
+            int WriteChunk(ArdbDumpChunk& chunk);
             int ReadType();
-            int LoadBuffer(Buffer& buffer);
-            int FlushWriteBuffer();
+            int LoadBuffer(Context& ctx, Buffer& buffer);
+            void SplitDumpRanges(uint32 parts, std::vector<std::string>& keys);
             int DoLoad();
             int DoSave();
+            friend class ArdbDumpLoadTask;
         public:
             ArdbDumpFile();
+            /*
+             * Unique id written in the header of every dump(version 3+), it tells whether a partially received
+             * dump is the same as the one the master has.
+             */
+            uint64 GetDumpID()
+            {
+                return m_dump_id;
+            }
+            static int ReadDumpID(const std::string& file, uint64& id);
             ~ArdbDumpFile();
     };
 
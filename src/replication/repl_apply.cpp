@@ -0,0 +1,177 @@
+/*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "repl_apply.hpp"
+#include "thread/lock_guard.hpp"
+#include "ardb.hpp"
+
+namespace ardb
+{
+    static const uint32 kMaxQueuedApplyTasks = 10000;
+
+    void ReplApplyWorker::Run()
+    {
+        ctx.identity = CONTEXT_SLAVE_CONNECTION;
+        ctx.server_address = MASTER_SERVER_ADDRESS_NAME;
+        while (true)
+        {
+            ReplApplyTask* task = NULL;
+            {
+                LockGuard<ThreadMutexLock> guard(lock);
+                while (running && queue.empty())
+                {
+                    lock.Wait(10);
+                }
+                if (queue.empty())
+                {
+                    break;
+                }
+                task = queue.front();
+                queue.pop_front();
+                applying_seq = task->seq;
+            }
+            /*
+             * Already fed to the replication backlog by the slave in stream order.
+             */
+            ctx.currentDB = task->db;
+            g_db->Call(ctx, task->cmd, ARDB_PROCESS_REPL_WRITE | ARDB_PROCESS_WITHOUT_REPLICATION);
+            ctx.reply.Clear();
+            DELETE(task);
+            atomic_add_uint64(&applier.m_applied_cmds, 1);
+            LockGuard<ThreadMutexLock> guard(lock);
+            applying_seq = 0;
+            lock.NotifyAll();
+        }
+    }
+
+    ReplApplier::ReplApplier() :
+            m_dispatched(0), m_applied_cmds(0), m_barriers(0)
+    {
+    }
+
+    void ReplApplier::Start(uint32 threads)
+    {
+        for (uint32 i = 0; i < threads; i++)
+        {
+            ReplApplyWorker* worker = new ReplApplyWorker(*this);
+            m_workers.push_back(worker);
+        }
+        for (uint32 i = 0; i < m_workers.size(); i++)
+        {
+            m_workers[i]->Start();
+        }
+        INFO_LOG("[Slave]Started %u replication apply threads.", threads);
+    }
+
+    void ReplApplier::Dispatch(DBID db, RedisCommandFrame& cmd)
+    {
+        ReplApplyWorker* worker = m_workers[KeyLocker::HashKey(db, cmd.GetArguments()[0]) % m_workers.size()];
+        ReplApplyTask* task = new ReplApplyTask;
+        task->cmd = cmd;
+        task->db = db;
+        task->seq = m_dispatched + 1;
+        LockGuard<ThreadMutexLock> guard(worker->lock);
+        while (worker->queue.size() >= kMaxQueuedApplyTasks)
+        {
+            worker->lock.Wait(1);
+        }
+        worker->queue.push_back(task);
+        store_release(const_cast<uint64*>(&m_dispatched), task->seq);
+        worker->lock.NotifyAll();
+    }
+
+    void ReplApplier::Barrier()
+    {
+        for (uint32 i = 0; i < m_workers.size(); i++)
+        {
+            ReplApplyWorker* worker = m_workers[i];
+            LockGuard<ThreadMutexLock> guard(worker->lock);
+            while (worker->applying_seq > 0 || !worker->queue.empty())
+            {
+                worker->lock.Wait(1);
+            }
+        }
+        m_barriers++;
+    }
+
+    uint64 ReplApplier::AppliedSeq()
+    {
+        uint64 applied = load_consume(&m_dispatched);
+        for (uint32 i = 0; i < m_workers.size(); i++)
+        {
+            ReplApplyWorker* worker = m_workers[i];
+            LockGuard<ThreadMutexLock> guard(worker->lock);
+            uint64 oldest = worker->applying_seq;
+            if (0 == oldest && !worker->queue.empty())
+            {
+                oldest = worker->queue.front()->seq;
+            }
+            if (oldest > 0 && oldest - 1 < applied)
+            {
+                applied = oldest - 1;
+            }
+        }
+        return applied;
+    }
+
+    void ReplApplier::StopSelf()
+    {
+        for (uint32 i = 0; i < m_workers.size(); i++)
+        {
+            m_workers[i]->running = false;
+        }
+        for (uint32 i = 0; i < m_workers.size(); i++)
+        {
+            m_workers[i]->Join();
+            DELETE(m_workers[i]);
+        }
+        m_workers.clear();
+    }
+
+    const std::string& ReplApplier::PrintStat(std::string& str)
+    {
+        uint64 queued = 0;
+        for (uint32 i = 0; i < m_workers.size(); i++)
+        {
+            LockGuard<ThreadMutexLock> guard(m_workers[i]->lock);
+            queued += m_workers[i]->queue.size();
+        }
+        str.append("slave_apply_threads:").append(stringfromll(m_workers.size())).append("\r\n");
+        str.append("slave_apply_queued_cmds:").append(stringfromll(queued)).append("\r\n");
+        str.append("slave_apply_parallel_cmds:").append(stringfromll(m_applied_cmds)).append("\r\n");
+        str.append("slave_apply_barriers:").append(stringfromll(m_barriers)).append("\r\n");
+        return str;
+    }
+
+    ReplApplier::~ReplApplier()
+    {
+        StopSelf();
+    }
+}
+
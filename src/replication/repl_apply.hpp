@@ -0,0 +1,100 @@
+/*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef REPL_APPLY_HPP_
+#define REPL_APPLY_HPP_
+#include <deque>
+#include <vector>
+#include "context.hpp"
+#include "thread/thread.hpp"
+#include "thread/thread_mutex_lock.hpp"
+
+namespace ardb
+{
+    struct ReplApplyTask
+    {
+            RedisCommandFrame cmd;
+            DBID db;
+            uint64 seq;
+    };
+    typedef std::deque<ReplApplyTask*> ReplApplyTaskQueue;
+
+    class ReplApplier;
+    struct ReplApplyWorker: public Thread
+    {
+            ReplApplier& applier;
+            ThreadMutexLock lock;
+            ReplApplyTaskQueue queue;
+            uint64 applying_seq; /* 0 while idle */
+            volatile bool running;
+            Context ctx;
+            ReplApplyWorker(ReplApplier& a) :
+                    applier(a), applying_seq(0), running(true)
+            {
+            }
+            void Run();
+    };
+
+    /*
+     * Parallel apply of replicated commands on a slave: single key writes are dispatched to a worker by
+     * hash(db, key) so the commands on one key keep their order, anything else is applied by the caller
+     * after a Barrier() which waits until all workers are idle. Dispatched commands are numbered in stream
+     * order, AppliedSeq() is the highest number up to which every command was applied.
+     */
+    class ReplApplier
+    {
+        private:
+            typedef std::vector<ReplApplyWorker*> WorkerArray;
+            WorkerArray m_workers;
+            volatile uint64 m_dispatched;
+            volatile uint64 m_applied_cmds;
+            volatile uint64 m_barriers;
+            friend struct ReplApplyWorker;
+        public:
+            ReplApplier();
+            void Start(uint32 threads);
+            bool IsStarted()
+            {
+                return !m_workers.empty();
+            }
+            void Dispatch(DBID db, RedisCommandFrame& cmd);
+            void Barrier();
+            uint64 DispatchedSeq()
+            {
+                return m_dispatched;
+            }
+            uint64 AppliedSeq();
+            void StopSelf();
+            const std::string& PrintStat(std::string& str);
+            ~ReplApplier();
+    };
+}
+
+#endif /* REPL_APPLY_HPP_ */
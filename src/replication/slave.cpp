@@ -35,6 +35,7 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include "ardb.hpp"
+#include "util/concurrent_queue.hpp"
 
 #define ARDB_SLAVE_SYNC_STATE_MMAP_FILE_SIZE 512
 
@@ -44,7 +45,7 @@ namespace ardb
             m_serv(serv), m_client(NULL), m_slave_state(
             SLAVE_STATE_CLOSED), m_cron_inited(false), m_cmd_recved_time(0), m_master_link_down_time(0), m_server_type(
             ARDB_DB_SERVER_TYPE), m_server_support_psync(false), m_actx(
-            NULL), m_rdb(NULL), m_backlog(serv->m_repl_backlog), m_routine_ts(0), m_cached_master_repl_offset(0), m_cached_master_repl_cksm(
+            NULL), m_rdb(NULL), m_backlog(serv->m_repl_backlog), m_dump_partial(false), m_dump_resuming(false), m_routine_ts(0), m_cached_master_repl_offset(0), m_cached_master_repl_cksm(
                     0), m_lastinteraction(0)
     {
     }
@@ -100,6 +101,20 @@ namespace ardb
         m_master_link_down_time = 0;
     }
 
+    /*
+     * Single key writes of supported dbs could be applied by the apply threads once the slave is synced.
+     */
+    bool Slave::ParallelApplicable(RedisCommandFrame& cmd)
+    {
+        if (m_serv->m_cfg.slave_apply_threads <= 0 || m_slave_state != SLAVE_STATE_SYNCED || m_actx->InTransc()
+                || cmd.GetArguments().empty() || !SupportDBID(m_actx->currentDB))
+        {
+            return false;
+        }
+        Ardb::RedisCommandHandlerSetting* setting = m_serv->FindRedisCommandHandlerSetting(cmd);
+        return NULL != setting && (setting->flags & ARDB_CMD_WRITE) && (setting->flags & ARDB_CMD_SINGLE_KEY);
+    }
+
     void Slave::HandleRedisCommand(Channel* ch, RedisCommandFrame& cmd)
     {
         int flag = ARDB_PROCESS_REPL_WRITE;
@@ -124,6 +139,26 @@ namespace ardb
         m_actx->identity = CONTEXT_SLAVE_CONNECTION;
         m_actx->client = NULL;
         m_actx->server_address = MASTER_SERVER_ADDRESS_NAME;
+        if (ParallelApplicable(cmd))
+        {
+            if (!m_applier.IsStarted())
+            {
+                m_applier.Start(m_serv->m_cfg.slave_apply_threads);
+            }
+            m_applier.Dispatch(m_actx->currentDB, cmd);
+            ReplApplyTask* task = new ReplApplyTask;
+            task->cmd = cmd;
+            task->db = m_actx->currentDB;
+            task->seq = m_applier.DispatchedSeq();
+            m_unfed_cmds.push_back(task);
+            FeedAppliedCommands();
+            return;
+        }
+        /*
+         * Multi key commands, SELECT, MULTI/EXEC and others wait for all dispatched commands.
+         */
+        m_applier.Barrier();
+        FeedAppliedCommands();
         if (0 != strcasecmp(cmd.GetCommand().c_str(), "SELECT"))
         {
             if (!SupportDBID(m_actx->currentDB))
@@ -133,6 +168,33 @@ namespace ardb
         }
         m_serv->Call(*m_actx, cmd, flag);
     }
+
+    void Slave::FeedAppliedCommands()
+    {
+        if (m_unfed_cmds.empty())
+        {
+            return;
+        }
+        uint64 applied = m_applier.AppliedSeq();
+        while (!m_unfed_cmds.empty() && m_unfed_cmds.front()->seq <= applied)
+        {
+            ReplApplyTask* task = m_unfed_cmds.front();
+            m_unfed_cmds.pop_front();
+            m_serv->m_master.FeedSlaves(task->db, task->cmd);
+            DELETE(task);
+        }
+    }
+
+    int64 Slave::AckOffset()
+    {
+        FeedAppliedCommands();
+        return m_backlog.GetReplEndOffset();
+    }
+
+    const std::string& Slave::PrintApplyStat(std::string& str)
+    {
+        return m_applier.PrintStat(str);
+    }
     void Slave::Routine()
     {
         uint32 now = time(NULL);
@@ -148,12 +210,13 @@ namespace ardb
                 }
             }
         }
+        FeedAppliedCommands();
         if (m_slave_state == SLAVE_STATE_SYNCED || m_slave_state == SLAVE_STATE_LOADING_DUMP_DATA)
         {
             if (m_server_support_psync && NULL != m_client)
             {
                 Buffer ack;
-                ack.Printf("REPLCONF ACK %lld\r\n", m_backlog.GetReplEndOffset());
+                ack.Printf("REPLCONF ACK %lld\r\n", AckOffset());
                 m_client->Write(ack);
             }
         }
@@ -225,8 +288,26 @@ namespace ardb
                     Buffer sync;
                     if (m_server_type == ARDB_DB_SERVER_TYPE)
                     {
-                        sync.Printf("apsync %s %lld cksm %llu\r\n", m_backlog.GetServerKey(),
-                                m_backlog.GetReplEndOffset(), m_backlog.GetChecksum());
+                        uint64 dump_id = 0;
+                        if (m_dump_partial && NULL != m_rdb)
+                        {
+                            m_rdb->Flush();
+                            if (0 != ArdbDumpFile::ReadDumpID(m_rdb->GetPath(), dump_id))
+                            {
+                                m_dump_partial = false;
+                            }
+                        }
+                        if (m_dump_partial)
+                        {
+                            sync.Printf("apsync %s %lld cksm %llu dump-id %llu dump-bytes %lld\r\n",
+                                    m_backlog.GetServerKey(), m_backlog.GetReplEndOffset(), m_backlog.GetChecksum(),
+                                    dump_id, m_rdb->WritedDataSize());
+                        }
+                        else
+                        {
+                            sync.Printf("apsync %s %lld cksm %llu\r\n", m_backlog.GetServerKey(),
+                                    m_backlog.GetReplEndOffset(), m_backlog.GetChecksum());
+                        }
                     }
                     else
                     {
@@ -265,10 +346,17 @@ namespace ardb
                         ch->Close();
                         return;
                     }
+                    /*
+                     * The master sends the rest of the dump we have partially
+                     */
+                    int64 resume_bytes = 0;
+                    m_dump_resuming = m_dump_partial && ss.size() > 4 && string_toint64(ss[4], resume_bytes)
+                            && resume_bytes == m_rdb->WritedDataSize();
+                    m_dump_partial = false;
                     /*
                      * Delete all data before receiving resyncing data
                      */
-                    if (m_serv->m_cfg.slave_cleardb_before_fullresync)
+                    if (m_serv->m_cfg.slave_cleardb_before_fullresync && !m_dump_resuming)
                     {
                         Context tmp;
                         m_serv->FlushAllData(tmp);
@@ -326,7 +414,19 @@ namespace ardb
         }
         if (chunk.IsFirstChunk())
         {
-            GetNewDumpFile()->SetExpectedDataSize(chunk.len);
+            if (m_dump_resuming)
+            {
+                std::string path = m_rdb->GetPath();
+                m_rdb->Close();
+                m_rdb->OpenWriteFile(path, true);
+                m_rdb->SetExpectedDataSize(m_rdb->WritedDataSize() + chunk.len);
+                INFO_LOG("[Slave]Resume dump file:%s from %lld bytes", path.c_str(), m_rdb->WritedDataSize());
+                m_dump_resuming = false;
+            }
+            else
+            {
+                GetNewDumpFile()->SetExpectedDataSize(chunk.len);
+            }
         }
         if (!chunk.chunk.empty())
         {
@@ -356,6 +456,7 @@ namespace ardb
                 m_client->DetachFD();
             }
             int ret = m_rdb->Load(CONTEXT_DUMP_SYNC_LOADING, m_rdb->GetPath(), Slave::LoadRDBRoutine, this);
+            m_serv->RebuildKeyCounts();
             if (NULL != m_client)
             {
                 /*
@@ -411,6 +512,11 @@ namespace ardb
     void Slave::ChannelClosed(ChannelHandlerContext& ctx, ChannelStateEvent& e)
     {
         INFO_LOG("[Slave]Replication connection closed.");
+        m_applier.Barrier();
+        FeedAppliedCommands();
+        m_dump_partial = m_slave_state == SLAVE_STATE_SYNING_DUMP_DATA && m_server_type == ARDB_DB_SERVER_TYPE
+                && NULL != m_rdb && m_rdb->WritedDataSize() > 0 && m_rdb->DumpLeftDataSize() > 0;
+        m_dump_resuming = false;
         m_lastinteraction = m_master_link_down_time = time(NULL);
         m_client = NULL;
         m_slave_state = 0;
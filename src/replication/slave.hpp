@@ -39,6 +39,7 @@
 #include "util/mmap.hpp"
 #include "rdb.hpp"
 #include "repl_backlog.hpp"
+#include "repl_apply.hpp"
 #include "codec.hpp"
 
 using namespace ardb::codec;
@@ -78,6 +79,12 @@ namespace ardb
              */
             DataDumpFile* m_rdb;
             ReplBacklog& m_backlog;
+            /*
+             * The ardb dump was partially received when the link dropped, and the master agreed to send the
+             * rest of it.
+             */
+            bool m_dump_partial;
+            bool m_dump_resuming;
 
             time_t m_routine_ts;
 
@@ -87,6 +94,16 @@ namespace ardb
 
             time_t m_lastinteraction;
 
+            ReplApplier m_applier;
+            /*
+             * Dispatched commands not fed to the own backlog yet, in stream order. A command is fed once every
+             * command dispatched up to it was applied, so the replication offset never covers unapplied writes.
+             */
+            ReplApplyTaskQueue m_unfed_cmds;
+
+            bool ParallelApplicable(RedisCommandFrame& cmd);
+            void FeedAppliedCommands();
+            int64 AckOffset();
             void HandleRedisCommand(Channel* ch, RedisCommandFrame& cmd);
             void HandleRedisReply(Channel* ch, RedisReply& reply);
             void HandleRedisDumpChunk(Channel* ch, RedisDumpFileChunk& chunk);
@@ -121,6 +138,7 @@ namespace ardb
             time_t GetMasterLastinteractionTime();
             int64 SyncLeftBytes();
             int64 LoadingLeftBytes();
+            const std::string& PrintApplyStat(std::string& str);
     };
 }
 
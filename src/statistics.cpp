@@ -28,7 +28,177 @@
  */
 #include "statistics.hpp"
 #include "ardb.hpp"
+#include <stdlib.h>
 OP_NAMESPACE_BEGIN
+    static void* alloc_cache_aligned(size_t bytes)
+    {
+        bytes = (bytes + ARDB_CACHE_LINE_SIZE - 1) / ARDB_CACHE_LINE_SIZE * ARDB_CACHE_LINE_SIZE;
+        void* mem = NULL;
+        if (0 != posix_memalign(&mem, ARDB_CACHE_LINE_SIZE, bytes))
+        {
+            abort();
+        }
+        memset(mem, 0, bytes);
+        return mem;
+    }
+
+    CommandStatistics::CommandStatistics() :
+            m_size(0)
+    {
+        pthread_key_create(&m_key, NULL);
+    }
+
+    void CommandStatistics::Init(uint32 size)
+    {
+        m_size = size;
+    }
+
+    CommandStatistics::Counter* CommandStatistics::ThreadCounters()
+    {
+        Counter* counters = (Counter*) pthread_getspecific(m_key);
+        if (NULL == counters)
+        {
+            counters = (Counter*) alloc_cache_aligned(m_size * sizeof(Counter));
+            pthread_setspecific(m_key, counters);
+            LockGuard<SpinMutexLock> guard(m_lock);
+            m_thread_counters.push_back(counters);
+        }
+        return counters;
+    }
+
+    CommandStatistics::Counter CommandStatistics::Merge(uint32 id)
+    {
+        Counter total;
+        LockGuard<SpinMutexLock> guard(m_lock);
+        for (uint32 i = 0; id < m_size && i < m_thread_counters.size(); i++)
+        {
+            total.calls += m_thread_counters[i][id].calls;
+            total.microseconds += m_thread_counters[i][id].microseconds;
+        }
+        return total;
+    }
+
+    CommandStatistics::~CommandStatistics()
+    {
+        for (uint32 i = 0; i < m_thread_counters.size(); i++)
+        {
+            free(m_thread_counters[i]);
+        }
+        pthread_key_delete(m_key);
+    }
+
+    LatencyHistograms::LatencyHistograms() :
+            m_size(0), m_window_start(time(NULL))
+    {
+        pthread_key_create(&m_key, NULL);
+    }
+
+    void LatencyHistograms::Init(uint32 size)
+    {
+        m_size = size;
+    }
+
+    LatencyHistograms::ThreadHistograms* LatencyHistograms::GetThreadHistograms()
+    {
+        ThreadHistograms* histograms = (ThreadHistograms*) pthread_getspecific(m_key);
+        if (NULL == histograms)
+        {
+            histograms = (ThreadHistograms*) alloc_cache_aligned(sizeof(ThreadHistograms));
+            pthread_setspecific(m_key, histograms);
+            LockGuard<SpinMutexLock> guard(m_lock);
+            m_thread_histograms.push_back(histograms);
+        }
+        return histograms;
+    }
+
+    LatencyHistogram* LatencyHistograms::GetThreadCommands()
+    {
+        ThreadHistograms* histograms = GetThreadHistograms();
+        if (NULL == histograms->commands)
+        {
+            LatencyHistogram* commands = (LatencyHistogram*) alloc_cache_aligned(m_size * sizeof(LatencyHistogram));
+            LockGuard<SpinMutexLock> guard(m_lock);
+            histograms->commands = commands;
+        }
+        return histograms->commands;
+    }
+
+    bool LatencyHistograms::GetCommand(uint32 id, LatencyHistogram& merged)
+    {
+        merged.Clear();
+        if (id >= m_size)
+        {
+            return false;
+        }
+        LockGuard<SpinMutexLock> guard(m_lock);
+        for (uint32 i = 0; i < m_thread_histograms.size(); i++)
+        {
+            if (NULL != m_thread_histograms[i]->commands)
+            {
+                merged.Merge(m_thread_histograms[i]->commands[id]);
+            }
+        }
+        return true;
+    }
+
+    void LatencyHistograms::GetEngine(EngineOperation op, LatencyHistogram& merged)
+    {
+        merged.Clear();
+        LockGuard<SpinMutexLock> guard(m_lock);
+        for (uint32 i = 0; i < m_thread_histograms.size(); i++)
+        {
+            merged.Merge(m_thread_histograms[i]->engine[op]);
+        }
+    }
+
+    void LatencyHistograms::GetQueue(LatencyHistogram& merged)
+    {
+        merged.Clear();
+        LockGuard<SpinMutexLock> guard(m_lock);
+        for (uint32 i = 0; i < m_thread_histograms.size(); i++)
+        {
+            merged.Merge(m_thread_histograms[i]->queue);
+        }
+    }
+
+    const char* LatencyHistograms::EngineOperationName(EngineOperation op)
+    {
+        static const char* names[] = { "get", "put", "del", "find", "commit", "compact" };
+        return op < ENGINE_OP_MAX ? names[op] : "unknown";
+    }
+
+    /*
+     * Counts recorded by their threads while this runs may survive the reset.
+     */
+    void LatencyHistograms::Clear()
+    {
+        LockGuard<SpinMutexLock> guard(m_lock);
+        for (uint32 i = 0; i < m_thread_histograms.size(); i++)
+        {
+            ThreadHistograms* histograms = m_thread_histograms[i];
+            for (uint32 j = 0; NULL != histograms->commands && j < m_size; j++)
+            {
+                histograms->commands[j].Clear();
+            }
+            for (uint32 j = 0; j < ENGINE_OP_MAX; j++)
+            {
+                histograms->engine[j].Clear();
+            }
+            histograms->queue.Clear();
+        }
+        m_window_start = time(NULL);
+    }
+
+    LatencyHistograms::~LatencyHistograms()
+    {
+        for (uint32 i = 0; i < m_thread_histograms.size(); i++)
+        {
+            free(m_thread_histograms[i]->commands);
+            free(m_thread_histograms[i]);
+        }
+        pthread_key_delete(m_key);
+    }
+
     Statistics::Statistics() :
             m_ops_sec_last_sample_time(get_current_epoch_millis())
     {
@@ -46,16 +216,19 @@ OP_NAMESPACE_BEGIN
     int Statistics::StatReadLatency(uint64 latency)
     {
         m_latency_stat.StatReadLatency(latency);
+        m_latency_histograms.StatEngine(ENGINE_OP_GET, latency);
         return 0;
     }
-    int Statistics::StatWriteLatency(uint64 latency)
+    int Statistics::StatWriteLatency(uint64 latency, EngineOperation op)
     {
         m_latency_stat.StatWriteLatency(latency);
+        m_latency_histograms.StatEngine(op, latency);
         return 0;
     }
     int Statistics::StatSeekLatency(uint64 latency)
     {
         m_latency_stat.StatSeekLatency(latency);
+        m_latency_histograms.StatEngine(ENGINE_OP_FIND, latency);
         return 0;
     }
     void Statistics::IncAcceptedClient(const std::string& server, int v)
@@ -34,7 +34,11 @@
 #include "thread/spin_mutex_lock.hpp"
 #include "thread/lock_guard.hpp"
 #include "util/string_helper.hpp"
+#include "util/latency_histogram.hpp"
+#include <pthread.h>
+#include <vector>
 #define ARDB_OPS_SEC_SAMPLES 16
+#define ARDB_CACHE_LINE_SIZE 64
 OP_NAMESPACE_BEGIN
 
     struct ServerStatistics
@@ -140,6 +144,105 @@ OP_NAMESPACE_BEGIN
                 return str;
             }
     };
+    /*
+     * Calls & time per command, every thread counts into its own cache line aligned counters without atomic
+     * operations, counters of all threads are only summed up when they are read.
+     */
+    class CommandStatistics
+    {
+        public:
+            struct Counter
+            {
+                    volatile uint64 calls;
+                    volatile uint64 microseconds;
+                    Counter() :
+                            calls(0), microseconds(0)
+                    {
+                    }
+            };
+        private:
+            uint32 m_size;
+            pthread_key_t m_key;
+            SpinMutexLock m_lock;
+            std::vector<Counter*> m_thread_counters; //counters of exited threads are kept to not lose their counts
+            Counter* ThreadCounters();
+        public:
+            CommandStatistics();
+            void Init(uint32 size);
+            void Stat(uint32 id, uint64 microseconds)
+            {
+                if (id < m_size)
+                {
+                    Counter* counters = ThreadCounters();
+                    counters[id].calls++;
+                    counters[id].microseconds += microseconds;
+                }
+            }
+            Counter Merge(uint32 id);
+            ~CommandStatistics();
+    };
+
+    enum EngineOperation
+    {
+        ENGINE_OP_GET = 0, ENGINE_OP_PUT, ENGINE_OP_DEL, ENGINE_OP_FIND, ENGINE_OP_COMMIT, ENGINE_OP_COMPACT, ENGINE_OP_MAX
+    };
+
+    /*
+     * Latency histograms per command, per engine operation and of the time commands wait between being decoded and
+     * being executed. All of them are cleared together, either by LATENCY RESET or when the cron starts a new window.
+     * Like CommandStatistics, every thread records into its own cache line aligned histograms without atomic
+     * operations, the histograms of all threads are merged when they are read. The per command histograms of a
+     * thread are only allocated once it ran a command.
+     */
+    class LatencyHistograms
+    {
+        private:
+            struct ThreadHistograms
+            {
+                    LatencyHistogram engine[ENGINE_OP_MAX];
+                    LatencyHistogram queue;
+                    LatencyHistogram* volatile commands;
+            };
+            uint32 m_size;
+            pthread_key_t m_key;
+            SpinMutexLock m_lock;
+            std::vector<ThreadHistograms*> m_thread_histograms; //histograms of exited threads are kept as well
+            volatile time_t m_window_start;
+            ThreadHistograms* GetThreadHistograms();
+            LatencyHistogram* GetThreadCommands();
+        public:
+            LatencyHistograms();
+            void Init(uint32 size);
+            void StatCommand(uint32 id, uint64 microseconds)
+            {
+                if (id < m_size)
+                {
+                    GetThreadCommands()[id].AddSingleThread(microseconds);
+                }
+            }
+            void StatEngine(EngineOperation op, uint64 microseconds)
+            {
+                GetThreadHistograms()->engine[op].AddSingleThread(microseconds);
+            }
+            void StatQueue(uint64 microseconds)
+            {
+                GetThreadHistograms()->queue.AddSingleThread(microseconds);
+            }
+            /*
+             * Merge the histograms of all threads into 'merged', returns false for an unknown command id.
+             */
+            bool GetCommand(uint32 id, LatencyHistogram& merged);
+            void GetEngine(EngineOperation op, LatencyHistogram& merged);
+            void GetQueue(LatencyHistogram& merged);
+            time_t GetWindowStart() const
+            {
+                return m_window_start;
+            }
+            static const char* EngineOperationName(EngineOperation op);
+            void Clear();
+            ~LatencyHistograms();
+    };
+
     class Statistics
     {
         private:
@@ -149,12 +252,14 @@ OP_NAMESPACE_BEGIN
 
 
             DBLatencyStatistics m_latency_stat;
+            CommandStatistics m_command_stat;
+            LatencyHistograms m_latency_histograms;
 
         public:
             Statistics();
             void Init();
             int StatReadLatency(uint64 latency);
-            int StatWriteLatency(uint64 latency);
+            int StatWriteLatency(uint64 latency, EngineOperation op = ENGINE_OP_PUT);
             int StatSeekLatency(uint64 latency);
             void IncAcceptedClient(const std::string& server, int v);
             void IncRefusedConnection(const std::string& server);
@@ -164,6 +269,14 @@ OP_NAMESPACE_BEGIN
             {
                 return m_latency_stat;
             }
+            CommandStatistics& GetCommandStat()
+            {
+                return m_command_stat;
+            }
+            LatencyHistograms& GetLatencyHistograms()
+            {
+                return m_latency_histograms;
+            }
             const std::string& PrintStat(std::string& str);
 
     };
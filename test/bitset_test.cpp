@@ -115,10 +115,90 @@ void test_bitset_bitop(Context& ctx, Ardb& db)
 
 }
 
+void test_bitset_bitop_sparse(Context& ctx, Ardb& db)
+{
+    RedisCommandFrame del;
+    del.SetFullCommand("del mybitset4 mybitset5 mybitset6");
+    db.Call(ctx, del, 0);
+
+    RedisCommandFrame setbit;
+    setbit.SetFullCommand("setbit mybitset4 2000100 1");
+    db.Call(ctx, setbit, 0);
+    setbit.SetFullCommand("setbit mybitset4 2050000 1");
+    db.Call(ctx, setbit, 0);
+    setbit.SetFullCommand("setbit mybitset5 2020000 1");
+    db.Call(ctx, setbit, 0);
+    setbit.SetFullCommand("setbit mybitset5 2050000 1");
+    db.Call(ctx, setbit, 0);
+    setbit.SetFullCommand("setbit mybitset5 2090000 1");
+    db.Call(ctx, setbit, 0);
+
+    RedisCommandFrame bitop;
+    bitop.SetFullCommand("bitopcount and mybitset4 mybitset5");
+    db.Call(ctx, bitop, 0);
+    CHECK_FATAL(ctx.reply.integer != 1, "bitopcount sparse and failed");
+    bitop.SetFullCommand("bitopcount or mybitset4 mybitset5");
+    db.Call(ctx, bitop, 0);
+    CHECK_FATAL(ctx.reply.integer != 4, "bitopcount sparse or failed");
+    bitop.SetFullCommand("bitopcount xor mybitset4 mybitset5");
+    db.Call(ctx, bitop, 0);
+    CHECK_FATAL(ctx.reply.integer != 3, "bitopcount sparse xor failed");
+    bitop.SetFullCommand("bitop or mybitset6 mybitset4 mybitset5");
+    db.Call(ctx, bitop, 0);
+    CHECK_FATAL(ctx.reply.integer != 4, "bitop sparse or failed");
+    RedisCommandFrame getbit;
+    getbit.SetFullCommand("getbit mybitset6 2090000");
+    db.Call(ctx, getbit, 0);
+    CHECK_FATAL(ctx.reply.integer != 1, "getbit mybitset6 failed");
+    getbit.SetFullCommand("getbit mybitset6 2020001");
+    db.Call(ctx, getbit, 0);
+    CHECK_FATAL(ctx.reply.integer != 0, "getbit mybitset6 failed");
+}
+
+/*
+ * one source starts at the first chunk, the other one later
+ */
+void test_bitset_bitop_first_chunk(Context& ctx, Ardb& db)
+{
+    RedisCommandFrame del;
+    del.SetFullCommand("del mybitset7 mybitset8 mybitset9");
+    db.Call(ctx, del, 0);
+
+    RedisCommandFrame setbit;
+    setbit.SetFullCommand("setbit mybitset7 0 1");
+    db.Call(ctx, setbit, 0);
+    setbit.SetFullCommand("setbit mybitset7 2050000 1");
+    db.Call(ctx, setbit, 0);
+    setbit.SetFullCommand("setbit mybitset8 2050000 1");
+    db.Call(ctx, setbit, 0);
+    setbit.SetFullCommand("setbit mybitset8 2090000 1");
+    db.Call(ctx, setbit, 0);
+
+    RedisCommandFrame bitop;
+    bitop.SetFullCommand("bitopcount and mybitset7 mybitset8");
+    db.Call(ctx, bitop, 0);
+    CHECK_FATAL(ctx.reply.integer != 1, "bitopcount first chunk and failed");
+    bitop.SetFullCommand("bitopcount or mybitset8 mybitset7");
+    db.Call(ctx, bitop, 0);
+    CHECK_FATAL(ctx.reply.integer != 3, "bitopcount first chunk or failed");
+    bitop.SetFullCommand("bitopcount xor mybitset7 mybitset8");
+    db.Call(ctx, bitop, 0);
+    CHECK_FATAL(ctx.reply.integer != 2, "bitopcount first chunk xor failed");
+    bitop.SetFullCommand("bitop or mybitset9 mybitset8 mybitset7");
+    db.Call(ctx, bitop, 0);
+    CHECK_FATAL(ctx.reply.integer != 3, "bitop first chunk or failed");
+    RedisCommandFrame getbit;
+    getbit.SetFullCommand("getbit mybitset9 0");
+    db.Call(ctx, getbit, 0);
+    CHECK_FATAL(ctx.reply.integer != 1, "getbit mybitset9 failed");
+}
+
 void test_bitset(Ardb& db)
 {
     Context ctx;
     test_bitset_common(ctx, db);
     test_bitset_bitop(ctx, db);
+    test_bitset_bitop_sparse(ctx, db);
+    test_bitset_bitop_first_chunk(ctx, db);
 }
 
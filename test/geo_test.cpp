@@ -6,6 +6,7 @@
  */
 
 #include "ardb.hpp"
+#include <math.h>
 using namespace ardb;
 
 void test_geo_common(Context& ctx, Ardb& db)
@@ -52,6 +53,32 @@ void test_geo_common(Context& ctx, Ardb& db)
             raius);
     db.Call(ctx, geosearch, 0);
     CHECK_FATAL(ctx.reply.MemberSize() != cmp.size() * 4, "geosearch failed");
+
+    /*
+     * ASC with LIMIT widens the radius from a small one, the nearest points must still be found.
+     */
+    double min_distance = -1;
+    for (uint32 i = 0; i < cmp.size(); i++)
+    {
+        double d = sqrt((cmp[i].x - p_x) * (cmp[i].x - p_x) + (cmp[i].y - p_y) * (cmp[i].y - p_y));
+        if (min_distance < 0 || d < min_distance)
+        {
+            min_distance = d;
+        }
+    }
+    geosearch.SetFullCommand("geosearch mygeo MERCATOR %.2f %.2f radius %d ASC WITHDISTANCES LIMIT 0 10", p_x, p_y,
+            raius);
+    db.Call(ctx, geosearch, 0);
+    CHECK_FATAL(ctx.reply.MemberSize() != 20, "geosearch with limit failed");
+    double last = 0;
+    for (uint32 i = 0; i < 10; i++)
+    {
+        double d = strtod(ctx.reply.MemberAt(i * 2 + 1).str.c_str(), NULL);
+        CHECK_FATAL(d < last, "geosearch with limit not sorted");
+        last = d;
+    }
+    CHECK_FATAL(fabs(strtod(ctx.reply.MemberAt(1).str.c_str(), NULL) - min_distance) > 0.5,
+            "geosearch with limit missed the nearest point");
 }
 
 void test_geo(Ardb& db)
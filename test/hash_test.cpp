@@ -222,6 +222,44 @@ void test_hash_setnx(Context& ctx, Ardb& db)
     CHECK_FATAL(ctx.reply.integer != 0, "hsetnx myhash failed");
 }
 
+/*
+ * "a" is a prefix of "a\0b", entries of both keys must stay apart once flushed into sst files with prefix filters.
+ */
+void test_hash_prefix_keys(Context& ctx, Ardb& db)
+{
+    std::string keys[2] = { "a", std::string("a\0b", 3) };
+    for (uint32 i = 0; i < 2; i++)
+    {
+        RedisCommandFrame del;
+        del.SetCommand("del");
+        del.AddArg(keys[i]);
+        db.Call(ctx, del, 0);
+    }
+    for (uint32 i = 0; i < 2; i++)
+    {
+        for (uint32 j = 0; j <= i; j++)
+        {
+            RedisCommandFrame hset;
+            hset.SetCommand("hset");
+            hset.AddArg(keys[i]);
+            hset.AddArg("field" + stringfromll(j));
+            hset.AddArg("value" + stringfromll(j));
+            db.Call(ctx, hset, 0);
+            CHECK_FATAL(ctx.reply.integer != 1, "hset prefix key failed");
+        }
+    }
+    db.GetKeyValueEngine().CompactRange(Slice(), Slice());
+    for (uint32 i = 0; i < 2; i++)
+    {
+        RedisCommandFrame hgetall;
+        hgetall.SetCommand("hgetall");
+        hgetall.AddArg(keys[i]);
+        db.Call(ctx, hgetall, 0);
+        CHECK_FATAL(ctx.reply.MemberSize() != (i + 1) * 2, "hgetall prefix key %u failed:%u", i, (uint32) ctx.reply.MemberSize());
+        CHECK_FATAL(ctx.reply.MemberAt(0).str != "field0", "hgetall prefix key %u failed", i);
+    }
+}
+
 void test_hash(Ardb& db)
 {
     Context tmpctx;
@@ -229,5 +267,6 @@ void test_hash(Ardb& db)
     test_hash_incr(tmpctx, db);
     test_hash_mgetset(tmpctx, db);
     test_hash_setnx(tmpctx, db);
+    test_hash_prefix_keys(tmpctx, db);
 }
 
@@ -196,10 +196,189 @@ void test_keys_rename(Context& ctx, Ardb& db)
     CHECK_FATAL(ctx.reply.integer != 1, "rename failed");
 }
 
+void test_keys_unlink(Context& ctx, Ardb& db)
+{
+    RedisCommandFrame del;
+    del.SetFullCommand("del myhash myset");
+    db.Call(ctx, del, 0);
+    int64 min_elements = db.GetConfig().lazyfree_min_elements;
+    int64 ziplist_entries = db.GetConfig().hash_max_ziplist_entries;
+    db.GetConfig().lazyfree_min_elements = 10;
+    db.GetConfig().hash_max_ziplist_entries = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        char tmp[256];
+        sprintf(tmp, "hset myhash field%d value%d", i, i);
+        RedisCommandFrame hset;
+        hset.SetFullCommand(tmp);
+        db.Call(ctx, hset, 0);
+    }
+    RedisCommandFrame sadd;
+    sadd.SetFullCommand("sadd myset 1 2 3");
+    db.Call(ctx, sadd, 0);
+
+    RedisCommandFrame unlink;
+    unlink.SetFullCommand("unlink myhash myset nosuchkey");
+    db.Call(ctx, unlink, 0);
+    CHECK_FATAL(ctx.reply.integer != 2, "unlink failed");
+    RedisCommandFrame exists;
+    exists.SetFullCommand("exists myhash");
+    db.Call(ctx, exists, 0);
+    CHECK_FATAL(ctx.reply.integer != 0, "unlink failed");
+
+    /*
+     * recreate the key before the background reclaim, no old field should show up
+     */
+    RedisCommandFrame hset;
+    hset.SetFullCommand("hset myhash field1 newvalue");
+    db.Call(ctx, hset, 0);
+    RedisCommandFrame hgetall;
+    hgetall.SetFullCommand("hgetall myhash");
+    db.Call(ctx, hgetall, 0);
+    CHECK_FATAL(ctx.reply.MemberSize() != 2, "hgetall after unlink failed");
+    db.GetConfig().lazyfree_min_elements = min_elements;
+    db.GetConfig().hash_max_ziplist_entries = ziplist_entries;
+}
+
+void test_keys_dbsize(Context& ctx, Ardb& db)
+{
+    DBID current = ctx.currentDB;
+    ctx.currentDB = 9;
+    RedisCommandFrame cmd;
+    cmd.SetFullCommand("flushdb");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("mset k1 v1 k2 v2 k1 v3");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("hset myhash f v");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("hset myhash f2 v");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("sadd myset 1 2 3");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("dbsize");
+    db.Call(ctx, cmd, 0);
+    CHECK_FATAL(ctx.reply.integer != 4, "dbsize failed:%" PRId64, ctx.reply.integer);
+
+    cmd.SetFullCommand("del k1 nosuchkey");
+    db.Call(ctx, cmd, 0);
+    /*
+     * blind overwrites of an existing and of a new key
+     */
+    cmd.SetFullCommand("set k2 v4");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("set k7 v7");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("dbsize");
+    db.Call(ctx, cmd, 0);
+    CHECK_FATAL(ctx.reply.integer != 4, "dbsize failed:%" PRId64, ctx.reply.integer);
+
+    /*
+     * k5 is written before msetnx fails on k2, the discarded batch must not count it
+     */
+    cmd.SetFullCommand("msetnx k5 v5 k2 v6");
+    db.Call(ctx, cmd, 0);
+    CHECK_FATAL(ctx.reply.integer != 0, "msetnx failed");
+    cmd.SetFullCommand("dbsize");
+    db.Call(ctx, cmd, 0);
+    CHECK_FATAL(ctx.reply.integer != 4, "dbsize after failed msetnx failed:%" PRId64, ctx.reply.integer);
+
+    cmd.SetFullCommand("flushdb");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("dbsize");
+    db.Call(ctx, cmd, 0);
+    CHECK_FATAL(ctx.reply.integer != 0, "dbsize failed:%" PRId64, ctx.reply.integer);
+    ctx.currentDB = current;
+}
+
+static void expire_sweep_keys(Context& ctx, Ardb& db, const char* prefix, uint32 count)
+{
+    for (uint32 i = 0; i < count; i++)
+    {
+        RedisCommandFrame set;
+        set.SetFullCommand("set %s%u v%u", prefix, i, i);
+        db.Call(ctx, set, 0);
+        RedisCommandFrame pexpire;
+        pexpire.SetFullCommand("pexpire %s%u 1", prefix, i);
+        db.Call(ctx, pexpire, 0);
+        CHECK_FATAL(ctx.reply.integer != 1, "pexpire failed");
+    }
+    usleep(5000);
+}
+
+void test_keys_expire_sweep(Context& ctx, Ardb& db)
+{
+    ctx.currentDB = 9;
+    RedisCommandFrame flushdb;
+    flushdb.SetFullCommand("flushdb");
+    db.Call(ctx, flushdb, 0);
+    ExpireManager manager;
+    RedisCommandFrame del;
+    bool more = false;
+    uint64 lag = 0;
+    uint32 stale = 0;
+
+    /*
+     * expired keys are deleted in batches of 'max_keys', each batch replicated as one DEL
+     */
+    db.GetConfig().lazyfree_lazy_expire = false;
+    expire_sweep_keys(ctx, db, "sweepkey", 10);
+    int count = manager.ExpireBatch(ctx.currentDB, 6, more, lag, del, stale);
+    CHECK_FATAL(count != 6 || !more || stale != 0, "expire batch failed:%d", count);
+    CHECK_FATAL(del.GetCommand() != "del" || del.GetArguments().size() != 6, "expire batch feed failed");
+    count = manager.ExpireBatch(ctx.currentDB, 6, more, lag, del, stale);
+    CHECK_FATAL(count != 4 || more || del.GetArguments().size() != 4, "expire batch failed:%d", count);
+    RedisCommandFrame dbsize;
+    dbsize.SetFullCommand("dbsize");
+    db.Call(ctx, dbsize, 0);
+    CHECK_FATAL(ctx.reply.integer != 0, "expired keys left:%d", (int) ctx.reply.integer);
+    CHECK_FATAL(manager.ExpireBatch(ctx.currentDB, 6, more, lag, del, stale) != 0, "empty expire batch failed");
+
+    /*
+     * index entries without a matching key are dropped without a feed, persisted keys are left alone
+     */
+    expire_sweep_keys(ctx, db, "stalekey", 3);
+    RedisCommandFrame persist;
+    persist.SetFullCommand("persist stalekey0");
+    db.Call(ctx, persist, 0);
+    ValueObject ghost(KEY_EXPIRATION_ELEMENT);
+    ghost.key.db = ctx.currentDB;
+    ghost.key.type = KEY_EXPIRATION_ELEMENT;
+    ghost.key.key = "ghostkey";
+    ghost.key.score.SetInt64(1000);
+    ghost.key.Encode();
+    ghost.Encode();
+    Options options;
+    db.GetKeyValueEngine().Put(Slice(ghost.key.encode_buf.GetRawReadBuffer(), ghost.key.encode_buf.ReadableBytes()),
+            Slice(ghost.encode_buf.GetRawReadBuffer(), ghost.encode_buf.ReadableBytes()), options);
+    count = manager.ExpireBatch(ctx.currentDB, 10, more, lag, del, stale);
+    CHECK_FATAL(count != 3 || stale != 1, "stale expire entries failed:%d/%u", count, stale);
+    CHECK_FATAL(del.GetArguments().size() != 2, "stale expire entries fed to slaves");
+    CHECK_FATAL(manager.ExpireBatch(ctx.currentDB, 10, more, lag, del, stale) != 0, "stale expire entry left");
+    RedisCommandFrame get;
+    get.SetFullCommand("get stalekey0");
+    db.Call(ctx, get, 0);
+    CHECK_FATAL(ctx.reply.str != "v0", "persisted key expired");
+
+    /*
+     * lazyfree expiration replicates UNLINK
+     */
+    db.GetConfig().lazyfree_lazy_expire = true;
+    expire_sweep_keys(ctx, db, "lazykey", 2);
+    count = manager.ExpireBatch(ctx.currentDB, 10, more, lag, del, stale);
+    CHECK_FATAL(count != 2 || del.GetCommand() != "unlink" || del.GetArguments().size() != 2,
+            "lazy expire batch failed:%d", count);
+    db.GetConfig().lazyfree_lazy_expire = false;
+    db.Call(ctx, flushdb, 0);
+    ctx.currentDB = 0;
+}
+
 void test_keys(Ardb& db)
 {
     Context tmpctx;
     test_keys_exists(tmpctx, db);
     test_keys_expire(tmpctx, db);
+    test_keys_unlink(tmpctx, db);
+    test_keys_dbsize(tmpctx, db);
+    test_keys_expire_sweep(tmpctx, db);
 }
 
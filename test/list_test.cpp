@@ -6,6 +6,8 @@
  */
 #include "ardb.hpp"
 #include <string>
+#include <deque>
+#include <algorithm>
 
 using namespace ardb;
 
@@ -477,6 +479,196 @@ void test_sequential_list(Context& ctx, Ardb& db)
 
 }
 
+static void check_list_content(Context& ctx, Ardb& db, const std::deque<std::string>& expected, const char* step)
+{
+    RedisCommandFrame lrange;
+    lrange.SetFullCommand("lrange mylist 0 -1");
+    db.Call(ctx, lrange, 0);
+    CHECK_FATAL(ctx.reply.type != REDIS_REPLY_ARRAY, "lrange mylist failed after %s", step);
+    CHECK_FATAL(ctx.reply.MemberSize() != expected.size(), "lrange mylist failed after %s", step);
+    for (uint32 i = 0; i < expected.size(); i++)
+    {
+        CHECK_FATAL(ctx.reply.MemberAt(i).str != expected[i], "lrange mylist failed after %s at %u", step, i);
+    }
+    RedisCommandFrame llen;
+    llen.SetFullCommand("llen mylist");
+    db.Call(ctx, llen, 0);
+    CHECK_FATAL(ctx.reply.integer != (int64) expected.size(), "llen mylist failed after %s", step);
+}
+
+void test_chunked_list(Context& ctx, Ardb& db)
+{
+    db.GetConfig().list_max_ziplist_entries = 16;
+    db.GetConfig().list_chunk_size = 4;
+    RedisCommandFrame del;
+    del.SetFullCommand("del mylist");
+    db.Call(ctx, del, 0);
+    std::deque<std::string> expected;
+    for (int i = 0; i < 40; i++)
+    {
+        RedisCommandFrame rpush;
+        rpush.SetFullCommand("rpush mylist v%d", i);
+        db.Call(ctx, rpush, 0);
+        expected.push_back("v" + stringfromll(i));
+    }
+    //repeated inserts at the same spot split chunks & index nodes
+    for (int i = 0; i < 100; i++)
+    {
+        std::string value = i % 2 ? "dup" : "x" + stringfromll(i);
+        RedisCommandFrame linsert;
+        linsert.SetFullCommand("linsert mylist before v20 %s", value.c_str());
+        db.Call(ctx, linsert, 0);
+        expected.insert(std::find(expected.begin(), expected.end(), "v20"), value);
+        CHECK_FATAL(ctx.reply.integer != (int64) expected.size(), "linsert mylist failed");
+    }
+    RedisCommandFrame linsert;
+    linsert.SetFullCommand("linsert mylist after v39 tail");
+    db.Call(ctx, linsert, 0);
+    expected.push_back("tail");
+    check_list_content(ctx, db, expected, "linsert");
+
+    int64 indexes[] = { 0, 7, 20, 63, 100, -1, -30 };
+    for (uint32 i = 0; i < arraysize(indexes); i++)
+    {
+        RedisCommandFrame lindex;
+        lindex.SetFullCommand("lindex mylist %" PRId64, indexes[i]);
+        db.Call(ctx, lindex, 0);
+        int64 pos = indexes[i] >= 0 ? indexes[i] : expected.size() + indexes[i];
+        CHECK_FATAL(ctx.reply.str != expected[pos], "lindex mylist %" PRId64 " failed", indexes[i]);
+    }
+
+    RedisCommandFrame lset;
+    lset.SetFullCommand("lset mylist 50 newvalue");
+    db.Call(ctx, lset, 0);
+    expected[50] = "newvalue";
+    lset.SetFullCommand("lset mylist -2 newvalue2");
+    db.Call(ctx, lset, 0);
+    expected[expected.size() - 2] = "newvalue2";
+    check_list_content(ctx, db, expected, "lset");
+
+    RedisCommandFrame lrem;
+    lrem.SetFullCommand("lrem mylist 10 dup");
+    db.Call(ctx, lrem, 0);
+    CHECK_FATAL(ctx.reply.integer != 10, "lrem mylist failed");
+    for (int i = 0; i < 10; i++)
+    {
+        expected.erase(std::find(expected.begin(), expected.end(), "dup"));
+    }
+    lrem.SetFullCommand("lrem mylist -5 dup");
+    db.Call(ctx, lrem, 0);
+    CHECK_FATAL(ctx.reply.integer != 5, "lrem mylist failed");
+    for (int i = 0; i < 5; i++)
+    {
+        expected.erase((std::find(expected.rbegin(), expected.rend(), "dup") + 1).base());
+    }
+    check_list_content(ctx, db, expected, "lrem");
+
+    RedisCommandFrame ltrim;
+    ltrim.SetFullCommand("ltrim mylist 3 -4");
+    db.Call(ctx, ltrim, 0);
+    expected.erase(expected.begin(), expected.begin() + 3);
+    expected.erase(expected.end() - 3, expected.end());
+    check_list_content(ctx, db, expected, "ltrim");
+
+    for (int i = 0; i < 10; i++)
+    {
+        RedisCommandFrame pop;
+        pop.SetFullCommand(i % 2 ? "lpop mylist" : "rpop mylist");
+        db.Call(ctx, pop, 0);
+        std::string value = i % 2 ? expected.front() : expected.back();
+        CHECK_FATAL(ctx.reply.str != value, "pop mylist failed");
+        if (i % 2)
+        {
+            expected.pop_front();
+        }
+        else
+        {
+            expected.pop_back();
+        }
+        RedisCommandFrame push;
+        push.SetFullCommand("lpush mylist p%d", i);
+        db.Call(ctx, push, 0);
+        expected.push_front("p" + stringfromll(i));
+    }
+    check_list_content(ctx, db, expected, "pop & push");
+
+    ltrim.SetFullCommand("ltrim mylist 5 5");
+    db.Call(ctx, ltrim, 0);
+    std::string left = expected[5];
+    expected.clear();
+    expected.push_back(left);
+    check_list_content(ctx, db, expected, "ltrim to one element");
+    RedisCommandFrame rpop;
+    rpop.SetFullCommand("rpop mylist");
+    db.Call(ctx, rpop, 0);
+    CHECK_FATAL(ctx.reply.str != left, "rpop mylist failed");
+    RedisCommandFrame exists;
+    exists.SetFullCommand("exists mylist");
+    db.Call(ctx, exists, 0);
+    CHECK_FATAL(ctx.reply.integer != 0, "exists mylist failed");
+    db.GetConfig().list_chunk_size = 128;
+}
+
+void test_raw_list_inplace(Context& ctx, Ardb& db)
+{
+    db.GetConfig().list_max_ziplist_entries = 16;
+    RedisCommandFrame del;
+    del.SetFullCommand("del mylist");
+    db.Call(ctx, del, 0);
+    std::deque<std::string> expected;
+    for (int i = 0; i < 40; i++)
+    {
+        RedisCommandFrame rpush;
+        rpush.SetFullCommand("rpush mylist v%d", i);
+        db.Call(ctx, rpush, 0);
+        expected.push_back("v" + stringfromll(i));
+    }
+    //raw lists are written in place, packing them into chunks is left to the db cron
+    for (int i = 0; i < 4; i++)
+    {
+        RedisCommandFrame linsert;
+        linsert.SetFullCommand(i % 2 ? "linsert mylist after v10 a%d" : "linsert mylist before v30 b%d", i);
+        db.Call(ctx, linsert, 0);
+        std::string value = (i % 2 ? "a" : "b") + stringfromll(i);
+        std::deque<std::string>::iterator it = std::find(expected.begin(), expected.end(), i % 2 ? "v10" : "v30");
+        expected.insert(i % 2 ? it + 1 : it, value);
+    }
+    RedisCommandFrame linsert;
+    linsert.SetFullCommand("linsert mylist before v0 head");
+    db.Call(ctx, linsert, 0);
+    expected.push_front("head");
+    check_list_content(ctx, db, expected, "raw linsert");
+
+    RedisCommandFrame lset;
+    lset.SetFullCommand("lset mylist -3 newvalue");
+    db.Call(ctx, lset, 0);
+    expected[expected.size() - 3] = "newvalue";
+    check_list_content(ctx, db, expected, "raw lset");
+
+    RedisCommandFrame lrem;
+    lrem.SetFullCommand("lrem mylist 0 v20");
+    db.Call(ctx, lrem, 0);
+    CHECK_FATAL(ctx.reply.integer != 1, "lrem mylist failed");
+    expected.erase(std::find(expected.begin(), expected.end(), "v20"));
+    lrem.SetFullCommand("lrem mylist -1 v39");
+    db.Call(ctx, lrem, 0);
+    CHECK_FATAL(ctx.reply.integer != 1, "lrem mylist failed");
+    expected.pop_back();
+    check_list_content(ctx, db, expected, "raw lrem");
+
+    RedisCommandFrame ltrim;
+    ltrim.SetFullCommand("ltrim mylist 2 -3");
+    db.Call(ctx, ltrim, 0);
+    expected.erase(expected.begin(), expected.begin() + 2);
+    expected.erase(expected.end() - 2, expected.end());
+    check_list_content(ctx, db, expected, "raw ltrim");
+    RedisCommandFrame rpop;
+    rpop.SetFullCommand("rpop mylist");
+    db.Call(ctx, rpop, 0);
+    CHECK_FATAL(ctx.reply.str != expected.back(), "rpop mylist failed");
+    db.Call(ctx, del, 0);
+}
+
 void test_list(Ardb& db)
 {
     Context tmpctx;
@@ -491,5 +683,7 @@ void test_list(Ardb& db)
     test_lists_ltrim(tmpctx, db);
     test_lists_rpoplpush(tmpctx, db);
     test_sequential_list(tmpctx, db);
+    test_raw_list_inplace(tmpctx, db);
+    test_chunked_list(tmpctx, db);
 }
 
@@ -5,7 +5,12 @@
  *      Author: wangqiying
  */
 #include "ardb.hpp"
+#include "engine/group_commit.hpp"
+#include "redis/crc64.h"
+#include "redis/endianconv.h"
 #include <string>
+#include <sys/socket.h>
+#include <fcntl.h>
 
 using namespace ardb;
 
@@ -200,6 +205,848 @@ void test_misc_sortzset(Context& ctx, Ardb& db)
     CHECK_FATAL(ctx.reply.MemberAt(6).str != "hashv3", "sort  failed");
 }
 
+void test_misc_key_codec(Context& ctx, Ardb& db)
+{
+    std::vector<KeyObject> keys;
+    const char* names[] = { "", "a", "a\0b", "ab" };
+    size_t name_lens[] = { 0, 1, 3, 2 };
+    int64 ivs[] = { LLONG_MIN, -5, 0, 3, 9007199254740993LL, LLONG_MAX };
+    double dvs[] = { -1e300, -4.5, 3.5, 9007199254740992.0, 1e300 };
+    for (size_t i = 0; i < 4; i++)
+    {
+        KeyObject k;
+        k.db = 1;
+        k.type = ZSET_ELEMENT_SCORE;
+        k.key = Slice(names[i], name_lens[i]);
+        k.element.SetString(Slice(names[i], name_lens[i]), false);
+        for (size_t j = 0; j < sizeof(ivs) / sizeof(ivs[0]); j++)
+        {
+            k.score.SetInt64(ivs[j]);
+            keys.push_back(k);
+        }
+        for (size_t j = 0; j < sizeof(dvs) / sizeof(dvs[0]); j++)
+        {
+            k.score.SetDouble(dvs[j]);
+            keys.push_back(k);
+        }
+    }
+    /*
+     * elements of recreated collections carry a version after the key
+     */
+    size_t unversioned = keys.size();
+    for (size_t i = 0; i < unversioned; i += 3)
+    {
+        KeyObject k = keys[i];
+        k.version = 1 + i % 2;
+        keys.push_back(k);
+    }
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        KeyObject& a = keys[i];
+        a.Encode(ARDB_CODEC_MEMCMP);
+        KeyObject decoded;
+        std::string dstr, astr;
+        Slice encoded(a.encode_buf.GetRawReadBuffer(), a.encode_buf.ReadableBytes());
+        CHECK_FATAL(!decode_key(encoded, decoded, ARDB_CODEC_MEMCMP), "memcmp key decode failed");
+        CHECK_FATAL(decoded.key != a.key || decoded.score.Compare(a.score) != 0
+                || decoded.score.GetDecodeString(dstr) != a.score.GetDecodeString(astr)
+                || decoded.element.Compare(a.element) != 0 || decoded.version != a.version,
+                "memcmp key roundtrip failed");
+        for (size_t j = 0; j < keys.size(); j++)
+        {
+            KeyObject& b = keys[j];
+            a.Encode(ARDB_CODEC_VARINT);
+            b.Encode(ARDB_CODEC_VARINT);
+            int legacy = CommonComparator::Compare(a.encode_buf.GetRawReadBuffer(), a.encode_buf.ReadableBytes(),
+                    b.encode_buf.GetRawReadBuffer(), b.encode_buf.ReadableBytes());
+            if (0 == legacy)
+            {
+                continue;
+            }
+            a.Encode(ARDB_CODEC_MEMCMP);
+            b.Encode(ARDB_CODEC_MEMCMP);
+            Slice as(a.encode_buf.GetRawReadBuffer(), a.encode_buf.ReadableBytes());
+            Slice bs(b.encode_buf.GetRawReadBuffer(), b.encode_buf.ReadableBytes());
+            CHECK_FATAL((as.compare(bs) < 0) != (legacy < 0), "memcmp key order differs from comparator order");
+        }
+    }
+}
+
+struct PatternCollector
+{
+        StringSet matched;
+        void operator()(const std::string& pattern, int& v)
+        {
+            matched.insert(pattern);
+        }
+};
+
+void test_misc_pattern_trie(Context& ctx, Ardb& db)
+{
+    PatternTrie<int> trie;
+    const char* patterns[] = { "*", "news.*", "news.sports", "news.s*", "new?.*", "a[bc]d", "\\*x", "news." };
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++)
+    {
+        trie.Insert(patterns[i]);
+    }
+    CHECK_FATAL(trie.Size() != 8, "pattern trie insert failed");
+    const char* channels[] = { "news.sports", "news.", "newz.x", "abd", "*x", "news" };
+    for (size_t i = 0; i < sizeof(channels) / sizeof(channels[0]); i++)
+    {
+        std::string channel = channels[i];
+        PatternCollector collector;
+        trie.Match(channel.data(), channel.size(), collector);
+        StringSet expected;
+        for (size_t j = 0; j < sizeof(patterns) / sizeof(patterns[0]); j++)
+        {
+            if (stringmatchlen(patterns[j], strlen(patterns[j]), channel.data(), channel.size(), 0))
+            {
+                expected.insert(patterns[j]);
+            }
+        }
+        CHECK_FATAL(collector.matched != expected, "pattern trie match failed for %s", channel.c_str());
+    }
+    CHECK_FATAL(!trie.Erase("news.s*"), "pattern trie erase failed");
+    CHECK_FATAL(trie.Erase("news.s*"), "pattern trie erase failed");
+    CHECK_FATAL(NULL == trie.Find("news.sports"), "pattern trie find failed");
+    CHECK_FATAL(NULL != trie.Find("news.s*"), "pattern trie find failed");
+    PatternCollector collector;
+    trie.Match("news.sports", 11, collector);
+    CHECK_FATAL(collector.matched.size() != 4, "pattern trie match failed after erase");
+}
+
+/*
+ * The decoder as it was before the vectorized scanner, kept as the baseline for
+ * test_misc_resp_decode_perf.
+ */
+static bool legacy_decode_multibulk(Buffer& buffer, ArgumentArray& args)
+{
+    size_t mark = buffer.GetReadIndex();
+    buffer.AdvanceReadIndex(1);
+    int index = buffer.IndexOf("\r\n", 2);
+    if (-1 == index)
+    {
+        buffer.SetReadIndex(mark);
+        return false;
+    }
+    char* eptr = NULL;
+    int32 multibulklen = strtol(buffer.GetRawReadBuffer(), &eptr, 10);
+    buffer.SetReadIndex(index + 2);
+    while (multibulklen > 0)
+    {
+        int newline_index = buffer.IndexOf("\r\n", 2);
+        if (-1 == newline_index)
+        {
+            buffer.SetReadIndex(mark);
+            args.clear();
+            return false;
+        }
+        buffer.AdvanceReadIndex(1);
+        int32 arglen = strtol(buffer.GetRawReadBuffer(), &eptr, 10);
+        buffer.SetReadIndex(newline_index + 2);
+        if (buffer.ReadableBytes() < (uint32) (arglen + 2))
+        {
+            buffer.SetReadIndex(mark);
+            args.clear();
+            return false;
+        }
+        args.push_back(std::string(buffer.GetRawReadBuffer(), arglen));
+        buffer.AdvanceReadIndex(arglen + 2);
+        multibulklen--;
+    }
+    return true;
+}
+
+void test_misc_resp_decode(Context& ctx, Ardb& db)
+{
+    std::string crlf_cases[] = { "", "\r", "\n", "\r\n", "abc\r\n", "abc\rx\r\n", std::string(40, 'a') + "\r\r\n",
+            std::string(100, '\r'), std::string(31, 'b') + "\r\n", std::string(63, 'c') + "\r" };
+    for (size_t i = 0; i < sizeof(crlf_cases) / sizeof(crlf_cases[0]); i++)
+    {
+        const std::string& str = crlf_cases[i];
+        size_t pos = str.find("\r\n");
+        int expected = pos == std::string::npos ? -1 : (int) pos;
+        CHECK_FATAL(resp_find_crlf(str.data(), str.size()) != expected, "crlf scan failed for case %u", (uint32 )i);
+    }
+    int64 v = 0;
+    CHECK_FATAL(resp_parse_int("123\r\n", 5, v) != 3 || v != 123, "resp int parse failed");
+    CHECK_FATAL(resp_parse_int("-1", 2, v) != 2 || v != -1, "resp int parse failed");
+    CHECK_FATAL(resp_parse_int("x1", 2, v) != 0, "resp int parse failed");
+
+    std::string req = "*3\r\n$3\r\nSET\r\n$4\r\nkey1\r\n$12\r\nvalue\r\nvalue\r\n*1\r\n$4\r\nPING\r\n";
+    Buffer buffer;
+    buffer.Write(req.data(), req.size());
+    RedisCommandFrame frame;
+    CHECK_FATAL(!RedisCommandDecoder::Decode(NULL, buffer, frame), "resp decode failed");
+    CHECK_FATAL(frame.GetCommand() != "SET" || frame.GetArguments().size() != 2, "resp decode failed");
+    CHECK_FATAL(*frame.GetArgument(1) != "value\r\nvalue", "resp decode failed");
+    RedisCommandFrame ping;
+    CHECK_FATAL(!RedisCommandDecoder::Decode(NULL, buffer, ping), "resp decode failed");
+    CHECK_FATAL(ping.GetCommand() != "PING" || buffer.Readable(), "resp decode failed");
+
+    /*
+     * Every truncation of a request must wait for more data without consuming anything.
+     */
+    for (size_t i = 1; i < req.size() - 14; i++)
+    {
+        Buffer partial;
+        partial.Write(req.data(), i);
+        RedisCommandFrame f;
+        CHECK_FATAL(RedisCommandDecoder::Decode(NULL, partial, f), "resp decode accepted partial frame");
+        CHECK_FATAL(partial.ReadableBytes() != i, "resp decode consumed partial frame");
+    }
+    Buffer bad;
+    bad.Write("*1\r\n$x\r\nabc\r\n", 13);
+    RedisCommandFrame f;
+    CHECK_FATAL(RedisCommandDecoder::Decode(NULL, bad, f), "resp decode accepted invalid bulk length");
+}
+
+void test_misc_resp_decode_perf(Context& ctx, Ardb& db)
+{
+    Buffer input;
+    for (uint32 i = 0; i < 10000; i++)
+    {
+        std::string key = "key:" + stringfromll(i);
+        std::string value = "value:" + stringfromll(i);
+        input.Printf("*3\r\n$3\r\nSET\r\n$%u\r\n%s\r\n$%u\r\n%s\r\n", (uint32) key.size(), key.c_str(),
+                (uint32) value.size(), value.c_str());
+    }
+    uint32 rounds = 20;
+    uint64 start = get_current_epoch_micros();
+    for (uint32 r = 0; r < rounds; r++)
+    {
+        input.SetReadIndex(0);
+        while (input.Readable())
+        {
+            ArgumentArray args;
+            CHECK_FATAL(!legacy_decode_multibulk(input, args), "legacy decode failed");
+        }
+    }
+    uint64 legacy_cost = get_current_epoch_micros() - start;
+    start = get_current_epoch_micros();
+    for (uint32 r = 0; r < rounds; r++)
+    {
+        input.SetReadIndex(0);
+        while (input.Readable())
+        {
+            RedisCommandFrame frame;
+            CHECK_FATAL(!RedisCommandDecoder::Decode(NULL, input, frame), "resp decode failed");
+        }
+    }
+    uint64 cost = get_current_epoch_micros() - start;
+    INFO_LOG("Decode %u SET requests: legacy %" PRIu64 "us, current %" PRIu64 "us", rounds * 10000, legacy_cost,
+            cost);
+}
+
+void test_misc_arena(Context& ctx, Ardb& db)
+{
+    Arena arena(1024, 8192);
+    char* a = (char*) arena.Allocate(10);
+    char* b = (char*) arena.Allocate(10);
+    CHECK_FATAL(b - a != 16, "arena allocate failed");
+    CHECK_FATAL(NULL == arena.Allocate(4096), "arena large allocate failed");
+    CHECK_FATAL(NULL != arena.Allocate(8192), "arena limit failed");
+    arena.Reset();
+    CHECK_FATAL(arena.MemoryUsage() != 1024, "arena reset failed");
+
+    Buffer buf;
+    Data field("a field value longer than the inline", false);
+    field.Encode(buf);
+    Data decoded;
+    CHECK_FATAL(!decoded.Decode(buf, &arena) || !decoded.arena_str, "arena decode failed");
+    CHECK_FATAL(decoded != field, "arena decode failed");
+    Data copy = decoded;
+    CHECK_FATAL(copy.arena_str || copy != field, "arena data copy failed");
+    decoded.SetInt64(1);
+    CHECK_FATAL(decoded.arena_str, "arena data overwrite failed");
+}
+
+static void* hold_lock_key(void* data)
+{
+    KeyLocker* locker = (KeyLocker*) data;
+    Barrier* barrier = NULL;
+    bool locked = locker->TryAddLockKey(0, "held", barrier);
+    return locked ? barrier : NULL;
+}
+
+void test_misc_try_keylock(Context& ctx, Ardb& db)
+{
+    KeyLocker locker;
+    locker.Init(4, 4);
+    pthread_t tid;
+    pthread_create(&tid, NULL, hold_lock_key, &locker);
+    void* held = NULL;
+    pthread_join(tid, &held);
+    CHECK_FATAL(NULL == held, "try lock key failed");
+    Barrier* barrier = NULL;
+    CHECK_FATAL(locker.TryAddLockKey(0, "held", barrier), "try lock key held by other thread");
+    CHECK_FATAL(!locker.TryAddLockKey(0, "free", barrier) || NULL == barrier, "try lock key failed");
+    Barrier* again = NULL;
+    CHECK_FATAL(!locker.TryAddLockKey(0, "free", again) || again != barrier, "try lock key not reentrant");
+    locker.ClearLockKey(0, "free", again);
+    locker.ClearLockKey(0, "free", barrier);
+    locker.ClearLockKey(0, "held", (Barrier*) held);
+    CHECK_FATAL(!locker.TryAddLockKey(0, "held", barrier), "try lock released key failed");
+    locker.ClearLockKey(0, "held", barrier);
+}
+
+struct GroupCommitTestLog
+{
+        volatile uint32 batches;
+        volatile uint32 syncs;
+        bool fail_sync;
+        GroupCommitter committer;
+        GroupCommitTestLog() :
+                batches(0), syncs(0), fail_sync(false)
+        {
+        }
+};
+
+static int group_commit_test_write(void* engine, void** batches, size_t count, bool sync)
+{
+    GroupCommitTestLog* log = (GroupCommitTestLog*) engine;
+    atomic_add_uint32(&log->batches, count);
+    if (sync)
+    {
+        atomic_add_uint32(&log->syncs, 1);
+        usleep(100);
+        return log->fail_sync ? -1 : 0;
+    }
+    return 0;
+}
+
+static void* group_commit_test_writer(void* data)
+{
+    GroupCommitTestLog* log = (GroupCommitTestLog*) data;
+    int failed = 0;
+    for (uint32 i = 0; i < 200; i++)
+    {
+        if (log->committer.Commit(&i, 100) != 0)
+        {
+            failed++;
+        }
+    }
+    return failed == 0 ? NULL : log;
+}
+
+void test_misc_group_commit(Context& ctx, Ardb& db)
+{
+    GroupCommitTestLog log;
+    log.committer.Init(&log, group_commit_test_write, 0, 1024 * 1024);
+    pthread_t tids[8];
+    for (uint32 i = 0; i < 8; i++)
+    {
+        pthread_create(&tids[i], NULL, group_commit_test_writer, &log);
+    }
+    for (uint32 i = 0; i < 8; i++)
+    {
+        void* failed = NULL;
+        pthread_join(tids[i], &failed);
+        CHECK_FATAL(NULL != failed, "group commit failed");
+    }
+    CHECK_FATAL(log.batches != 1600, "group commit lost batches");
+    CHECK_FATAL(log.syncs >= log.batches, "group commit did not group concurrent writers");
+    INFO_LOG("Group committed %u batches with %u syncs", log.batches, log.syncs);
+
+    log.fail_sync = true;
+    uint32 batch = 0;
+    CHECK_FATAL(log.committer.Commit(&batch, 100) == 0, "group commit sync failure not reported");
+}
+
+void test_misc_repl_apply(Context& ctx, Ardb& db)
+{
+    RedisCommandFrame del;
+    del.SetFullCommand("del applykey0 applykey1 applykey2 applykey3");
+    db.Call(ctx, del, 0);
+
+    ReplApplier applier;
+    applier.Start(4);
+    std::string expected;
+    for (uint32 i = 0; i < 200; i++)
+    {
+        for (uint32 k = 0; k < 4; k++)
+        {
+            RedisCommandFrame append;
+            append.SetFullCommand("append applykey%u %u,", k, i);
+            applier.Dispatch(ctx.currentDB, append);
+        }
+        expected.append(stringfromll(i)).append(",");
+    }
+    applier.Barrier();
+    CHECK_FATAL(applier.AppliedSeq() != 800, "repl apply seq mismatch");
+    for (uint32 k = 0; k < 4; k++)
+    {
+        RedisCommandFrame get;
+        get.SetFullCommand("get applykey%u", k);
+        db.Call(ctx, get, 0);
+        CHECK_FATAL(ctx.reply.str != expected, "repl apply lost order on applykey%u", k);
+    }
+    applier.StopSelf();
+}
+
+static uint64 ping_calls(Context& ctx, Ardb& db)
+{
+    RedisCommandFrame info;
+    info.SetFullCommand("info commandstats");
+    db.Call(ctx, info, 0);
+    size_t pos = ctx.reply.str.find("cmdstat_ping:calls=");
+    if (pos == std::string::npos)
+    {
+        return 0;
+    }
+    uint64 calls = 0;
+    string_touint64(ctx.reply.str.substr(pos + strlen("cmdstat_ping:calls="),
+            ctx.reply.str.find(',', pos) - pos - strlen("cmdstat_ping:calls=")), calls);
+    return calls;
+}
+
+static void* ping_from_thread(void* data)
+{
+    Context ctx;
+    for (int i = 0; i < 100; i++)
+    {
+        RedisCommandFrame ping;
+        ping.SetFullCommand("ping");
+        g_db->Call(ctx, ping, 0);
+    }
+    return NULL;
+}
+
+void test_misc_command_table(Context& ctx, Ardb& db)
+{
+    RedisCommandFrame cmd;
+    cmd.SetFullCommand("SeT cmdtable_key v1");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("GET cmdtable_key");
+    db.Call(ctx, cmd, 0);
+    CHECK_FATAL(ctx.reply.str != "v1", "mixed case command lookup failed");
+    CHECK_FATAL(cmd.GetType() != REDIS_CMD_GET, "command type not resolved");
+    cmd.SetFullCommand("nosuchcmd cmdtable_key");
+    db.Call(ctx, cmd, 0);
+    CHECK_FATAL(ctx.reply.type != REDIS_REPLY_ERROR, "unknown command accepted");
+
+    uint64 before = ping_calls(ctx, db);
+    pthread_t tid;
+    pthread_create(&tid, NULL, ping_from_thread, NULL);
+    for (int i = 0; i < 100; i++)
+    {
+        RedisCommandFrame ping;
+        ping.SetFullCommand("PING");
+        db.Call(ctx, ping, 0);
+    }
+    pthread_join(tid, NULL);
+    uint64 after = ping_calls(ctx, db);
+    CHECK_FATAL(after - before != 200, "commandstats lost calls of threads:%" PRIu64, after - before);
+}
+
+static void* stat_latency_from_thread(void* data)
+{
+    LatencyHistograms* histograms = (LatencyHistograms*) data;
+    histograms->StatCommand(1, 1000);
+    histograms->StatEngine(ENGINE_OP_GET, 1000);
+    return NULL;
+}
+
+void test_misc_latency_histogram(Context& ctx, Ardb& db)
+{
+    for (uint64 v = 0; v < 100000; v = v * 2 + 1)
+    {
+        uint32 idx = LatencyHistogram::BucketIndex(v);
+        CHECK_FATAL(LatencyHistogram::BucketUpperBound(idx) < v, "bucket of %" PRIu64 " ends before it", v);
+        CHECK_FATAL(idx > 0 && LatencyHistogram::BucketUpperBound(idx - 1) >= v, "bucket of %" PRIu64 " starts after it",
+                v);
+        CHECK_FATAL(LatencyHistogram::BucketUpperBound(idx) - v > v / 8, "bucket of %" PRIu64 " too wide", v);
+    }
+    LatencyHistogram histogram;
+    for (uint64 v = 1; v <= 1000; v++)
+    {
+        histogram.Add(v);
+    }
+    uint64 p50 = histogram.Percentile(50);
+    uint64 p99 = histogram.Percentile(99);
+    CHECK_FATAL(p50 < 500 || p50 > 500 + 500 / 8, "p50 is %" PRIu64, p50);
+    CHECK_FATAL(p99 < 990 || p99 > 1000, "p99 is %" PRIu64, p99);
+
+    LatencyHistograms per_thread;
+    per_thread.Init(4);
+    per_thread.StatCommand(1, 10);
+    per_thread.StatEngine(ENGINE_OP_GET, 10);
+    pthread_t tid;
+    pthread_create(&tid, NULL, stat_latency_from_thread, &per_thread);
+    pthread_join(tid, NULL);
+    LatencyHistogram merged;
+    CHECK_FATAL(!per_thread.GetCommand(1, merged), "command histogram missing");
+    CHECK_FATAL(merged.Count() != 2 || merged.Max() != 1000, "threads' command histograms not merged");
+    CHECK_FATAL(per_thread.GetCommand(4, merged), "histogram of unknown command");
+    per_thread.GetEngine(ENGINE_OP_GET, merged);
+    CHECK_FATAL(merged.Count() != 2 || merged.Average() != 505, "threads' engine histograms not merged");
+    per_thread.Clear();
+    per_thread.GetCommand(1, merged);
+    CHECK_FATAL(merged.Count() != 0, "threads' histograms not cleared");
+
+    RedisCommandFrame cmd;
+    cmd.SetFullCommand("latency reset");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("get latency_key");
+    db.Call(ctx, cmd, 0);
+    cmd.SetFullCommand("latency histogram get set");
+    db.Call(ctx, cmd, 0);
+    CHECK_FATAL(ctx.reply.MemberSize() != 2, "latency histogram replied %u members", (uint32) ctx.reply.MemberSize());
+    CHECK_FATAL(ctx.reply.MemberAt(0).str != "get", "latency histogram of get missing");
+    CHECK_FATAL(ctx.reply.MemberAt(1).MemberAt(1).integer != 1, "latency histogram counted wrong calls");
+    cmd.SetFullCommand("latency dump");
+    db.Call(ctx, cmd, 0);
+    CHECK_FATAL(ctx.reply.str.find("\"get\":{\"count\":1") == std::string::npos, "latency dump missing get");
+}
+
+static CacheData* new_cache_entry(uint64 mem)
+{
+    CacheData* data = new CacheData;
+    data->mem = mem;
+    return data;
+}
+
+static bool cache_contains(ClockCache& cache, const DBItemKey& key)
+{
+    CacheData* data = cache.Get(key, true);
+    if (NULL == data)
+    {
+        return false;
+    }
+    data->DecRef();
+    return true;
+}
+
+static void release_evicted(CacheDataArray& evicted)
+{
+    for (uint32 i = 0; i < evicted.size(); i++)
+    {
+        evicted[i]->DecRef();
+    }
+    evicted.clear();
+}
+
+void test_misc_clock_cache(Context& ctx, Ardb& db)
+{
+    CacheDataArray evicted;
+    {
+        /*
+         * A one-time scan must not flush keys that were requested a few times.
+         */
+        ClockCache cache;
+        cache.Init(1, 8, 0);
+        for (uint32 i = 0; i < 8; i++)
+        {
+            DBItemKey key(0, "hot" + stringfromll(i));
+            for (uint32 j = 0; j < 4; j++)
+            {
+                CHECK_FATAL(cache.Get(key, false) != NULL, "hot key cached before insert");
+            }
+            CHECK_FATAL(!cache.Insert(key, new_cache_entry(0), false, evicted), "hot key not admitted");
+        }
+        for (uint32 i = 0; i < 200; i++)
+        {
+            DBItemKey key(0, "scan" + stringfromll(i));
+            CHECK_FATAL(cache.Get(key, false) != NULL, "scanned key cached before insert");
+            CacheData* data = new_cache_entry(0);
+            if (!cache.Insert(key, data, false, evicted))
+            {
+                data->DecRef();
+            }
+        }
+        release_evicted(evicted);
+        for (uint32 i = 0; i < 8; i++)
+        {
+            CHECK_FATAL(!cache_contains(cache, DBItemKey(0, "hot" + stringfromll(i))), "scan evicted hot%u", i);
+        }
+        CHECK_FATAL(cache.Rejected() != 200, "admission rejected %" PRIu64 " scanned keys", cache.Rejected());
+    }
+    {
+        /*
+         * The CLOCK hand skips a referenced entry once and evicts the next unreferenced one.
+         */
+        ClockCache cache;
+        cache.Init(1, 4, 0);
+        for (uint32 i = 0; i < 4; i++)
+        {
+            cache.Insert(DBItemKey(0, "clock" + stringfromll(i)), new_cache_entry(0), true, evicted);
+        }
+        CacheData* data = cache.Get(DBItemKey(0, "clock0"), false);
+        CHECK_FATAL(NULL == data, "clock0 not cached");
+        data->DecRef();
+        cache.Insert(DBItemKey(0, "clock4"), new_cache_entry(0), true, evicted);
+        CHECK_FATAL(evicted.size() != 1, "evicted %u entries", (uint32) evicted.size());
+        release_evicted(evicted);
+        CHECK_FATAL(!cache_contains(cache, DBItemKey(0, "clock0")), "referenced entry evicted");
+        CHECK_FATAL(cache_contains(cache, DBItemKey(0, "clock1")), "unreferenced entry kept");
+        CHECK_FATAL(cache.Size() != 4 || cache.Evicted() != 1, "wrong cache size after eviction");
+    }
+    {
+        /*
+         * Byte limits hold after the periodic trim, also when a cached entry grew after its insert.
+         */
+        ClockCache cache;
+        cache.Init(1, 0, 4000);
+        for (uint32 i = 0; i < 10; i++)
+        {
+            cache.Insert(DBItemKey(0, "bytes" + stringfromll(i)), new_cache_entry(1000), true, evicted);
+        }
+        cache.Trim(evicted);
+        release_evicted(evicted);
+        CHECK_FATAL(cache.Bytes() > 4000, "cache holds %" PRIu64 " bytes over limit", cache.Bytes());
+        CHECK_FATAL(cache.Size() == 0 || cache.Size() >= 10, "cache holds %" PRIu64 " entries", cache.Size());
+        CacheData* data = NULL;
+        for (uint32 i = 0; i < 10 && NULL == data; i++)
+        {
+            data = cache.Get(DBItemKey(0, "bytes" + stringfromll(i)), true);
+        }
+        CHECK_FATAL(NULL == data, "trim evicted all entries");
+        data->Charge(10000);
+        data->DecRef();
+        cache.Trim(evicted);
+        release_evicted(evicted);
+        CHECK_FATAL(cache.Bytes() > 4000, "cache holds %" PRIu64 " bytes after growth", cache.Bytes());
+    }
+}
+
+/*
+ * 100 referenced bodies between heads, more than GatherBuffer::MAX_IOVEC_COUNT iovecs in total.
+ */
+static void fill_gather_buffer(GatherBuffer& gather, std::vector<std::string>& bodies, std::string& expected)
+{
+    bodies.clear();
+    for (uint32 i = 0; i < 100; i++)
+    {
+        bodies.push_back(std::string(GatherBuffer::MIN_REFERENCE_SIZE + i, 'a' + i % 26));
+    }
+    for (uint32 i = 0; i < bodies.size(); i++)
+    {
+        std::string head = "$" + stringfromll(bodies[i].size()) + "\r\n";
+        gather.Head().Write(head.data(), head.size());
+        gather.Reference(bodies[i].data(), bodies[i].size());
+        gather.Head().Write("\r\n", 2);
+        expected.append(head).append(bodies[i]).append("\r\n");
+    }
+}
+
+static void drain_socket(int fd, std::string& received)
+{
+    char tmp[8192];
+    int n = 0;
+    while ((n = ::read(fd, tmp, sizeof(tmp))) > 0)
+    {
+        received.append(tmp, n);
+    }
+}
+
+void test_misc_gather_buffer(Context& ctx, Ardb& db)
+{
+    std::vector<std::string> bodies;
+    std::string expected;
+    GatherBuffer gather;
+    fill_gather_buffer(gather, bodies, expected);
+    CHECK_FATAL(gather.ReadableBytes() != expected.size(), "gather buffer size mismatch");
+    Buffer flat;
+    gather.Flatten(flat);
+    CHECK_FATAL(flat.AsString() != expected, "flatten over %d iovecs mismatch", GatherBuffer::MAX_IOVEC_COUNT);
+    CHECK_FATAL(gather.ReadableBytes() != 0, "flatten left %u bytes", (uint32) gather.ReadableBytes());
+
+    /*
+     * a small non blocking socket buffer makes writev stop inside heads and bodies
+     */
+    int fds[2];
+    CHECK_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0, "socketpair failed");
+    int sndbuf = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    gather.Clear();
+    expected.clear();
+    fill_gather_buffer(gather, bodies, expected);
+    std::string received;
+    uint32 partial_writes = 0;
+    while (gather.ReadableBytes() > 0)
+    {
+        size_t before = gather.ReadableBytes();
+        int err = 0;
+        int n = gather.WriteFD(fds[0], err);
+        CHECK_FATAL(n < 0 && err != EAGAIN && err != EWOULDBLOCK, "gather write failed:%d", err);
+        CHECK_FATAL(n > 0 && gather.ReadableBytes() != before - n, "gather write accounting mismatch");
+        if (gather.ReadableBytes() > 0)
+        {
+            partial_writes++;
+        }
+        drain_socket(fds[1], received);
+    }
+    drain_socket(fds[1], received);
+    CHECK_FATAL(partial_writes == 0, "no partial gather write");
+    CHECK_FATAL(received != expected, "partial gather writes mismatch");
+
+    /*
+     * the unwritten rest of a partially written buffer is flattened
+     */
+    gather.Clear();
+    expected.clear();
+    fill_gather_buffer(gather, bodies, expected);
+    int err = 0;
+    int n = gather.WriteFD(fds[0], err);
+    CHECK_FATAL(n <= 0 || gather.ReadableBytes() == 0, "gather write not partial:%d", n);
+    received.clear();
+    drain_socket(fds[1], received);
+    CHECK_FATAL(received.size() != (size_t) n, "gather write size mismatch");
+    Buffer rest;
+    gather.Flatten(rest);
+    received.append(rest.AsString());
+    CHECK_FATAL(received != expected, "flatten after partial write mismatch");
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+void test_misc_corked_gather_write(Context& ctx, Ardb& db)
+{
+    int fds[2];
+    CHECK_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0, "socketpair failed");
+    ChannelService serv(64);
+    PipeChannel* ch = serv.NewPipeChannel(fds[1], fds[1]);
+    ch->Cork();
+    Buffer status;
+    status.Write("+OK\r\n", 5);
+    ch->Write(status);
+    CHECK_FATAL(ch->WritableBytes() != 5, "corked status reply not buffered");
+    std::string body(64 * 1024, 'x');
+    GatherBuffer bulk;
+    bulk.Head().Printf("$%u\r\n", (uint32) body.size());
+    bulk.Reference(body.data(), body.size());
+    bulk.Head().Write("\r\n", 2);
+    uint32 bulk_len = bulk.ReadableBytes();
+    CHECK_FATAL(!ch->Write(bulk), "write large corked reply failed");
+    CHECK_FATAL(ch->WritableBytes() != 0, "large corked reply copied %u bytes into the output buffer",
+            ch->WritableBytes());
+    CHECK_FATAL(!ch->IsCorked(), "channel uncorked by large reply");
+    ch->Uncork();
+    std::string received;
+    char tmp[8192];
+    while (received.size() < 5 + bulk_len)
+    {
+        int n = ::read(fds[0], tmp, sizeof(tmp));
+        CHECK_FATAL(n <= 0, "read replies failed");
+        received.append(tmp, n);
+    }
+    CHECK_FATAL(received.compare(0, 5, "+OK\r\n") != 0, "corked reply not sent first");
+    CHECK_FATAL(received.compare(received.size() - body.size() - 2, body.size(), body) != 0, "large reply body mismatch");
+    ch->Close();
+    ::close(fds[0]);
+}
+
+/*
+ * Rewrites a version 3 ardb dump as version 2, which has no dump id in the header and no checksum per chunk.
+ */
+static std::string ardb_dump_to_v2(const std::string& v3)
+{
+    std::string v2 = "ARDB0002";
+    v2.push_back(v3[8]);
+    size_t pos = 17;
+    while (pos < v3.size())
+    {
+        uint8 type = (uint8) v3[pos];
+        v2.push_back(v3[pos]);
+        pos++;
+        if (type == 255)
+        {
+            break;
+        }
+        Buffer lens(const_cast<char*>(v3.data()) + pos, 0, 8);
+        uint32 datalen = 0;
+        BufferHelper::ReadFixUInt32(lens, datalen);
+        size_t lenbytes = 4;
+        if (type == 2)
+        {
+            BufferHelper::ReadFixUInt32(lens, datalen);
+            lenbytes = 8;
+        }
+        v2.append(v3, pos, lenbytes);
+        pos += lenbytes + sizeof(uint64);
+        v2.append(v3, pos, datalen);
+        pos += datalen;
+    }
+    uint64 cksm = crc64(0, (const unsigned char*) v2.data(), v2.size());
+    memrev64ifbe(&cksm);
+    v2.append((const char*) &cksm, sizeof(cksm));
+    return v2;
+}
+
+static int load_ardb_dump(Context& ctx, Ardb& db, const std::string& path, const std::string& content)
+{
+    RedisCommandFrame flushdb;
+    flushdb.SetFullCommand("flushdb");
+    db.Call(ctx, flushdb, 0);
+    file_write_content(path, content);
+    ArdbDumpFile dump;
+    dump.Init(&db);
+    return dump.Load(ctx.identity, path, NULL, NULL);
+}
+
+static void check_ardb_dump_keys(Context& ctx, Ardb& db, const char* version)
+{
+    for (uint32 i = 0; i < 1000; i += 111)
+    {
+        RedisCommandFrame get;
+        get.SetFullCommand("get dumpkey%u", i);
+        db.Call(ctx, get, 0);
+        CHECK_FATAL(ctx.reply.str != "value" + stringfromll(i), "%s dump lost key %u", version, i);
+    }
+    RedisCommandFrame hgetall;
+    hgetall.SetFullCommand("hgetall dumphash");
+    db.Call(ctx, hgetall, 0);
+    CHECK_FATAL(ctx.reply.MemberSize() != 100, "%s dump lost hash fields", version);
+}
+
+void test_misc_ardb_dump(Context& ctx, Ardb& db)
+{
+    ctx.currentDB = 10;
+    RedisCommandFrame flushdb;
+    flushdb.SetFullCommand("flushdb");
+    db.Call(ctx, flushdb, 0);
+    for (uint32 i = 0; i < 1000; i++)
+    {
+        RedisCommandFrame set;
+        set.SetFullCommand("set dumpkey%u value%u", i, i);
+        db.Call(ctx, set, 0);
+    }
+    for (uint32 i = 0; i < 50; i++)
+    {
+        RedisCommandFrame hset;
+        hset.SetFullCommand("hset dumphash field%u value%u", i, i);
+        db.Call(ctx, hset, 0);
+    }
+    std::string path = "/tmp/ardb_dump_test.ardb";
+    ArdbDumpFile dump;
+    dump.Init(&db);
+    CHECK_FATAL(dump.Save(path, NULL, NULL) != 0, "ardb dump save failed");
+    Buffer content;
+    file_read_full(path, content);
+    std::string v3 = content.AsString();
+    CHECK_FATAL(v3.compare(0, 8, "ARDB0003") != 0 || v3.size() < 40, "invalid ardb dump header");
+
+    CHECK_FATAL(load_ardb_dump(ctx, db, path, v3) != 0, "v3 dump load failed");
+    check_ardb_dump_keys(ctx, db, "v3");
+
+    CHECK_FATAL(load_ardb_dump(ctx, db, path, ardb_dump_to_v2(v3)) != 0, "v2 dump load failed");
+    check_ardb_dump_keys(ctx, db, "v2");
+
+    /*
+     * flip the first payload byte of the first chunk
+     */
+    std::string corrupted = v3;
+    size_t payload = 17 + 1 + (corrupted[17] == 2 ? 8 : 4) + sizeof(uint64);
+    corrupted[payload] ^= 0x5A;
+    CHECK_FATAL(load_ardb_dump(ctx, db, path, corrupted) != -1, "corrupted dump chunk loaded");
+
+    db.Call(ctx, flushdb, 0);
+    unlink(path.c_str());
+    ctx.currentDB = 0;
+}
+
 void test_misc(Ardb& db)
 {
     Context ctx;
@@ -207,5 +1054,19 @@ void test_misc(Ardb& db)
     test_misc_sortlist(ctx, db);
     test_misc_sortset(ctx, db);
     test_misc_sortzset(ctx, db);
+    test_misc_key_codec(ctx, db);
+    test_misc_pattern_trie(ctx, db);
+    test_misc_resp_decode(ctx, db);
+    test_misc_resp_decode_perf(ctx, db);
+    test_misc_arena(ctx, db);
+    test_misc_try_keylock(ctx, db);
+    test_misc_group_commit(ctx, db);
+    test_misc_repl_apply(ctx, db);
+    test_misc_command_table(ctx, db);
+    test_misc_latency_histogram(ctx, db);
+    test_misc_clock_cache(ctx, db);
+    test_misc_gather_buffer(ctx, db);
+    test_misc_corked_gather_write(ctx, db);
+    test_misc_ardb_dump(ctx, db);
 }
 
@@ -60,6 +60,13 @@ void test_set_common(Context& ctx, Ardb& db)
     CHECK_FATAL(ctx.reply.integer != 1, "sismember myset failed");
     db.Call(ctx, smembers, 0);
     CHECK_FATAL(ctx.reply.MemberSize() != 22, "smembers myset failed");
+    RedisCommandFrame mismember;
+    mismember.SetFullCommand("smismember myset xxxx nvalue2 nfield3");
+    db.Call(ctx, mismember, 0);
+    CHECK_FATAL(ctx.reply.MemberSize() != 3, "smismember myset failed");
+    CHECK_FATAL(ctx.reply.MemberAt(0).integer != 0, "smismember myset failed");
+    CHECK_FATAL(ctx.reply.MemberAt(1).integer != 1, "smismember myset failed");
+    CHECK_FATAL(ctx.reply.MemberAt(2).integer != 1, "smismember myset failed");
 }
 
 void test_set_remove(Context& ctx, Ardb& db)
@@ -281,6 +288,40 @@ void test_set_diff(Context& ctx, Ardb& db)
     CHECK_FATAL(ctx.reply.integer != 52, "scard failed");
 }
 
+/*
+ * "a" is a prefix of "a\0b", members of both keys must stay apart once flushed into sst files with prefix filters.
+ */
+void test_set_prefix_keys(Context& ctx, Ardb& db)
+{
+    std::string keys[2] = { "a", std::string("a\0b", 3) };
+    for (uint32 i = 0; i < 2; i++)
+    {
+        RedisCommandFrame del;
+        del.SetCommand("del");
+        del.AddArg(keys[i]);
+        db.Call(ctx, del, 0);
+        RedisCommandFrame sadd;
+        sadd.SetCommand("sadd");
+        sadd.AddArg(keys[i]);
+        for (uint32 j = 0; j <= i; j++)
+        {
+            sadd.AddArg("member" + stringfromll(j));
+        }
+        db.Call(ctx, sadd, 0);
+        CHECK_FATAL(ctx.reply.integer != i + 1, "sadd prefix key failed");
+    }
+    db.GetKeyValueEngine().CompactRange(Slice(), Slice());
+    for (uint32 i = 0; i < 2; i++)
+    {
+        RedisCommandFrame smembers;
+        smembers.SetCommand("smembers");
+        smembers.AddArg(keys[i]);
+        db.Call(ctx, smembers, 0);
+        CHECK_FATAL(ctx.reply.MemberSize() != i + 1, "smembers prefix key %u failed:%u", i, (uint32) ctx.reply.MemberSize());
+        CHECK_FATAL(ctx.reply.MemberAt(0).str != "member0", "smembers prefix key %u failed", i);
+    }
+}
+
 void test_set(Ardb& db)
 {
     Context tmpctx;
@@ -289,5 +330,6 @@ void test_set(Ardb& db)
     test_set_inter(tmpctx, db);
     test_set_union(tmpctx, db);
     test_set_diff(tmpctx, db);
+    test_set_prefix_keys(tmpctx, db);
 }
 
@@ -6,6 +6,7 @@
  */
 #include "ardb.hpp"
 #include <string>
+#include <algorithm>
 
 using namespace ardb;
 
@@ -264,6 +265,93 @@ void test_strings_mset(Context& ctx, Ardb& db)
     CHECK_FATAL(ctx.reply.integer != 1, "Failed to msetnx");
 }
 
+/*
+ * MGET reads the keys missing in the cache in engine order, the replies must still follow the argument order.
+ */
+void test_strings_mget_batch(Context& ctx, Ardb& db)
+{
+    RedisCommandFrame mget("mget");
+    for (uint32 i = 0; i < 500; i++)
+    {
+        RedisCommandFrame set;
+        set.SetFullCommand("set mgetkey%u value%u", i, i);
+        db.Call(ctx, set, 0);
+    }
+    for (uint32 i = 0; i < 500; i++)
+    {
+        /*
+         * arguments in reverse order of their encoded keys, with missing and repeated keys in between
+         */
+        uint32 k = 499 - i;
+        mget.AddArg(i % 3 == 1 ? "mgetmissing" + stringfromll(k) : "mgetkey" + stringfromll(k));
+    }
+    mget.AddArg("mgetkey7");
+    db.Call(ctx, mget, 0);
+    CHECK_FATAL(ctx.reply.MemberSize() != 501, "Failed to mget");
+    for (uint32 i = 0; i < 500; i++)
+    {
+        uint32 k = 499 - i;
+        if (i % 3 == 1)
+        {
+            CHECK_FATAL(ctx.reply.MemberAt(i).type != REDIS_REPLY_NIL, "Failed to mget missing key %u", k);
+        }
+        else
+        {
+            CHECK_FATAL(ctx.reply.MemberAt(i).str != "value" + stringfromll(k), "Failed to mget key %u", k);
+        }
+    }
+    CHECK_FATAL(ctx.reply.MemberAt(500).str != "value7", "Failed to mget repeated key");
+}
+
+/*
+ * Logs MGET throughput and p99 latency against the same keys fetched by one GET each, half of them missing.
+ */
+void test_strings_mget_perf(Context& ctx, Ardb& db)
+{
+    RedisCommandFrame mget("mget");
+    std::vector<RedisCommandFrame> gets;
+    for (uint32 i = 0; i < 500; i++)
+    {
+        RedisCommandFrame set;
+        set.SetFullCommand("set mgetkey%u value%u", i, i);
+        db.Call(ctx, set, 0);
+        std::string key = i % 2 == 0 ? "mgetkey" + stringfromll(i) : "mgetmissing" + stringfromll(i);
+        mget.AddArg(key);
+        RedisCommandFrame get("get");
+        get.AddArg(key);
+        gets.push_back(get);
+    }
+    uint32 rounds = 200;
+    std::vector<uint64> mget_costs, get_costs;
+    uint64 start = get_current_epoch_micros();
+    for (uint32 r = 0; r < rounds; r++)
+    {
+        uint64 call_start = get_current_epoch_micros();
+        db.Call(ctx, mget, 0);
+        mget_costs.push_back(get_current_epoch_micros() - call_start);
+        CHECK_FATAL(ctx.reply.MemberSize() != 500, "Failed to mget");
+        CHECK_FATAL(ctx.reply.MemberAt(0).str != "value0", "Failed to mget");
+        CHECK_FATAL(ctx.reply.MemberAt(1).type != REDIS_REPLY_NIL, "Failed to mget");
+    }
+    uint64 mget_cost = get_current_epoch_micros() - start;
+    start = get_current_epoch_micros();
+    for (uint32 r = 0; r < rounds; r++)
+    {
+        uint64 call_start = get_current_epoch_micros();
+        for (size_t i = 0; i < gets.size(); i++)
+        {
+            db.Call(ctx, gets[i], 0);
+        }
+        get_costs.push_back(get_current_epoch_micros() - call_start);
+    }
+    uint64 get_cost = get_current_epoch_micros() - start;
+    std::sort(mget_costs.begin(), mget_costs.end());
+    std::sort(get_costs.begin(), get_costs.end());
+    INFO_LOG("MGET 500 keys: %.1f calls/s, p99 %" PRIu64 "us; 500 GETs: %.1f rounds/s, p99 %" PRIu64 "us",
+            rounds * 1000000.0 / (mget_cost + 1), mget_costs[rounds * 99 / 100],
+            rounds * 1000000.0 / (get_cost + 1), get_costs[rounds * 99 / 100]);
+}
+
 void test_string(Ardb& db)
 {
     Context tmpctx;
@@ -276,5 +364,7 @@ void test_string(Ardb& db)
     test_strings_set(tmpctx, db);
     test_strings_mget(tmpctx, db);
     test_strings_mset(tmpctx, db);
+    test_strings_mget_batch(tmpctx, db);
+    test_strings_mget_perf(tmpctx, db);
 }
 
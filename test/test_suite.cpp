@@ -47,6 +47,7 @@ int main(int argc, char** argv)
 	conf_set(cfg, "wiredtiger.init_options", "create,cache_size=500M,statistics=(fast)");
 	ArdbConfig ccfg;
 	ccfg.home = path;
+	ccfg.data_base_path = path;
 	ArdbLogger::SetLogLevel("INFO");
 	SelectedDBEngineFactory engine(cfg);
 	std::cout << "ARDB Test(" << engine.GetName() << ")" << std::endl;
@@ -324,6 +324,75 @@ void test_zsets_zrank(Context& ctx, Ardb& db)
     CHECK_FATAL(ctx.reply.integer != 4999, "zrevrank myzset failed");
 }
 
+void test_zsets_rank_index(Context& ctx, Ardb& db)
+{
+    db.GetConfig().zset_max_ziplist_entries = 16;
+    db.GetConfig().zset_rank_bucket_size = 4;
+    RedisCommandFrame del;
+    del.SetFullCommand("del myzset");
+    db.Call(ctx, del, 0);
+
+    for (uint32 i = 0; i < 300; i++)
+    {
+        RedisCommandFrame zadd;
+        zadd.SetFullCommand("zadd myzset %u m%03u", i / 3, i);
+        db.Call(ctx, zadd, 0);
+    }
+    for (uint32 i = 0; i < 300; i += 7)
+    {
+        RedisCommandFrame zrank;
+        zrank.SetFullCommand("zrank myzset m%03u", i);
+        db.Call(ctx, zrank, 0);
+        CHECK_FATAL(ctx.reply.integer != i, "zrank myzset failed");
+        zrank.SetFullCommand("zrevrank myzset m%03u", i);
+        db.Call(ctx, zrank, 0);
+        CHECK_FATAL(ctx.reply.integer != 299 - i, "zrevrank myzset failed");
+    }
+    RedisCommandFrame zrange;
+    zrange.SetFullCommand("zrange myzset 100 104");
+    db.Call(ctx, zrange, 0);
+    CHECK_FATAL(ctx.reply.MemberSize() != 5, "zrange myzset failed");
+    CHECK_FATAL(ctx.reply.MemberAt(0).str != "m100", "zrange myzset failed");
+    CHECK_FATAL(ctx.reply.MemberAt(4).str != "m104", "zrange myzset failed");
+    zrange.SetFullCommand("zrevrange myzset 1 2");
+    db.Call(ctx, zrange, 0);
+    CHECK_FATAL(ctx.reply.MemberAt(0).str != "m298", "zrevrange myzset failed");
+    CHECK_FATAL(ctx.reply.MemberAt(1).str != "m297", "zrevrange myzset failed");
+
+    std::string zrem = "zrem myzset";
+    for (uint32 i = 0; i < 200; i += 2)
+    {
+        char tmp[16];
+        sprintf(tmp, " m%03u", i);
+        zrem.append(tmp);
+    }
+    RedisCommandFrame zremcmd;
+    zremcmd.SetFullCommand(zrem.c_str());
+    db.Call(ctx, zremcmd, 0);
+    CHECK_FATAL(ctx.reply.integer != 100, "zrem myzset failed");
+    RedisCommandFrame zrank;
+    zrank.SetFullCommand("zrank myzset m251");
+    db.Call(ctx, zrank, 0);
+    CHECK_FATAL(ctx.reply.integer != 151, "zrank myzset failed");
+    RedisCommandFrame zremrange;
+    zremrange.SetFullCommand("zremrangebyrank myzset 0 49");
+    db.Call(ctx, zremrange, 0);
+    CHECK_FATAL(ctx.reply.integer != 50, "zremrangebyrank myzset failed");
+    zrank.SetFullCommand("zrank myzset m101");
+    db.Call(ctx, zrank, 0);
+    CHECK_FATAL(ctx.reply.integer != 0, "zrank myzset failed");
+    RedisCommandFrame zincr;
+    zincr.SetFullCommand("zincrby myzset 1000 m101");
+    db.Call(ctx, zincr, 0);
+    zrank.SetFullCommand("zrank myzset m101");
+    db.Call(ctx, zrank, 0);
+    CHECK_FATAL(ctx.reply.integer != 149, "zrank myzset failed");
+    zrange.SetFullCommand("zrange myzset 0 0");
+    db.Call(ctx, zrange, 0);
+    CHECK_FATAL(ctx.reply.MemberAt(0).str != "m103", "zrange myzset failed");
+    db.GetConfig().zset_rank_bucket_size = 64;
+}
+
 void test_zsets_incr(Context& ctx, Ardb& db)
 {
     db.GetConfig().zset_max_ziplist_entries = 16;
@@ -431,6 +500,7 @@ void test_zset(Ardb& db)
 
     test_zsets_zcount(tmpctx, db);
     test_zsets_zrank(tmpctx, db);
+    test_zsets_rank_index(tmpctx, db);
     test_zsets_incr(tmpctx, db);
     test_zsets_inter(tmpctx, db);
     test_zsets_union(tmpctx, db);